@@ -0,0 +1,349 @@
+/** \file   ark.c
+ * \brief   ARKive container handling
+ *
+ * An ARKive starts with the number of files and a directory of 29-byte
+ * entries, padded to whole 254-byte blocks. The files follow, each padded to
+ * whole blocks, so the data of each file is found by adding up the lengths
+ * of the files in front of it. REL files have their side sectors after their
+ * data.
+ *
+ * SRK archives use the same layout, but their files can be compressed, and
+ * compressed files aren't block aligned. The compression scheme isn't
+ * documented, so compressed files and the files stored after them can't be
+ * extracted and are counted as unavailable.
+ *
+ * See doc/reference/formats/ark-srk.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "io.h"
+#include "petasc.h"
+#include "cbmdos.h"
+#include "d64.h"
+#include "d64write.h"
+
+#include "ark.h"
+
+
+/** \brief  Locate the data of the files in \a ark
+ *
+ * Files cut short by the end of the archive keep the data that's there and
+ * are counted in \c ark->truncated.
+ *
+ * \param[in,out]   ark ARKive handle
+ */
+static void ark_locate(zcc_ark_t *ark)
+{
+    size_t offset = (size_t)ark->dir_blocks * ZCC_ARK_BLOCK_SIZE;
+    bool lost = false;
+
+    for (int i = 0; i < ark->entry_count; i++) {
+        zcc_ark_entry_t *entry = &ark->entries[i];
+        int data_blocks = entry->blocks - entry->side_sectors;
+        size_t size = 0;
+
+        if (entry->compressed) {
+            /* not block aligned: the files after this one are lost too */
+            lost = true;
+        }
+        if (lost) {
+            entry->data = NULL;
+            entry->size = 0;
+            ark->unavailable++;
+            continue;
+        }
+
+        if (data_blocks > 0) {
+            size = (size_t)(data_blocks - 1) * ZCC_ARK_BLOCK_SIZE
+                + (size_t)entry->lsu - 1;
+        }
+        if (offset > ark->size) {
+            offset = ark->size;
+        }
+        if (size > ark->size - offset) {
+            size = ark->size - offset;
+            ark->truncated++;
+        }
+        entry->data = ark->data + offset;
+        entry->size = size;
+        offset += (size_t)entry->blocks * ZCC_ARK_BLOCK_SIZE;
+    }
+}
+
+
+/** \brief  Parse directory of \a ark
+ *
+ * ARKives don't have a signature, so the directory is checked for valid file
+ * types and sizes instead.
+ *
+ * \param[in,out]   ark ARKive handle
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+static bool ark_parse(zcc_ark_t *ark)
+{
+    size_t dir_size;
+    int count;
+
+    if (ark->size < 1) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+    count = ark->data[ZCC_ARK_FILE_COUNT];
+    dir_size = 1 + (size_t)count * ZCC_ARK_DIRENT_SIZE;
+    if (count == 0 || dir_size > ark->size) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+    ark->dir_blocks = (int)((dir_size + ZCC_ARK_BLOCK_SIZE - 1) / ZCC_ARK_BLOCK_SIZE);
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t *dirent = ark->data + 1 + i * ZCC_ARK_DIRENT_SIZE;
+        zcc_ark_entry_t *entry = &ark->entries[i];
+        int type = dirent[ZCC_ARK_DIRENT_TYPE] & ZCC_CBMDOS_FILETYPE_MASK;
+
+        entry->blocks = dirent[ZCC_ARK_DIRENT_BLOCKS]
+            | (dirent[ZCC_ARK_DIRENT_BLOCKS + 1] << 8);
+        entry->lsu = dirent[ZCC_ARK_DIRENT_LSU];
+        if (type > ZCC_CBMDOS_FILETYPE_REL
+                || (entry->blocks > 0 && entry->lsu < 1)) {
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+            return false;
+        }
+        memcpy(entry->name, dirent + ZCC_ARK_DIRENT_FILENAME,
+               ZCC_CBMDOS_FILENAME_MAX);
+        entry->type = (zcc_cbmdos_filetype_t)type;
+        entry->compressed = (dirent[ZCC_ARK_DIRENT_TYPE] & ZCC_ARK_COMPRESSED_MASK) != 0;
+        entry->record_size = 0;
+        entry->side_sectors = 0;
+        if (entry->type == ZCC_CBMDOS_FILETYPE_REL) {
+            /* REL files are never compressed */
+            entry->compressed = false;
+            entry->record_size = dirent[ZCC_ARK_DIRENT_RECORD_SIZE];
+            entry->side_sectors = dirent[ZCC_ARK_DIRENT_SIDE_BLOCKS];
+            if (entry->side_sectors > entry->blocks) {
+                zcc_errno = ZCC_ERR_INVALID_IMAGE;
+                return false;
+            }
+        }
+        ark->entry_count++;
+    }
+
+    ark_locate(ark);
+    return true;
+}
+
+
+/** \brief  Initialize ARKive handle \a ark
+ *
+ * \param[out]  ark ARKive handle
+ */
+void zcc_ark_init(zcc_ark_t *ark)
+{
+    ark->data = NULL;
+    ark->size = 0;
+    ark->dir_blocks = 0;
+    ark->entry_count = 0;
+    ark->truncated = 0;
+    ark->unavailable = 0;
+}
+
+
+/** \brief  Free memory used by the members of \a ark
+ *
+ * \param[in,out]   ark ARKive handle
+ */
+void zcc_ark_free(zcc_ark_t *ark)
+{
+    if (ark->data != NULL) {
+        zcc_free(ark->data);
+    }
+    zcc_ark_init(ark);
+}
+
+
+/** \brief  Read ARK or SRK archive \a path into \a ark
+ *
+ * \param[in,out]   ark     ARKive handle
+ * \param[in]       path    path to archive
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+bool zcc_ark_read(zcc_ark_t *ark, const char *path)
+{
+    long size;
+
+    zcc_ark_free(ark);
+    size = zcc_fread_alloc(&ark->data, path);
+    if (size < 0) {
+        return false;
+    }
+    ark->size = (size_t)size;
+    if (!ark_parse(ark)) {
+        zcc_ark_free(ark);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Dump directory of \a ark on stdout
+ *
+ * \param[in]   ark ARKive handle
+ */
+void zcc_ark_dump(const zcc_ark_t *ark)
+{
+    printf("%d directory blocks, %d files:\n",
+            ark->dir_blocks, ark->entry_count);
+    for (int i = 0; i < ark->entry_count; i++) {
+        const zcc_ark_entry_t *entry = &ark->entries[i];
+        char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+        zcc_pet_filename_to_host(host, entry->name, NULL);
+        if (entry->data == NULL) {
+            printf("%-5d \"%s\" %s  (%s)\n",
+                   entry->blocks, host, zcc_cbmdos_filetype_str(entry->type),
+                   entry->compressed ? "compressed" : "not found");
+        } else {
+            printf("%-5d \"%s\" %s  ($%06lx, %lu bytes)\n",
+                   entry->blocks, host, zcc_cbmdos_filetype_str(entry->type),
+                   (unsigned long)(entry->data - ark->data),
+                   (unsigned long)(entry->size));
+        }
+    }
+}
+
+
+/** \brief  Write files in \a ark to host files
+ *
+ * Files are written to the current directory as 'name.ext', with 'ext' the
+ * file type. The data of REL files is written without side sectors. Files
+ * that can't be extracted are skipped, unless asked for by \a name.
+ *
+ * \param[in]   ark     ARKive handle
+ * \param[in]   name    only extract file \a name (host filename, without
+ *                      extension), or NULL to extract all files
+ * \param[in]   verbose print the name and size of each file
+ *
+ * \return  number of files extracted or -1 on error
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ * \throw   ZCC_ERR_UNSUPPORTED
+ */
+int zcc_ark_extract(const zcc_ark_t *ark, const char *name, bool verbose)
+{
+    int count = 0;
+
+    for (int i = 0; i < ark->entry_count; i++) {
+        const zcc_ark_entry_t *entry = &ark->entries[i];
+        char host[ZCC_CBMDOS_FILENAME_MAX + 5];
+
+        if (name != NULL) {
+            zcc_pet_filename_to_host(host, entry->name, NULL);
+            if (strcmp(host, name) != 0) {
+                continue;
+            }
+            if (entry->data == NULL) {
+                zcc_errno = ZCC_ERR_UNSUPPORTED;
+                return -1;
+            }
+        } else if (entry->data == NULL) {
+            continue;
+        }
+        zcc_pet_filename_to_host(host, entry->name,
+                                 zcc_cbmdos_filetype_str(entry->type));
+        if (!zcc_fwrite(host, entry->data, entry->size)) {
+            return -1;
+        }
+        if (verbose) {
+            printf("%-20s %6lu bytes\n", host, (unsigned long)(entry->size));
+        }
+        count++;
+    }
+    if (name != NULL && count == 0) {
+        zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+        return -1;
+    }
+    return count;
+}
+
+
+/** \brief  Convert \a ark to D64 image \a d64
+ *
+ * \a d64 must have been allocated, it gets formatted with disk name \a name.
+ * The blocks of each file are copied from the archive into its block chain
+ * as is, files that can't be extracted are skipped.
+ *
+ * \param[in]       ark     ARKive handle
+ * \param[in,out]   d64     D64 image
+ * \param[in]       name    disk name (ASCII)
+ *
+ * \return  number of files written, or -1 on error
+ * \throw   ZCC_ERR_FILETYPE    REL files aren't supported
+ * \throw   ZCC_ERR_DISK_FULL
+ * \throw   ZCC_ERR_DIR_FULL
+ */
+int zcc_ark_to_d64(const zcc_ark_t *ark, zcc_d64_t *d64, const char *name)
+{
+    zcc_d64_newfile_t files[ZCC_ARK_FILES_MAX];
+    char names[ZCC_ARK_FILES_MAX][ZCC_CBMDOS_FILENAME_MAX + 1];
+    int count = 0;
+
+    zcc_d64_format(d64, name, "00");
+
+    for (int i = 0; i < ark->entry_count; i++) {
+        const zcc_ark_entry_t *entry = &ark->entries[i];
+        size_t len = ZCC_CBMDOS_FILENAME_MAX;
+
+        if (entry->data == NULL) {
+            continue;
+        }
+        while (len > 0 && entry->name[len - 1] == 0xa0) {
+            len--;
+        }
+        zcc_pet_to_asc_str(names[count], entry->name, len);
+        files[count].name = names[count];
+        files[count].type = entry->type;
+        files[count].head = NULL;
+        files[count].head_size = 0;
+        files[count].data = entry->data;
+        files[count].size = entry->size;
+        count++;
+    }
+    if (zcc_d64_write_files(d64, files, count) < count) {
+        return -1;
+    }
+    return count;
+}
@@ -0,0 +1,129 @@
+/** \file   ark.h
+ * \brief   ARKive container handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_ARK_H
+#define ZCC_ARK_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbmdos.h"
+#include "d64.h"
+
+
+/** \brief  Maximum number of files in an ARKive
+ */
+#define ZCC_ARK_FILES_MAX       255
+
+/** \brief  Size of a block in an ARKive
+ */
+#define ZCC_ARK_BLOCK_SIZE      ZCC_D64_BLOCK_SIZE_DATA
+
+/** \brief  Offset of the number of files, the directory entries follow it
+ */
+#define ZCC_ARK_FILE_COUNT      0x00
+
+/** \brief  Size of a directory entry
+ */
+#define ZCC_ARK_DIRENT_SIZE     0x1d
+
+/** \brief  Offset in a directory entry of the file attribute
+ */
+#define ZCC_ARK_DIRENT_TYPE     0x00
+
+/** \brief  Offset in a directory entry of the number of bytes used in the
+ *          last block, plus one
+ */
+#define ZCC_ARK_DIRENT_LSU      0x01
+
+/** \brief  Offset in a directory entry of the PETSCII filename
+ */
+#define ZCC_ARK_DIRENT_FILENAME 0x02
+
+/** \brief  Offset in a directory entry of the record size of a REL file
+ */
+#define ZCC_ARK_DIRENT_RECORD_SIZE  0x12
+
+/** \brief  Offset in a directory entry of the number of side sector blocks of
+ *          a REL file
+ */
+#define ZCC_ARK_DIRENT_SIDE_BLOCKS  0x19
+
+/** \brief  Offset in a directory entry of the length in blocks (16-bit LE)
+ */
+#define ZCC_ARK_DIRENT_BLOCKS   0x1b
+
+/** \brief  File attribute bit of compressed files in SRK archives
+ */
+#define ZCC_ARK_COMPRESSED_MASK 0x10
+
+
+/** \brief  File in an ARKive
+ */
+typedef struct zcc_ark_entry_s {
+    uint8_t                 name[ZCC_CBMDOS_FILENAME_MAX];  /**< PETSCII name,
+                                                                 padded with
+                                                                 0xa0 */
+    zcc_cbmdos_filetype_t   type;   /**< file type */
+    bool                    compressed; /**< compressed (SRK) */
+    int                     blocks; /**< length in blocks, including side
+                                         sectors of REL files */
+    int                     lsu;    /**< number of bytes used in the last data
+                                         block, plus one */
+    int                     record_size;    /**< record size of REL files */
+    int                     side_sectors;   /**< number of side sector blocks
+                                                 after the data of REL
+                                                 files */
+    const uint8_t *         data;   /**< file data, points into the
+                                         archive, `NULL` when the data can't
+                                         be located */
+    size_t                  size;   /**< size of \c data in bytes */
+} zcc_ark_entry_t;
+
+
+/** \brief  ARKive handle
+ */
+typedef struct zcc_ark_s {
+    uint8_t *           data;       /**< archive data */
+    size_t              size;       /**< size of \c data */
+    int                 dir_blocks; /**< size of the directory in blocks */
+    zcc_ark_entry_t     entries[ZCC_ARK_FILES_MAX]; /**< files, in directory
+                                                         order */
+    int                 entry_count;    /**< number of files */
+    int                 truncated;  /**< number of files cut short by the end
+                                         of the archive */
+    int                 unavailable;    /**< number of files whose data can't
+                                             be extracted */
+} zcc_ark_t;
+
+
+void zcc_ark_init(zcc_ark_t *ark);
+void zcc_ark_free(zcc_ark_t *ark);
+bool zcc_ark_read(zcc_ark_t *ark, const char *path);
+void zcc_ark_dump(const zcc_ark_t *ark);
+int  zcc_ark_extract(const zcc_ark_t *ark, const char *name, bool verbose);
+int  zcc_ark_to_d64(const zcc_ark_t *ark, zcc_d64_t *d64, const char *name);
+
+#endif
@@ -0,0 +1,589 @@
+/** \file   bam.c
+ * \brief   D64 block availability map
+ *
+ * Works on a copy of the BAM held as one 64-bit word per track, so counting
+ * free blocks is a popcount per track and finding a free sector is a
+ * count-trailing-zeros, instead of testing bits one by one. The on-disk BAM
+ * entries are only touched when loading and storing the map.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "d64.h"
+
+#include "bam.h"
+
+
+#if defined(__GNUC__)
+
+/** \brief  Number of bits set in \a W
+ */
+# define bam_popcount(W)    __builtin_popcountll(W)
+
+/** \brief  Index of the lowest bit set in \a W (\a W must not be 0)
+ */
+# define bam_ctz(W)         __builtin_ctzll(W)
+
+#else
+
+/** \brief  Count number of bits set in \a w
+ *
+ * \param[in]   w   word
+ *
+ * \return  number of set bits in \a w
+ */
+static int bam_popcount(uint64_t w)
+{
+    int c = 0;
+
+    while (w) {
+        w &= w - 1U;
+        c++;
+    }
+    return c;
+}
+
+
+/** \brief  Get index of lowest bit set in \a w
+ *
+ * \param[in]   w   word, must not be 0
+ *
+ * \return  bit index
+ */
+static int bam_ctz(uint64_t w)
+{
+    int c = 0;
+
+    while (!(w & 1U)) {
+        w >>= 1;
+        c++;
+    }
+    return c;
+}
+
+#endif
+
+
+/** \brief  Get bitmask with all sectors of \a track set
+ *
+ * \param[in]   bam     BAM
+ * \param[in]   track   track number
+ *
+ * \return  bitmask
+ */
+static uint64_t bam_track_mask(const zcc_bam_t *bam, int track)
+{
+    return ((uint64_t)1 << bam->geometry->sectors[track]) - 1U;
+}
+
+
+/** \brief  Extract the bits of \a track from block bitmap \a blocks
+ *
+ * \param[in]   bam     BAM
+ * \param[in]   blocks  bitmap indexed by block number (see
+ *                      #ZCC_D64_BITMAP_GET)
+ * \param[in]   track   track number
+ *
+ * \return  bits for \a track, bit N being sector N
+ */
+static uint64_t bam_bitmap_extract(const zcc_bam_t *bam,
+                                   const uint64_t *blocks,
+                                   int track)
+{
+    int index = bam->geometry->track_block[track];
+    int word = index / 64;
+    int bit = index % 64;
+    int sectors = bam->geometry->sectors[track];
+    uint64_t bits;
+
+    bits = blocks[word] >> bit;
+    if (bit + sectors > 64) {
+        bits |= blocks[word + 1] << (64 - bit);
+    }
+    return bits & bam_track_mask(bam, track);
+}
+
+
+/** \brief  Locate the on-disk BAM entry of \a track in \a data
+ *
+ * D64 entries are four bytes in (18,0). The D71 keeps the free counts of
+ * tracks 36-70 at the end of (18,0) and their bitmaps in (53,0). D81 entries
+ * are six bytes, in (40,1) for tracks 1-40 and (40,2) for tracks 41-80.
+ *
+ * \param[in]   bam     BAM
+ * \param[in]   data    image data
+ * \param[in]   track   track number
+ * \param[out]  count   free count of the entry
+ * \param[out]  bitmap  bitmap of the entry (\a bytes bytes)
+ * \param[out]  bytes   size of the bitmap in bytes
+ */
+static void bam_entry(const zcc_bam_t *bam, uint8_t *data, int track,
+                      uint8_t **count, uint8_t **bitmap, int *bytes)
+{
+    const zcc_d64_geometry_t *geometry = bam->geometry;
+    uint8_t *sector = data + zcc_d64_geometry_block_offset(geometry,
+                                                           geometry->bam_track,
+                                                           geometry->bam_sector);
+    uint8_t *sector2 = NULL;
+
+    if (geometry->bam2_track != 0) {
+        sector2 = data + zcc_d64_geometry_block_offset(geometry,
+                                                       geometry->bam2_track,
+                                                       geometry->bam2_sector);
+    }
+
+    switch (geometry->format) {
+        case ZCC_D64_FORMAT_D81:
+            if (track > ZCC_D81_DIR_TRACK) {
+                sector = sector2;
+                track -= ZCC_D81_DIR_TRACK;
+            }
+            *count = sector + ZCC_D81_BAM_TRACKS
+                + (track - 1) * ZCC_D81_BAMENT_SIZE;
+            *bitmap = *count + 1;
+            *bytes = ZCC_D81_BAMENT_SIZE - 1;
+            return;
+        case ZCC_D64_FORMAT_D71:
+            if (track > ZCC_D64_TRACK_MAX) {
+                track -= ZCC_D64_TRACK_MAX + 1;
+                *count = sector + ZCC_D71_BAM_COUNTS + track;
+                *bytes = ZCC_D64_BAMENT_SIZE - 1;
+                *bitmap = sector2 + track * *bytes;
+                return;
+            }
+            /* fall through */
+        case ZCC_D64_FORMAT_D64:   /* fall through */
+        case ZCC_D64_FORMAT_COUNT:  /* fall through */
+        default:
+            *count = sector + zcc_d64_bament_offset(bam->type, track)
+                + ZCC_D64_BAMENT_COUNT;
+            *bitmap = *count - ZCC_D64_BAMENT_COUNT + ZCC_D64_BAMENT_BITMAP;
+            *bytes = ZCC_D64_BAMENT_SIZE - 1;
+            return;
+    }
+}
+
+
+/** \brief  Initialize \a bam for \a geometry with all sectors free
+ *
+ * \param[out]  bam         BAM
+ * \param[in]   geometry    disk geometry
+ * \param[in]   type        DOS type
+ * \param[in]   track_max   number of tracks
+ */
+static void bam_setup(zcc_bam_t *bam,
+                      const zcc_d64_geometry_t *geometry,
+                      zcc_d64_type_t type,
+                      int track_max)
+{
+    bam->geometry = geometry;
+    bam->type = type;
+    bam->track_max = track_max;
+    bam->tracks[0] = 0;
+    for (int track = ZCC_D64_TRACK_MIN;
+            track <= ZCC_D64_GEOMETRY_TRACK_MAX;
+            track++) {
+        bam->tracks[track] = track <= track_max
+            ? bam_track_mask(bam, track) : 0;
+    }
+}
+
+
+/** \brief  Find free sector in \a bits, starting at \a start
+ *
+ * Wraps around to sector 0 if no free sector at or above \a start exists.
+ *
+ * \param[in]   bits    free-sector bitmap of a track
+ * \param[in]   start   sector to start looking at
+ *
+ * \return  sector number or -1 if the track is full
+ */
+static int bam_find_free(uint64_t bits, int start)
+{
+    uint64_t above = bits & (~(uint64_t)0 << start);
+
+    if (above != 0) {
+        return bam_ctz(above);
+    }
+    if (bits != 0) {
+        return bam_ctz(bits);
+    }
+    return -1;
+}
+
+
+/** \brief  Initialize \a bam of a D64 with all sectors free
+ *
+ * \param[out]  bam         BAM
+ * \param[in]   type        DOS type
+ * \param[in]   track_max   number of tracks (35 or 40)
+ */
+void zcc_bam_init(zcc_bam_t *bam, zcc_d64_type_t type, int track_max)
+{
+    bam_setup(bam, zcc_d64_geometry(ZCC_D64_FORMAT_D64), type, track_max);
+}
+
+
+/** \brief  Initialize \a bam of an image of \a geometry with all sectors free
+ *
+ * \param[out]  bam         BAM
+ * \param[in]   geometry    disk geometry
+ * \param[in]   type        DOS type
+ * \param[in]   track_max   number of tracks in the BAM
+ */
+void zcc_bam_init_geometry(zcc_bam_t *bam,
+                           const zcc_d64_geometry_t *geometry,
+                           zcc_d64_type_t type,
+                           int track_max)
+{
+    bam_setup(bam, geometry, type, track_max);
+}
+
+
+/** \brief  Load BAM of \a d64 into \a bam
+ *
+ * Tracks 36-40 of a D64 are loaded for 40-track images with a DOS type that
+ * has an extended BAM. A 40-track image with type #ZCC_D64_TYPE_CBMDOS is
+ * handled as a 35-track image. D71 and D81 images always have all tracks of
+ * their geometry.
+ *
+ * \param[out]  bam BAM
+ * \param[in]   d64 D64 image
+ */
+void zcc_bam_load(zcc_bam_t *bam, const zcc_d64_t *d64)
+{
+    int track_max = ZCC_D64_TRACK_MAX;
+
+    if (d64->geometry->format != ZCC_D64_FORMAT_D64) {
+        track_max = d64->geometry->track_max;
+    } else if (d64->size == ZCC_D64_SIZE_EXTENDED
+            && zcc_d64_bament_offset(d64->type, ZCC_D64_TRACK_MAX_EXT) >= 0) {
+        track_max = ZCC_D64_TRACK_MAX_EXT;
+    }
+    bam_setup(bam, d64->geometry, d64->type, track_max);
+
+    for (int track = ZCC_D64_TRACK_MIN; track <= track_max; track++) {
+        uint8_t *count;
+        uint8_t *entry;
+        uint64_t bits = 0;
+        int bytes;
+
+        bam_entry(bam, d64->data, track, &count, &entry, &bytes);
+        for (int i = bytes - 1; i >= 0; i--) {
+            bits = (bits << 8) | entry[i];
+        }
+        bam->tracks[track] = bits & bam_track_mask(bam, track);
+    }
+}
+
+
+/** \brief  Write \a bam into the BAM sector(s) of \a d64
+ *
+ * Updates the free count and bitmap of each BAM entry, the rest of the BAM
+ * sectors is left as-is.
+ *
+ * \param[in]       bam BAM
+ * \param[in,out]   d64 D64 image
+ */
+void zcc_bam_store(const zcc_bam_t *bam, zcc_d64_t *d64)
+{
+    for (int track = ZCC_D64_TRACK_MIN; track <= bam->track_max; track++) {
+        uint8_t *count;
+        uint8_t *entry;
+        uint64_t bits = bam->tracks[track];
+        int bytes;
+
+        bam_entry(bam, d64->data, track, &count, &entry, &bytes);
+        *count = (uint8_t)bam_popcount(bits);
+        for (int i = 0; i < bytes; i++) {
+            entry[i] = (uint8_t)((bits >> (i * 8)) & 0xff);
+        }
+    }
+}
+
+
+/** \brief  Get number of free sectors on \a track
+ *
+ * \param[in]   bam     BAM
+ * \param[in]   track   track number
+ *
+ * \return  free sectors, 0 for tracks outside \a bam
+ */
+int zcc_bam_track_free(const zcc_bam_t *bam, int track)
+{
+    if (track < ZCC_D64_TRACK_MIN || track > bam->track_max) {
+        return 0;
+    }
+    return bam_popcount(bam->tracks[track]);
+}
+
+
+/** \brief  Get number of free blocks in \a bam
+ *
+ * \param[in]   bam BAM
+ *
+ * \return  blocks free, excluding the directory track like CBM DOS does (and
+ *          the second BAM track of a D71, like the 1571)
+ */
+int zcc_bam_blocks_free(const zcc_bam_t *bam)
+{
+    int blocks = 0;
+
+    for (int track = ZCC_D64_TRACK_MIN; track <= bam->track_max; track++) {
+        if (track != bam->geometry->dir_track
+                && track != bam->geometry->bam2_track) {
+            blocks += bam_popcount(bam->tracks[track]);
+        }
+    }
+    return blocks;
+}
+
+
+/** \brief  Count sectors with a different state in \a bam1 and \a bam2
+ *
+ * \param[in]   bam1    BAM
+ * \param[in]   bam2    BAM
+ *
+ * \return  number of sectors free in one BAM but used in the other
+ */
+int zcc_bam_diff(const zcc_bam_t *bam1, const zcc_bam_t *bam2)
+{
+    int count = 0;
+
+    for (int track = ZCC_D64_TRACK_MIN;
+            track <= ZCC_D64_GEOMETRY_TRACK_MAX;
+            track++) {
+        count += bam_popcount(bam1->tracks[track] ^ bam2->tracks[track]);
+    }
+    return count;
+}
+
+
+/** \brief  Check if (\a track, \a sector) is free
+ *
+ * \param[in]   bam     BAM
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  true if free
+ */
+bool zcc_bam_is_free(const zcc_bam_t *bam, int track, int sector)
+{
+    if (track < ZCC_D64_TRACK_MIN || track > bam->track_max) {
+        return false;
+    }
+    return (bam->tracks[track] >> sector) & 1U;
+}
+
+
+/** \brief  Mark (\a track, \a sector) as used
+ *
+ * \param[in,out]   bam     BAM
+ * \param[in]       track   track number
+ * \param[in]       sector  sector number
+ */
+void zcc_bam_mark_used(zcc_bam_t *bam, int track, int sector)
+{
+    if (track >= ZCC_D64_TRACK_MIN && track <= bam->track_max) {
+        bam->tracks[track] &= ~((uint64_t)1 << sector);
+    }
+}
+
+
+/** \brief  Mark (\a track, \a sector) as free
+ *
+ * \param[in,out]   bam     BAM
+ * \param[in]       track   track number
+ * \param[in]       sector  sector number
+ */
+void zcc_bam_mark_free(zcc_bam_t *bam, int track, int sector)
+{
+    if (track >= ZCC_D64_TRACK_MIN && track <= bam->track_max) {
+        bam->tracks[track] |= ((uint64_t)1 << sector)
+            & bam_track_mask(bam, track);
+    }
+}
+
+
+/** \brief  Mark all blocks set in \a blocks as used
+ *
+ * \param[in,out]   bam     BAM
+ * \param[in]       blocks  bitmap indexed by block number, of
+ *                          #ZCC_D64_BITMAP_WORDS words
+ */
+void zcc_bam_mark_used_bitmap(zcc_bam_t *bam, const uint64_t *blocks)
+{
+    for (int track = ZCC_D64_TRACK_MIN; track <= bam->track_max; track++) {
+        bam->tracks[track] &= ~bam_bitmap_extract(bam, blocks, track);
+    }
+}
+
+
+/** \brief  Mark all blocks set in \a blocks as free
+ *
+ * \param[in,out]   bam     BAM
+ * \param[in]       blocks  bitmap indexed by block number, of
+ *                          #ZCC_D64_BITMAP_WORDS words
+ */
+void zcc_bam_mark_free_bitmap(zcc_bam_t *bam, const uint64_t *blocks)
+{
+    for (int track = ZCC_D64_TRACK_MIN; track <= bam->track_max; track++) {
+        bam->tracks[track] |= bam_bitmap_extract(bam, blocks, track);
+    }
+}
+
+
+/** \brief  Allocate first block of a file
+ *
+ * Like the 1541, start at the tracks next to the directory track and move
+ * outwards, alternating between the lower and upper half of the disk.
+ *
+ * \param[in,out]   bam     BAM
+ * \param[out]      track   track number of block
+ * \param[out]      sector  sector number of block
+ *
+ * \return  false if the disk is full
+ */
+bool zcc_bam_alloc_first(zcc_bam_t *bam, int *track, int *sector)
+{
+    int dir_track = bam->geometry->dir_track;
+    int distance_max = bam->track_max - dir_track;
+
+    if (distance_max < dir_track - ZCC_D64_TRACK_MIN) {
+        distance_max = dir_track - ZCC_D64_TRACK_MIN;
+    }
+
+    for (int distance = 1; distance <= distance_max; distance++) {
+        int candidates[2];
+
+        candidates[0] = dir_track - distance;
+        candidates[1] = dir_track + distance;
+        for (int i = 0; i < 2; i++) {
+            int t = candidates[i];
+
+            if (t >= ZCC_D64_TRACK_MIN && t <= bam->track_max
+                    && bam->tracks[t] != 0) {
+                *track = t;
+                *sector = bam_ctz(bam->tracks[t]);
+                bam->tracks[t] &= ~((uint64_t)1 << *sector);
+                return true;
+            }
+        }
+    }
+    zcc_errno = ZCC_ERR_DISK_FULL;
+    return false;
+}
+
+
+/** \brief  Allocate the block following (\a track, \a sector)
+ *
+ * Uses the 1541 algorithm: add \a interleave to the sector number, wrapping
+ * around (minus one) when passing the end of the track, and take the first
+ * free sector from there. When the track is full, continue on the next track
+ * away from the directory track; when that half of the disk is full, try the
+ * other half.
+ *
+ * Blocks on the directory track are only allocated on the directory track,
+ * using #ZCC_BAM_INTERLEAVE_DIR is advised there.
+ *
+ * \param[in,out]   bam         BAM
+ * \param[in,out]   track       track number of previous block, track number
+ *                              of the new block on success
+ * \param[in,out]   sector      sector number of previous block, sector
+ *                              number of the new block on success
+ * \param[in]       interleave  sector interleave
+ *
+ * \return  false if no free block was found
+ */
+bool zcc_bam_alloc_next(zcc_bam_t *bam, int *track, int *sector,
+                        int interleave)
+{
+    int order[ZCC_D64_GEOMETRY_TRACK_MAX];
+    int dir_track = bam->geometry->dir_track;
+    int count = 0;
+    int t = *track;
+    int sectors;
+    int start;
+
+    if (t < ZCC_D64_TRACK_MIN || t > bam->track_max) {
+        zcc_errno = ZCC_ERR_TRACK_RANGE;
+        return false;
+    }
+
+    sectors = bam->geometry->sectors[t];
+    start = *sector + interleave;
+    if (start >= sectors) {
+        start -= sectors;
+        if (start > 0) {
+            start--;
+        }
+    }
+    start %= sectors;
+
+    /* determine the order in which to try tracks */
+    order[count++] = t;
+    if (t < dir_track) {
+        for (int i = t - 1; i >= ZCC_D64_TRACK_MIN; i--) {
+            order[count++] = i;
+        }
+        for (int i = dir_track + 1; i <= bam->track_max; i++) {
+            order[count++] = i;
+        }
+        for (int i = dir_track - 1; i > t; i--) {
+            order[count++] = i;
+        }
+    } else if (t > dir_track) {
+        for (int i = t + 1; i <= bam->track_max; i++) {
+            order[count++] = i;
+        }
+        for (int i = dir_track - 1; i >= ZCC_D64_TRACK_MIN; i--) {
+            order[count++] = i;
+        }
+        for (int i = dir_track + 1; i < t; i++) {
+            order[count++] = i;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        int s;
+
+        t = order[i];
+        /* the interleave only applies to the current track */
+        s = bam_find_free(bam->tracks[t], i == 0 ? start : 0);
+        if (s >= 0) {
+            bam->tracks[t] &= ~((uint64_t)1 << s);
+            *track = t;
+            *sector = s;
+            return true;
+        }
+    }
+    zcc_errno = ZCC_ERR_DISK_FULL;
+    return false;
+}
@@ -0,0 +1,83 @@
+/** \file   bam.h
+ * \brief   D64 block availability map - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_BAM_H
+#define ZCC_BAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+
+
+/** \brief  Default interleave for files on a 1541
+ */
+#define ZCC_BAM_INTERLEAVE_FILE 10
+
+/** \brief  Default interleave for the directory on a 1541
+ */
+#define ZCC_BAM_INTERLEAVE_DIR  3
+
+
+/** \brief  Block availability map
+ *
+ * Holds the BAM of a D64, D71 or D81 as one 64-bit word per track, bit N set
+ * meaning sector N is free, which is the bit order of the on-disk BAM
+ * entries. The free counts of the on-disk entries are not stored, they're
+ * derived from the bitmaps with a popcount when writing the BAM back.
+ */
+typedef struct zcc_bam_s {
+    uint64_t        tracks[ZCC_D64_GEOMETRY_TRACK_MAX + 1]; /**< free-sector
+                                                                 bitmap per
+                                                                 track (index 0
+                                                                 is unused) */
+    int             track_max;  /**< number of tracks in the BAM */
+    zcc_d64_type_t  type;       /**< DOS type */
+    const zcc_d64_geometry_t *geometry; /**< disk geometry */
+} zcc_bam_t;
+
+
+void zcc_bam_init(zcc_bam_t *bam, zcc_d64_type_t type, int track_max);
+void zcc_bam_init_geometry(zcc_bam_t *bam,
+                           const zcc_d64_geometry_t *geometry,
+                           zcc_d64_type_t type,
+                           int track_max);
+void zcc_bam_load(zcc_bam_t *bam, const zcc_d64_t *d64);
+void zcc_bam_store(const zcc_bam_t *bam, zcc_d64_t *d64);
+
+int  zcc_bam_track_free(const zcc_bam_t *bam, int track);
+int  zcc_bam_blocks_free(const zcc_bam_t *bam);
+int  zcc_bam_diff(const zcc_bam_t *bam1, const zcc_bam_t *bam2);
+
+bool zcc_bam_is_free(const zcc_bam_t *bam, int track, int sector);
+void zcc_bam_mark_used(zcc_bam_t *bam, int track, int sector);
+void zcc_bam_mark_free(zcc_bam_t *bam, int track, int sector);
+void zcc_bam_mark_used_bitmap(zcc_bam_t *bam, const uint64_t *blocks);
+void zcc_bam_mark_free_bitmap(zcc_bam_t *bam, const uint64_t *blocks);
+
+bool zcc_bam_alloc_first(zcc_bam_t *bam, int *track, int *sector);
+bool zcc_bam_alloc_next(zcc_bam_t *bam, int *track, int *sector,
+                        int interleave);
+
+#endif
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #include "cbmdos.h"
 #include "debug.h"
@@ -37,6 +38,8 @@
 #include "petasc.h"
 
 #include "d64.h"
+#include "bam.h"
+#include "d64map.h"
 
 
 /** \brief  DOS type strings
@@ -59,50 +62,218 @@ static const zcc_d64_speedzone_t speedzones[] = {
     { 31, 40, 17 }
 };
 
+/** \brief  Speed zones table for D71 images
+ *
+ * The second side repeats the zones of the first.
+ */
+static const zcc_d64_speedzone_t speedzones_d71[] = {
+    {  1, 17, 21 },
+    { 18, 24, 19 },
+    { 25, 30, 18 },
+    { 31, 35, 17 },
+    { 36, 52, 21 },
+    { 53, 59, 19 },
+    { 60, 65, 18 },
+    { 66, 70, 17 }
+};
 
+/** \brief  Speed zones table for D81 images
+ */
+static const zcc_d64_speedzone_t speedzones_d81[] = {
+    {  1, 80, 40 }
+};
 
 
-/** \brief  Get offset in bytes for block at (\a track, \a sector)
+/** \brief  Geometry descriptors, indexed by zcc_d64_format_t
  *
- * \param[in]   track   track number
- * \param[in]   sector  sector number
+ * The per-track tables are filled in by geometry_init().
+ */
+static zcc_d64_geometry_t geometries[ZCC_D64_FORMAT_COUNT] = {
+    {
+        ZCC_D64_FORMAT_D64, "D64", ZCC_D64_TRACK_MAX_EXT, ZCC_D64_BLOCKS_MAX,
+        ZCC_D64_DIRENT_MAX,
+        ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR, ZCC_D64_BAM_DISKNAME,
+        ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR, 0, 0,
+        ZCC_D64_DIR_TRACK, ZCC_D64_DIR_SECTOR,
+        { 0 }, { 0 }
+    },
+    {
+        ZCC_D64_FORMAT_D71, "D71", 70, ZCC_D71_BLOCKS,
+        ZCC_D64_DIRENT_MAX,
+        ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR, ZCC_D64_BAM_DISKNAME,
+        ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR, ZCC_D71_BAM2_TRACK, 0,
+        ZCC_D64_DIR_TRACK, ZCC_D64_DIR_SECTOR,
+        { 0 }, { 0 }
+    },
+    {
+        ZCC_D64_FORMAT_D81, "D81", ZCC_D64_GEOMETRY_TRACK_MAX, ZCC_D81_BLOCKS,
+        ZCC_D64_GEOMETRY_DIRENT_MAX,
+        ZCC_D81_DIR_TRACK, ZCC_D81_HEADER_SECTOR, ZCC_D81_DISKNAME,
+        ZCC_D81_DIR_TRACK, ZCC_D81_BAM_SECTOR,
+        ZCC_D81_DIR_TRACK, ZCC_D81_BAM2_SECTOR,
+        ZCC_D81_DIR_TRACK, ZCC_D81_DIR_SECTOR,
+        { 0 }, { 0 }
+    }
+};
+
+/** \brief  Guard for geometry_init()
+ */
+static pthread_once_t geometry_once = PTHREAD_ONCE_INIT;
+
+
+/** \brief  Fill in the per-track tables of \a geometry from \a zones
  *
- * \return  offset in bytes or -1 on failure
+ * \param[in,out]   geometry    geometry descriptor
+ * \param[in]       zones       speedzones of the format
+ * \param[in]       count       number of elements in \a zones
+ */
+static void geometry_fill(zcc_d64_geometry_t *geometry,
+                          const zcc_d64_speedzone_t *zones,
+                          size_t count)
+{
+    int block = 0;
+
+    for (size_t z = 0; z < count; z++) {
+        for (int track = zones[z].track_min;
+                track <= zones[z].track_max && track <= geometry->track_max;
+                track++) {
+            geometry->sectors[track] = (uint8_t)zones[z].sectors;
+            geometry->track_block[track] = (uint16_t)block;
+            block += zones[z].sectors;
+        }
+    }
+}
+
+
+/** \brief  Build the per-track tables of all geometries
+ */
+static void geometry_init(void)
+{
+    geometry_fill(&geometries[ZCC_D64_FORMAT_D64], speedzones,
+                  sizeof speedzones / sizeof speedzones[0]);
+    geometry_fill(&geometries[ZCC_D64_FORMAT_D71], speedzones_d71,
+                  sizeof speedzones_d71 / sizeof speedzones_d71[0]);
+    geometry_fill(&geometries[ZCC_D64_FORMAT_D81], speedzones_d81,
+                  sizeof speedzones_d81 / sizeof speedzones_d81[0]);
+}
+
+
+/** \brief  Get geometry descriptor of \a format
+ *
+ * \param[in]   format  image format
+ *
+ * \return  geometry descriptor, the D64 geometry for unknown formats
+ */
+const zcc_d64_geometry_t *zcc_d64_geometry(zcc_d64_format_t format)
+{
+    pthread_once(&geometry_once, geometry_init);
+    if (format < ZCC_D64_FORMAT_D64 || format >= ZCC_D64_FORMAT_COUNT) {
+        format = ZCC_D64_FORMAT_D64;
+    }
+    return &geometries[format];
+}
+
+
+/** \brief  Get linear index of block (\a track, \a sector) in \a geometry
+ *
+ * The index is the number of the block counting from (1,0), so it can be used
+ * to index per-block tables and bitmaps.
+ *
+ * \param[in]   geometry    geometry descriptor
+ * \param[in]   track       track number
+ * \param[in]   sector      sector number
+ *
+ * \return  block index or -1 on failure
  * \throw   ZCC_ERR_TRACK_RANGE
  * \throw   ZCC_ERR_SECTOR_RANGE
  */
-long zcc_d64_block_offset(int track, int sector)
+int zcc_d64_geometry_block_index(const zcc_d64_geometry_t *geometry,
+                                 int track, int sector)
 {
-    int zone = 0;
-    long offset = 0;
-    int tracks;
-
-    /* preliminary checks on track and sector number */
-    if (track < ZCC_D64_TRACK_MIN || track > ZCC_D64_TRACK_MAX_EXT) {
+    if (track < ZCC_D64_TRACK_MIN || track > geometry->track_max) {
         zcc_errno = ZCC_ERR_TRACK_RANGE;
         return -1;
     }
-    if (sector < ZCC_D64_SECTOR_MIN || sector > ZCC_D64_SECTOR_MAX) {
+    if (sector < ZCC_D64_SECTOR_MIN || sector >= geometry->sectors[track]) {
         zcc_errno = ZCC_ERR_SECTOR_RANGE;
         return -1;
     }
+    return geometry->track_block[track] + sector;
+}
 
-    while (zone < (int)(sizeof speedzones / sizeof speedzones[0])
-            && (track > speedzones[zone].track_max)) {
-        /* add complete zone */
-        tracks = speedzones[zone].track_max - speedzones[zone].track_min + 1;
-        offset += tracks * ZCC_D64_BLOCK_SIZE_RAW * speedzones[zone].sectors;
-        zone++;
-    }
 
-    /* final sector number check */
-    if (sector >= speedzones[zone].sectors) {
+/** \brief  Get offset in bytes of block (\a track, \a sector) in \a geometry
+ *
+ * \param[in]   geometry    geometry descriptor
+ * \param[in]   track       track number
+ * \param[in]   sector      sector number
+ *
+ * \return  offset in bytes or -1 on failure
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+long zcc_d64_geometry_block_offset(const zcc_d64_geometry_t *geometry,
+                                   int track, int sector)
+{
+    int index = zcc_d64_geometry_block_index(geometry, track, sector);
+
+    if (index < 0) {
         return -1;
     }
+    return (long)index * ZCC_D64_BLOCK_SIZE_RAW;
+}
+
+
+/** \brief  Get offset in bytes for block at (\a track, \a sector)
+ *
+ * Uses the 40-track D64 geometry.
+ *
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  offset in bytes or -1 on failure
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+long zcc_d64_block_offset(int track, int sector)
+{
+    return zcc_d64_geometry_block_offset(zcc_d64_geometry(ZCC_D64_FORMAT_D64),
+                                         track, sector);
+}
 
-    tracks = track - speedzones[zone].track_min;
-    offset += tracks * ZCC_D64_BLOCK_SIZE_RAW * speedzones[zone].sectors;
-    return offset + sector * ZCC_D64_BLOCK_SIZE_RAW;
+
+/** \brief  Get linear index of block (\a track, \a sector)
+ *
+ * Uses the 40-track D64 geometry, see zcc_d64_geometry_block_index().
+ *
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  block index or -1 on failure
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+int zcc_d64_block_index(int track, int sector)
+{
+    return zcc_d64_geometry_block_index(zcc_d64_geometry(ZCC_D64_FORMAT_D64),
+                                        track, sector);
+}
+
+
+/** \brief  Get block index of the block linked to by \a track and \a sector
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  block index or -1 when (\a track, \a sector) isn't valid for \a d64
+ */
+int zcc_d64_link_index(const zcc_d64_t *d64, int track, int sector)
+{
+    if (!zcc_d64_track_is_valid(d64, track)) {
+        return -1;
+    }
+    return zcc_d64_geometry_block_index(d64->geometry, track, sector);
 }
 
 
@@ -132,6 +303,26 @@ long zcc_d64_track_offset(int track)
  *          images requires an external check for the track count
  */
 int zcc_d64_track_max_sector(int track)
+{
+    const zcc_d64_geometry_t *geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D64);
+
+    if (track < ZCC_D64_TRACK_MIN || track > geometry->track_max) {
+        zcc_errno = ZCC_ERR_TRACK_RANGE;
+        return -1;
+    }
+    return geometry->sectors[track];
+}
+
+
+
+/** \brief  Get speedzone index of \a track
+ *
+ * \param[in]   track   track number
+ *
+ * \return  index in the speedzone table, 0 for tracks 1-17, or -1 on error
+ * \throw   ZCC_ERR_TRACK_RANGE
+ */
+int zcc_d64_track_speedzone(int track)
 {
     int zone = 0;
 
@@ -139,11 +330,9 @@ int zcc_d64_track_max_sector(int track)
         zcc_errno = ZCC_ERR_TRACK_RANGE;
         return -1;
     }
-
     while (zone < (int)(sizeof speedzones / sizeof speedzones[0])) {
         if (track <= speedzones[zone].track_max) {
-            /* found zone */
-            return speedzones[zone].sectors;
+            return zone;
         }
         zone++;
     }
@@ -152,6 +341,94 @@ int zcc_d64_track_max_sector(int track)
 }
 
 
+/** \brief  Get DOS error number of error info code \a error
+ *
+ * \param[in]   error   error info code
+ *
+ * \return  DOS error number as reported by the drive, 0 for no error
+ */
+int zcc_d64_error_number(zcc_d64_error_t error)
+{
+    switch (error) {
+        case ZCC_D64_ERROR_HEADER:
+            return 20;
+        case ZCC_D64_ERROR_SYNC:
+            return 21;
+        case ZCC_D64_ERROR_DATA:
+            return 22;
+        case ZCC_D64_ERROR_DATA_CHECKSUM:
+            return 23;
+        case ZCC_D64_ERROR_VERIFY:
+            return 24;
+        case ZCC_D64_ERROR_WRITE_VERIFY:
+            return 25;
+        case ZCC_D64_ERROR_WRITE_PROTECT:
+            return 26;
+        case ZCC_D64_ERROR_HEADER_CHECKSUM:
+            return 27;
+        case ZCC_D64_ERROR_LONG_DATA:
+            return 28;
+        case ZCC_D64_ERROR_ID_MISMATCH:
+            return 29;
+        case ZCC_D64_ERROR_DRIVE_NOT_READY:
+            return 74;
+        case ZCC_D64_ERROR_NONE:    /* fall through */
+        case ZCC_D64_ERROR_OK:      /* fall through */
+        default:
+            return 0;
+    }
+}
+
+
+
+
+/** \brief  Show blocks with errors in error info \a errors
+ *
+ * \param[in]   errors      error info code per block, see zcc_d64_error_t
+ * \param[in]   track_max   number of tracks
+ *
+ * \return  number of blocks with errors
+ */
+int zcc_d64_dump_errors(const uint8_t *errors, int track_max)
+{
+    int bad = 0;
+
+    for (int track = ZCC_D64_TRACK_MIN; track <= track_max; track++) {
+        int index = zcc_d64_block_index(track, 0);
+        int sectors = zcc_d64_track_max_sector(track);
+
+        for (int sector = 0; sector < sectors; sector++) {
+            zcc_d64_error_t error = (zcc_d64_error_t)errors[index + sector];
+
+            if (error != ZCC_D64_ERROR_OK && error != ZCC_D64_ERROR_NONE) {
+                printf("%2d/%2d: error %d\n",
+                       track, sector, zcc_d64_error_number(error));
+                bad++;
+            }
+        }
+    }
+    printf("%d bad sectors\n", bad);
+    return bad;
+}
+
+
+/** \brief  Get number of tracks of \a d64
+ *
+ * D64 images of type #ZCC_D64_TYPE_CBMDOS have 35 tracks, the other DOS types
+ * 40. D71 and D81 images have the tracks of their geometry.
+ *
+ * \param[in]   d64     D64 handle
+ *
+ * \return  highest valid track number
+ */
+int zcc_d64_track_count(const zcc_d64_t *d64)
+{
+    if (d64->geometry->format != ZCC_D64_FORMAT_D64) {
+        return d64->geometry->track_max;
+    }
+    return d64->type == ZCC_D64_TYPE_CBMDOS
+        ? ZCC_D64_TRACK_MAX : ZCC_D64_TRACK_MAX_EXT;
+}
 
 
 /** \brief  Check if \a track number is valid for \a d64
@@ -165,16 +442,12 @@ int zcc_d64_track_max_sector(int track)
  */
 bool zcc_d64_track_is_valid(const zcc_d64_t *d64, int track)
 {
-    int track_max;
-
     if (d64 == NULL) {
         zcc_errno = ZCC_ERR_NULL;
         return false;
     }
 
-    track_max = (d64->type == ZCC_D64_TYPE_CBMDOS ? 35 : 40);
-
-    if (track < ZCC_D64_TRACK_MIN || track > track_max) {
+    if (track < ZCC_D64_TRACK_MIN || track > zcc_d64_track_count(d64)) {
         zcc_errno = ZCC_ERR_TRACK_RANGE;
         return false;
     }
@@ -195,18 +468,7 @@ bool zcc_d64_track_is_valid(const zcc_d64_t *d64, int track)
  */
 bool zcc_d64_block_is_valid(const zcc_d64_t *d64, int track, int sector)
 {
-    int sector_max;
-
-    if (!zcc_d64_track_is_valid(d64, track)) {
-        return false;   /* error codes already set */
-    }
-
-    sector_max = zcc_d64_track_max_sector(track);
-    if (sector < ZCC_D64_SECTOR_MIN || sector > sector_max) {
-        zcc_errno = ZCC_ERR_SECTOR_RANGE;
-        return false;
-    }
-    return true;
+    return zcc_d64_link_index(d64, track, sector) >= 0;
 }
 
 
@@ -225,18 +487,14 @@ bool zcc_d64_block_read(const zcc_d64_t *d64,
                         uint8_t *buffer,
                         int track, int sector)
 {
-    long offset;
+    int index = zcc_d64_link_index(d64, track, sector);
 
-    if (!zcc_d64_track_is_valid(d64, track)) {
+    if (index < 0) {
         return false;
     }
 
-    offset = zcc_d64_block_offset(track, sector);
-    if (offset < 0) {
-        return false;
-    }
-
-    memcpy(buffer, d64->data + offset, ZCC_D64_BLOCK_SIZE_RAW);
+    memcpy(buffer, d64->data + index * ZCC_D64_BLOCK_SIZE_RAW,
+           ZCC_D64_BLOCK_SIZE_RAW);
     return true;
 }
 
@@ -256,18 +514,15 @@ bool zcc_d64_block_write(zcc_d64_t *d64,
                          const uint8_t *buffer,
                          int track, int sector)
 {
-    long offset;
-
-    if (!zcc_d64_track_is_valid(d64, track)) {
-        return false;
-    }
+    int index = zcc_d64_link_index(d64, track, sector);
 
-    offset = zcc_d64_block_offset(track, sector);
-    if (offset < 0) {
+    if (index < 0) {
         return false;
     }
 
-    memcpy(d64->data + offset, buffer, ZCC_D64_BLOCK_SIZE_RAW);
+    memcpy(d64->data + index * ZCC_D64_BLOCK_SIZE_RAW, buffer,
+           ZCC_D64_BLOCK_SIZE_RAW);
+    d64->written[index / 8] |= (uint8_t)(1U << (index % 8));
     return true;
 }
 
@@ -281,7 +536,12 @@ void zcc_d64_init(zcc_d64_t *d64)
     d64->path = NULL;
     d64->data = NULL;
     d64->size = 0;
+    d64->errors = NULL;
     d64->type = ZCC_D64_TYPE_CBMDOS;
+    d64->geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D64);
+    d64->pool = NULL;
+    d64->recycled = false;
+    memset(d64->written, 0, sizeof d64->written);
 }
 
 
@@ -302,6 +562,105 @@ void zcc_d64_alloc(zcc_d64_t *d64, zcc_d64_type_t type)
 
     d64->data = zcc_calloc(size, 1LU);
     d64->size = size;
+    d64->errors = NULL;
+    d64->type = type;
+    d64->geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D64);
+}
+
+
+/** \brief  Allocate memory in \a d64 for an image of \a format
+ *
+ * D64 images are allocated with 35 tracks, use zcc_d64_alloc() for 40-track
+ * images.
+ *
+ * \param[in,out]   d64     D64 handle
+ * \param[in]       format  image format
+ */
+void zcc_d64_alloc_format(zcc_d64_t *d64, zcc_d64_format_t format)
+{
+    const zcc_d64_geometry_t *geometry = zcc_d64_geometry(format);
+
+    if (geometry->format == ZCC_D64_FORMAT_D64) {
+        zcc_d64_alloc(d64, ZCC_D64_TYPE_CBMDOS);
+        return;
+    }
+    d64->size = (size_t)geometry->blocks * ZCC_D64_BLOCK_SIZE_RAW;
+    d64->data = zcc_calloc(d64->size, 1LU);
+    d64->errors = NULL;
+    d64->type = ZCC_D64_TYPE_CBMDOS;
+    d64->geometry = geometry;
+}
+
+
+/** \brief  Allocate memory in \a d64 for a D64 of \a type from \a pool
+ *
+ * Like zcc_d64_alloc(), but takes the image buffer from \a pool. A recycled
+ * buffer isn't cleared here: the caller is expected to write the blocks it
+ * has data for with zcc_d64_block_write() and then call
+ * zcc_d64_clear_unwritten() to clear the remaining blocks. zcc_d64_free() will
+ * hand the buffer back to \a pool.
+ *
+ * \param[in,out]   d64     D64 handle
+ * \param[in]       type    D64 type
+ * \param[in]       pool    buffer pool (`NULL` to use zcc_d64_alloc())
+ */
+void zcc_d64_alloc_pooled(zcc_d64_t *d64, zcc_d64_type_t type, zcc_pool_t *pool)
+{
+    if (pool == NULL) {
+        zcc_d64_alloc(d64, type);
+        return;
+    }
+
+    d64->data = zcc_pool_d64_get(pool, &(d64->recycled));
+    d64->size = type == ZCC_D64_TYPE_CBMDOS
+        ? ZCC_D64_SIZE_CBMDOS : ZCC_D64_SIZE_EXTENDED;
+    d64->errors = NULL;
+    d64->type = type;
+    d64->geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D64);
+    d64->pool = pool;
+    memset(d64->written, 0, sizeof d64->written);
+}
+
+
+/** \brief  Clear all blocks of \a d64 not written since it was allocated
+ *
+ * Only does any work when the image buffer was recycled from a pool, a fresh
+ * buffer is already zeroed-out. Runs of unwritten blocks are cleared with a
+ * single memset().
+ *
+ * \param[in,out]   d64 D64 handle
+ */
+void zcc_d64_clear_unwritten(zcc_d64_t *d64)
+{
+    size_t blocks = d64->size / ZCC_D64_BLOCK_SIZE_RAW;
+    size_t block = 0;
+
+    if (!d64->recycled) {
+        return;
+    }
+
+    while (block < blocks) {
+        size_t run;
+
+        if (d64->written[block / 8] == 0xff && block % 8 == 0) {
+            /* skip 8 written blocks at once */
+            block += 8;
+            continue;
+        }
+        if (d64->written[block / 8] & (1U << (block % 8))) {
+            block++;
+            continue;
+        }
+        /* find end of run of unwritten blocks */
+        run = block + 1;
+        while (run < blocks && !(d64->written[run / 8] & (1U << (run % 8)))) {
+            run++;
+        }
+        memset(d64->data + block * ZCC_D64_BLOCK_SIZE_RAW, 0,
+               (run - block) * ZCC_D64_BLOCK_SIZE_RAW);
+        block = run;
+    }
+    d64->recycled = false;
 }
 
 
@@ -315,15 +674,27 @@ void zcc_d64_free(zcc_d64_t *d64)
         zcc_free(d64->path);
     }
     if (d64->data != NULL) {
-        zcc_free(d64->data);
+        if (d64->pool != NULL) {
+            zcc_pool_d64_put(d64->pool, d64->data);
+        } else {
+            zcc_free(d64->data);
+        }
     }
+    d64->path = NULL;
+    d64->data = NULL;
+    d64->errors = NULL;
 }
 
 
 /** \brief  Read D64 file
+ *
+ * D71 and D81 images are recognized by their size and get the matching
+ * geometry, their DOS type is #ZCC_D64_TYPE_CBMDOS. Images with error info
+ * are accepted as well, \c errors then points at the error info in the
+ * loaded data.
  *
  * \param[in,out]   d64     D64 handle
- * \param[in]       path    path to D64 image file
+ * \param[in]       path    path to D64, D71 or D81 image file
  * \param[in]       type    D64 type (ignored when 35 tracks)
  *
  * \return  TRUE if succesfull
@@ -331,39 +702,112 @@ void zcc_d64_free(zcc_d64_t *d64)
 bool zcc_d64_read(zcc_d64_t *d64, const char *path, zcc_d64_type_t type)
 {
     long result;
+    size_t size;
 
     /* Attempt to load image data */
     result = zcc_fread_alloc(&(d64->data), path);
     zcc_debug("got %ld bytes\n", result);
-    if (result != ZCC_D64_SIZE_CBMDOS && result != ZCC_D64_SIZE_EXTENDED) {
-        /* Failed */
-        zcc_debug("error: invalid image size\n");
-        zcc_free(d64->data);
-        d64->data = NULL;
-        return false;
+    switch (result) {
+        case ZCC_D64_SIZE_CBMDOS:           /* fall through */
+        case ZCC_D64_SIZE_CBMDOS_ERRORS:
+            type = ZCC_D64_TYPE_CBMDOS;
+            size = ZCC_D64_SIZE_CBMDOS;
+            d64->geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D64);
+            break;
+        case ZCC_D64_SIZE_EXTENDED:         /* fall through */
+        case ZCC_D64_SIZE_EXTENDED_ERRORS:
+            size = ZCC_D64_SIZE_EXTENDED;
+            d64->geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D64);
+            break;
+        case ZCC_D71_SIZE:                  /* fall through */
+        case ZCC_D71_SIZE + ZCC_D71_BLOCKS:
+            type = ZCC_D64_TYPE_CBMDOS;
+            size = ZCC_D71_SIZE;
+            d64->geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D71);
+            break;
+        case ZCC_D81_SIZE:                  /* fall through */
+        case ZCC_D81_SIZE + ZCC_D81_BLOCKS:
+            type = ZCC_D64_TYPE_CBMDOS;
+            size = ZCC_D81_SIZE;
+            d64->geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D81);
+            break;
+        default:
+            /* Failed */
+            zcc_debug("error: invalid image size\n");
+            zcc_free(d64->data);
+            d64->data = NULL;
+            return false;
     }
 
     /* OK */
     d64->path = zcc_strdup(path);
-    d64->size = (size_t)result;
-    if (result == ZCC_D64_SIZE_CBMDOS) {
-        d64->type = ZCC_D64_TYPE_CBMDOS;
-    } else {
-        d64->type = type;
-    }
+    d64->size = size;
+    d64->errors = (size_t)result > size ? d64->data + size : NULL;
+    d64->type = type;
     return true;
 }
 
 
+/** \brief  Add error info to \a d64
+ *
+ * All blocks are marked #ZCC_D64_ERROR_OK. The error info is stored right
+ * after the block data, so it's written along with the image. Pooled image
+ * buffers have room for it, other buffers are resized. Does nothing if
+ * \a d64 already has error info.
+ *
+ * \param[in,out]   d64     D64 image
+ */
+void zcc_d64_errors_attach(zcc_d64_t *d64)
+{
+    size_t blocks = d64->size / ZCC_D64_BLOCK_SIZE_RAW;
+
+    if (d64->errors != NULL) {
+        return;
+    }
+    if (d64->pool == NULL) {
+        d64->data = zcc_realloc(d64->data, d64->size + blocks);
+    }
+    d64->errors = d64->data + d64->size;
+    memset(d64->errors, ZCC_D64_ERROR_OK, blocks);
+}
+
+
+/** \brief  Get error info code of block (\a track, \a sector) of \a d64
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  error code, #ZCC_D64_ERROR_NONE if \a d64 has no error info or the
+ *          block isn't valid
+ */
+zcc_d64_error_t zcc_d64_block_error(const zcc_d64_t *d64,
+                                    int track, int sector)
+{
+    int index;
+
+    if (d64->errors == NULL) {
+        return ZCC_D64_ERROR_NONE;
+    }
+    index = zcc_d64_link_index(d64, track, sector);
+    if (index < 0) {
+        return ZCC_D64_ERROR_NONE;
+    }
+    return (zcc_d64_error_t)d64->errors[index];
+}
+
+
 /** \brief  Dump some generic info about \a d64 on stdout
  *
  * \param[in]   d64     D64 handle
  */
 void zcc_d64_dump_info(const zcc_d64_t *d64)
 {
+    printf("format: %s\n", d64->geometry->name);
     printf("type: %s\n", dos_types[d64->type]);
     printf("path: %s\n", d64->path != NULL ? d64->path : "<unset>");
     printf("size: $%lx\n", (unsigned long)d64->size);
+    printf("error info: %s\n", d64->errors != NULL ? "yes" : "no");
 }
 
 
@@ -373,9 +817,18 @@ void zcc_d64_dump_info(const zcc_d64_t *d64)
  */
 void zcc_d64_dump_bam(const zcc_d64_t *d64)
 {
-    zcc_hexdump(d64->data + ZCC_D64_BAM_OFFSET,
-            ZCC_D64_BLOCK_SIZE_RAW,
-            ZCC_D64_BAM_OFFSET);
+    const zcc_d64_geometry_t *geometry = d64->geometry;
+    long offset = zcc_d64_geometry_block_offset(geometry,
+                                                geometry->bam_track,
+                                                geometry->bam_sector);
+
+    zcc_hexdump(d64->data + offset, ZCC_D64_BLOCK_SIZE_RAW, (size_t)offset);
+    if (geometry->bam2_track != 0) {
+        offset = zcc_d64_geometry_block_offset(geometry,
+                                               geometry->bam2_track,
+                                               geometry->bam2_sector);
+        zcc_hexdump(d64->data + offset, ZCC_D64_BLOCK_SIZE_RAW, (size_t)offset);
+    }
 }
 
 
@@ -383,7 +836,8 @@ void zcc_d64_dump_bam(const zcc_d64_t *d64)
  *
  * Write the image in \a d64 to the host file system. If \a path is `NULL`, use
  * the path in \a d64. If that is also `NULL`, fail. Using a non-NULL \a path
- * will replace the old path in \a d64.
+ * will replace the old path in \a d64. Error info, if any, is written after
+ * the block data.
  *
  * \param[in,out]   d64     D64 handle
  * \param[in]       path    path to write to (NULL to use \a d64's path
@@ -399,45 +853,125 @@ bool zcc_d64_write(zcc_d64_t *d64, const char *path)
     }
 
     /* use new path? */
-    if (path != NULL) {
+    if (path != NULL && path != d64->path) {
         if (d64->path != NULL) {
             zcc_free(d64->path);
-            d64->path = zcc_strdup(path);
         }
+        d64->path = zcc_strdup(path);
     }
 
-    if (zcc_fwrite(d64->path, d64->data, d64->size)) {
-        return false;
+    return zcc_fwrite(d64->path, d64->data, d64->size
+            + (d64->errors != NULL ? d64->size / ZCC_D64_BLOCK_SIZE_RAW : 0));
+}
+
+
+/** \brief  Get offset in the BAM sector of the BAM entry for \a track
+ *
+ * Tracks 36-40 are only supported for the 40-track DOS types, each of which
+ * stores their BAM entries at a different location. ProfDOS isn't documented
+ * in the D64 format description, so it's assumed to use the SpeedDOS layout.
+ *
+ * \param[in]   type    DOS type
+ * \param[in]   track   track number
+ *
+ * \return  offset in sector (18,0) or -1 when \a track has no BAM entry
+ */
+int zcc_d64_bament_offset(zcc_d64_type_t type, int track)
+{
+    int base;
+
+    if (track >= ZCC_D64_TRACK_MIN && track <= ZCC_D64_TRACK_MAX) {
+        return ZCC_D64_BAM_TRACKS + (track - 1) * ZCC_D64_BAMENT_SIZE;
     }
-    return true;
+    if (track <= ZCC_D64_TRACK_MAX || track > ZCC_D64_TRACK_MAX_EXT) {
+        zcc_errno = ZCC_ERR_TRACK_RANGE;
+        return -1;
+    }
+
+    switch (type) {
+        case ZCC_D64_TYPE_SPEEDDOS: /* fall through */
+        case ZCC_D64_TYPE_PROFDOS:
+            base = ZCC_D64_BAM_TRACKS_SPEEDDOS;
+            break;
+        case ZCC_D64_TYPE_DOLPHINDOS:
+            base = ZCC_D64_BAM_TRACKS_DOLPHINDOS;
+            break;
+        case ZCC_D64_TYPE_PROLOGICDOS:
+            base = ZCC_D64_BAM_TRACKS_PROLOGICDOS;
+            break;
+        case ZCC_D64_TYPE_CBMDOS:   /* fall through */
+        default:
+            zcc_errno = ZCC_ERR_TRACK_RANGE;
+            return -1;
+    }
+    return base + (track - ZCC_D64_TRACK_MAX - 1) * ZCC_D64_BAMENT_SIZE;
 }
 
 
-/** \brief  Read BAM entry for \a track in \a d64 into \a bament
+/** \brief  Get offset in the BAM sector of the disk name
+ *
+ * PrologicDOS moves the disk name and ID to make room for its extra BAM
+ * entries, the disk ID always follows the disk name at +$12.
+ *
+ * \param[in]   type    DOS type
+ *
+ * \return  offset in sector (18,0)
+ */
+int zcc_d64_diskname_offset(zcc_d64_type_t type)
+{
+    if (type == ZCC_D64_TYPE_PROLOGICDOS) {
+        return ZCC_D64_BAM_DISKNAME_PROLOGICDOS;
+    }
+    return ZCC_D64_BAM_DISKNAME;
+}
+
+
+/** \brief  Get pointer to the disk name of \a d64
  *
- * Only works for 35-track images at the moment.
+ * The disk ID and DOS type follow the name at +$12 in all formats.
+ *
+ * \param[in]   d64     D64 image
+ *
+ * \return  pointer to the PETSCII disk name in the image data
+ */
+const uint8_t *zcc_d64_diskname(const zcc_d64_t *d64)
+{
+    const zcc_d64_geometry_t *geometry = d64->geometry;
+    int index = zcc_d64_geometry_block_index(geometry,
+                                             geometry->header_track,
+                                             geometry->header_sector);
+    int offset = geometry->format == ZCC_D64_FORMAT_D64
+        ? zcc_d64_diskname_offset(d64->type) : geometry->diskname;
+
+    return d64->data + index * ZCC_D64_BLOCK_SIZE_RAW + offset;
+}
+
+
+/** \brief  Read BAM entry for \a track in \a d64 into \a bament
  *
  * \param[in]   d64     D64 image
  * \param[out]  bament  storage for raw BAM entry (4 bytes)
  * \param[in]   track   track number
  *
  * \return  TRUE on success
+ *
+ * \note    Uses the D64 BAM layout, see bam.c for the other formats
  */
 bool zcc_d64_bament_read(const zcc_d64_t *d64, uint8_t *bament, int track)
 {
     uint8_t *bam;
     long offset;
+    int entry;
 
-    if (track < ZCC_D64_TRACK_MIN || track > ZCC_D64_TRACK_MAX) {
+    entry = zcc_d64_bament_offset(d64->type, track);
+    if (entry < 0) {
         return false;
     }
 
     offset = zcc_d64_block_offset(ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR);
     bam = d64->data + offset;
 
-    memcpy(bament,
-           bam + ZCC_D64_BAM_TRACKS + (track - 1) * ZCC_D64_BAMENT_SIZE,
-           ZCC_D64_BAMENT_SIZE);
+    memcpy(bament, bam + entry, ZCC_D64_BAMENT_SIZE);
 
     return true;
 }
@@ -449,30 +983,15 @@ bool zcc_d64_bament_read(const zcc_d64_t *d64, uint8_t *bament, int track)
  *
  * \return  blocks free
  *
- * \todo    Mask out unused bits for invalid sectors
+ * \note    Excludes track 18, just like CBM DOS. Includes tracks 36-40 for
+ *          40-track DOS types.
  */
-int zcc_d64_blocks_free(zcc_d64_t *d64)
+int zcc_d64_blocks_free(const zcc_d64_t *d64)
 {
-    int blocks = 0;
-
-    for (int track = ZCC_D64_TRACK_MIN; track <= ZCC_D64_TRACK_MAX; track++) {
-        /* exclude track 18 */
-        if (track != ZCC_D64_DIR_TRACK) {
-            uint8_t bament[ZCC_D64_BAMENT_SIZE];
-            int popcount;
-
-            zcc_d64_bament_read(d64, bament, track);
+    zcc_bam_t bam;
 
-            popcount = zcc_popcount_byte(bament[ZCC_D64_BAMENT_BITMAP + 0])
-                     + zcc_popcount_byte(bament[ZCC_D64_BAMENT_BITMAP + 1])
-                     + zcc_popcount_byte(bament[ZCC_D64_BAMENT_BITMAP + 2]);
-#if 0
-            zcc_debug("popcount for track %d = %d\n", track, popcount);
-#endif
-            blocks += popcount;
-        }
-    }
-    return blocks;
+    zcc_bam_load(&bam, d64);
+    return zcc_bam_blocks_free(&bam);
 }
 
 
@@ -490,10 +1009,12 @@ void zcc_d64_dirent_init(zcc_d64_dirent_t *dirent, zcc_d64_t *d64)
         exit(1);
     }
     dirent->d64 = d64;
+    dirent->dir = NULL;
     memset(dirent->name, 0, ZCC_D64_DISKNAME_MAXLEN);
     memset(dirent->geos, 0, ZCC_D64_DIRENT_GEOS_SIZE);
     dirent->filetype = 0;
     dirent->size = 0;
+    dirent->size_valid = false;
     dirent->blocks = 0;
     dirent->track = 0;
     dirent->sector = 0;
@@ -506,14 +1027,15 @@ void zcc_d64_dirent_init(zcc_d64_dirent_t *dirent, zcc_d64_t *d64)
 
 
 /** \brief  Read data into \a dirent from \a data
+ *
+ * The size in bytes of the file isn't determined here, since that requires
+ * walking the file's block chain, see zcc_d64_dirent_size().
  *
  * \param[out]  dirent  D64 directory entry
  * \param[in]   data    raw directory entry data
  */
 void zcc_d64_dirent_read(zcc_d64_dirent_t *dirent, const uint8_t *data)
 {
-    long size;
-
     /* $00 (useless) */
     dirent->dir_track = data[ZCC_D64_DIRENT_DIR_TRACK];
     /* $01 */
@@ -535,19 +1057,54 @@ void zcc_d64_dirent_read(zcc_d64_dirent_t *dirent, const uint8_t *data)
     /* $18-$1d */
     memcpy(dirent->geos, data + ZCC_D64_DIRENT_GEOS, ZCC_D64_DIRENT_GEOS_SIZE);
     /* $1e-$1f */
-    dirent->blocks = (uint8_t)(data[ZCC_D64_DIRENT_BLOCKS_LSB]
+    dirent->blocks = (uint16_t)(data[ZCC_D64_DIRENT_BLOCKS_LSB]
             + 256 * data[ZCC_D64_DIRENT_BLOCKS_MSB]);
 
-    /* get file size in bytes */
-    if (zcc_d64_block_is_valid(dirent->d64, dirent->track, dirent->sector)) {
-        zcc_debug("getting file size in bytes for (%d,%d):",
-                dirent->track, dirent->sector);
-        size = zcc_d64_file_size(dirent->d64, dirent->track, dirent->sector);
-        zcc_debug("file size = %ld", size);
-        if (size >= 0) {
-            dirent->size = (size_t)size;
+    /* size in bytes is determined on demand */
+    dirent->size = 0;
+    dirent->size_valid = false;
+}
+
+
+/** \brief  Get size in bytes of the file of \a dirent
+ *
+ * For an entry of a directory read with zcc_d64_dir_read() the sizes of all
+ * entries are calculated from a single block ownership map on the first call,
+ * see zcc_d64_dir_calc_sizes(). The size of a standalone entry is determined
+ * by walking its chain. The size is cached in \a dirent.
+ *
+ * \param[in,out]   dirent  D64 directory entry
+ *
+ * \return  size in bytes or -1 on error
+ */
+long zcc_d64_dirent_size(zcc_d64_dirent_t *dirent)
+{
+    long size;
+
+    if (dirent->size_valid) {
+        return (long)dirent->size;
+    }
+
+    if (dirent->dir != NULL) {
+        if (!dirent->dir->sizes_calculated) {
+            zcc_d64_dir_calc_sizes(dirent->dir);
+        }
+        if (!dirent->size_valid) {
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+            return -1;
         }
+        return (long)dirent->size;
     }
+
+    size = zcc_d64_file_size(dirent->d64, dirent->track, dirent->sector);
+    zcc_debug("file size of (%d,%d) = %ld",
+            dirent->track, dirent->sector, size);
+    if (size < 0) {
+        return -1;
+    }
+    dirent->size = (size_t)size;
+    dirent->size_valid = true;
+    return size;
 }
 
 
@@ -560,24 +1117,29 @@ void zcc_d64_dirent_read(zcc_d64_dirent_t *dirent, const uint8_t *data)
  */
 bool zcc_d64_dirent_iter_init(zcc_d64_dirent_iter_t *iter, zcc_d64_t *d64)
 {
-    uint8_t buffer[ZCC_D64_BLOCK_SIZE_RAW];
-    iter->d64 = d64;
-    iter->sector = ZCC_D64_DIR_SECTOR;
-    iter->offset = 0;
-    iter->index = 0;
+    int index;
 
     if (d64 == NULL) {
         exit(1);
     }
 
-    /* read raw initial block at (18,1) */
-    if (!zcc_d64_block_read(d64, buffer, ZCC_D64_DIR_TRACK, ZCC_D64_DIR_SECTOR)) {
+    iter->d64 = d64;
+    iter->track = d64->geometry->dir_track;
+    iter->sector = d64->geometry->dir_sector;
+    iter->offset = 0;
+    iter->index = 0;
+
+    /* locate raw initial block, (18,1) on D64 */
+    index = zcc_d64_link_index(d64, iter->track, iter->sector);
+    if (index < 0) {
         zcc_perror(__func__);
         exit(1);
     }
     /* convert to dirent */
     iter->dirent.d64 = d64;    /* !! */
-    zcc_d64_dirent_read(&(iter->dirent), buffer);
+    iter->dirent.dir = NULL;
+    zcc_d64_dirent_read(&(iter->dirent),
+                        d64->data + index * ZCC_D64_BLOCK_SIZE_RAW);
 
     return (bool)(iter->dirent.name[0]);
 }
@@ -591,8 +1153,9 @@ bool zcc_d64_dirent_iter_init(zcc_d64_dirent_iter_t *iter, zcc_d64_t *d64)
  */
 bool zcc_d64_dirent_iter_next(zcc_d64_dirent_iter_t *iter)
 {
-    uint8_t buffer[ZCC_D64_BLOCK_SIZE_RAW];
-    if (iter->index == ZCC_D64_DIRENT_MAX - 1
+    int index;
+
+    if (iter->index == iter->d64->geometry->dirent_max - 1
             || iter->dirent.name[0] == 0) {
         return false;
     }
@@ -603,31 +1166,38 @@ bool zcc_d64_dirent_iter_next(zcc_d64_dirent_iter_t *iter)
         iter->offset += ZCC_D64_DIRENT_SIZE;
     } else {
         /* check for next dir sector */
-        long offset;
         uint8_t *data;
+        int next_track;
         int next_sector;
 
 
         zcc_debug("Checking for next dir sector\n");
-        offset = zcc_d64_block_offset(ZCC_D64_DIR_TRACK, iter->sector);
-        if (offset < 0) {
+        index = zcc_d64_link_index(iter->d64, iter->track, iter->sector);
+        if (index < 0) {
             return false;
         }
-        data = iter->d64->data + offset;
-        next_sector = data[1];
-        zcc_debug("Next block = (18,%d)\n", next_sector);
-        if (next_sector == 255) {
+        data = iter->d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+        next_track = data[ZCC_D64_BLOCK_TRACK];
+        next_sector = data[ZCC_D64_BLOCK_SECTOR];
+        zcc_debug("Next block = (%d,%d)\n", next_track, next_sector);
+        if (next_track == 0) {
             return false;
         }
         iter->offset = 0;
+        iter->track = next_track;
         iter->sector = next_sector;
     }
-    /* read raw initial block at (18,1) */
-    zcc_debug("Reading dirent from (18,%d), offset %02x\n",
-            iter->sector, iter->offset);
-    zcc_d64_block_read(iter->d64, buffer, ZCC_D64_DIR_TRACK, iter->sector);
+    /* read dirent in place */
+    zcc_debug("Reading dirent from (%d,%d), offset %02x\n",
+            iter->track, iter->sector, iter->offset);
+    index = zcc_d64_link_index(iter->d64, iter->track, iter->sector);
+    if (index < 0) {
+        return false;
+    }
     /* convert to dirent */
-    zcc_d64_dirent_read(&(iter->dirent), buffer + iter->offset);
+    zcc_d64_dirent_read(&(iter->dirent),
+                        iter->d64->data + index * ZCC_D64_BLOCK_SIZE_RAW
+                        + iter->offset);
     iter->index++;
     return (bool)(iter->dirent.name[0]);
 }
@@ -639,8 +1209,8 @@ bool zcc_d64_dirent_iter_next(zcc_d64_dirent_iter_t *iter)
  */
 void zcc_d64_dirent_iter_dump(const zcc_d64_dirent_iter_t *iter)
 {
-    printf("dir sector = %d, in-sector offset: %02x\n",
-            iter->sector, (unsigned int)(iter->offset));
+    printf("dir block = (%d,%d), in-sector offset: %02x\n",
+            iter->track, iter->sector, (unsigned int)(iter->offset));
 }
 
 
@@ -712,6 +1282,7 @@ bool zcc_d64_block_iter_init(zcc_d64_block_iter_t *iter,
         iter->track = track;
         iter->sector = sector;
         iter->size = ZCC_D64_BLOCK_SIZE_RAW;
+        iter->count = 1;
         if (zcc_d64_block_read(d64, iter->data, track, sector)) {
             iter->valid = true;
             return true;
@@ -742,45 +1313,78 @@ bool zcc_d64_block_iter_next(zcc_d64_block_iter_t *iter)
     if (next_track == 0) {
         return false;
     }
+    if (iter->count >= iter->d64->geometry->blocks) {
+        /* more blocks than the image has: the chain loops */
+        zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+        return false;
+    }
     if (!zcc_d64_block_read(iter->d64, iter->data, next_track, next_sector)) {
         return false;
     }
 
     iter->track = next_track;
     iter->sector = next_sector;
+    iter->count++;
     return true;
 }
 
 
 /** \brief  Determine size of file starting at (\a track, \a sector) in \a d64
+ *
+ * Walks the block chain in place, without copying any block data. Blocks
+ * visited are recorded in a bitmap, so a chain linking back into itself is
+ * reported as an error instead of looping forever.
+ *
+ * This works for any chain, like GEOS info blocks and VLIR records. Sizes of
+ * directory entries should be taken from zcc_d64_dirent_size() or
+ * zcc_d64_dir_calc_sizes() instead, which use the block ownership map and so
+ * agree with --d64-validate on cross-linked files.
  *
  * \param[in]   d64     D64 image
  * \param[in]   track   track number of first block of file
  * \param[in]   sector  sector number of first block of file
  *
  * \return  file size or -1 on error
- *
- * \todo    document error codes this could set.
+ * \throw   ZCC_ERR_NULL
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ * \throw   ZCC_ERR_CHAIN_CYCLE
  */
 long zcc_d64_file_size(zcc_d64_t *d64, int track, int sector)
 {
-    zcc_d64_block_iter_t iter;
+    uint64_t visited[ZCC_D64_BITMAP_WORDS];
+    const uint8_t *block;
     long size = 0;
+    int index;
 
-    if (!zcc_d64_block_iter_init(&iter, d64, track, sector)) {
+    index = zcc_d64_link_index(d64, track, sector);
+    if (index < 0) {
         return -1;
     }
-
-    while (zcc_d64_block_iter_next(&iter)) {
+    memset(visited, 0, sizeof visited);
+    ZCC_D64_BITMAP_SET(visited, index);
+    block = d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+
+    while (block[ZCC_D64_BLOCK_TRACK] != 0) {
+        index = zcc_d64_link_index(d64,
+                                   block[ZCC_D64_BLOCK_TRACK],
+                                   block[ZCC_D64_BLOCK_SECTOR]);
+        if (index < 0) {
+            return -1;
+        }
+        if (ZCC_D64_BITMAP_GET(visited, index)) {
+            zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+            return -1;
+        }
+        ZCC_D64_BITMAP_SET(visited, index);
+        block = d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
         size += ZCC_D64_BLOCK_SIZE_DATA;
     }
     /* the sector number points to the last data byte */
-    return size + iter.data[ZCC_D64_BLOCK_SECTOR] - 1;
+    return size + block[ZCC_D64_BLOCK_SECTOR] - 1;
 }
 
 
-
-
 /** \brief  Initialize D64 directory object
  *
  * \param[out]  dir     D64 directory
@@ -795,10 +1399,11 @@ void zcc_d64_dir_init(zcc_d64_dir_t *dir, zcc_d64_t *d64)
     dir->d64 = d64;
     memset(dir->diskname, 0, ZCC_D64_DISKNAME_MAXLEN);
     memset(dir->diskid, 0, ZCC_D64_DISKID_MAXLEN);
-    for (int i = 0; i < ZCC_D64_DIRENT_MAX; i++) {
+    for (int i = 0; i < ZCC_D64_GEOMETRY_DIRENT_MAX; i++) {
         zcc_d64_dirent_init(&(dir->entries[i]), d64);
     }
     dir->entry_count = 0;
+    dir->sizes_calculated = false;
 }
 
 
@@ -812,18 +1417,16 @@ void zcc_d64_dir_init(zcc_d64_dir_t *dir, zcc_d64_t *d64)
  */
 bool zcc_d64_dir_read(zcc_d64_dir_t *dir)
 {
-    long offset;
-    uint8_t *bam;
+    const uint8_t *name;
     zcc_d64_dirent_iter_t iter;
 
-    /* get pointer to BAM */
-    offset = zcc_d64_block_offset(ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR);
-    bam = dir->d64->data + offset;
-
     /* get disk name */
-    memcpy(dir->diskname, bam + ZCC_D64_BAM_DISKNAME, ZCC_D64_DISKNAME_MAXLEN);
+    name = zcc_d64_diskname(dir->d64);
+    memcpy(dir->diskname, name, ZCC_D64_DISKNAME_MAXLEN);
     /* get disk id */
-    memcpy(dir->diskid, bam + ZCC_D64_BAM_DISKID, ZCC_D64_DISKID_MAXLEN);
+    memcpy(dir->diskid,
+           name + ZCC_D64_BAM_DISKID - ZCC_D64_BAM_DISKNAME,
+           ZCC_D64_DISKID_MAXLEN);
 
 
     /* initialize dirent iter */
@@ -835,39 +1438,270 @@ bool zcc_d64_dir_read(zcc_d64_dir_t *dir)
     /* iterate over entries */
     do {
         /* copy dirent */
-        dir->entries[dir->entry_count++] = iter.dirent;
+        dir->entries[dir->entry_count] = iter.dirent;
+        dir->entries[dir->entry_count].dir = dir;
+        dir->entry_count++;
     } while (zcc_d64_dirent_iter_next(&iter));
 
     return true;
 }
 
 
-/** \brief  Dump directory \a dir on stdout
+/** \brief  Determine the size in bytes of all files in \a dir at once
  *
- * \param[in]   dir D64 directory
+ * The sizes are taken from the block ownership map of the image, built in a
+ * single pass over all chains, so they're the same as reported by
+ * zcc_d64_map_build(): a file whose chain loops, has an invalid link or runs
+ * into the chain of an earlier file has no valid size. Scratched files aren't
+ * in the map, their chains are walked on their own.
+ *
+ * Entries with a broken chain are left with an invalid size.
+ *
+ * \param[in,out]   dir D64 directory, read with zcc_d64_dir_read()
+ *
+ * \return  false if any file has a broken block chain
  */
-void zcc_d64_dir_dump(zcc_d64_dir_t *dir)
+bool zcc_d64_dir_calc_sizes(zcc_d64_dir_t *dir)
+{
+    zcc_d64_map_t *map;
+    bool result = true;
+
+    map = zcc_malloc(sizeof *map);
+    if (!zcc_d64_map_build(map, dir->d64)) {
+        zcc_free(map);
+        return false;
+    }
+
+    for (int e = 0; e < dir->entry_count; e++) {
+        zcc_d64_dirent_t *dirent = &(dir->entries[e]);
+        const uint8_t *entry = e < map->file_count ? map->files[e].entry : NULL;
+        long size;
+
+        if (dirent->size_valid) {
+            continue;
+        }
+        if (dirent->track == 0) {
+            /* no blocks (separator entries and such) */
+            size = 0;
+        } else if (dirent->filetype == 0) {
+            size = zcc_d64_file_size(dir->d64, dirent->track, dirent->sector);
+        } else if (entry != NULL
+                && ZCC_D64_DIRENT_GET_TRACK(entry) == dirent->track
+                && ZCC_D64_DIRENT_GET_SECTOR(entry) == dirent->sector) {
+            size = zcc_d64_map_file_size(map, e);
+        } else {
+            /* directory changed since it was read */
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+            size = -1;
+        }
+        if (size < 0) {
+            result = false;
+            continue;
+        }
+        dirent->size = (size_t)size;
+        dirent->size_valid = true;
+    }
+
+    dir->sizes_calculated = true;
+    zcc_free(map);
+    return result;
+}
+
+
+/** \brief  Print directory header line on stdout
+ *
+ * \param[in]   diskname    PETSCII disk name
+ * \param[in]   diskid      PETSCII disk ID and DOS type
+ */
+static void dump_dir_header(const uint8_t *diskname, const uint8_t *diskid)
 {
     char diskname_buf[ZCC_D64_DISKNAME_MAXLEN + 1];
     char diskid_buf[ZCC_D64_DISKID_MAXLEN + 1];
 
-    zcc_pet_to_asc_str(diskname_buf, dir->diskname, ZCC_D64_DISKNAME_MAXLEN);
-    zcc_pet_to_asc_str(diskid_buf, dir->diskname, ZCC_D64_DISKID_MAXLEN);
+    zcc_pet_to_asc_str(diskname_buf, diskname, ZCC_D64_DISKNAME_MAXLEN);
+    zcc_pet_to_asc_str(diskid_buf, diskid, ZCC_D64_DISKID_MAXLEN);
 
     printf("0 \"%16s\" %5s\n", diskname_buf, diskid_buf);
+}
+
+
+/** \brief  Print directory entry on stdout, without newline
+ *
+ * \param[in]   blocks      size in blocks
+ * \param[in]   name        PETSCII filename
+ * \param[in]   filetype    filetype byte
+ */
+static void dump_dir_entry(int blocks, const uint8_t *name, int filetype)
+{
+    char filename[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+    zcc_pet_to_asc_str(filename, name, ZCC_CBMDOS_FILENAME_MAX);
+
+    printf("%-5d \"%s\" %c%s%c",
+            blocks,
+            filename,
+            filetype & ZCC_CBMDOS_CLOSED_MASK ? ' ' : '*',
+            zcc_cbmdos_filetype_str((zcc_cbmdos_filetype_t)filetype),
+            filetype & ZCC_CBMDOS_LOCKED_MASK ? '<' : ' ');
+}
+
+
+/** \brief  Dump directory \a dir on stdout
+ *
+ * File sizes in bytes are only shown for entries that have them calculated
+ * already, see zcc_d64_dir_calc_sizes().
+ *
+ * \param[in]   dir D64 directory
+ */
+void zcc_d64_dir_dump(zcc_d64_dir_t *dir)
+{
+    dump_dir_header(dir->diskname, dir->diskid);
 
     for (int i = 0; i < dir->entry_count; i++) {
         zcc_d64_dirent_t *dirent = &(dir->entries[i]);
-        char filename[ZCC_CBMDOS_FILENAME_MAX + 1];
-
-        zcc_pet_to_asc_str(filename, dirent->name, ZCC_CBMDOS_FILENAME_MAX);
 
-        printf("%-5d \"%s\" %c%s%c\n",
-                (int)(dirent->blocks),
-                filename,
-                dirent->filetype & ZCC_CBMDOS_CLOSED_MASK ? ' ' : '*',
-                zcc_cbmdos_filetype_str(dirent->filetype),
-                dirent->filetype & ZCC_CBMDOS_LOCKED_MASK ? '<' : ' ');
+        dump_dir_entry(dirent->blocks, dirent->name, dirent->filetype);
+        if (dirent->size_valid) {
+            printf("  %6lu", (unsigned long)(dirent->size));
+        }
+        putchar('\n');
     }
     printf("%d blocks free.\n", zcc_d64_blocks_free(dir->d64));
 }
+
+
+/*
+ * Directory view: zero-copy directory access
+ */
+
+
+/** \brief  Point \a iter at directory block (\a track, \a sector)
+ *
+ * \param[in,out]   iter    directory view iterator
+ * \param[in]       track   track number
+ * \param[in]       sector  sector number
+ *
+ * \return  false if the block isn't valid
+ */
+static bool dirview_iter_set_block(zcc_d64_dirview_iter_t *iter,
+                                   int track, int sector)
+{
+    int index = zcc_d64_link_index(iter->d64, track, sector);
+
+    if (index < 0) {
+        return false;
+    }
+    iter->track = track;
+    iter->sector = sector;
+    iter->offset = 0;
+    iter->block = iter->d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+    iter->entry = iter->block;
+    return true;
+}
+
+
+/** \brief  Initialize D64 directory view iterator
+ *
+ * \param[out]  iter    directory view iterator
+ * \param[in]   d64     D64 image
+ *
+ * \return  true if at least one dirent was found
+ */
+bool zcc_d64_dirview_iter_init(zcc_d64_dirview_iter_t *iter,
+                               const zcc_d64_t *d64)
+{
+    iter->d64 = d64;
+    iter->index = 0;
+    iter->block = NULL;
+    iter->entry = NULL;
+    if (!dirview_iter_set_block(iter,
+                                d64->geometry->dir_track,
+                                d64->geometry->dir_sector)) {
+        return false;
+    }
+    return iter->entry[ZCC_D64_DIRENT_FILENAME] != 0;
+}
+
+
+/** \brief  Move D64 directory view iterator to the next entry
+ *
+ * Follows the (track, sector) links of the directory blocks, like the drive
+ * does, so directories extending beyond the directory track are handled as
+ * well. The number of entries is limited to the maximum of the geometry,
+ * which also guards against directory chains linking back to themselves.
+ *
+ * \param[in,out]   iter    directory view iterator
+ *
+ * \return  true if a next entry was found, false when end-of-dir
+ */
+bool zcc_d64_dirview_iter_next(zcc_d64_dirview_iter_t *iter)
+{
+    if (iter->entry == NULL
+            || iter->index >= iter->d64->geometry->dirent_max - 1
+            || iter->entry[ZCC_D64_DIRENT_FILENAME] == 0) {
+        return false;
+    }
+
+    if (iter->offset < ZCC_D64_BLOCK_SIZE_RAW - ZCC_D64_DIRENT_SIZE) {
+        /* move inside sector */
+        iter->offset += ZCC_D64_DIRENT_SIZE;
+        iter->entry = iter->block + iter->offset;
+    } else {
+        int track = iter->block[ZCC_D64_BLOCK_TRACK];
+        int sector = iter->block[ZCC_D64_BLOCK_SECTOR];
+
+        if (track == 0 || !dirview_iter_set_block(iter, track, sector)) {
+            iter->entry = NULL;
+            return false;
+        }
+    }
+    iter->index++;
+    return iter->entry[ZCC_D64_DIRENT_FILENAME] != 0;
+}
+
+
+/** \brief  Read directory of \a d64 into \a view
+ *
+ * \param[out]  view    directory view
+ * \param[in]   d64     D64 image
+ *
+ * \return  bool
+ */
+bool zcc_d64_dirview_read(zcc_d64_dirview_t *view, const zcc_d64_t *d64)
+{
+    zcc_d64_dirview_iter_t iter;
+
+    view->d64 = d64;
+    view->diskname = zcc_d64_diskname(d64);
+    view->diskid = view->diskname + ZCC_D64_BAM_DISKID - ZCC_D64_BAM_DISKNAME;
+    view->entry_count = 0;
+
+    if (!zcc_d64_dirview_iter_init(&iter, d64)) {
+        return true;
+    }
+    do {
+        view->entries[view->entry_count++] = iter.entry;
+    } while (zcc_d64_dirview_iter_next(&iter));
+
+    return true;
+}
+
+
+/** \brief  Dump directory \a view on stdout
+ *
+ * \param[in]   view    directory view
+ */
+void zcc_d64_dirview_dump(const zcc_d64_dirview_t *view)
+{
+    dump_dir_header(view->diskname, view->diskid);
+
+    for (int i = 0; i < view->entry_count; i++) {
+        const uint8_t *entry = view->entries[i];
+
+        dump_dir_entry(ZCC_D64_DIRENT_GET_BLOCKS(entry),
+                       ZCC_D64_DIRENT_GET_NAME(entry),
+                       ZCC_D64_DIRENT_GET_FILETYPE(entry));
+        putchar('\n');
+    }
+    printf("%d blocks free.\n", zcc_d64_blocks_free(view->d64));
+}
@@ -30,6 +30,7 @@
 #include <stdbool.h>
 
 #include "cbmdos.h"
+#include "pool.h"
 
 
 /** \brief  Size of a standard 35-track D64 image without error info
@@ -41,6 +42,72 @@
 #define ZCC_D64_SIZE_EXTENDED   (ZCC_D64_SIZE_CBMDOS + 5 * 17 * 256)
 
 
+/** \brief  Size of a standard 35-track D64 image with error info
+ *
+ * The error info is a byte per block appended to the block data.
+ */
+#define ZCC_D64_SIZE_CBMDOS_ERRORS      (ZCC_D64_SIZE_CBMDOS + 683)
+
+/** \brief  Size of a 40-track D64 image with error info
+ */
+#define ZCC_D64_SIZE_EXTENDED_ERRORS    (ZCC_D64_SIZE_EXTENDED + 768)
+
+
+/** \brief  Number of blocks in a 40-track D64 image
+ */
+#define ZCC_D64_BLOCKS_MAX      768
+
+/** \brief  Size of a D71 image without error info
+ */
+#define ZCC_D71_SIZE            349696
+
+/** \brief  Number of blocks in a D71 image
+ */
+#define ZCC_D71_BLOCKS          1366
+
+/** \brief  Size of a D81 image without error info
+ */
+#define ZCC_D81_SIZE            819200
+
+/** \brief  Number of blocks in a D81 image
+ */
+#define ZCC_D81_BLOCKS          3200
+
+/** \brief  Highest track number of any supported geometry (D81)
+ */
+#define ZCC_D64_GEOMETRY_TRACK_MAX  80
+
+/** \brief  Number of blocks of the largest supported geometry (D81)
+ *
+ * Use this instead of #ZCC_D64_BLOCKS_MAX for per-block tables of code that
+ * handles images of any geometry.
+ */
+#define ZCC_D64_GEOMETRY_BLOCKS_MAX ZCC_D81_BLOCKS
+
+/** \brief  Maximum number of directory entries of any supported geometry
+ *
+ * The 1581 has 37 directory sectors of eight entries each.
+ */
+#define ZCC_D64_GEOMETRY_DIRENT_MAX 296
+
+
+/** \brief  Number of 64-bit words in a bitmap with a bit per block
+ */
+#define ZCC_D64_BITMAP_WORDS    ((ZCC_D64_GEOMETRY_BLOCKS_MAX + 63) / 64)
+
+/** \brief  Test bit for block index \a I in 64-bit word bitmap \a B
+ */
+#define ZCC_D64_BITMAP_GET(B, I)    (((B)[(I) >> 6] >> ((I) & 63)) & 1U)
+
+/** \brief  Set bit for block index \a I in 64-bit word bitmap \a B
+ */
+#define ZCC_D64_BITMAP_SET(B, I)    ((B)[(I) >> 6] |= (uint64_t)1 << ((I) & 63))
+
+/** \brief  Clear bit for block index \a I in 64-bit word bitmap \a B
+ */
+#define ZCC_D64_BITMAP_CLR(B, I)    ((B)[(I) >> 6] &= ~((uint64_t)1 << ((I) & 63)))
+
+
 /** \brief  Minimum track number for D64 images
  */
 #define ZCC_D64_TRACK_MIN       1
@@ -152,6 +219,54 @@
 #define ZCC_D64_DIRENT_BLOCKS_MSB   0x1f
 
 
+/*
+ * Accessors for raw directory entries
+ *
+ * These take a pointer to a raw 32-byte directory entry, for example as
+ * returned by the directory view iterator, and read the fields in place.
+ */
+
+/** \brief  Get filetype byte of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_FILETYPE(P)  ((P)[ZCC_D64_DIRENT_FILETYPE])
+
+/** \brief  Get track number of first block of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_TRACK(P)     ((P)[ZCC_D64_DIRENT_TRACK])
+
+/** \brief  Get sector number of first block of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_SECTOR(P)    ((P)[ZCC_D64_DIRENT_SECTOR])
+
+/** \brief  Get pointer to PETSCII filename of raw dirent \a P
+ *
+ * The name is #ZCC_CBMDOS_FILENAME_MAX bytes, padded with $a0
+ */
+#define ZCC_D64_DIRENT_GET_NAME(P)      ((P) + ZCC_D64_DIRENT_FILENAME)
+
+/** \brief  Get track number of first side-sector block of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_SSB_TRACK(P) ((P)[ZCC_D64_DIRENT_SSB_TRACK])
+
+/** \brief  Get sector number of first side-sector block of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_SSB_SECTOR(P) ((P)[ZCC_D64_DIRENT_SSB_SECTOR])
+
+/** \brief  Get REL record length of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_REL_LENGTH(P) ((P)[ZCC_D64_DIRENT_REL_LENGTH])
+
+/** \brief  Get pointer to GEOS data of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_GEOS(P)      ((P) + ZCC_D64_DIRENT_GEOS)
+
+/** \brief  Get size in blocks of raw dirent \a P
+ */
+#define ZCC_D64_DIRENT_GET_BLOCKS(P) \
+    ((int)((P)[ZCC_D64_DIRENT_BLOCKS_LSB] \
+        + 256 * (P)[ZCC_D64_DIRENT_BLOCKS_MSB]))
+
+
 /** \brief  Offset in bytes in a D64 of the BAM
  */
 #define ZCC_D64_BAM_OFFSET  0x16500
@@ -173,6 +288,47 @@
  */
 #define ZCC_D64_DIR_SECTOR   1
 
+/** \brief  Track number of the second BAM sector of a D71 (tracks 36-70)
+ */
+#define ZCC_D71_BAM2_TRACK  53
+
+/** \brief  Offset in the D71 BAM sector (18,0) of the free counts of tracks
+ *          36-70
+ */
+#define ZCC_D71_BAM_COUNTS  0xdd
+
+/** \brief  Track number of the D81 header and directory
+ */
+#define ZCC_D81_DIR_TRACK   40
+
+/** \brief  Sector number of the D81 header (disk name and ID)
+ */
+#define ZCC_D81_HEADER_SECTOR   0
+
+/** \brief  Sector number of the D81 BAM for tracks 1-40
+ */
+#define ZCC_D81_BAM_SECTOR  1
+
+/** \brief  Sector number of the D81 BAM for tracks 41-80
+ */
+#define ZCC_D81_BAM2_SECTOR 2
+
+/** \brief  Sector number of the first D81 directory block
+ */
+#define ZCC_D81_DIR_SECTOR  3
+
+/** \brief  Offset in the D81 header of the disk name
+ */
+#define ZCC_D81_DISKNAME    0x04
+
+/** \brief  Offset in a D81 BAM sector of the first BAM entry
+ */
+#define ZCC_D81_BAM_TRACKS  0x10
+
+/** \brief  Size of a D81 BAM entry (free count and 40-bit bitmap)
+ */
+#define ZCC_D81_BAMENT_SIZE 0x06
+
 
 
 
@@ -189,6 +345,40 @@ typedef enum zcc_d64_type_e {
 } zcc_d64_type_t;
 
 
+/** \brief  Image formats sharing the D64 code
+ */
+typedef enum zcc_d64_format_e {
+    ZCC_D64_FORMAT_D64,     /**< 1541, 35 or 40 tracks */
+    ZCC_D64_FORMAT_D71,     /**< 1571, 70 tracks (double-sided) */
+    ZCC_D64_FORMAT_D81,     /**< 1581, 80 tracks of 40 sectors */
+    ZCC_D64_FORMAT_COUNT    /**< number of formats */
+} zcc_d64_format_t;
+
+
+/** \brief  1541 error codes as stored in the error info of a D64 image
+ *
+ * The values are the codes used in error info bytes, the matching DOS error
+ * numbers are given in the descriptions, see zcc_d64_error_number().
+ */
+typedef enum zcc_d64_error_e {
+    ZCC_D64_ERROR_NONE = 0x00,              /**< no error info */
+    ZCC_D64_ERROR_OK = 0x01,                /**< 00, no error */
+    ZCC_D64_ERROR_HEADER = 0x02,            /**< 20, header block not found */
+    ZCC_D64_ERROR_SYNC = 0x03,              /**< 21, no sync character */
+    ZCC_D64_ERROR_DATA = 0x04,              /**< 22, data block not present */
+    ZCC_D64_ERROR_DATA_CHECKSUM = 0x05,     /**< 23, data block checksum
+                                                 error */
+    ZCC_D64_ERROR_VERIFY = 0x06,            /**< 24, byte decoding error */
+    ZCC_D64_ERROR_WRITE_VERIFY = 0x07,      /**< 25, write-verify error */
+    ZCC_D64_ERROR_WRITE_PROTECT = 0x08,     /**< 26, write protect on */
+    ZCC_D64_ERROR_HEADER_CHECKSUM = 0x09,   /**< 27, header block checksum
+                                                 error */
+    ZCC_D64_ERROR_LONG_DATA = 0x0a,         /**< 28, data block too long */
+    ZCC_D64_ERROR_ID_MISMATCH = 0x0b,       /**< 29, disk ID mismatch */
+    ZCC_D64_ERROR_DRIVE_NOT_READY = 0x0f    /**< 74, drive not ready */
+} zcc_d64_error_t;
+
+
 /** \brief  D64 speedzone entry
  */
 typedef struct zcc_d64_speedzone_s {
@@ -198,14 +388,61 @@ typedef struct zcc_d64_speedzone_s {
 } zcc_d64_speedzone_t;
 
 
+/** \brief  Disk geometry descriptor
+ *
+ * Describes the layout of an image format. The per-track tables are filled
+ * in once from the speedzones of the format, so locating a block is a table
+ * lookup for every format. Obtain descriptors with zcc_d64_geometry().
+ */
+typedef struct zcc_d64_geometry_s {
+    zcc_d64_format_t    format;         /**< image format */
+    const char *        name;           /**< format name ("D64", ...) */
+    int                 track_max;      /**< highest track number */
+    int                 blocks;         /**< number of blocks */
+    int                 dirent_max;     /**< maximum number of directory
+                                             entries */
+    int                 header_track;   /**< track of disk name and ID */
+    int                 header_sector;  /**< sector of disk name and ID */
+    int                 diskname;       /**< offset of the disk name in the
+                                             header sector */
+    int                 bam_track;      /**< track of the (first) BAM sector */
+    int                 bam_sector;     /**< sector of the (first) BAM sector */
+    int                 bam2_track;     /**< track of the second BAM sector
+                                             (0 if none) */
+    int                 bam2_sector;    /**< sector of the second BAM sector */
+    int                 dir_track;      /**< track of the first directory
+                                             block */
+    int                 dir_sector;     /**< sector of the first directory
+                                             block */
+    uint8_t             sectors[ZCC_D64_GEOMETRY_TRACK_MAX + 1];
+                                        /**< sectors per track, 0 for tracks
+                                             outside the geometry */
+    uint16_t            track_block[ZCC_D64_GEOMETRY_TRACK_MAX + 1];
+                                        /**< block index of sector 0 of each
+                                             track */
+} zcc_d64_geometry_t;
+
+
 /** \brief  D64 handle
  *
+ * Also used for D71 and D81 images, \c geometry determines the layout.
  */
 typedef struct zcc_d64_s {
     char *          path;   /**< path to image file */
     uint8_t *       data;   /**< binary data */
-    size_t          size;   /**< size of data */
+    size_t          size;   /**< size of data, excluding error info */
+    uint8_t *       errors; /**< error info, a zcc_d64_error_t per block,
+                                 pointing into \c data right after the block
+                                 data (`NULL` if the image has none) */
     zcc_d64_type_t  type;   /**< DOS type */
+    const zcc_d64_geometry_t *geometry; /**< disk geometry */
+    zcc_pool_t *    pool;   /**< buffer pool \a data was taken from (optional) */
+    bool            recycled;   /**< \a data was reused from \a pool and
+                                     contains stale data */
+    uint8_t         written[ZCC_D64_GEOMETRY_BLOCKS_MAX / 8];   /**< bitmap of blocks
+                                                             written with
+                                                             zcc_d64_block_write()
+                                                             */
 } zcc_d64_t;
 
 
@@ -213,10 +450,15 @@ typedef struct zcc_d64_s {
  */
 typedef struct zcc_d64_dirent_s {
     zcc_d64_t * d64;    /**< D64 reference */
+    struct zcc_d64_dir_s *dir;  /**< directory containing the entry, `NULL`
+                                     for a standalone entry */
     uint8_t     name[ZCC_CBMDOS_FILENAME_MAX];  /**< PETSCII filename */
     uint8_t     geos[ZCC_D64_DIRENT_GEOS_SIZE]; /**< GEOS data */
     uint16_t    blocks;     /**< size of the file in blocks */
-    size_t      size;       /**< size in bytes */
+    size_t      size;       /**< size in bytes, only valid when
+                                 \c size_valid is set, use
+                                 zcc_d64_dirent_size() */
+    bool        size_valid; /**< \c size has been calculated */
     uint8_t     filetype;   /**< filetype and locked/closed flags */
     uint8_t     dir_track;  /**< track number of next dir block */
     uint8_t     dir_sector; /**< sector number of next dir block */
@@ -233,7 +475,8 @@ typedef struct zcc_d64_dirent_s {
 typedef struct zcc_d64_dirent_iter_s {
     zcc_d64_t *d64;             /**< reference to D64 */
     zcc_d64_dirent_t dirent;    /**< directory entry */
-    int sector;                 /**< sector number in track 18 */
+    int track;                  /**< track number of current dir block */
+    int sector;                 /**< sector number of current dir block */
     int offset;                 /**< offset in current dir sector */
     int index;                  /**< dirent index in d64 */
 } zcc_d64_dirent_iter_t;
@@ -255,12 +498,28 @@ typedef struct zcc_d64_dirent_iter_s {
 
 /** \brief  Offset in BAM of the disk ID
  */
-#define ZCC_D64_BAM_DISKID      0xa5
+#define ZCC_D64_BAM_DISKID      0xa2
+
+/** \brief  Offset in BAM of the disk name on PrologicDOS 40-track disks
+ */
+#define ZCC_D64_BAM_DISKNAME_PROLOGICDOS    0xa4
 
 /** \brief  Offset in BAM of the BAM entries for tracks 1-35
  */
 #define ZCC_D64_BAM_TRACKS      0x04
 
+/** \brief  Offset in BAM of the SpeedDOS BAM entries for tracks 36-40
+ */
+#define ZCC_D64_BAM_TRACKS_SPEEDDOS     0xc0
+
+/** \brief  Offset in BAM of the DolphinDOS BAM entries for tracks 36-40
+ */
+#define ZCC_D64_BAM_TRACKS_DOLPHINDOS   0xac
+
+/** \brief  Offset in BAM of the PrologicDOS BAM entries for tracks 36-40
+ */
+#define ZCC_D64_BAM_TRACKS_PROLOGICDOS  0x90
+
 /** \brief  Size of a BAM entry for a track
  */
 #define ZCC_D64_BAMENT_SIZE     0x04
@@ -287,11 +546,46 @@ typedef struct zcc_d64_dir_s {
     zcc_d64_t *d64;    /**< D64 reference */
     uint8_t diskname[ZCC_D64_DISKNAME_MAXLEN];  /**< PETSCII disk name */
     uint8_t diskid[ZCC_D64_DISKID_MAXLEN];  /**< PETSCII disk ID + DOS type */
-    zcc_d64_dirent_t entries[ZCC_D64_DIRENT_MAX];   /**< directory entries */
+    zcc_d64_dirent_t entries[ZCC_D64_GEOMETRY_DIRENT_MAX];  /**< directory
+                                                                 entries */
     int entry_count;    /**< number of directory entries */
+    bool sizes_calculated;  /**< zcc_d64_dir_calc_sizes() has been called */
 } zcc_d64_dir_t;
 
 
+/** \brief  D64 directory view
+ *
+ * Compact, read-only representation of a directory: instead of copies of the
+ * entries this contains pointers to the raw entries in the image data, to be
+ * read with the ZCC_D64_DIRENT_GET_*() macros. The pointers are valid for as
+ * long as the image data isn't freed.
+ */
+typedef struct zcc_d64_dirview_s {
+    const zcc_d64_t *d64;       /**< D64 reference */
+    const uint8_t *diskname;    /**< PETSCII disk name in the BAM */
+    const uint8_t *diskid;      /**< PETSCII disk ID + DOS type in the BAM */
+    const uint8_t *entries[ZCC_D64_GEOMETRY_DIRENT_MAX];    /**< raw directory
+                                                                 entries */
+    int entry_count;            /**< number of directory entries */
+} zcc_d64_dirview_t;
+
+
+/** \brief  D64 directory view iterator
+ *
+ * Iterates the directory without copying any data, \c entry points into the
+ * image data.
+ */
+typedef struct zcc_d64_dirview_iter_s {
+    const zcc_d64_t *d64;   /**< reference to D64 */
+    const uint8_t *block;   /**< current directory block */
+    const uint8_t *entry;   /**< current raw directory entry */
+    int track;              /**< track number of current directory block */
+    int sector;             /**< sector number of current directory block */
+    int offset;             /**< offset in current dir sector */
+    int index;              /**< dirent index in d64 */
+} zcc_d64_dirview_iter_t;
+
+
 /** \brief  D64 block iterator object
  *
  * A block is a raw (256 bytes) sector in a D64 image
@@ -302,19 +596,35 @@ typedef struct zcc_d64_block_iter_s {
     size_t size;                            /**< current block data size */
     int track;                              /**< current block track number */
     int sector;                             /**< current block sector number */
+    int count;                              /**< number of blocks visited */
     bool valid;                             /**< iterator is valid */
 } zcc_d64_block_iter_t;
 
 
 
+const zcc_d64_geometry_t *zcc_d64_geometry(zcc_d64_format_t format);
+long zcc_d64_geometry_block_offset(const zcc_d64_geometry_t *geometry,
+                                   int track, int sector);
+int  zcc_d64_geometry_block_index(const zcc_d64_geometry_t *geometry,
+                                  int track, int sector);
+
 long zcc_d64_block_offset(int track, int sector);
+int  zcc_d64_block_index(int track, int sector);
+int  zcc_d64_link_index(const zcc_d64_t *d64, int track, int sector);
 long zcc_d64_track_offset(int track);
+int  zcc_d64_track_count(const zcc_d64_t *d64);
 bool zcc_d64_track_is_valid(const zcc_d64_t *d64, int track);
 void zcc_d64_init(zcc_d64_t *d64);
 void zcc_d64_alloc(zcc_d64_t *d64, zcc_d64_type_t type);
+void zcc_d64_alloc_format(zcc_d64_t *d64, zcc_d64_format_t format);
+void zcc_d64_alloc_pooled(zcc_d64_t *d64, zcc_d64_type_t type, zcc_pool_t *pool);
+void zcc_d64_clear_unwritten(zcc_d64_t *d64);
 void zcc_d64_free(zcc_d64_t *d64);
 bool zcc_d64_read(zcc_d64_t *d64, const char *path, zcc_d64_type_t type);
 bool zcc_d64_write(zcc_d64_t *d64, const char *path);
+void zcc_d64_errors_attach(zcc_d64_t *d64);
+zcc_d64_error_t zcc_d64_block_error(const zcc_d64_t *d64,
+                                    int track, int sector);
 void zcc_d64_dump_info(const zcc_d64_t *d64);
 void zcc_d64_dump_bam(const zcc_d64_t *d64);
 
@@ -326,10 +636,11 @@ bool zcc_d64_block_write(zcc_d64_t *d64,
                          int track, int sector);
 
 
-int zcc_d64_blocks_free(zcc_d64_t *d64);
+int zcc_d64_blocks_free(const zcc_d64_t *d64);
 
 void zcc_d64_dirent_init(zcc_d64_dirent_t *dirent, zcc_d64_t *d64);
 void zcc_d64_dirent_read(zcc_d64_dirent_t *dirent, const uint8_t *data);
+long zcc_d64_dirent_size(zcc_d64_dirent_t *dirent);
 
 
 bool zcc_d64_dirent_iter_init(zcc_d64_dirent_iter_t *iter, zcc_d64_t *d64);
@@ -343,13 +654,26 @@ void zcc_d64_dirent_iter_dump(const zcc_d64_dirent_iter_t *iter);
 
 void zcc_d64_dir_init(zcc_d64_dir_t *dir, zcc_d64_t * d64);
 bool zcc_d64_dir_read(zcc_d64_dir_t *dir);
+bool zcc_d64_dir_calc_sizes(zcc_d64_dir_t *dir);
 void zcc_d64_dir_dump(zcc_d64_dir_t *dir);
 
+bool zcc_d64_dirview_iter_init(zcc_d64_dirview_iter_t *iter,
+                               const zcc_d64_t *d64);
+bool zcc_d64_dirview_iter_next(zcc_d64_dirview_iter_t *iter);
+bool zcc_d64_dirview_read(zcc_d64_dirview_t *view, const zcc_d64_t *d64);
+void zcc_d64_dirview_dump(const zcc_d64_dirview_t *view);
+
 
+int  zcc_d64_bament_offset(zcc_d64_type_t type, int track);
+int  zcc_d64_diskname_offset(zcc_d64_type_t type);
+const uint8_t *zcc_d64_diskname(const zcc_d64_t *d64);
 bool zcc_d64_bament_read(const zcc_d64_t *d64, uint8_t *bament, int track);
 
 
 int zcc_d64_track_max_sector(int track);
+int zcc_d64_track_speedzone(int track);
+int zcc_d64_error_number(zcc_d64_error_t error);
+int zcc_d64_dump_errors(const uint8_t *errors, int track_max);
 
 bool zcc_d64_block_is_valid(const zcc_d64_t *d64, int track, int sector);
 
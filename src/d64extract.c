@@ -0,0 +1,614 @@
+/** \file   d64extract.c
+ * \brief   Extract files from D64 images
+ *
+ * Files are written straight from the image data: the data part of each block
+ * of a file becomes an entry in an I/O vector and the whole file is written
+ * with writev(), so no contiguous copy of the file is ever made. Block chains
+ * are resolved up front in the calling thread, after which the files are
+ * written by a small pool of worker threads.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* writev(), IOV_MAX, sysconf() */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "cbmdos.h"
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "petasc.h"
+#include "d64.h"
+#include "pc64.h"
+
+#include "d64extract.h"
+
+
+#ifndef IOV_MAX
+/** \brief  Fallback for the maximum number of vectors passed to writev()
+ */
+# define IOV_MAX    16
+#endif
+
+/** \brief  Size of a host filename buffer
+ *
+ * Filename, '~' plus collision counter, '.' plus extension and terminator
+ */
+#define EXTRACT_NAME_MAX    (ZCC_CBMDOS_FILENAME_MAX + 4 + 4 + 1)
+
+
+/** \brief  File extraction job
+ */
+typedef struct extract_job_s {
+    const uint8_t * entry;      /**< raw directory entry */
+    char            name[EXTRACT_NAME_MAX]; /**< host filename */
+    uint8_t         head[ZCC_PC64_HEADER_SIZE]; /**< header written in front
+                                                     of the data */
+    size_t          head_size;  /**< size of \c head, 0 for none */
+    char *          path;       /**< host path */
+    struct iovec *  iov;        /**< I/O vector with the file's data */
+    int             iov_count;  /**< number of elements in \c iov */
+    long            size;       /**< size in bytes */
+    int             error;      /**< error code (0 = OK) */
+} extract_job_t;
+
+
+/** \brief  Job queue shared by the worker threads
+ */
+typedef struct extract_queue_s {
+    extract_job_t * jobs;   /**< jobs */
+    int             count;  /**< number of jobs */
+    int             next;   /**< index of next job to process */
+    pthread_mutex_t lock;   /**< lock for \c next */
+} extract_queue_t;
+
+
+/** \brief  Collect the data of the file at \a entry as an I/O vector
+ *
+ * The vector points into \a d64's data, one element per block, preceded by
+ * the job's header if it has one.
+ *
+ * \param[in]       d64     D64 image
+ * \param[in,out]   job     extraction job
+ *
+ * \return  true on success, on failure `job->error` is set
+ */
+static bool extract_gather(const zcc_d64_t *d64, extract_job_t *job)
+{
+    uint64_t visited[ZCC_D64_BITMAP_WORDS];
+    int blocks[ZCC_D64_GEOMETRY_BLOCKS_MAX];
+    int count = 0;
+    int index;
+
+    job->iov = NULL;
+    job->iov_count = 0;
+    job->size = 0;
+    memset(visited, 0, sizeof visited);
+
+    index = zcc_d64_link_index(d64,
+                               ZCC_D64_DIRENT_GET_TRACK(job->entry),
+                               ZCC_D64_DIRENT_GET_SECTOR(job->entry));
+    while (index >= 0) {
+        const uint8_t *block = d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+
+        if (ZCC_D64_BITMAP_GET(visited, index)) {
+            job->error = ZCC_ERR_CHAIN_CYCLE;
+            return false;
+        }
+        ZCC_D64_BITMAP_SET(visited, index);
+        blocks[count++] = index;
+
+        if (block[ZCC_D64_BLOCK_TRACK] == 0) {
+            break;
+        }
+        index = zcc_d64_link_index(d64,
+                                   block[ZCC_D64_BLOCK_TRACK],
+                                   block[ZCC_D64_BLOCK_SECTOR]);
+    }
+    if (index < 0) {
+        job->error = zcc_errno != ZCC_ERR_OK ? zcc_errno : ZCC_ERR_SECTOR_RANGE;
+        return false;
+    }
+
+    job->iov = zcc_malloc(sizeof *(job->iov) * (size_t)(count + 1));
+    if (job->head_size > 0) {
+        job->iov[job->iov_count].iov_base = job->head;
+        job->iov[job->iov_count].iov_len = job->head_size;
+        job->iov_count++;
+    }
+    for (int i = 0; i < count; i++) {
+        uint8_t *block = d64->data + blocks[i] * ZCC_D64_BLOCK_SIZE_RAW;
+        size_t len = ZCC_D64_BLOCK_SIZE_DATA;
+
+        if (i == count - 1) {
+            /* last block: sector byte is the index of the last data byte */
+            int last = block[ZCC_D64_BLOCK_SECTOR];
+
+            len = last >= ZCC_D64_BLOCK_DATA ? (size_t)(last - 1) : 0;
+        }
+        job->iov[job->iov_count].iov_base = block + ZCC_D64_BLOCK_DATA;
+        job->iov[job->iov_count].iov_len = len;
+        job->iov_count++;
+        job->size += (long)len;
+    }
+    return true;
+}
+
+
+/** \brief  Write all of \a iov to \a fd, handling short writes
+ *
+ * \param[in]       fd      file descriptor
+ * \param[in,out]   iov     I/O vector (modified)
+ * \param[in]       count   number of elements in \a iov
+ *
+ * \return  true on success
+ */
+static bool extract_writev(int fd, struct iovec *iov, int count)
+{
+    while (count > 0) {
+        ssize_t result;
+        size_t written;
+
+        result = writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        /* skip elements written completely */
+        written = (size_t)result;
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0 && written > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Write I/O vector \a iov to host file \a path
+ *
+ * Doesn't touch `zcc_errno`, so it's safe to call from the worker threads.
+ *
+ * \param[in]       path    host path
+ * \param[in,out]   iov     I/O vector (modified)
+ * \param[in]       count   number of elements in \a iov
+ *
+ * \return  true on success
+ */
+static bool extract_file_writev(const char *path, struct iovec *iov, int count)
+{
+    int fd;
+    bool result;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    result = extract_writev(fd, iov, count);
+    if (close(fd) != 0) {
+        result = false;
+    }
+    return result;
+}
+
+
+/** \brief  Write file of \a job to the host
+ *
+ * \param[in,out]   job     extraction job
+ *
+ * \return  true on success, on failure `job->error` is set
+ */
+static bool extract_write(extract_job_t *job)
+{
+    if (!extract_file_writev(job->path, job->iov, job->iov_count)) {
+        job->error = ZCC_ERR_IO;
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Worker thread: write files until the queue is empty
+ *
+ * \param[in,out]   arg     job queue
+ *
+ * \return  `NULL`
+ */
+static void *extract_worker(void *arg)
+{
+    extract_queue_t *queue = arg;
+
+    while (true) {
+        int index;
+
+        pthread_mutex_lock(&(queue->lock));
+        index = queue->next++;
+        pthread_mutex_unlock(&(queue->lock));
+
+        if (index >= queue->count) {
+            break;
+        }
+        if (queue->jobs[index].error == 0) {
+            extract_write(&(queue->jobs[index]));
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Generate unique host filename for \a job
+ *
+ * \param[in,out]   job     extraction job
+ * \param[in]       jobs    jobs with names already generated
+ * \param[in]       count   number of elements in \a jobs
+ */
+static void extract_name(extract_job_t *job,
+                         const extract_job_t *jobs,
+                         int count)
+{
+    char base[ZCC_CBMDOS_FILENAME_MAX + 1];
+    const char *ext;
+    int copy = 1;
+    bool unique;
+
+    zcc_pet_filename_to_host(base, ZCC_D64_DIRENT_GET_NAME(job->entry), NULL);
+    if (base[0] == '\0') {
+        strcpy(base, "_");
+    }
+    ext = zcc_cbmdos_filetype_str(ZCC_D64_DIRENT_GET_FILETYPE(job->entry));
+
+    do {
+        if (copy == 1) {
+            snprintf(job->name, sizeof job->name, "%s.%s", base, ext);
+        } else {
+            snprintf(job->name, sizeof job->name, "%s~%d.%s", base, copy, ext);
+        }
+        unique = true;
+        for (int i = 0; i < count && unique; i++) {
+            if (strcmp(jobs[i].name, job->name) == 0) {
+                unique = false;
+            }
+        }
+        copy++;
+    } while (!unique);
+}
+
+
+/** \brief  Extract the file at directory entry \a entry to \a path
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   entry   raw directory entry in \a d64
+ * \param[in]   path    host path
+ *
+ * \return  number of bytes written or -1 on failure
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ * \throw   ZCC_ERR_IO
+ */
+long zcc_d64_extract_file(const zcc_d64_t *d64,
+                          const uint8_t *entry,
+                          const char *path)
+{
+    extract_job_t job;
+    bool result;
+
+    job.entry = entry;
+    job.head_size = 0;
+    job.path = zcc_strdup(path);
+    job.error = 0;
+
+    result = extract_gather(d64, &job) && extract_write(&job);
+    zcc_free(job.iov);
+    zcc_free(job.path);
+    if (!result) {
+        zcc_errno = job.error;
+        return -1;
+    }
+    return job.size;
+}
+
+
+/** \brief  Write I/O vector \a iov to host file \a path
+ *
+ * The vector is modified while writing. For single-threaded callers, the
+ * extraction workers don't use this since it sets `zcc_errno`.
+ *
+ * \param[in]       path    host path
+ * \param[in,out]   iov     I/O vector
+ * \param[in]       count   number of elements in \a iov
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_IO
+ */
+bool zcc_d64_extract_writev(const char *path, struct iovec *iov, int count)
+{
+    if (!extract_file_writev(path, iov, count)) {
+        zcc_errno = ZCC_ERR_IO;
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Write the files of the jobs in \a queue and report the results
+ *
+ * The jobs and their paths and vectors are freed.
+ *
+ * \param[in,out]   queue   job queue
+ * \param[in]       threads number of worker threads (0 = number of CPUs)
+ * \param[in]       verbose list files extracted on stdout
+ *
+ * \return  number of files extracted, or -1 when one or more files failed
+ */
+static int extract_run(extract_queue_t *queue, int threads, bool verbose)
+{
+    pthread_t workers[ZCC_D64_EXTRACT_THREADS_MAX];
+    int started = 0;
+    int extracted = 0;
+    int error = 0;
+
+    /* write files */
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > ZCC_D64_EXTRACT_THREADS_MAX) {
+        threads = ZCC_D64_EXTRACT_THREADS_MAX;
+    }
+    if (threads > queue->count) {
+        threads = queue->count;
+    }
+    pthread_mutex_init(&(queue->lock), NULL);
+    while (started < threads - 1) {
+        if (pthread_create(&workers[started], NULL, extract_worker, queue)
+                != 0) {
+            break;
+        }
+        started++;
+    }
+    /* the calling thread works the queue as well */
+    extract_worker(queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&(queue->lock));
+
+    /* report and clean up */
+    for (int i = 0; i < queue->count; i++) {
+        extract_job_t *job = &(queue->jobs[i]);
+
+        if (job->error == 0) {
+            extracted++;
+            if (verbose) {
+                printf("%s: %ld bytes\n", job->path, job->size);
+            }
+        } else {
+            if (error == 0) {
+                error = job->error;
+            }
+            printf("%s: %s\n", job->path, zcc_strerror(job->error));
+        }
+        zcc_free(job->iov);
+        zcc_free(job->path);
+    }
+    zcc_free(queue->jobs);
+
+    if (error != 0) {
+        zcc_errno = error;
+        return -1;
+    }
+    return extracted;
+}
+
+
+/** \brief  Check if \a entry holds a file that can be extracted
+ *
+ * Scratched files, DEL files and files without blocks are skipped.
+ *
+ * \param[in]   entry   raw directory entry
+ *
+ * \return  bool
+ */
+static bool extract_wanted(const uint8_t *entry)
+{
+    return (ZCC_D64_DIRENT_GET_FILETYPE(entry) & ZCC_CBMDOS_FILETYPE_MASK)
+            != ZCC_CBMDOS_FILETYPE_DEL
+        && ZCC_D64_DIRENT_GET_TRACK(entry) != 0;
+}
+
+
+/** \brief  Set host path of \a job from \a dir and its name
+ *
+ * \param[in,out]   job extraction job
+ * \param[in]       dir host directory
+ */
+static void extract_path(extract_job_t *job, const char *dir)
+{
+    size_t len = strlen(dir) + strlen(job->name) + 2;
+
+    job->path = zcc_malloc(len);
+    snprintf(job->path, len, "%s/%s", dir, job->name);
+}
+
+
+/** \brief  Extract files from \a d64 into host directory \a dir
+ *
+ * Scratched files, DEL files and files without blocks are skipped. Host
+ * filenames are generated from the CBM filename with the file type as
+ * extension, duplicate names get a '~N' suffix.
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   dir     host directory (`NULL` for the current directory)
+ * \param[in]   name    host filename (without extension) of the file to
+ *                      extract, or `NULL` to extract all files
+ * \param[in]   threads number of worker threads (0 = number of CPUs)
+ * \param[in]   verbose list files extracted on stdout
+ *
+ * \return  number of files extracted, or -1 when one or more files failed
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ */
+int zcc_d64_extract(const zcc_d64_t *d64,
+                    const char *dir,
+                    const char *name,
+                    int threads,
+                    bool verbose)
+{
+    zcc_d64_dirview_t view;
+    extract_queue_t queue;
+
+    if (!zcc_d64_dirview_read(&view, d64)) {
+        return -1;
+    }
+    if (dir == NULL) {
+        dir = ".";
+    }
+
+    /* create jobs and resolve block chains */
+    queue.jobs = zcc_malloc(sizeof *(queue.jobs) * ZCC_D64_GEOMETRY_DIRENT_MAX);
+    queue.count = 0;
+    queue.next = 0;
+    for (int i = 0; i < view.entry_count; i++) {
+        const uint8_t *entry = view.entries[i];
+        extract_job_t *job = &(queue.jobs[queue.count]);
+
+        if (!extract_wanted(entry)) {
+            continue;
+        }
+        if (name != NULL) {
+            char base[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+            zcc_pet_filename_to_host(base, ZCC_D64_DIRENT_GET_NAME(entry),
+                                     NULL);
+            if (strcmp(base, name) != 0) {
+                continue;
+            }
+        }
+
+        job->entry = entry;
+        job->head_size = 0;
+        job->error = 0;
+        extract_name(job, queue.jobs, queue.count);
+        extract_path(job, dir);
+        extract_gather(d64, job);
+        queue.count++;
+    }
+
+    if (name != NULL && queue.count == 0) {
+        zcc_free(queue.jobs);
+        zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+        return -1;
+    }
+
+    return extract_run(&queue, threads, verbose);
+}
+
+
+/** \brief  Export files from \a d64 as PC64 files into host directory \a dir
+ *
+ * Each file is written as a PC64 header followed by the file's blocks in a
+ * single gathered write. Files already in \a dir are read once into a set of
+ * names, colliding names get the next free number in their extension (P00,
+ * P01, ...). DEL files can't be stored in PC64 files and are skipped.
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   dir     host directory (`NULL` for the current directory)
+ * \param[in]   threads number of worker threads (0 = number of CPUs)
+ * \param[in]   verbose list files exported on stdout
+ *
+ * \return  number of files exported, or -1 when one or more files failed
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_INVALID_FILENAME    more than 100 files share a name
+ */
+int zcc_d64_extract_pc64(const zcc_d64_t *d64,
+                         const char *dir,
+                         int threads,
+                         bool verbose)
+{
+    zcc_d64_dirview_t view;
+    zcc_pc64_names_t names;
+    extract_queue_t queue;
+
+    if (!zcc_d64_dirview_read(&view, d64)) {
+        return -1;
+    }
+    if (dir == NULL) {
+        dir = ".";
+    }
+    zcc_pc64_names_init(&names);
+    if (!zcc_pc64_names_scan(&names, dir)) {
+        zcc_pc64_names_free(&names);
+        return -1;
+    }
+
+    queue.jobs = zcc_malloc(sizeof *(queue.jobs) * ZCC_D64_GEOMETRY_DIRENT_MAX);
+    queue.count = 0;
+    queue.next = 0;
+    for (int i = 0; i < view.entry_count; i++) {
+        const uint8_t *entry = view.entries[i];
+        extract_job_t *job = &(queue.jobs[queue.count]);
+        zcc_cbmdos_filetype_t type = (zcc_cbmdos_filetype_t)
+            (ZCC_D64_DIRENT_GET_FILETYPE(entry) & ZCC_CBMDOS_FILETYPE_MASK);
+
+        if (!extract_wanted(entry)) {
+            continue;
+        }
+
+        job->entry = entry;
+        job->error = 0;
+        job->head_size = ZCC_PC64_HEADER_SIZE;
+        zcc_pc64_header(job->head, ZCC_D64_DIRENT_GET_NAME(entry),
+                        type == ZCC_CBMDOS_FILETYPE_REL
+                        ? ZCC_D64_DIRENT_GET_REL_LENGTH(entry) : 0);
+        if (!zcc_pc64_name(&names, job->name, ZCC_D64_DIRENT_GET_NAME(entry),
+                           type)) {
+            job->error = zcc_errno;
+            job->iov = NULL;
+            job->name[0] = '\0';
+        } else {
+            extract_gather(d64, job);
+        }
+        extract_path(job, dir);
+        queue.count++;
+    }
+    zcc_pc64_names_free(&names);
+
+    return extract_run(&queue, threads, verbose);
+}
@@ -0,0 +1,55 @@
+/** \file   d64extract.h
+ * \brief   Extract files from D64 images - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_D64EXTRACT_H
+#define ZCC_D64EXTRACT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+
+struct iovec;
+
+
+/** \brief  Maximum number of worker threads used for extracting
+ */
+#define ZCC_D64_EXTRACT_THREADS_MAX 8
+
+
+bool zcc_d64_extract_writev(const char *path, struct iovec *iov, int count);
+long zcc_d64_extract_file(const zcc_d64_t *d64,
+                          const uint8_t *entry,
+                          const char *path);
+int  zcc_d64_extract(const zcc_d64_t *d64,
+                     const char *dir,
+                     const char *name,
+                     int threads,
+                     bool verbose);
+int  zcc_d64_extract_pc64(const zcc_d64_t *d64,
+                          const char *dir,
+                          int threads,
+                          bool verbose);
+
+#endif
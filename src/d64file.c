@@ -0,0 +1,384 @@
+/** \file   d64file.c
+ * \brief   Streaming access to files in D64 images
+ *
+ * Provides open/read/seek/close on the block chain of a file, reading the
+ * data straight from the image buffer. zcc_d64_file_span() gives direct
+ * access to the data of each block, for consumers that don't need a copy.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "d64.h"
+
+#include "d64file.h"
+
+
+/** \brief  Get pointer to block \a i of \a file
+ *
+ * \param[in]   file    file handle
+ * \param[in]   i       index in the file's block list
+ *
+ * \return  raw block data
+ */
+static const uint8_t *file_block(const zcc_d64_file_t *file, int i)
+{
+    return file->d64->data + file->blocks[i] * ZCC_D64_BLOCK_SIZE_RAW;
+}
+
+
+/** \brief  Get number of data bytes in raw block \a block
+ *
+ * \param[in]   block   raw block data
+ *
+ * \return  254 for all but the last block of a chain
+ */
+static int file_block_length(const uint8_t *block)
+{
+    int last;
+
+    if (block[ZCC_D64_BLOCK_TRACK] != 0) {
+        return ZCC_D64_BLOCK_SIZE_DATA;
+    }
+    /* last block: sector byte is the index of the last data byte */
+    last = block[ZCC_D64_BLOCK_SECTOR];
+    return last >= ZCC_D64_BLOCK_DATA ? last - 1 : 0;
+}
+
+
+/** \brief  Follow the chain of \a file until block \a block is known
+ *
+ * \param[in,out]   file    file handle
+ * \param[in]       block   index in the file's block list
+ *
+ * \return  1 on success, 0 if the file has fewer blocks, -1 on error
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+static int file_extend(zcc_d64_file_t *file, int block)
+{
+    while (file->block_count <= block) {
+        const uint8_t *last = file_block(file, file->block_count - 1);
+        int index;
+
+        if (last[ZCC_D64_BLOCK_TRACK] == 0) {
+            file->chain_done = true;
+            return 0;
+        }
+        index = zcc_d64_link_index(file->d64,
+                                   last[ZCC_D64_BLOCK_TRACK],
+                                   last[ZCC_D64_BLOCK_SECTOR]);
+        if (index < 0) {
+            return -1;
+        }
+        if (ZCC_D64_BITMAP_GET(file->visited, index)) {
+            zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+            return -1;
+        }
+        ZCC_D64_BITMAP_SET(file->visited, index);
+        file->blocks[file->block_count++] = (int16_t)index;
+    }
+    return 1;
+}
+
+
+/** \brief  Get data at the current position of \a file
+ *
+ * Moves to the next block if the current one is exhausted.
+ *
+ * \param[in,out]   file    file handle
+ * \param[out]      data    pointer to data at the current position
+ *
+ * \return  number of bytes left in the current block, 0 on EOF, -1 on error
+ */
+static long file_current(zcc_d64_file_t *file, const uint8_t **data)
+{
+    if (!file->open) {
+        zcc_errno = ZCC_ERR_NULL;
+        return -1;
+    }
+
+    while (true) {
+        const uint8_t *block = file_block(file, file->block);
+        int length = file_block_length(block);
+        int result;
+
+        if (file->offset < length) {
+            *data = block + ZCC_D64_BLOCK_DATA + file->offset;
+            return length - file->offset;
+        }
+        if (block[ZCC_D64_BLOCK_TRACK] == 0) {
+            return 0;
+        }
+        result = file_extend(file, file->block + 1);
+        if (result <= 0) {
+            return result;
+        }
+        file->block++;
+        file->offset = 0;
+    }
+}
+
+
+/** \brief  Open file starting at (\a track, \a sector) in \a d64
+ *
+ * \param[out]  file    file handle
+ * \param[in]   d64     D64 image, must stay valid while \a file is open
+ * \param[in]   track   track number of the first block
+ * \param[in]   sector  sector number of the first block
+ *
+ * \return  true on success
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+bool zcc_d64_file_open(zcc_d64_file_t *file,
+                       const zcc_d64_t *d64,
+                       int track, int sector)
+{
+    int index = zcc_d64_link_index(d64, track, sector);
+
+    file->open = false;
+    if (index < 0) {
+        return false;
+    }
+
+    file->d64 = d64;
+    memset(file->visited, 0, sizeof file->visited);
+    ZCC_D64_BITMAP_SET(file->visited, index);
+    file->blocks[0] = (int16_t)index;
+    file->block_count = 1;
+    file->chain_done = false;
+    file->block = 0;
+    file->offset = 0;
+    file->open = true;
+    return true;
+}
+
+
+/** \brief  Open file of raw directory entry \a entry in \a d64
+ *
+ * \param[out]  file    file handle
+ * \param[in]   d64     D64 image
+ * \param[in]   entry   raw directory entry
+ *
+ * \return  true on success
+ */
+bool zcc_d64_file_open_entry(zcc_d64_file_t *file,
+                             const zcc_d64_t *d64,
+                             const uint8_t *entry)
+{
+    return zcc_d64_file_open(file, d64,
+                             ZCC_D64_DIRENT_GET_TRACK(entry),
+                             ZCC_D64_DIRENT_GET_SECTOR(entry));
+}
+
+
+/** \brief  Read up to \a size bytes from \a file into \a dest
+ *
+ * \param[in,out]   file    file handle
+ * \param[out]      dest    destination buffer
+ * \param[in]       size    number of bytes to read
+ *
+ * \return  number of bytes read (less than \a size at end of file), or -1 on
+ *          error
+ */
+long zcc_d64_file_read(zcc_d64_file_t *file, uint8_t *dest, size_t size)
+{
+    size_t total = 0;
+
+    while (total < size) {
+        const uint8_t *data;
+        long avail = file_current(file, &data);
+        size_t n;
+
+        if (avail < 0) {
+            return -1;
+        }
+        if (avail == 0) {
+            break;
+        }
+        n = size - total < (size_t)avail ? size - total : (size_t)avail;
+        memcpy(dest + total, data, n);
+        file->offset += (int)n;
+        total += n;
+    }
+    return (long)total;
+}
+
+
+/** \brief  Get direct access to the data at the current position of \a file
+ *
+ * Sets \a data to the remaining data of the current block and moves the
+ * position past it. Calling this repeatedly returns the file in block-sized
+ * spans without copying.
+ *
+ * \param[in,out]   file    file handle
+ * \param[out]      data    pointer into the image data
+ *
+ * \return  number of bytes at \a data, 0 on end of file, -1 on error
+ */
+long zcc_d64_file_span(zcc_d64_file_t *file, const uint8_t **data)
+{
+    long avail = file_current(file, data);
+
+    if (avail > 0) {
+        file->offset += (int)avail;
+    }
+    return avail;
+}
+
+
+/** \brief  Get size in bytes of \a file
+ *
+ * Follows the chain to its end if that hasn't happened yet.
+ *
+ * \param[in,out]   file    file handle
+ *
+ * \return  size in bytes or -1 on error
+ */
+long zcc_d64_file_length(zcc_d64_file_t *file)
+{
+    const uint8_t *last;
+
+    if (!file->open) {
+        zcc_errno = ZCC_ERR_NULL;
+        return -1;
+    }
+    if (!file->chain_done && file_extend(file, ZCC_D64_GEOMETRY_BLOCKS_MAX) < 0) {
+        return -1;
+    }
+    last = file_block(file, file->block_count - 1);
+    return (long)(file->block_count - 1) * ZCC_D64_BLOCK_SIZE_DATA
+        + file_block_length(last);
+}
+
+
+/** \brief  Get current position in \a file
+ *
+ * \param[in]   file    file handle
+ *
+ * \return  offset in bytes from the start of the file
+ */
+long zcc_d64_file_tell(const zcc_d64_file_t *file)
+{
+    return (long)file->block * ZCC_D64_BLOCK_SIZE_DATA + file->offset;
+}
+
+
+/** \brief  Move position in \a file
+ *
+ * Only the blocks up to the new position are looked up, whole blocks are
+ * skipped without touching their data. Seeking relative to the end
+ * (`SEEK_END`) requires following the chain to its end.
+ *
+ * \param[in,out]   file    file handle
+ * \param[in]       offset  offset in bytes
+ * \param[in]       whence  `SEEK_SET`, `SEEK_CUR` or `SEEK_END`
+ *
+ * \return  true on success
+ * \throw   ZCC_ERR_SEEK_RANGE
+ */
+bool zcc_d64_file_seek(zcc_d64_file_t *file, long offset, int whence)
+{
+    long target;
+    int block;
+    int result;
+
+    if (!file->open) {
+        zcc_errno = ZCC_ERR_NULL;
+        return false;
+    }
+
+    switch (whence) {
+        case SEEK_SET:
+            target = offset;
+            break;
+        case SEEK_CUR:
+            target = zcc_d64_file_tell(file) + offset;
+            break;
+        case SEEK_END:
+            target = zcc_d64_file_length(file);
+            if (target < 0) {
+                return false;
+            }
+            target += offset;
+            break;
+        default:
+            zcc_errno = ZCC_ERR_SEEK_RANGE;
+            return false;
+    }
+    if (target < 0) {
+        zcc_errno = ZCC_ERR_SEEK_RANGE;
+        return false;
+    }
+
+    block = (int)(target / ZCC_D64_BLOCK_SIZE_DATA);
+    if (block >= file->d64->geometry->blocks) {
+        zcc_errno = ZCC_ERR_SEEK_RANGE;
+        return false;
+    }
+    result = file_extend(file, block);
+    if (result < 0) {
+        return false;
+    }
+    if (result == 0) {
+        /* only valid when seeking to the end of a file of whole blocks */
+        if (block != file->block_count
+                || file_block_length(file_block(file, block - 1))
+                    != ZCC_D64_BLOCK_SIZE_DATA
+                || target % ZCC_D64_BLOCK_SIZE_DATA != 0) {
+            zcc_errno = ZCC_ERR_SEEK_RANGE;
+            return false;
+        }
+        file->block = block - 1;
+        file->offset = ZCC_D64_BLOCK_SIZE_DATA;
+        return true;
+    }
+    if (target % ZCC_D64_BLOCK_SIZE_DATA
+            > file_block_length(file_block(file, block))) {
+        zcc_errno = ZCC_ERR_SEEK_RANGE;
+        return false;
+    }
+    file->block = block;
+    file->offset = (int)(target % ZCC_D64_BLOCK_SIZE_DATA);
+    return true;
+}
+
+
+/** \brief  Close \a file
+ *
+ * \param[in,out]   file    file handle
+ */
+void zcc_d64_file_close(zcc_d64_file_t *file)
+{
+    file->open = false;
+    file->d64 = NULL;
+    file->block_count = 0;
+}
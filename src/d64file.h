@@ -0,0 +1,73 @@
+/** \file   d64file.h
+ * \brief   Streaming access to files in D64 images - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_D64FILE_H
+#define ZCC_D64FILE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+
+
+/** \brief  Handle of an open file in a D64 image
+ *
+ * The list of blocks of the file is built lazily: reading and seeking only
+ * follow the chain as far as needed, so opening a file is O(1) and reading
+ * the first bytes of a large file doesn't walk the whole chain.
+ */
+typedef struct zcc_d64_file_s {
+    const zcc_d64_t *   d64;    /**< D64 image */
+
+    /** \brief  Block indexes of the file's blocks found so far
+     */
+    int16_t             blocks[ZCC_D64_GEOMETRY_BLOCKS_MAX];
+    int                 block_count;    /**< number of entries in \c blocks */
+    bool                chain_done;     /**< last block has been found */
+
+    /** \brief  Bitmap of blocks in \c blocks, to detect cycles
+     */
+    uint64_t            visited[ZCC_D64_BITMAP_WORDS];
+
+    int                 block;  /**< index in \c blocks of the current block */
+    int                 offset; /**< offset in the current block's data */
+    bool                open;   /**< handle is open */
+} zcc_d64_file_t;
+
+
+bool zcc_d64_file_open(zcc_d64_file_t *file,
+                       const zcc_d64_t *d64,
+                       int track, int sector);
+bool zcc_d64_file_open_entry(zcc_d64_file_t *file,
+                             const zcc_d64_t *d64,
+                             const uint8_t *entry);
+long zcc_d64_file_read(zcc_d64_file_t *file, uint8_t *dest, size_t size);
+long zcc_d64_file_span(zcc_d64_file_t *file, const uint8_t **data);
+bool zcc_d64_file_seek(zcc_d64_file_t *file, long offset, int whence);
+long zcc_d64_file_tell(const zcc_d64_file_t *file);
+long zcc_d64_file_length(zcc_d64_file_t *file);
+void zcc_d64_file_close(zcc_d64_file_t *file);
+
+#endif
@@ -0,0 +1,563 @@
+/** \file   d64map.c
+ * \brief   D64 block ownership map
+ *
+ * Determines which directory entry owns each block of a D64 image, by walking
+ * the directory chain and all block chains reachable from it. Chain walking
+ * uses a bitmap of visited blocks: a walk stops at the first block already
+ * seen, so corrupt images with cycles or cross-linked files can't make it loop
+ * and the whole analysis is linear in the number of blocks.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbmdos.h"
+#include "debug.h"
+#include "errors.h"
+#include "petasc.h"
+#include "d64.h"
+#include "bam.h"
+
+#include "d64map.h"
+
+
+/** \brief  Offset in a GEOS dirent of the info block track number
+ */
+#define GEOS_INFO_TRACK     0x15
+
+/** \brief  Offset in a GEOS dirent of the info block sector number
+ */
+#define GEOS_INFO_SECTOR    0x16
+
+/** \brief  Offset in a GEOS dirent of the file structure byte
+ */
+#define GEOS_STRUCTURE      0x17
+
+/** \brief  Offset in a GEOS dirent of the GEOS filetype
+ */
+#define GEOS_FILETYPE       0x18
+
+/** \brief  GEOS file structure value for VLIR files
+ */
+#define GEOS_STRUCTURE_VLIR 0x01
+
+
+/** \brief  Walk block chain starting at (\a track, \a sector)
+ *
+ * Marks all blocks of the chain as owned by \a owner. The walk stops at the
+ * end of the chain, at an invalid link or at a block already visited.
+ *
+ * \param[in,out]   map     block map
+ * \param[in]       owner   owner of the blocks
+ * \param[in]       track   track number of first block
+ * \param[in]       sector  sector number of first block
+ * \param[out]      blocks  number of blocks claimed (added)
+ * \param[out]      last    index of the last block of the chain (`NULL` to
+ *                          ignore)
+ * \param[out]      other   owner of the visited block the walk ran into
+ *
+ * \return  status flags (ZCC_D64_FILE_*), 0 for a clean chain
+ */
+static int map_walk_chain(zcc_d64_map_t *map,
+                          int owner,
+                          int track, int sector,
+                          int *blocks,
+                          int *last,
+                          int *other)
+{
+    const zcc_d64_t *d64 = map->d64;
+    int index;
+
+    index = zcc_d64_link_index(d64, track, sector);
+    if (index < 0) {
+        return ZCC_D64_FILE_BAD_LINK;
+    }
+
+    while (true) {
+        const uint8_t *block;
+
+        if (ZCC_D64_BITMAP_GET(map->visited, index)) {
+            if (map->owner[index] == owner) {
+                return ZCC_D64_FILE_CYCLE;
+            }
+            *other = map->owner[index];
+            return ZCC_D64_FILE_CROSSLINK;
+        }
+        ZCC_D64_BITMAP_SET(map->visited, index);
+        map->owner[index] = (int16_t)owner;
+        (*blocks)++;
+
+        block = d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+        if (block[ZCC_D64_BLOCK_TRACK] == 0) {
+            if (last != NULL) {
+                *last = index;
+            }
+            return 0;
+        }
+        index = zcc_d64_link_index(d64,
+                                   block[ZCC_D64_BLOCK_TRACK],
+                                   block[ZCC_D64_BLOCK_SECTOR]);
+        if (index < 0) {
+            return ZCC_D64_FILE_BAD_LINK;
+        }
+    }
+}
+
+
+/** \brief  Get number of tracks in the image data of \a d64
+ *
+ * For D64 images this depends on the size, not on the DOS type, so blocks
+ * on tracks 36-40 are checked even if the BAM doesn't cover them.
+ *
+ * \param[in]   d64     D64 image
+ *
+ * \return  number of tracks
+ */
+static int map_track_count(const zcc_d64_t *d64)
+{
+    if (d64->geometry->format != ZCC_D64_FORMAT_D64) {
+        return d64->geometry->track_max;
+    }
+    return d64->size == ZCC_D64_SIZE_EXTENDED
+        ? ZCC_D64_TRACK_MAX_EXT : ZCC_D64_TRACK_MAX;
+}
+
+
+/** \brief  Mark block (\a track, \a sector) as used by the DOS
+ *
+ * \param[in,out]   map     block map
+ * \param[in]       track   track number
+ * \param[in]       sector  sector number
+ */
+static void map_mark_system(zcc_d64_map_t *map, int track, int sector)
+{
+    int index = zcc_d64_geometry_block_index(map->d64->geometry,
+                                             track, sector);
+
+    ZCC_D64_BITMAP_SET(map->visited, index);
+    map->owner[index] = ZCC_D64_OWNER_SYSTEM;
+}
+
+
+/** \brief  Check if the BAM of \a map marks (\a track, \a sector) as free
+ *
+ * \param[in]   map     block map
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  1 if free, 0 if allocated, -1 if the track isn't in the BAM
+ */
+static int map_bam_is_free(const zcc_d64_map_t *map, int track, int sector)
+{
+    if (track > map->bam.track_max) {
+        return -1;
+    }
+    return zcc_bam_is_free(&(map->bam), track, sector) ? 1 : 0;
+}
+
+
+/** \brief  Walk the extra chains of a file: REL side sectors, GEOS records
+ *
+ * \param[in,out]   map     block map
+ * \param[in]       index   file index
+ *
+ * \return  status flags
+ */
+static int map_walk_extra(zcc_d64_map_t *map, int index)
+{
+    zcc_d64_map_file_t *file = &(map->files[index]);
+    const uint8_t *entry = file->entry;
+    int filetype = ZCC_D64_DIRENT_GET_FILETYPE(entry) & ZCC_CBMDOS_FILETYPE_MASK;
+    int status = 0;
+
+    if (filetype == ZCC_CBMDOS_FILETYPE_REL) {
+        /* side sector chain */
+        if (ZCC_D64_DIRENT_GET_SSB_TRACK(entry) != 0) {
+            status |= map_walk_chain(map, index,
+                                     ZCC_D64_DIRENT_GET_SSB_TRACK(entry),
+                                     ZCC_D64_DIRENT_GET_SSB_SECTOR(entry),
+                                     &(file->blocks), NULL, &(file->owner));
+        }
+    } else if (filetype <= ZCC_CBMDOS_FILETYPE_PRG
+            && entry[GEOS_FILETYPE] != 0
+            && entry[GEOS_STRUCTURE] <= GEOS_STRUCTURE_VLIR) {
+        /* GEOS file: info block */
+        if (entry[GEOS_INFO_TRACK] != 0) {
+            status |= map_walk_chain(map, index,
+                                     entry[GEOS_INFO_TRACK],
+                                     entry[GEOS_INFO_SECTOR],
+                                     &(file->blocks), NULL, &(file->owner));
+        }
+        /* VLIR: the first block is the record block, walk each record */
+        if (entry[GEOS_STRUCTURE] == GEOS_STRUCTURE_VLIR) {
+            int rec = zcc_d64_link_index(map->d64,
+                                         ZCC_D64_DIRENT_GET_TRACK(entry),
+                                         ZCC_D64_DIRENT_GET_SECTOR(entry));
+            if (rec >= 0) {
+                const uint8_t *records = map->d64->data
+                    + rec * ZCC_D64_BLOCK_SIZE_RAW;
+
+                for (int r = 2; r < ZCC_D64_BLOCK_SIZE_RAW; r += 2) {
+                    if (records[r] == 0) {
+                        if (records[r + 1] == 0) {
+                            break;  /* end of records */
+                        }
+                        continue;   /* record not available */
+                    }
+                    status |= map_walk_chain(map, index,
+                                             records[r], records[r + 1],
+                                             &(file->blocks), NULL,
+                                             &(file->owner));
+                }
+            }
+        }
+    }
+    return status;
+}
+
+
+/** \brief  Build block ownership map of \a d64
+ *
+ * \param[out]  map     block map
+ * \param[in]   d64     D64 image
+ *
+ * \return  true if the directory could be read (problems found in the image
+ *          are recorded in \a map, use zcc_d64_map_is_valid())
+ */
+bool zcc_d64_map_build(zcc_d64_map_t *map, const zcc_d64_t *d64)
+{
+    const zcc_d64_geometry_t *geometry = d64->geometry;
+    zcc_d64_dirview_t view;
+    int index;
+    int blocks = 0;
+    int dummy = 0;
+    int tracks;
+
+    map->d64 = d64;
+    for (int i = 0; i < geometry->blocks; i++) {
+        map->owner[i] = ZCC_D64_OWNER_NONE;
+    }
+    memset(map->visited, 0, sizeof map->visited);
+    map->file_count = 0;
+    map->blocks_used = 0;
+    map->cycles = 0;
+    map->crosslinks = 0;
+    map->bad_links = 0;
+    map->orphans = 0;
+    map->unallocated = 0;
+    map->dir_broken = false;
+    zcc_bam_load(&(map->bam), d64);
+
+    /* header, BAM and directory chain */
+    map_mark_system(map, geometry->header_track, geometry->header_sector);
+    map_mark_system(map, geometry->bam_track, geometry->bam_sector);
+    if (geometry->format == ZCC_D64_FORMAT_D71) {
+        /* the 1571 allocates all of track 53 for its second BAM sector */
+        for (int sector = 0; sector < geometry->sectors[geometry->bam2_track];
+                sector++) {
+            map_mark_system(map, geometry->bam2_track, sector);
+        }
+    } else if (geometry->bam2_track != 0) {
+        map_mark_system(map, geometry->bam2_track, geometry->bam2_sector);
+    }
+    if (map_walk_chain(map, ZCC_D64_OWNER_SYSTEM,
+                       geometry->dir_track, geometry->dir_sector,
+                       &blocks, NULL, &dummy) != 0) {
+        map->dir_broken = true;
+    }
+
+    if (!zcc_d64_dirview_read(&view, d64)) {
+        return false;
+    }
+
+    /* files */
+    for (int i = 0; i < view.entry_count; i++) {
+        zcc_d64_map_file_t *file = &(map->files[i]);
+        const uint8_t *entry = view.entries[i];
+        int last = -1;
+
+        file->entry = entry;
+        file->blocks = 0;
+        file->size = -1;
+        file->status = 0;
+        file->owner = ZCC_D64_OWNER_NONE;
+        map->file_count++;
+
+        if (ZCC_D64_DIRENT_GET_FILETYPE(entry) == 0
+                || ZCC_D64_DIRENT_GET_TRACK(entry) == 0) {
+            /* scratched, or no blocks */
+            file->size = 0;
+            continue;
+        }
+
+        file->status = map_walk_chain(map, i,
+                                      ZCC_D64_DIRENT_GET_TRACK(entry),
+                                      ZCC_D64_DIRENT_GET_SECTOR(entry),
+                                      &(file->blocks), &last, &(file->owner));
+        if (file->status == 0 && last >= 0) {
+            const uint8_t *block = d64->data + last * ZCC_D64_BLOCK_SIZE_RAW;
+
+            file->size = (long)(file->blocks - 1) * ZCC_D64_BLOCK_SIZE_DATA
+                + block[ZCC_D64_BLOCK_SECTOR] - 1;
+        }
+        file->status |= map_walk_extra(map, i);
+
+        if (file->blocks != ZCC_D64_DIRENT_GET_BLOCKS(entry)) {
+            file->status |= ZCC_D64_FILE_BLOCKS;
+        }
+        if (file->status & ZCC_D64_FILE_CYCLE) {
+            map->cycles++;
+        }
+        if (file->status & ZCC_D64_FILE_CROSSLINK) {
+            map->crosslinks++;
+        }
+        if (file->status & ZCC_D64_FILE_BAD_LINK) {
+            map->bad_links++;
+        }
+    }
+
+    /* compare with BAM */
+    tracks = map_track_count(d64);
+    index = 0;
+    for (int track = ZCC_D64_TRACK_MIN; track <= tracks; track++) {
+        int sectors = geometry->sectors[track];
+
+        for (int sector = 0; sector < sectors; sector++, index++) {
+            int bam_free = map_bam_is_free(map, track, sector);
+            bool used = ZCC_D64_BITMAP_GET(map->visited, index);
+
+            if (used) {
+                map->blocks_used++;
+            }
+            if (bam_free == 0 && !used) {
+                map->orphans++;
+            } else if (bam_free == 1 && used) {
+                map->unallocated++;
+            }
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Check if \a map found any problems in the image
+ *
+ * Directory block counts not matching the actual number of blocks are not
+ * considered a problem, the drive doesn't care either.
+ *
+ * \param[in]   map     block map
+ *
+ * \return  true if the image is consistent
+ */
+bool zcc_d64_map_is_valid(const zcc_d64_map_t *map)
+{
+    return !map->dir_broken
+        && map->cycles == 0
+        && map->crosslinks == 0
+        && map->bad_links == 0
+        && map->orphans == 0
+        && map->unallocated == 0;
+}
+
+
+/** \brief  Get size in bytes of file \a index in \a map
+ *
+ * \param[in]   map     block map
+ * \param[in]   index   file index
+ *
+ * \return  size in bytes or -1 when the file's chain is broken
+ * \throw   ZCC_ERR_NULL
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+long zcc_d64_map_file_size(const zcc_d64_map_t *map, int index)
+{
+    if (index < 0 || index >= map->file_count) {
+        zcc_errno = ZCC_ERR_NULL;
+        return -1;
+    }
+    if (map->files[index].status & ZCC_D64_FILE_CYCLE) {
+        zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+        return -1;
+    }
+    if (map->files[index].size < 0) {
+        /* invalid link or running into another file's chain */
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return -1;
+    }
+    return map->files[index].size;
+}
+
+
+/** \brief  Print filename of file \a index in \a map
+ *
+ * \param[in]   map     block map
+ * \param[in]   index   file index
+ */
+static void map_print_name(const zcc_d64_map_t *map, int index)
+{
+    char name[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+    zcc_pet_to_asc_str(name,
+                       ZCC_D64_DIRENT_GET_NAME(map->files[index].entry),
+                       ZCC_CBMDOS_FILENAME_MAX);
+    printf("\"%s\"", name);
+}
+
+
+/** \brief  Print validation report of \a map on stdout
+ *
+ * \param[in]   map     block map
+ * \param[in]   verbose also list files without problems and list the
+ *                      orphaned/unallocated blocks
+ */
+void zcc_d64_map_dump(const zcc_d64_map_t *map, bool verbose)
+{
+    if (map->dir_broken) {
+        printf("directory chain is broken\n");
+    }
+
+    for (int i = 0; i < map->file_count; i++) {
+        const zcc_d64_map_file_t *file = &(map->files[i]);
+
+        if (file->status == 0 && !verbose) {
+            continue;
+        }
+        map_print_name(map, i);
+        printf(": %d blocks", file->blocks);
+        if (file->size >= 0) {
+            printf(", %ld bytes", file->size);
+        }
+        if (file->status & ZCC_D64_FILE_CYCLE) {
+            printf(", chain contains a cycle");
+        }
+        if (file->status & ZCC_D64_FILE_BAD_LINK) {
+            printf(", chain contains an invalid link");
+        }
+        if (file->status & ZCC_D64_FILE_CROSSLINK) {
+            printf(", cross-linked with ");
+            if (file->owner >= 0) {
+                map_print_name(map, file->owner);
+            } else {
+                printf("the directory");
+            }
+        }
+        if (file->status & ZCC_D64_FILE_BLOCKS) {
+            printf(", directory says %d blocks",
+                    ZCC_D64_DIRENT_GET_BLOCKS(file->entry));
+        }
+        putchar('\n');
+    }
+
+    if (verbose && (map->orphans > 0 || map->unallocated > 0)) {
+        int index = 0;
+        int tracks = map_track_count(map->d64);
+
+        for (int track = ZCC_D64_TRACK_MIN; track <= tracks; track++) {
+            int sectors = map->d64->geometry->sectors[track];
+
+            for (int sector = 0; sector < sectors; sector++, index++) {
+                int bam_free = map_bam_is_free(map, track, sector);
+                bool used = ZCC_D64_BITMAP_GET(map->visited, index);
+
+                if (bam_free == 0 && !used) {
+                    printf("(%2d,%2d): allocated but not in use\n",
+                            track, sector);
+                } else if (bam_free == 1 && used) {
+                    printf("(%2d,%2d): in use but not allocated\n",
+                            track, sector);
+                }
+            }
+        }
+    }
+
+    printf("%d blocks in use, %d cycles, %d cross-links, %d invalid links, "
+            "%d orphaned blocks, %d unallocated blocks.\n",
+            map->blocks_used, map->cycles, map->crosslinks, map->bad_links,
+            map->orphans, map->unallocated);
+}
+
+
+/** \brief  Replace the BAM of \a d64 with the blocks in use according to \a map
+ *
+ * All blocks reached from the directory are marked as used, all other blocks
+ * as free, and the BAM entries in sector (18,0) are rewritten. The rest of the
+ * BAM sector (disk name, ID, DOS version) is left alone. \a map is updated to
+ * match the new BAM.
+ *
+ * When the directory chain is broken or a file chain loops or has an invalid
+ * link, the blocks past the damage are unknown and would be freed, so the BAM
+ * is left untouched.
+ *
+ * \param[in,out]   map     block map, built from \a d64
+ * \param[in,out]   d64     D64 image
+ *
+ * \return  number of blocks whose BAM state changed, or -1 when the chains
+ *          are damaged
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+int zcc_d64_map_rebuild_bam(zcc_d64_map_t *map, zcc_d64_t *d64)
+{
+    zcc_bam_t bam;
+    int changed;
+
+    if (map->dir_broken || map->cycles > 0 || map->bad_links > 0) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return -1;
+    }
+
+    zcc_bam_init_geometry(&bam, map->bam.geometry, map->bam.type,
+                          map->bam.track_max);
+    zcc_bam_mark_used_bitmap(&bam, map->visited);
+    changed = zcc_bam_diff(&bam, &(map->bam));
+    zcc_bam_store(&bam, d64);
+
+    map->bam = bam;
+    map->orphans = 0;
+    map->unallocated = 0;
+    return changed;
+}
+
+
+/** \brief  Rebuild the BAM of \a d64 from its directory and file chains
+ *
+ * \param[in,out]   d64     D64 image
+ *
+ * \return  number of blocks whose BAM state changed, or -1 when the
+ *          directory couldn't be read or the chains are damaged
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ * \see     zcc_d64_map_rebuild_bam()
+ */
+int zcc_d64_rebuild_bam(zcc_d64_t *d64)
+{
+    zcc_d64_map_t map;
+
+    if (!zcc_d64_map_build(&map, d64)) {
+        return -1;
+    }
+    return zcc_d64_map_rebuild_bam(&map, d64);
+}
@@ -0,0 +1,116 @@
+/** \file   d64map.h
+ * \brief   D64 block ownership map - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_D64MAP_H
+#define ZCC_D64MAP_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+#include "bam.h"
+
+
+/** \brief  Owner value of a block not reachable from the directory
+ */
+#define ZCC_D64_OWNER_NONE      -1
+
+/** \brief  Owner value of a BAM or directory block
+ */
+#define ZCC_D64_OWNER_SYSTEM    -2
+
+
+/** \brief  File status flag: the block chain links back into itself
+ */
+#define ZCC_D64_FILE_CYCLE      0x01
+
+/** \brief  File status flag: the block chain runs into another file's chain
+ */
+#define ZCC_D64_FILE_CROSSLINK  0x02
+
+/** \brief  File status flag: the block chain contains an invalid link
+ */
+#define ZCC_D64_FILE_BAD_LINK   0x04
+
+/** \brief  File status flag: the block count in the directory is wrong
+ */
+#define ZCC_D64_FILE_BLOCKS     0x08
+
+
+/** \brief  Per-file result of the block analysis
+ */
+typedef struct zcc_d64_map_file_s {
+    const uint8_t * entry;      /**< raw directory entry */
+    int             blocks;     /**< number of blocks owned by the file */
+    long            size;       /**< size in bytes, -1 when the chain is
+                                     broken */
+    int             status;     /**< ZCC_D64_FILE_* flags */
+    int             owner;      /**< owner of the block the chain ran into
+                                     (#ZCC_D64_FILE_CROSSLINK only) */
+} zcc_d64_map_file_t;
+
+
+/** \brief  Block ownership map of a D64 image
+ *
+ * Built in one pass over the directory and all block chains. Every block is
+ * followed at most once: a chain stops at the first block already visited,
+ * which is how cycles and cross-links are detected.
+ */
+typedef struct zcc_d64_map_s {
+    const zcc_d64_t *   d64;    /**< D64 image */
+
+    /** \brief  Owner of each block
+     *
+     * Index in \c files, #ZCC_D64_OWNER_SYSTEM or #ZCC_D64_OWNER_NONE
+     */
+    int16_t             owner[ZCC_D64_GEOMETRY_BLOCKS_MAX];
+
+    /** \brief  Bitmap of blocks reached from the directory
+     */
+    uint64_t            visited[ZCC_D64_BITMAP_WORDS];
+
+    zcc_bam_t           bam;    /**< BAM of the image */
+
+    zcc_d64_map_file_t  files[ZCC_D64_GEOMETRY_DIRENT_MAX];  /**< files */
+    int                 file_count; /**< number of entries in \c files */
+
+    int blocks_used;    /**< number of blocks reached from the directory */
+    int cycles;         /**< number of files with a cycle in their chain */
+    int crosslinks;     /**< number of files running into another chain */
+    int bad_links;      /**< number of chains with an invalid link */
+    int orphans;        /**< blocks allocated in the BAM, but unreachable */
+    int unallocated;    /**< blocks reachable, but free in the BAM */
+    bool dir_broken;    /**< directory chain is broken or loops */
+} zcc_d64_map_t;
+
+
+bool zcc_d64_map_build(zcc_d64_map_t *map, const zcc_d64_t *d64);
+bool zcc_d64_map_is_valid(const zcc_d64_map_t *map);
+long zcc_d64_map_file_size(const zcc_d64_map_t *map, int index);
+void zcc_d64_map_dump(const zcc_d64_map_t *map, bool verbose);
+int  zcc_d64_map_rebuild_bam(zcc_d64_map_t *map, zcc_d64_t *d64);
+int  zcc_d64_rebuild_bam(zcc_d64_t *d64);
+
+#endif
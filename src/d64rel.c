@@ -0,0 +1,234 @@
+/** \file   d64rel.c
+ * \brief   REL file access in D64 images
+ *
+ * The data blocks of a REL file are listed in its side sectors, 120 per
+ * side sector, in groups of six side sectors. 1581 images add a super side
+ * sector in front, pointing at the first side sector of each group. All side
+ * sectors are linked in a single chain, which is followed once when the file
+ * is opened.
+ *
+ * See doc/reference/formats/d64.txt, d71.txt and d81.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "cbmdos.h"
+#include "d64.h"
+
+#include "d64rel.h"
+
+
+/** \brief  Get pointer to the data of block \a index of \a d64
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   index   block index
+ *
+ * \return  pointer to the raw block
+ */
+static const uint8_t *rel_block(const zcc_d64_t *d64, int index)
+{
+    return d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+}
+
+
+/** \brief  Add the data blocks listed in \a side to \a rel
+ *
+ * \param[in,out]   rel     REL handle
+ * \param[in]       side    side sector
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ * \throw   ZCC_ERR_INVALID_IMAGE   more data blocks than the image holds
+ */
+static bool rel_add_blocks(zcc_d64_rel_t *rel, const uint8_t *side)
+{
+    int end = ZCC_D64_BLOCK_SIZE_RAW;
+
+    /* the last side sector's sector byte is the index of its last byte */
+    if (side[ZCC_D64_BLOCK_TRACK] == 0 && side[ZCC_D64_BLOCK_SECTOR] < end) {
+        end = side[ZCC_D64_BLOCK_SECTOR] + 1;
+    }
+    for (int pos = ZCC_D64_REL_SIDE_DATA; pos + 1 < end; pos += 2) {
+        int index;
+
+        if (side[pos] == 0) {
+            break;
+        }
+        index = zcc_d64_link_index(rel->d64, side[pos], side[pos + 1]);
+        if (index < 0) {
+            zcc_errno = ZCC_ERR_SECTOR_RANGE;
+            return false;
+        }
+        if (rel->block_count == ZCC_D64_GEOMETRY_BLOCKS_MAX) {
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+            return false;
+        }
+        rel->blocks[rel->block_count++] = (int16_t)index;
+    }
+    return true;
+}
+
+
+/** \brief  Open REL file at raw directory entry \a entry
+ *
+ * Follows the side sector chain once, collecting the data blocks.
+ *
+ * \param[out]  rel     REL handle
+ * \param[in]   d64     D64 image
+ * \param[in]   entry   raw directory entry in \a d64
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_FILETYPE        not a REL file
+ * \throw   ZCC_ERR_INVALID_IMAGE   invalid record size or side sector
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+bool zcc_d64_rel_open(zcc_d64_rel_t *rel,
+                      const zcc_d64_t *d64,
+                      const uint8_t *entry)
+{
+    uint64_t visited[ZCC_D64_BITMAP_WORDS];
+    const uint8_t *last;
+    int index;
+
+    rel->d64 = d64;
+    rel->block_count = 0;
+    rel->side_sectors = 0;
+    rel->record_size = ZCC_D64_DIRENT_GET_REL_LENGTH(entry);
+    rel->size = 0;
+    rel->record_count = 0;
+
+    if ((ZCC_D64_DIRENT_GET_FILETYPE(entry) & ZCC_CBMDOS_FILETYPE_MASK)
+            != ZCC_CBMDOS_FILETYPE_REL) {
+        zcc_errno = ZCC_ERR_FILETYPE;
+        return false;
+    }
+    if (rel->record_size == 0) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+
+    memset(visited, 0, sizeof visited);
+    index = zcc_d64_link_index(d64,
+                               ZCC_D64_DIRENT_GET_SSB_TRACK(entry),
+                               ZCC_D64_DIRENT_GET_SSB_SECTOR(entry));
+    if (index >= 0
+            && rel_block(d64, index)[ZCC_D64_REL_SIDE_NUMBER]
+                == ZCC_D64_REL_SUPER_MARKER) {
+        /* 1581: the super side sector links to the first side sector */
+        const uint8_t *super = rel_block(d64, index);
+
+        ZCC_D64_BITMAP_SET(visited, index);
+        index = zcc_d64_link_index(d64,
+                                   super[ZCC_D64_BLOCK_TRACK],
+                                   super[ZCC_D64_BLOCK_SECTOR]);
+    }
+    while (true) {
+        const uint8_t *side;
+
+        if (index < 0) {
+            zcc_errno = ZCC_ERR_SECTOR_RANGE;
+            return false;
+        }
+        if (ZCC_D64_BITMAP_GET(visited, index)) {
+            zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+            return false;
+        }
+        ZCC_D64_BITMAP_SET(visited, index);
+
+        side = rel_block(d64, index);
+        if (side[ZCC_D64_REL_SIDE_NUMBER]
+                    != rel->side_sectors % ZCC_D64_REL_GROUP_SIZE
+                || side[ZCC_D64_REL_SIDE_RECORD_SIZE] != rel->record_size) {
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+            return false;
+        }
+        rel->side_sectors++;
+        if (!rel_add_blocks(rel, side)) {
+            return false;
+        }
+        if (side[ZCC_D64_BLOCK_TRACK] == 0) {
+            break;
+        }
+        index = zcc_d64_link_index(d64,
+                                   side[ZCC_D64_BLOCK_TRACK],
+                                   side[ZCC_D64_BLOCK_SECTOR]);
+    }
+
+    if (rel->block_count > 0) {
+        last = rel_block(d64, rel->blocks[rel->block_count - 1]);
+        rel->size = (long)(rel->block_count - 1) * ZCC_D64_BLOCK_SIZE_DATA;
+        if (last[ZCC_D64_BLOCK_TRACK] != 0) {
+            rel->size += ZCC_D64_BLOCK_SIZE_DATA;
+        } else if (last[ZCC_D64_BLOCK_SECTOR] >= ZCC_D64_BLOCK_DATA) {
+            rel->size += last[ZCC_D64_BLOCK_SECTOR] - 1;
+        }
+    }
+    rel->record_count = rel->size / rel->record_size;
+    return true;
+}
+
+
+/** \brief  Read \a record of \a rel into \a dest
+ *
+ * The position of the record gives its block in the list built by
+ * zcc_d64_rel_open(), a record spans at most two blocks.
+ *
+ * \param[in]   rel     REL handle
+ * \param[in]   record  record number, starting at 0
+ * \param[out]  dest    destination, \c rel->record_size bytes
+ *
+ * \return  number of bytes read (\c rel->record_size) or -1 on error
+ * \throw   ZCC_ERR_SEEK_RANGE  no such record
+ */
+long zcc_d64_rel_read_record(const zcc_d64_rel_t *rel,
+                             long record,
+                             uint8_t *dest)
+{
+    long offset = record * rel->record_size;
+    int block = (int)(offset / ZCC_D64_BLOCK_SIZE_DATA);
+    int pos = (int)(offset % ZCC_D64_BLOCK_SIZE_DATA);
+    int len = rel->record_size;
+
+    if (record < 0 || record >= rel->record_count) {
+        zcc_errno = ZCC_ERR_SEEK_RANGE;
+        return -1;
+    }
+    if (pos + len > ZCC_D64_BLOCK_SIZE_DATA) {
+        len = ZCC_D64_BLOCK_SIZE_DATA - pos;
+    }
+    memcpy(dest, rel_block(rel->d64, rel->blocks[block]) + ZCC_D64_BLOCK_DATA + pos,
+           (size_t)len);
+    if (len < rel->record_size) {
+        memcpy(dest + len,
+               rel_block(rel->d64, rel->blocks[block + 1]) + ZCC_D64_BLOCK_DATA,
+               (size_t)(rel->record_size - len));
+    }
+    return rel->record_size;
+}
@@ -0,0 +1,86 @@
+/** \file   d64rel.h
+ * \brief   REL file access in D64 images - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_D64REL_H
+#define ZCC_D64REL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+
+
+/** \brief  Offset in a side sector of its number in the group
+ */
+#define ZCC_D64_REL_SIDE_NUMBER     0x02
+
+/** \brief  Offset in a side sector of the record size
+ */
+#define ZCC_D64_REL_SIDE_RECORD_SIZE    0x03
+
+/** \brief  Offset in a side sector of the links to the data blocks
+ */
+#define ZCC_D64_REL_SIDE_DATA       0x10
+
+/** \brief  Number of data blocks covered by a side sector
+ */
+#define ZCC_D64_REL_SIDE_BLOCKS     120
+
+/** \brief  Number of side sectors in a group
+ */
+#define ZCC_D64_REL_GROUP_SIZE      6
+
+/** \brief  Value of byte 2 of a 1581 super side sector
+ */
+#define ZCC_D64_REL_SUPER_MARKER    0xfe
+
+
+/** \brief  Handle of a REL file in a D64 image
+ *
+ * The side sectors are read once into a flat list of data blocks, so the
+ * block holding any byte of the file is found with a division.
+ */
+typedef struct zcc_d64_rel_s {
+    const zcc_d64_t *   d64;            /**< D64 image */
+
+    /** \brief  Block indexes of the data blocks, in file order
+     */
+    int16_t             blocks[ZCC_D64_GEOMETRY_BLOCKS_MAX];
+    int                 block_count;    /**< number of entries in \c blocks */
+    int                 side_sectors;   /**< number of side sectors */
+    int                 record_size;    /**< record size in bytes */
+    long                size;           /**< size of the data in bytes */
+    long                record_count;   /**< number of records */
+} zcc_d64_rel_t;
+
+
+bool zcc_d64_rel_open(zcc_d64_rel_t *rel,
+                      const zcc_d64_t *d64,
+                      const uint8_t *entry);
+long zcc_d64_rel_read_record(const zcc_d64_rel_t *rel,
+                             long record,
+                             uint8_t *dest);
+
+#endif
@@ -0,0 +1,373 @@
+/** \file   d64write.c
+ * \brief   Create files in D64 images
+ *
+ * Writes host data as new files into a D64 image: blocks are allocated in a
+ * zcc_bam_t using the 1541's interleave, the chain is written directly into
+ * the image data and a directory entry is added, extending the directory on
+ * track 18 when needed. zcc_d64_write_files() writes any number of files with
+ * a single load and store of the on-disk BAM.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "cbmdos.h"
+#include "petasc.h"
+#include "d64.h"
+#include "bam.h"
+
+#include "d64write.h"
+
+
+/** \brief  PETSCII padding character for names in the BAM and directory
+ */
+#define PET_PAD 0xa0
+
+
+/** \brief  Copy ASCII string \a asc to \a pet as PETSCII, padded with 0xa0
+ *
+ * \param[out]  pet PETSCII target
+ * \param[in]   asc ASCII string
+ * \param[in]   n   size of \a pet
+ */
+static void pet_copy_padded(uint8_t *pet, const char *asc, size_t n)
+{
+    size_t len = strlen(asc);
+
+    zcc_asc_to_pet_str(pet, asc, n);
+    if (len < n) {
+        memset(pet + len, PET_PAD, n - len);
+    }
+}
+
+
+/** \brief  Copy \a length bytes at \a offset of \a file to \a dest
+ *
+ * The contents of \a file are its head followed by its data.
+ *
+ * \param[out] dest    destination
+ * \param[in]  file    file to write
+ * \param[in]  offset  offset in the contents of \a file
+ * \param[in]  length  number of bytes to copy
+ */
+static void newfile_copy(uint8_t *dest,
+                         const zcc_d64_newfile_t *file,
+                         size_t offset,
+                         size_t length)
+{
+    if (offset < file->head_size) {
+        size_t n = file->head_size - offset;
+
+        if (n > length) {
+            n = length;
+        }
+        memcpy(dest, file->head + offset, n);
+        dest += n;
+        offset += n;
+        length -= n;
+    }
+    if (length > 0) {
+        memcpy(dest, file->data + offset - file->head_size, length);
+    }
+}
+
+
+/** \brief  Get pointer to raw block (\a track, \a sector) of \a d64
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  pointer into the image data
+ */
+static uint8_t *block_ptr(zcc_d64_t *d64, int track, int sector)
+{
+    return d64->data + zcc_d64_block_offset(track, sector);
+}
+
+
+/** \brief  Find a free directory entry in \a d64
+ *
+ * Returns the first unused entry in the directory chain. When all blocks are
+ * full a new directory block is allocated on track 18 in \a bam and linked
+ * to the end of the chain.
+ *
+ * \param[in,out]   d64 D64 image
+ * \param[in,out]   bam BAM
+ *
+ * \return  raw directory entry or NULL on failure
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_DIR_FULL
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+static uint8_t *dir_find_free(zcc_d64_t *d64, zcc_bam_t *bam)
+{
+    uint64_t visited[ZCC_D64_BITMAP_WORDS];
+    int track = ZCC_D64_DIR_TRACK;
+    int sector = ZCC_D64_DIR_SECTOR;
+    uint8_t *block;
+
+    memset(visited, 0, sizeof visited);
+    while (true) {
+        int index = zcc_d64_link_index(d64, track, sector);
+
+        if (index < 0) {
+            return NULL;
+        }
+        if (ZCC_D64_BITMAP_GET(visited, index)) {
+            zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+            return NULL;
+        }
+        ZCC_D64_BITMAP_SET(visited, index);
+
+        block = d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+        for (int offset = 0;
+                offset < ZCC_D64_BLOCK_SIZE_RAW;
+                offset += ZCC_D64_DIRENT_SIZE) {
+            if (block[offset + ZCC_D64_DIRENT_FILETYPE] == 0) {
+                return block + offset;
+            }
+        }
+        if (block[ZCC_D64_BLOCK_TRACK] == 0) {
+            break;
+        }
+        track = block[ZCC_D64_BLOCK_TRACK];
+        sector = block[ZCC_D64_BLOCK_SECTOR];
+    }
+
+    /* all directory blocks are in use, add a new one to the chain */
+    if (!zcc_bam_alloc_next(bam, &track, &sector, ZCC_BAM_INTERLEAVE_DIR)) {
+        zcc_errno = ZCC_ERR_DIR_FULL;
+        return NULL;
+    }
+    block[ZCC_D64_BLOCK_TRACK] = (uint8_t)track;
+    block[ZCC_D64_BLOCK_SECTOR] = (uint8_t)sector;
+
+    block = block_ptr(d64, track, sector);
+    memset(block, 0, ZCC_D64_BLOCK_SIZE_RAW);
+    block[ZCC_D64_BLOCK_SECTOR] = 0xff;
+    return block;
+}
+
+
+/** \brief  Write \a file to \a d64, allocating blocks in \a bam
+ *
+ * The on-disk BAM isn't touched. On failure all blocks allocated for the
+ * file are released in \a bam again.
+ *
+ * \param[in,out]   d64     D64 image
+ * \param[in,out]   bam     BAM
+ * \param[in]       file    file to write
+ *
+ * \return  true on success
+ * \throw   ZCC_ERR_FILETYPE
+ * \throw   ZCC_ERR_DISK_FULL
+ * \throw   ZCC_ERR_DIR_FULL
+ */
+static bool write_file(zcc_d64_t *d64, zcc_bam_t *bam,
+                       const zcc_d64_newfile_t *file)
+{
+    uint8_t tracks[ZCC_D64_BLOCKS_MAX];
+    uint8_t sectors[ZCC_D64_BLOCKS_MAX];
+    uint8_t *entry;
+    size_t size = file->head_size + file->size;
+    size_t blocks;
+    int track = 0;
+    int sector = 0;
+
+    if (file->type > ZCC_CBMDOS_FILETYPE_USR) {
+        /* REL files require side sectors, which aren't supported */
+        zcc_errno = ZCC_ERR_FILETYPE;
+        return false;
+    }
+
+    /* a file always occupies at least one block */
+    blocks = size == 0
+        ? 1 : (size + ZCC_D64_BLOCK_SIZE_DATA - 1) / ZCC_D64_BLOCK_SIZE_DATA;
+    if (blocks > (size_t)zcc_bam_blocks_free(bam)) {
+        zcc_errno = ZCC_ERR_DISK_FULL;
+        return false;
+    }
+
+    for (size_t i = 0; i < blocks; i++) {
+        bool ok = i == 0
+            ? zcc_bam_alloc_first(bam, &track, &sector)
+            : zcc_bam_alloc_next(bam, &track, &sector, ZCC_BAM_INTERLEAVE_FILE);
+
+        if (!ok) {
+            while (i-- > 0) {
+                zcc_bam_mark_free(bam, tracks[i], sectors[i]);
+            }
+            return false;
+        }
+        tracks[i] = (uint8_t)track;
+        sectors[i] = (uint8_t)sector;
+    }
+
+    entry = dir_find_free(d64, bam);
+    if (entry == NULL) {
+        for (size_t i = 0; i < blocks; i++) {
+            zcc_bam_mark_free(bam, tracks[i], sectors[i]);
+        }
+        return false;
+    }
+
+    /* write the chain */
+    for (size_t i = 0; i < blocks; i++) {
+        uint8_t *block = block_ptr(d64, tracks[i], sectors[i]);
+        size_t offset = i * ZCC_D64_BLOCK_SIZE_DATA;
+        size_t length = size - offset;
+
+        if (i < blocks - 1) {
+            block[ZCC_D64_BLOCK_TRACK] = tracks[i + 1];
+            block[ZCC_D64_BLOCK_SECTOR] = sectors[i + 1];
+            length = ZCC_D64_BLOCK_SIZE_DATA;
+        } else {
+            /* last block: sector byte is the index of the last data byte */
+            if (size == 0) {
+                length = 0;
+            }
+            block[ZCC_D64_BLOCK_TRACK] = 0;
+            block[ZCC_D64_BLOCK_SECTOR] = (uint8_t)(length + 1);
+            memset(block + ZCC_D64_BLOCK_DATA + length, 0,
+                   ZCC_D64_BLOCK_SIZE_DATA - length);
+        }
+        if (length > 0) {
+            newfile_copy(block + ZCC_D64_BLOCK_DATA, file, offset, length);
+        }
+    }
+
+    /* fill in the directory entry, leaving the link of the dir block alone */
+    memset(entry + ZCC_D64_DIRENT_FILETYPE, 0,
+           ZCC_D64_DIRENT_SIZE - ZCC_D64_DIRENT_FILETYPE);
+    entry[ZCC_D64_DIRENT_FILETYPE] = (uint8_t)(file->type | ZCC_CBMDOS_CLOSED_MASK);
+    entry[ZCC_D64_DIRENT_TRACK] = tracks[0];
+    entry[ZCC_D64_DIRENT_SECTOR] = sectors[0];
+    pet_copy_padded(entry + ZCC_D64_DIRENT_FILENAME, file->name,
+                    ZCC_CBMDOS_FILENAME_MAX);
+    entry[ZCC_D64_DIRENT_BLOCKS_LSB] = (uint8_t)(blocks & 0xff);
+    entry[ZCC_D64_DIRENT_BLOCKS_MSB] = (uint8_t)(blocks >> 8);
+    return true;
+}
+
+
+/** \brief  Format \a d64 as an empty disk
+ *
+ * \a d64 must have been allocated with zcc_d64_alloc(), its size and DOS type
+ * determine the BAM layout. All image data is cleared.
+ *
+ * \param[in,out]   d64     D64 image
+ * \param[in]       name    disk name (ASCII, at most 16 characters used)
+ * \param[in]       id      disk ID (ASCII, at most 2 characters used)
+ */
+void zcc_d64_format(zcc_d64_t *d64, const char *name, const char *id)
+{
+    uint8_t *bam_block = d64->data + ZCC_D64_BAM_OFFSET;
+    uint8_t *dir_block = block_ptr(d64, ZCC_D64_DIR_TRACK, ZCC_D64_DIR_SECTOR);
+    uint8_t *header = bam_block + zcc_d64_diskname_offset(d64->type);
+    zcc_bam_t bam;
+    int track_max = ZCC_D64_TRACK_MAX;
+
+    memset(d64->data, 0, d64->size);
+
+    bam_block[ZCC_D64_BLOCK_TRACK] = ZCC_D64_DIR_TRACK;
+    bam_block[ZCC_D64_BLOCK_SECTOR] = ZCC_D64_DIR_SECTOR;
+    bam_block[0x02] = 0x41;     /* 'A': DOS version */
+
+    /* disk name, ID and DOS type: the ID follows the name and two 0xa0's */
+    memset(header, PET_PAD, 0x1b);
+    pet_copy_padded(header, name, ZCC_D64_DISKNAME_MAXLEN);
+    pet_copy_padded(header + 0x12, id, 2);
+    header[0x15] = 0x32;        /* '2' */
+    header[0x16] = d64->type == ZCC_D64_TYPE_PROLOGICDOS ? 0x50 : 0x41;
+
+    dir_block[ZCC_D64_BLOCK_SECTOR] = 0xff;
+
+    if (d64->size == ZCC_D64_SIZE_EXTENDED
+            && zcc_d64_bament_offset(d64->type, ZCC_D64_TRACK_MAX_EXT) >= 0) {
+        track_max = ZCC_D64_TRACK_MAX_EXT;
+    }
+    zcc_bam_init(&bam, d64->type, track_max);
+    zcc_bam_mark_used(&bam, ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR);
+    zcc_bam_mark_used(&bam, ZCC_D64_DIR_TRACK, ZCC_D64_DIR_SECTOR);
+    zcc_bam_store(&bam, d64);
+}
+
+
+/** \brief  Write \a file to \a d64
+ *
+ * \param[in,out]   d64     D64 image
+ * \param[in]       file    file to write
+ *
+ * \return  true on success
+ * \see     zcc_d64_write_files()
+ */
+bool zcc_d64_write_file(zcc_d64_t *d64, const zcc_d64_newfile_t *file)
+{
+    return zcc_d64_write_files(d64, file, 1) == 1;
+}
+
+
+/** \brief  Write \a count \a files to \a d64
+ *
+ * The BAM is loaded once, all blocks are allocated in memory and the BAM is
+ * stored once after the last file. Writing stops at the first file that
+ * can't be written, the files before it are kept. Only 1541 images can be
+ * written to, D71 and D81 images are rejected.
+ *
+ * \param[in,out]   d64     D64 image
+ * \param[in]       files   files to write
+ * \param[in]       count   number of \a files
+ *
+ * \return  number of files written, less than \a count on error
+ * \throw   ZCC_ERR_FILETYPE
+ * \throw   ZCC_ERR_DISK_FULL
+ * \throw   ZCC_ERR_DIR_FULL
+ * \throw   ZCC_ERR_UNSUPPORTED
+ */
+int zcc_d64_write_files(zcc_d64_t *d64,
+                        const zcc_d64_newfile_t *files,
+                        int count)
+{
+    zcc_bam_t bam;
+    int written = 0;
+
+    if (d64->geometry->format != ZCC_D64_FORMAT_D64) {
+        zcc_errno = ZCC_ERR_UNSUPPORTED;
+        return 0;
+    }
+
+    zcc_bam_load(&bam, d64);
+    while (written < count && write_file(d64, &bam, &files[written])) {
+        written++;
+    }
+    zcc_bam_store(&bam, d64);
+    return written;
+}
@@ -0,0 +1,57 @@
+/** \file   d64write.h
+ * \brief   Create files in D64 images - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_D64WRITE_H
+#define ZCC_D64WRITE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbmdos.h"
+#include "d64.h"
+
+
+/** \brief  File to write to a D64 image
+ */
+typedef struct zcc_d64_newfile_s {
+    const char *            name;   /**< ASCII filename, at most 16
+                                         characters are used */
+    zcc_cbmdos_filetype_t   type;   /**< file type (DEL, SEQ, PRG or USR) */
+    const uint8_t *         head;   /**< bytes written in front of \c data,
+                                         for example a load address kept
+                                         apart from the data (optional) */
+    size_t                  head_size;  /**< size of \c head in bytes */
+    const uint8_t *         data;   /**< file contents */
+    size_t                  size;   /**< size of \c data in bytes */
+} zcc_d64_newfile_t;
+
+
+void zcc_d64_format(zcc_d64_t *d64, const char *name, const char *id);
+bool zcc_d64_write_file(zcc_d64_t *d64, const zcc_d64_newfile_t *file);
+int  zcc_d64_write_files(zcc_d64_t *d64,
+                         const zcc_d64_newfile_t *files,
+                         int count);
+
+#endif
@@ -46,7 +46,16 @@ static const char *err_msgs[] = {
     "invalid filename",
     "RLE error",
     "invalid zipcode data",
-    "invalid zipcode pack method"
+    "invalid zipcode pack method",
+    "block chain contains a cycle",
+    "disk full",
+    "file not found",
+    "seek position out of range",
+    "directory full",
+    "unsupported file type",
+    "invalid image data",
+    "unsupported format feature",
+    "file exists"
 };
 
 
@@ -58,7 +67,7 @@ static const char *err_msgs[] = {
  */
 const char *zcc_strerror(int code)
 {
-    if (code >= 0 || code < (int)(sizeof err_msgs / sizeof err_msgs[0])) {
+    if (code >= 0 && code < (int)(sizeof err_msgs / sizeof err_msgs[0])) {
         return err_msgs[code];
     } else {
         return "unknown error";
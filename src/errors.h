@@ -37,7 +37,16 @@ enum zcc_errno_e {
     ZCC_ERR_RLE,                /**< RLE error (probably need to split this
                                      into multiple errors) */
     ZCC_ERR_ZC_INVALID_DATA,        /**< invalid zipcode data */
-    ZCC_ERR_ZC_INVALID_PACK_METHOD  /**< invalid zipcode pack method (%11) */
+    ZCC_ERR_ZC_INVALID_PACK_METHOD, /**< invalid zipcode pack method (%11) */
+    ZCC_ERR_CHAIN_CYCLE,            /**< block chain links back into itself */
+    ZCC_ERR_DISK_FULL,              /**< no free blocks left */
+    ZCC_ERR_FILE_NOT_FOUND,         /**< file not found in image */
+    ZCC_ERR_SEEK_RANGE,             /**< seek position outside of file */
+    ZCC_ERR_DIR_FULL,               /**< no free directory entries left */
+    ZCC_ERR_FILETYPE,               /**< unsupported file type */
+    ZCC_ERR_INVALID_IMAGE,          /**< invalid image or container data */
+    ZCC_ERR_UNSUPPORTED,            /**< unsupported format feature */
+    ZCC_ERR_FILE_EXISTS             /**< file exists and won't be replaced */
 };
 
 extern int zcc_errno;
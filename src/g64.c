@@ -0,0 +1,866 @@
+/** \file   g64.c
+ * \brief   G64 handling
+ *
+ * G64 images contain the raw GCR stream of each track. Images created here
+ * have a fixed layout: all 84 half track entries, with data for the full
+ * tracks only, each track taking up #ZCC_G64_TRACK_SIZE_MAX bytes.
+ *
+ * Decoding to D64 treats each track as a circular bit stream: sync marks are
+ * located a 64-bit word at a time, the GCR following them is realigned to
+ * whole bytes and decoded with zcc_gcr_decode(). Tracks are independent, so
+ * they're decoded by a pool of worker threads. Encoding a D64 uses the same
+ * pool, writing standard tracks at the density of each speedzone.
+ *
+ * See doc/reference/formats/g64.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "io.h"
+#include "d64.h"
+
+#include "g64.h"
+
+
+/** \brief  Track size in bytes for each D64 speedzone
+ *
+ * These are the sizes MNIB uses for tracks written at 300 RPM.
+ */
+static const size_t track_sizes[] = { 7692, 7142, 6666, 6250 };
+
+
+/** \brief  Size of an entry in the track data area
+ *
+ * 16-bit track length followed by the track data
+ */
+#define TRACK_ENTRY_SIZE    (2 + ZCC_G64_TRACK_SIZE_MAX)
+
+
+/** \brief  Number of zero bytes after the copies of a track in the decoding
+ *          buffer, so 64-bit loads never run past the end
+ */
+#define TRACK_PADDING       8
+
+/** \brief  Number of blocks in a 35-track image
+ */
+#define BLOCKS_CBMDOS       ((int)(ZCC_D64_SIZE_CBMDOS / ZCC_D64_BLOCK_SIZE_RAW))
+
+/** \brief  Number of sync start positions checked per 64-bit window
+ *
+ * A run of #ZCC_G64_SYNC_BITS starting at any of these positions fits in
+ * the window.
+ */
+#define SYNC_WINDOW         48
+
+
+#if defined(__GNUC__)
+
+/** \brief  Number of leading zero bits in \a W (\a W must not be 0)
+ */
+# define g64_clz(W)         __builtin_clzll(W)
+
+#else
+
+/** \brief  Get number of leading zero bits in \a w
+ *
+ * \param[in]   w   word, must not be 0
+ *
+ * \return  number of zero bits above the highest bit set
+ */
+static int g64_clz(uint64_t w)
+{
+    int c = 0;
+
+    while (!(w & ((uint64_t)1 << 63))) {
+        w <<= 1;
+        c++;
+    }
+    return c;
+}
+
+#endif
+
+
+/** \brief  Queue of tracks worked on by a pool of threads
+ */
+typedef struct track_queue_s {
+    void        (*func)(void *state, int track);    /**< work for a track */
+    void *      state;      /**< state passed to \c func */
+    int         track_max;  /**< last track */
+    int         next;       /**< next track to work on */
+    pthread_mutex_t lock;   /**< lock for \c next */
+} track_queue_t;
+
+
+/** \brief  Track decoding state shared by the worker threads
+ */
+typedef struct decode_state_s {
+    const zcc_g64_t *   g64;        /**< G64 image */
+    zcc_d64_t *         d64;        /**< D64 image, blocks are written
+                                         directly into its data */
+    uint8_t             header_errors[ZCC_D64_BLOCKS_MAX];  /**< error code
+                                                                 of each
+                                                                 header */
+    uint8_t             data_errors[ZCC_D64_BLOCKS_MAX];    /**< error code
+                                                                 of each data
+                                                                 block */
+    uint8_t             ids[ZCC_D64_BLOCKS_MAX][2]; /**< disk ID in each
+                                                         header (ID2, ID1) */
+} decode_state_t;
+
+
+/** \brief  Track encoding state shared by the worker threads
+ */
+typedef struct encode_state_s {
+    zcc_g64_t *         g64;    /**< G64 image */
+    const zcc_d64_t *   d64;    /**< D64 image */
+    uint8_t             id[2];  /**< disk ID as stored in headers (ID2, ID1) */
+} encode_state_t;
+
+
+/** \brief  Store 16-bit little endian \a value at \a p
+ *
+ * \param[out]  p       destination
+ * \param[in]   value   value
+ */
+static void put_le16(uint8_t *p, size_t value)
+{
+    p[0] = (uint8_t)(value & 0xff);
+    p[1] = (uint8_t)((value >> 8) & 0xff);
+}
+
+
+/** \brief  Store 32-bit little endian \a value at \a p
+ *
+ * \param[out]  p       destination
+ * \param[in]   value   value
+ */
+static void put_le32(uint8_t *p, size_t value)
+{
+    put_le16(p, value & 0xffff);
+    put_le16(p + 2, (value >> 16) & 0xffff);
+}
+
+
+/** \brief  Get 16-bit little endian value at \a p
+ *
+ * \param[in]   p   source
+ *
+ * \return  value
+ */
+static size_t get_le16(const uint8_t *p)
+{
+    return (size_t)p[0] | ((size_t)p[1] << 8);
+}
+
+
+/** \brief  Get 32-bit little endian value at \a p
+ *
+ * \param[in]   p   source
+ *
+ * \return  value
+ */
+static size_t get_le32(const uint8_t *p)
+{
+    return get_le16(p) | (get_le16(p + 2) << 16);
+}
+
+
+/** \brief  Initialize G64 handle \a g64
+ *
+ * \param[out]  g64 G64 handle
+ */
+void zcc_g64_init(zcc_g64_t *g64)
+{
+    g64->data = NULL;
+    g64->size = 0;
+    g64->track_max = 0;
+    memset(g64->errors, ZCC_D64_ERROR_NONE, sizeof g64->errors);
+    g64->bad_sectors = 0;
+}
+
+
+/** \brief  Free memory used by the members of \a g64
+ *
+ * \param[in,out]   g64 G64 handle
+ */
+void zcc_g64_free(zcc_g64_t *g64)
+{
+    if (g64->data != NULL) {
+        zcc_free(g64->data);
+    }
+    zcc_g64_init(g64);
+}
+
+
+/** \brief  Get 1541 speedzone of \a track
+ *
+ * \param[in]   track   track number
+ *
+ * \return  speedzone (3 for tracks 1-17 down to 0 for tracks 31 and up), or
+ *          -1 on error
+ * \throw   ZCC_ERR_TRACK_RANGE
+ */
+int zcc_g64_speedzone(int track)
+{
+    int zone = zcc_d64_track_speedzone(track);
+
+    return zone < 0 ? -1 : 3 - zone;
+}
+
+
+/** \brief  Get size of the GCR data of a standard \a track
+ *
+ * \param[in]   track   track number
+ *
+ * \return  track size in bytes, or 0 on error
+ * \throw   ZCC_ERR_TRACK_RANGE
+ */
+size_t zcc_g64_track_capacity(int track)
+{
+    int zone = zcc_d64_track_speedzone(track);
+
+    return zone < 0 ? 0 : track_sizes[zone];
+}
+
+
+/** \brief  Allocate G64 image with \a track_max standard tracks
+ *
+ * Each track is set to its standard size and filled with gap bytes, so it
+ * contains no sync marks until sectors are put in.
+ *
+ * \param[out]  g64         G64 handle
+ * \param[in]   track_max   number of tracks (35 or 40)
+ */
+void zcc_g64_alloc(zcc_g64_t *g64, int track_max)
+{
+    size_t size = ZCC_G64_TRACK_DATA + (size_t)track_max * TRACK_ENTRY_SIZE;
+    uint8_t *data = zcc_calloc(size, 1LU);
+
+    memcpy(data, ZCC_G64_SIGNATURE, ZCC_G64_SIGNATURE_LEN);
+    data[ZCC_G64_VERSION] = 0;
+    data[ZCC_G64_TRACK_COUNT] = ZCC_G64_HALFTRACKS;
+    put_le16(data + ZCC_G64_TRACK_SIZE, ZCC_G64_TRACK_SIZE_MAX);
+
+    for (int track = 1; track <= track_max; track++) {
+        size_t offset = ZCC_G64_TRACK_DATA
+            + (size_t)(track - 1) * TRACK_ENTRY_SIZE;
+        size_t capacity = zcc_g64_track_capacity(track);
+        int entry = (track - 1) * 2 * 4;
+
+        put_le32(data + ZCC_G64_TRACK_OFFSETS + entry, offset);
+        put_le32(data + ZCC_G64_SPEED_OFFSETS + entry,
+                 (size_t)zcc_g64_speedzone(track));
+        put_le16(data + offset, capacity);
+        memset(data + offset + 2, ZCC_G64_GAP_BYTE, capacity);
+        /* unused space after the track data */
+        memset(data + offset + 2 + capacity, 0xff,
+               ZCC_G64_TRACK_SIZE_MAX - capacity);
+    }
+
+    g64->data = data;
+    g64->size = size;
+    g64->track_max = track_max;
+}
+
+
+/** \brief  Read G64 image \a path
+ *
+ * Only the full tracks are used, half tracks are ignored.
+ *
+ * \param[out]  g64     G64 handle
+ * \param[in]   path    path to image file
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ */
+bool zcc_g64_read(zcc_g64_t *g64, const char *path)
+{
+    long size;
+    int halftracks;
+
+    zcc_g64_free(g64);
+    size = zcc_fread_alloc(&g64->data, path);
+    if (size < 0) {
+        return false;
+    }
+    g64->size = (size_t)size;
+
+    if (g64->size < ZCC_G64_TRACK_OFFSETS
+            || memcmp(g64->data, ZCC_G64_SIGNATURE, ZCC_G64_SIGNATURE_LEN) != 0
+            || g64->data[ZCC_G64_VERSION] != 0) {
+        zcc_g64_free(g64);
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+        return false;
+    }
+    halftracks = g64->data[ZCC_G64_TRACK_COUNT];
+    if (halftracks > ZCC_G64_HALFTRACKS
+            || g64->size < ZCC_G64_TRACK_OFFSETS + (size_t)halftracks * 4) {
+        zcc_g64_free(g64);
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+        return false;
+    }
+
+    for (int track = 1; (track - 1) * 2 < halftracks; track++) {
+        size_t offset = get_le32(g64->data + ZCC_G64_TRACK_OFFSETS
+                                 + (track - 1) * 2 * 4);
+
+        if (offset == 0) {
+            continue;
+        }
+        if (offset + 2 > g64->size
+                || offset + 2 + get_le16(g64->data + offset) > g64->size) {
+            zcc_g64_free(g64);
+            zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+            return false;
+        }
+        g64->track_max = track;
+    }
+    return true;
+}
+
+
+/** \brief  Write \a g64 to \a path
+ *
+ * \param[in]   g64     G64 handle
+ * \param[in]   path    path to image file
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_IO
+ */
+bool zcc_g64_write(const zcc_g64_t *g64, const char *path)
+{
+    return zcc_fwrite(path, g64->data, g64->size);
+}
+
+
+/** \brief  Get GCR data of \a track in \a g64
+ *
+ * \param[in]   g64     G64 handle
+ * \param[in]   track   track number
+ * \param[out]  size    size of the track data
+ *
+ * \return  pointer to the track data or `NULL` when \a track isn't present
+ * \throw   ZCC_ERR_TRACK_RANGE
+ */
+uint8_t *zcc_g64_track(const zcc_g64_t *g64, int track, size_t *size)
+{
+    size_t offset;
+
+    if (track < 1 || track > g64->track_max) {
+        zcc_errno = ZCC_ERR_TRACK_RANGE;
+        return NULL;
+    }
+    offset = get_le32(g64->data + ZCC_G64_TRACK_OFFSETS + (track - 1) * 2 * 4);
+    if (offset == 0 || offset + 2 > g64->size) {
+        zcc_errno = ZCC_ERR_TRACK_RANGE;
+        return NULL;
+    }
+    *size = get_le16(g64->data + offset);
+    return g64->data + offset + 2;
+}
+
+
+/** \brief  Write the framing of a standard sector to \a dest
+ *
+ * Writes the header sync, the GCR bytes of \a header, the header gap and
+ * the data sync. The GCR bytes of the data block go at the returned pointer.
+ *
+ * \param[out]  dest    position in the track data
+ * \param[in]   header  GCR-encoded sector header
+ *                      (#ZCC_GCR_HEADER_SIZE bytes)
+ *
+ * \return  pointer to the position of the data block
+ */
+uint8_t *zcc_g64_sector_frame(uint8_t *dest, const uint8_t *header)
+{
+    memset(dest, 0xff, ZCC_G64_SYNC_SIZE);
+    dest += ZCC_G64_SYNC_SIZE;
+    memcpy(dest, header, ZCC_GCR_HEADER_SIZE);
+    dest += ZCC_GCR_HEADER_SIZE;
+    memset(dest, ZCC_G64_GAP_BYTE, ZCC_G64_HEADER_GAP);
+    dest += ZCC_G64_HEADER_GAP;
+    memset(dest, 0xff, ZCC_G64_SYNC_SIZE);
+    return dest + ZCC_G64_SYNC_SIZE;
+}
+
+
+/** \brief  Load 64 bits at \a p, first byte in the most significant bits
+ *
+ * \param[in]   p   source
+ *
+ * \return  word
+ */
+static uint64_t load_be64(const uint8_t *p)
+{
+    uint64_t w = 0;
+
+    for (int i = 0; i < 8; i++) {
+        w = (w << 8) | p[i];
+    }
+    return w;
+}
+
+
+/** \brief  Find the end of the next sync mark in bit stream \a buf
+ *
+ * Checks #SYNC_WINDOW start positions per 64-bit load: ANDing the word with
+ * itself shifted by 1 to #ZCC_G64_SYNC_BITS - 1 leaves a bit set for each
+ * position a long enough run of 1-bits starts at.
+ *
+ * \param[in]   buf     bit stream, followed by #TRACK_PADDING bytes
+ * \param[in]   from    bit position to start looking at
+ * \param[in]   limit   maximum bit position to return
+ *
+ * \return  bit position of the first 0-bit after the sync, or -1 when there is
+ *          no sync before \a limit
+ */
+static long find_sync(const uint8_t *buf, long from, long limit)
+{
+    long byte = from >> 3;
+    int skip = (int)(from & 7);
+
+    while (byte * 8 < limit) {
+        uint64_t w = load_be64(buf + byte);
+        uint64_t run = w;
+        long pos;
+
+        for (int k = 1; k < ZCC_G64_SYNC_BITS; k++) {
+            run &= w << k;
+        }
+        run &= (~(uint64_t)0 >> skip) & (~(uint64_t)0 << (64 - SYNC_WINDOW));
+        if (run == 0) {
+            byte += SYNC_WINDOW / 8;
+            skip = 0;
+            continue;
+        }
+
+        /* skip the rest of the 1-bits */
+        pos = byte * 8 + g64_clz(run) + ZCC_G64_SYNC_BITS;
+        while (pos < limit) {
+            uint64_t ones = ~(load_be64(buf + (pos >> 3)) << (pos & 7));
+            int count = ones == 0 ? 56 : g64_clz(ones);
+
+            if (count > 56) {
+                count = 56;
+            }
+            pos += count;
+            if (count < 56) {
+                break;
+            }
+        }
+        return pos <= limit ? pos : -1;
+    }
+    return -1;
+}
+
+
+/** \brief  Copy \a count bytes starting at bit position \a pos of \a buf
+ *
+ * \param[out]  dest    byte-aligned copy
+ * \param[in]   buf     bit stream
+ * \param[in]   pos     bit position
+ * \param[in]   count   number of bytes
+ */
+static void read_bytes(uint8_t *dest, const uint8_t *buf, long pos, size_t count)
+{
+    const uint8_t *src = buf + (pos >> 3);
+    int shift = (int)(pos & 7);
+
+    if (shift == 0) {
+        memcpy(dest, src, count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = (uint8_t)((src[i] << shift) | (src[i + 1] >> (8 - shift)));
+    }
+}
+
+
+/** \brief  Decode \a track into the D64 of \a state
+ *
+ * Mimics the drive: after each sync with a valid header for a sector of the
+ * track, the next sync is expected to be followed by the data block.
+ *
+ * \param[in,out]   state   decoding state (decode_state_t)
+ * \param[in]       track   track number
+ */
+static void track_decode(void *state, int track)
+{
+    decode_state_t *decode = state;
+    uint8_t *header_errors;
+    uint8_t *data_errors;
+    int index = zcc_d64_block_index(track, 0);
+    int sectors = zcc_d64_track_max_sector(track);
+    uint32_t seen = 0;
+    const uint8_t *gcr;
+    uint8_t *buf;
+    size_t size = 0;
+    long bits;
+    long limit;
+    long pos;
+
+    header_errors = decode->header_errors + index;
+    data_errors = decode->data_errors + index;
+    for (int sector = 0; sector < sectors; sector++) {
+        header_errors[sector] = ZCC_D64_ERROR_SYNC;
+        data_errors[sector] = ZCC_D64_ERROR_OK;
+    }
+
+    gcr = track <= decode->g64->track_max
+        ? zcc_g64_track(decode->g64, track, &size) : NULL;
+    if (gcr == NULL || size < ZCC_GCR_DATA_SIZE) {
+        return;
+    }
+
+    /* two copies of the track, so reads can run past its end */
+    buf = zcc_malloc(size * 2 + TRACK_PADDING);
+    memcpy(buf, gcr, size);
+    memcpy(buf + size, gcr, size);
+    memset(buf + size * 2, 0, TRACK_PADDING);
+    bits = (long)size * 8;
+    limit = (long)(size * 2 - ZCC_GCR_DATA_SIZE) * 8;
+
+    pos = find_sync(buf, 0, bits);
+    if (pos >= 0) {
+        for (int sector = 0; sector < sectors; sector++) {
+            header_errors[sector] = ZCC_D64_ERROR_HEADER;
+        }
+    }
+
+    while (pos >= 0 && pos < bits) {
+        uint8_t raw[ZCC_GCR_DATA_SIZE];
+        uint8_t block[ZCC_GCR_DATA_SIZE];
+        uint8_t checksum = 0;
+        long next;
+        int sector;
+
+        read_bytes(raw, buf, pos, ZCC_GCR_HEADER_SIZE);
+        zcc_gcr_decode(block, raw, ZCC_GCR_HEADER_SIZE / ZCC_GCR_GROUP_SIZE);
+        next = find_sync(buf, pos + ZCC_GCR_HEADER_SIZE * 8, limit);
+        sector = block[2];
+        if (block[0] != ZCC_GCR_HEADER_ID || block[3] != track
+                || sector >= sectors || (seen & (1U << sector)) != 0) {
+            pos = next;
+            continue;
+        }
+        seen |= 1U << sector;
+        if (block[1] != (block[2] ^ block[3] ^ block[4] ^ block[5])) {
+            header_errors[sector] = ZCC_D64_ERROR_HEADER_CHECKSUM;
+        } else {
+            header_errors[sector] = ZCC_D64_ERROR_OK;
+        }
+        decode->ids[index + sector][0] = block[4];
+        decode->ids[index + sector][1] = block[5];
+
+        /* data block */
+        if (next < 0) {
+            data_errors[sector] = ZCC_D64_ERROR_DATA;
+            break;
+        }
+        read_bytes(raw, buf, next, ZCC_GCR_DATA_SIZE - 1);
+        zcc_gcr_decode(block, raw, (ZCC_GCR_DATA_SIZE - 1) / ZCC_GCR_GROUP_SIZE);
+        if (block[0] != ZCC_GCR_DATA_ID) {
+            /* probably the next header */
+            data_errors[sector] = ZCC_D64_ERROR_DATA;
+            pos = next;
+            continue;
+        }
+        for (int i = 1; i <= ZCC_D64_BLOCK_SIZE_RAW; i++) {
+            checksum ^= block[i];
+        }
+        if (checksum != block[ZCC_D64_BLOCK_SIZE_RAW + 1]) {
+            data_errors[sector] = ZCC_D64_ERROR_DATA_CHECKSUM;
+        }
+        memcpy(decode->d64->data + zcc_d64_block_offset(track, sector),
+               block + 1, ZCC_D64_BLOCK_SIZE_RAW);
+        pos = find_sync(buf, next + (ZCC_GCR_DATA_SIZE - 1) * 8, limit);
+    }
+    zcc_free(buf);
+}
+
+
+/** \brief  Worker thread: work on tracks until none are left
+ *
+ * \param[in,out]   arg track queue
+ *
+ * \return  `NULL`
+ */
+static void *track_worker(void *arg)
+{
+    track_queue_t *queue = arg;
+
+    while (true) {
+        int track;
+
+        pthread_mutex_lock(&(queue->lock));
+        track = queue->next++;
+        pthread_mutex_unlock(&(queue->lock));
+
+        if (track > queue->track_max) {
+            break;
+        }
+        queue->func(queue->state, track);
+    }
+    return NULL;
+}
+
+
+/** \brief  Call \a func for tracks 1 to \a track_max using \a threads threads
+ *
+ * \param[in]       func        work for a track
+ * \param[in,out]   state       state passed to \a func
+ * \param[in]       track_max   last track
+ * \param[in]       threads     number of threads (0 = number of CPUs)
+ */
+static void tracks_run(void (*func)(void *, int),
+                       void *state,
+                       int track_max,
+                       int threads)
+{
+    track_queue_t queue;
+    pthread_t workers[ZCC_G64_THREADS_MAX];
+    int started = 0;
+
+    queue.func = func;
+    queue.state = state;
+    queue.track_max = track_max;
+    queue.next = ZCC_D64_TRACK_MIN;
+
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > ZCC_G64_THREADS_MAX) {
+        threads = ZCC_G64_THREADS_MAX;
+    }
+    pthread_mutex_init(&(queue.lock), NULL);
+    while (started < threads - 1) {
+        if (pthread_create(&workers[started], NULL, track_worker, &queue)
+                != 0) {
+            break;
+        }
+        started++;
+    }
+    /* the calling thread works the queue as well */
+    track_worker(&queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&(queue.lock));
+}
+
+
+/** \brief  Decode the standard sectors of \a g64 into \a d64
+ *
+ * Allocates a 35-track CBM DOS image, or a SpeedDOS image when any headers
+ * were found on tracks 36-40. The error code of each block is stored in \a g64,
+ * header errors take precedence over data block errors like in the drive.
+ * The disk ID of each header is compared with the ID of the 18/0 header.
+ *
+ * \param[in,out]   g64     G64 image
+ * \param[out]      d64     D64 image
+ * \param[in]       threads number of worker threads (0 = number of CPUs)
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_NULL
+ */
+bool zcc_g64_decode(zcc_g64_t *g64, zcc_d64_t *d64, int threads)
+{
+    decode_state_t *decode;
+    int bam_index = zcc_d64_block_index(ZCC_D64_BAM_TRACK, ZCC_D64_BAM_SECTOR);
+    bool have_id;
+    bool extended = false;
+
+    if (g64->data == NULL) {
+        zcc_errno = ZCC_ERR_NULL;
+        return false;
+    }
+
+    zcc_d64_alloc(d64, ZCC_D64_TYPE_SPEEDDOS);
+    decode = zcc_malloc(sizeof *decode);
+    decode->g64 = g64;
+    decode->d64 = d64;
+    memset(decode->ids, 0, sizeof decode->ids);
+    tracks_run(track_decode, decode, ZCC_D64_TRACK_MAX_EXT, threads);
+
+    /* combine header and data errors, check IDs */
+    have_id = decode->header_errors[bam_index] == ZCC_D64_ERROR_OK;
+    memset(g64->errors, ZCC_D64_ERROR_NONE, sizeof g64->errors);
+    g64->bad_sectors = 0;
+    for (int i = 0; i < ZCC_D64_BLOCKS_MAX; i++) {
+        uint8_t error = decode->header_errors[i];
+
+        if (error == ZCC_D64_ERROR_OK) {
+            if (have_id
+                    && memcmp(decode->ids[i], decode->ids[bam_index], 2) != 0) {
+                error = ZCC_D64_ERROR_ID_MISMATCH;
+            } else {
+                error = decode->data_errors[i];
+            }
+        }
+        g64->errors[i] = error;
+        if (i >= BLOCKS_CBMDOS && decode->header_errors[i] != ZCC_D64_ERROR_SYNC
+                && decode->header_errors[i] != ZCC_D64_ERROR_HEADER) {
+            extended = true;
+        }
+    }
+    zcc_free(decode);
+
+    if (!extended) {
+        d64->type = ZCC_D64_TYPE_CBMDOS;
+        d64->size = ZCC_D64_SIZE_CBMDOS;
+    }
+    for (int i = 0; i < (extended ? ZCC_D64_BLOCKS_MAX : BLOCKS_CBMDOS); i++) {
+        if (g64->errors[i] != ZCC_D64_ERROR_OK) {
+            g64->bad_sectors++;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Show the blocks of \a g64 with errors
+ *
+ * Only valid after zcc_g64_decode().
+ *
+ * \param[in]   g64 G64 image
+ */
+void zcc_g64_dump_errors(const zcc_g64_t *g64)
+{
+    int track_max = ZCC_D64_TRACK_MAX;
+
+    for (int i = BLOCKS_CBMDOS; i < ZCC_D64_BLOCKS_MAX; i++) {
+        if (g64->errors[i] != ZCC_D64_ERROR_SYNC
+                && g64->errors[i] != ZCC_D64_ERROR_HEADER) {
+            track_max = ZCC_D64_TRACK_MAX_EXT;
+        }
+    }
+    zcc_d64_dump_errors(g64->errors, track_max);
+}
+
+
+/** \brief  Encode \a track of the D64 of \a state
+ *
+ * Writes the sectors in order, spreading the space left over the tail gaps.
+ *
+ * \param[in,out]   state   encoding state (encode_state_t)
+ * \param[in]       track   track number
+ */
+static void track_encode(void *state, int track)
+{
+    encode_state_t *encode = state;
+    int sectors = zcc_d64_track_max_sector(track);
+    size_t size = 0;
+    size_t gap;
+    uint8_t *dest = zcc_g64_track(encode->g64, track, &size);
+
+    if (dest == NULL) {
+        return;
+    }
+    gap = (size - (size_t)sectors * ZCC_G64_SECTOR_SIZE) / (size_t)sectors;
+    for (int sector = 0; sector < sectors; sector++) {
+        uint8_t header[ZCC_GCR_GROUP_DATA * 2];
+        uint8_t gcr[ZCC_GCR_HEADER_SIZE];
+        uint8_t block[ZCC_GCR_GROUP_DATA * 65];
+        uint8_t checksum = 0;
+
+        header[0] = ZCC_GCR_HEADER_ID;
+        header[2] = (uint8_t)sector;
+        header[3] = (uint8_t)track;
+        header[4] = encode->id[0];
+        header[5] = encode->id[1];
+        header[1] = (uint8_t)(header[2] ^ header[3] ^ header[4] ^ header[5]);
+        header[6] = 0x0f;
+        header[7] = 0x0f;
+        zcc_gcr_encode(gcr, header, sizeof header / ZCC_GCR_GROUP_DATA);
+
+        block[0] = ZCC_GCR_DATA_ID;
+        memcpy(block + 1,
+               encode->d64->data + zcc_d64_block_offset(track, sector),
+               ZCC_D64_BLOCK_SIZE_RAW);
+        for (int i = 1; i <= ZCC_D64_BLOCK_SIZE_RAW; i++) {
+            checksum ^= block[i];
+        }
+        block[ZCC_D64_BLOCK_SIZE_RAW + 1] = checksum;
+        block[ZCC_D64_BLOCK_SIZE_RAW + 2] = 0;
+        block[ZCC_D64_BLOCK_SIZE_RAW + 3] = 0;
+
+        dest = zcc_g64_sector_frame(dest, gcr);
+        zcc_gcr_encode(dest, block, sizeof block / ZCC_GCR_GROUP_DATA);
+        dest += ZCC_GCR_DATA_SIZE - 1 + gap;
+    }
+}
+
+
+/** \brief  Encode \a d64 into G64 image \a g64
+ *
+ * Creates standard 1541 tracks: each track has the size and speed zone of
+ * its D64 speedzone, the headers contain the disk ID from the BAM.
+ * Only 1541 images can be encoded, D71 and D81 images are rejected.
+ *
+ * \param[out]  g64     G64 image
+ * \param[in]   d64     D64 image
+ * \param[in]   threads number of worker threads (0 = number of CPUs)
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_NULL
+ * \throw   ZCC_ERR_UNSUPPORTED
+ */
+bool zcc_g64_encode(zcc_g64_t *g64, const zcc_d64_t *d64, int threads)
+{
+    encode_state_t encode;
+    const uint8_t *id;
+
+    if (d64->data == NULL) {
+        zcc_errno = ZCC_ERR_NULL;
+        return false;
+    }
+    if (d64->geometry->format != ZCC_D64_FORMAT_D64) {
+        zcc_errno = ZCC_ERR_UNSUPPORTED;
+        return false;
+    }
+
+    zcc_g64_alloc(g64, d64->size == ZCC_D64_SIZE_CBMDOS
+                  ? ZCC_D64_TRACK_MAX : ZCC_D64_TRACK_MAX_EXT);
+    id = d64->data + ZCC_D64_BAM_OFFSET + zcc_d64_diskname_offset(d64->type)
+        + (ZCC_D64_BAM_DISKID - ZCC_D64_BAM_DISKNAME);
+    encode.g64 = g64;
+    encode.d64 = d64;
+    encode.id[0] = id[1];
+    encode.id[1] = id[0];
+    tracks_run(track_encode, &encode, g64->track_max, threads);
+    return true;
+}
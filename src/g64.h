@@ -0,0 +1,141 @@
+/** \file   g64.h
+ * \brief   G64 handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_G64_H
+#define ZCC_G64_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+#include "gcr.h"
+
+/** \brief  G64 signature
+ */
+#define ZCC_G64_SIGNATURE       "GCR-1541"
+
+/** \brief  Length of the G64 signature
+ */
+#define ZCC_G64_SIGNATURE_LEN   8
+
+/** \brief  Offset in the header of the version byte
+ */
+#define ZCC_G64_VERSION         0x08
+
+/** \brief  Offset in the header of the number of (half) tracks
+ */
+#define ZCC_G64_TRACK_COUNT     0x09
+
+/** \brief  Offset in the header of the maximum track size (16-bit LE)
+ */
+#define ZCC_G64_TRACK_SIZE      0x0a
+
+/** \brief  Offset in the header of the track offset table (32-bit LE)
+ */
+#define ZCC_G64_TRACK_OFFSETS   0x0c
+
+/** \brief  Number of half tracks in a standard image
+ */
+#define ZCC_G64_HALFTRACKS      84
+
+/** \brief  Offset in the header of the speed zone table (32-bit LE)
+ */
+#define ZCC_G64_SPEED_OFFSETS   (ZCC_G64_TRACK_OFFSETS + ZCC_G64_HALFTRACKS * 4)
+
+/** \brief  Offset of the first track in images created by zcc_g64_alloc()
+ */
+#define ZCC_G64_TRACK_DATA      (ZCC_G64_SPEED_OFFSETS + ZCC_G64_HALFTRACKS * 4)
+
+/** \brief  Maximum size of a track's GCR data
+ */
+#define ZCC_G64_TRACK_SIZE_MAX  7928
+
+/** \brief  Highest full track number a G64 can contain
+ */
+#define ZCC_G64_TRACK_MAX       (ZCC_G64_HALFTRACKS / 2)
+
+/** \brief  Maximum number of worker threads used for decoding
+ */
+#define ZCC_G64_THREADS_MAX     8
+
+
+/*
+ * Standard sector layout
+ */
+
+/** \brief  Minimum number of 1-bits of a sync mark
+ */
+#define ZCC_G64_SYNC_BITS       10
+
+/** \brief  Number of $ff bytes of a sync mark
+ */
+#define ZCC_G64_SYNC_SIZE       5
+
+/** \brief  Number of $55 bytes between the header and the data sync
+ */
+#define ZCC_G64_HEADER_GAP      9
+
+/** \brief  Gap byte value
+ */
+#define ZCC_G64_GAP_BYTE        0x55
+
+/** \brief  Size of a sector without the tail gap
+ *
+ * Header sync and header, header gap, data sync and the 325 GCR bytes of the
+ * data block.
+ */
+#define ZCC_G64_SECTOR_SIZE     (ZCC_G64_SYNC_SIZE + ZCC_GCR_HEADER_SIZE \
+                                 + ZCC_G64_HEADER_GAP + ZCC_G64_SYNC_SIZE \
+                                 + ZCC_GCR_DATA_SIZE - 1)
+
+
+/** \brief  G64 handle
+ */
+typedef struct zcc_g64_s {
+    uint8_t *   data;       /**< image data */
+    size_t      size;       /**< size of \c data */
+    int         track_max;  /**< highest (full) track present */
+    uint8_t     errors[ZCC_D64_BLOCKS_MAX]; /**< error info code per block
+                                                 after decoding, see
+                                                 zcc_d64_error_t */
+    int         bad_sectors;    /**< number of blocks with errors */
+} zcc_g64_t;
+
+
+void     zcc_g64_init(zcc_g64_t *g64);
+void     zcc_g64_free(zcc_g64_t *g64);
+void     zcc_g64_alloc(zcc_g64_t *g64, int track_max);
+bool     zcc_g64_read(zcc_g64_t *g64, const char *path);
+bool     zcc_g64_write(const zcc_g64_t *g64, const char *path);
+bool     zcc_g64_decode(zcc_g64_t *g64, zcc_d64_t *d64, int threads);
+bool     zcc_g64_encode(zcc_g64_t *g64, const zcc_d64_t *d64, int threads);
+void     zcc_g64_dump_errors(const zcc_g64_t *g64);
+
+int      zcc_g64_speedzone(int track);
+size_t   zcc_g64_track_capacity(int track);
+uint8_t *zcc_g64_track(const zcc_g64_t *g64, int track, size_t *size);
+uint8_t *zcc_g64_sector_frame(uint8_t *dest, const uint8_t *header);
+
+#endif
@@ -0,0 +1,176 @@
+/** \file   gcr.c
+ * \brief   GCR (group code recording) encoding and decoding
+ *
+ * The 1541 stores each nybble as a 5-bit code, so four bytes take up five
+ * bytes on disk. Decoding uses a table indexed by 10 bits of GCR, giving a
+ * whole byte per lookup instead of combining two 5-bit lookups with shifts
+ * and masks. Encoding likewise uses a table with the 10-bit code of each
+ * byte.
+ *
+ * See doc/reference/formats/zip_six.txt for the code table.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "gcr.h"
+
+
+/** \brief  Flag in decode_table for invalid GCR codes
+ */
+#define GCR_INVALID 0x100
+
+
+/** \brief  5-bit GCR codes of the nybbles $0-$f
+ */
+static const uint8_t gcr_codes[16] = {
+    0x0a, 0x0b, 0x12, 0x13, 0x0e, 0x0f, 0x16, 0x17,
+    0x09, 0x19, 0x1a, 0x1b, 0x0d, 0x1d, 0x1e, 0x15
+};
+
+
+/** \brief  Decoded byte for each 10-bit GCR value
+ *
+ * Values containing an invalid 5-bit code have #GCR_INVALID set, their low
+ * bits decode the invalid nybble(s) as 0.
+ */
+static uint16_t decode_table[1024];
+
+/** \brief  Guard for building decode_table once
+ */
+static pthread_once_t decode_table_once = PTHREAD_ONCE_INIT;
+
+/** \brief  10-bit GCR code of each byte
+ */
+static uint16_t encode_table[256];
+
+/** \brief  Guard for building encode_table once
+ */
+static pthread_once_t encode_table_once = PTHREAD_ONCE_INIT;
+
+
+/** \brief  Build decode_table
+ */
+static void decode_table_init(void)
+{
+    uint16_t nybbles[32];
+
+    for (int code = 0; code < 32; code++) {
+        nybbles[code] = GCR_INVALID;
+    }
+    for (int nybble = 0; nybble < 16; nybble++) {
+        nybbles[gcr_codes[nybble]] = (uint16_t)nybble;
+    }
+
+    for (int value = 0; value < 1024; value++) {
+        uint16_t hi = nybbles[value >> 5];
+        uint16_t lo = nybbles[value & 0x1f];
+
+        decode_table[value] = (uint16_t)((((hi & 0x0f) << 4) | (lo & 0x0f))
+                                         | ((hi | lo) & GCR_INVALID));
+    }
+}
+
+
+/** \brief  Build encode_table
+ */
+static void encode_table_init(void)
+{
+    for (int value = 0; value < 256; value++) {
+        encode_table[value] = (uint16_t)((gcr_codes[value >> 4] << 5)
+                                         | gcr_codes[value & 0x0f]);
+    }
+}
+
+
+/** \brief  Decode \a groups groups of GCR data
+ *
+ * Decodes \a groups * 5 bytes at \a src into \a groups * 4 bytes at \a dest.
+ * Invalid codes are decoded as 0, decoding continues after them.
+ *
+ * \param[out]  dest    decoded data
+ * \param[in]   src     GCR data
+ * \param[in]   groups  number of 5-byte groups to decode
+ *
+ * \return  false if \a src contained invalid GCR codes
+ */
+bool zcc_gcr_decode(uint8_t *dest, const uint8_t *src, size_t groups)
+{
+    unsigned int invalid = 0;
+
+    pthread_once(&decode_table_once, decode_table_init);
+
+    for (size_t i = 0; i < groups; i++) {
+        uint64_t bits = ((uint64_t)src[0] << 32) | ((uint64_t)src[1] << 24)
+            | ((uint64_t)src[2] << 16) | ((uint64_t)src[3] << 8) | src[4];
+        unsigned int b0 = decode_table[(bits >> 30) & 0x3ff];
+        unsigned int b1 = decode_table[(bits >> 20) & 0x3ff];
+        unsigned int b2 = decode_table[(bits >> 10) & 0x3ff];
+        unsigned int b3 = decode_table[bits & 0x3ff];
+
+        dest[0] = (uint8_t)b0;
+        dest[1] = (uint8_t)b1;
+        dest[2] = (uint8_t)b2;
+        dest[3] = (uint8_t)b3;
+        invalid |= b0 | b1 | b2 | b3;
+
+        src += ZCC_GCR_GROUP_SIZE;
+        dest += ZCC_GCR_GROUP_DATA;
+    }
+    return (invalid & GCR_INVALID) == 0;
+}
+
+
+/** \brief  Encode \a groups groups of data to GCR
+ *
+ * Encodes \a groups * 4 bytes at \a src into \a groups * 5 bytes at \a dest.
+ *
+ * \param[out]  dest    GCR data
+ * \param[in]   src     data
+ * \param[in]   groups  number of 4-byte groups to encode
+ */
+void zcc_gcr_encode(uint8_t *dest, const uint8_t *src, size_t groups)
+{
+    pthread_once(&encode_table_once, encode_table_init);
+
+    for (size_t i = 0; i < groups; i++) {
+        uint64_t bits = ((uint64_t)encode_table[src[0]] << 30)
+            | ((uint64_t)encode_table[src[1]] << 20)
+            | ((uint64_t)encode_table[src[2]] << 10)
+            | encode_table[src[3]];
+
+        dest[0] = (uint8_t)(bits >> 32);
+        dest[1] = (uint8_t)(bits >> 24);
+        dest[2] = (uint8_t)(bits >> 16);
+        dest[3] = (uint8_t)(bits >> 8);
+        dest[4] = (uint8_t)bits;
+
+        src += ZCC_GCR_GROUP_DATA;
+        dest += ZCC_GCR_GROUP_SIZE;
+    }
+}
@@ -0,0 +1,62 @@
+/** \file   gcr.h
+ * \brief   GCR (group code recording) encoding and decoding - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_GCR_H
+#define ZCC_GCR_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/** \brief  Number of GCR bytes in a group
+ */
+#define ZCC_GCR_GROUP_SIZE  5
+
+/** \brief  Number of decoded bytes in a group
+ */
+#define ZCC_GCR_GROUP_DATA  4
+
+/** \brief  Size of a GCR-encoded sector header (8 bytes decoded)
+ */
+#define ZCC_GCR_HEADER_SIZE 10
+
+/** \brief  Size of a GCR-encoded data block (260 bytes decoded, plus a
+ *          padding byte)
+ */
+#define ZCC_GCR_DATA_SIZE   326
+
+/** \brief  Header block descriptor value
+ */
+#define ZCC_GCR_HEADER_ID   0x08
+
+/** \brief  Data block descriptor value
+ */
+#define ZCC_GCR_DATA_ID     0x07
+
+
+bool zcc_gcr_decode(uint8_t *dest, const uint8_t *src, size_t groups);
+void zcc_gcr_encode(uint8_t *dest, const uint8_t *src, size_t groups);
+
+#endif
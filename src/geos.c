@@ -0,0 +1,565 @@
+/** \file   geos.c
+ * \brief   GEOS file handling
+ *
+ * GEOS files are normal D64 files with extra data in the directory entry and
+ * usually an info block. The data of a VLIR file is split into up to 127
+ * records, each with its own block chain, found through a record block.
+ *
+ * GEOS files can be exported in the CVT format written by GEOS Convert: a
+ * block with the directory entry and a signature, the info block, for VLIR
+ * files the record block with each link replaced by the record's block count
+ * and last byte index, followed by the data.
+ *
+ * See doc/reference/formats/geos.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* struct iovec */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "petasc.h"
+#include "cbmdos.h"
+#include "d64.h"
+#include "d64extract.h"
+#include "pc64.h"
+
+#include "geos.h"
+
+
+/** \brief  CVT signature of VLIR files
+ */
+#define CVT_SIGNATURE_VLIR  "PRG formatted GEOS file V1.0"
+
+/** \brief  CVT signature of sequential files
+ */
+#define CVT_SIGNATURE_SEQ   "SEQ formatted GEOS file V1.0"
+
+/** \brief  Size of the directory entry stored in a CVT file
+ *
+ * The entry without the link to the next directory block.
+ */
+#define CVT_DIRENT_SIZE     (ZCC_D64_DIRENT_SIZE - ZCC_D64_DIRENT_FILETYPE)
+
+/** \brief  Size of a host filename buffer for a CVT file
+ *
+ * Filename, '~' plus copy counter, ".cvt" and terminator
+ */
+#define CVT_NAME_MAX        (ZCC_CBMDOS_FILENAME_MAX + 4 + 4 + 1)
+
+
+/** \brief  I/O vector of a CVT file
+ */
+typedef struct cvt_vec_s {
+    struct iovec *  iov;    /**< elements */
+    int             count;  /**< number of elements used */
+    int             size;   /**< number of elements allocated */
+    long            bytes;  /**< total size in bytes */
+} cvt_vec_t;
+
+
+/** \brief  Follow the block chain starting at block \a index
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   index   block index of the first block
+ * \param[out]  blocks  block indexes of the chain, ZCC_D64_GEOMETRY_BLOCKS_MAX
+ *                      elements
+ * \param[out]  last    number of bytes used in the last block
+ *
+ * \return  number of blocks in the chain or -1 on error
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+static int geos_chain(const zcc_d64_t *d64, int index, int *blocks, int *last)
+{
+    uint64_t visited[ZCC_D64_BITMAP_WORDS];
+    int count = 0;
+
+    memset(visited, 0, sizeof visited);
+    while (true) {
+        const uint8_t *block = d64->data + index * ZCC_D64_BLOCK_SIZE_RAW;
+
+        if (ZCC_D64_BITMAP_GET(visited, index)) {
+            zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+            return -1;
+        }
+        ZCC_D64_BITMAP_SET(visited, index);
+        blocks[count++] = index;
+
+        if (block[ZCC_D64_BLOCK_TRACK] == 0) {
+            /* last block: sector byte is the index of the last data byte */
+            *last = block[ZCC_D64_BLOCK_SECTOR] >= ZCC_D64_BLOCK_DATA
+                ? block[ZCC_D64_BLOCK_SECTOR] - 1 : 0;
+            return count;
+        }
+        index = zcc_d64_link_index(d64,
+                                   block[ZCC_D64_BLOCK_TRACK],
+                                   block[ZCC_D64_BLOCK_SECTOR]);
+        if (index < 0) {
+            zcc_errno = ZCC_ERR_SECTOR_RANGE;
+            return -1;
+        }
+    }
+}
+
+
+/** \brief  Get block index of \a record of \a vlir, checking its range
+ *
+ * \param[in]   vlir    VLIR handle
+ * \param[in]   record  record number
+ * \param[out]  head    block index of the first block, -1 if empty
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ */
+static bool vlir_head(const zcc_geos_vlir_t *vlir, int record, int *head)
+{
+    if (record < 0 || record >= vlir->record_count) {
+        zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+        return false;
+    }
+    *head = vlir->heads[record];
+    return true;
+}
+
+
+/** \brief  Append \a len bytes at \a data to \a vec
+ *
+ * \param[in,out]   vec     I/O vector
+ * \param[in]       data    data
+ * \param[in]       len     size of \a data
+ */
+static void cvt_add(cvt_vec_t *vec, uint8_t *data, size_t len)
+{
+    if (vec->count == vec->size) {
+        vec->size *= 2;
+        vec->iov = zcc_realloc(vec->iov, sizeof *(vec->iov) * (size_t)vec->size);
+    }
+    vec->iov[vec->count].iov_base = data;
+    vec->iov[vec->count].iov_len = len;
+    vec->count++;
+    vec->bytes += (long)len;
+}
+
+
+/** \brief  Append the data of the blocks in \a blocks to \a vec
+ *
+ * \param[in,out]   vec     I/O vector
+ * \param[in]       d64     D64 image
+ * \param[in]       blocks  block indexes
+ * \param[in]       count   number of elements in \a blocks
+ * \param[in]       last    number of bytes used in the last block
+ */
+static void cvt_add_blocks(cvt_vec_t *vec,
+                           const zcc_d64_t *d64,
+                           const int *blocks,
+                           int count,
+                           int last)
+{
+    for (int i = 0; i < count; i++) {
+        uint8_t *block = d64->data + blocks[i] * ZCC_D64_BLOCK_SIZE_RAW;
+
+        cvt_add(vec, block + ZCC_D64_BLOCK_DATA,
+                i < count - 1 ? ZCC_D64_BLOCK_SIZE_DATA : (size_t)last);
+    }
+}
+
+
+/** \brief  Get GEOS file structure of raw directory entry \a entry
+ *
+ * Follows the checks from the GEOS documentation: REL files can't be GEOS
+ * files, and GEOS files need a valid structure and either a VLIR structure
+ * or a GEOS file type. GEOS itself stores its files as USR.
+ *
+ * \param[in]   entry   raw directory entry
+ *
+ * \return  ZCC_GEOS_STRUCTURE_SEQ, ZCC_GEOS_STRUCTURE_VLIR or -1 if the file
+ *          isn't a GEOS file
+ */
+int zcc_geos_structure(const uint8_t *entry)
+{
+    int structure = entry[ZCC_GEOS_DIRENT_STRUCTURE];
+
+    if ((ZCC_D64_DIRENT_GET_FILETYPE(entry) & ZCC_CBMDOS_FILETYPE_MASK)
+                > ZCC_CBMDOS_FILETYPE_USR
+            || structure > ZCC_GEOS_STRUCTURE_VLIR
+            || (structure == ZCC_GEOS_STRUCTURE_SEQ
+                && entry[ZCC_GEOS_DIRENT_TYPE] == 0)) {
+        return -1;
+    }
+    return structure;
+}
+
+
+/** \brief  Open VLIR file at raw directory entry \a entry
+ *
+ * Reads the record block into the index of record chains.
+ *
+ * \param[out]  vlir    VLIR handle
+ * \param[in]   d64     D64 image
+ * \param[in]   entry   raw directory entry in \a d64
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_FILETYPE        not a VLIR file
+ * \throw   ZCC_ERR_SECTOR_RANGE    invalid record block or record link
+ */
+bool zcc_geos_vlir_open(zcc_geos_vlir_t *vlir,
+                        const zcc_d64_t *d64,
+                        const uint8_t *entry)
+{
+    const uint8_t *block;
+
+    if (zcc_geos_structure(entry) != ZCC_GEOS_STRUCTURE_VLIR) {
+        zcc_errno = ZCC_ERR_FILETYPE;
+        return false;
+    }
+    vlir->d64 = d64;
+    vlir->entry = entry;
+    vlir->info = zcc_d64_link_index(d64,
+                                    entry[ZCC_GEOS_DIRENT_INFO_TRACK],
+                                    entry[ZCC_GEOS_DIRENT_INFO_SECTOR]);
+    vlir->index = zcc_d64_link_index(d64,
+                                     ZCC_D64_DIRENT_GET_TRACK(entry),
+                                     ZCC_D64_DIRENT_GET_SECTOR(entry));
+    vlir->record_count = 0;
+    if (vlir->index < 0) {
+        zcc_errno = ZCC_ERR_SECTOR_RANGE;
+        return false;
+    }
+
+    /* 00/00 ends the index, 00/ff is an empty record */
+    block = d64->data + vlir->index * ZCC_D64_BLOCK_SIZE_RAW + ZCC_D64_BLOCK_DATA;
+    for (int i = 0; i < ZCC_GEOS_RECORDS_MAX; i++) {
+        int track = block[i * 2];
+        int sector = block[i * 2 + 1];
+
+        if (track == 0 && sector == 0) {
+            break;
+        }
+        vlir->heads[i] = -1;
+        if (track != 0) {
+            vlir->heads[i] = zcc_d64_link_index(d64, track, sector);
+            if (vlir->heads[i] < 0) {
+                zcc_errno = ZCC_ERR_SECTOR_RANGE;
+                return false;
+            }
+        }
+        vlir->record_count++;
+    }
+    return true;
+}
+
+
+/** \brief  Get size of \a record of \a vlir in bytes
+ *
+ * \param[in]   vlir    VLIR handle
+ * \param[in]   record  record number
+ *
+ * \return  size in bytes (0 for an empty record) or -1 on error
+ * \throw   ZCC_ERR_FILE_NOT_FOUND  no such record
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+long zcc_geos_vlir_record_size(const zcc_geos_vlir_t *vlir, int record)
+{
+    int blocks[ZCC_D64_GEOMETRY_BLOCKS_MAX];
+    int head;
+    int count;
+    int last;
+
+    if (!vlir_head(vlir, record, &head)) {
+        return -1;
+    }
+    if (head < 0) {
+        return 0;
+    }
+    count = geos_chain(vlir->d64, head, blocks, &last);
+    if (count < 0) {
+        return -1;
+    }
+    return (long)(count - 1) * ZCC_D64_BLOCK_SIZE_DATA + last;
+}
+
+
+/** \brief  Read \a record of \a vlir into \a buffer
+ *
+ * \param[in]   vlir    VLIR handle
+ * \param[in]   record  record number
+ * \param[out]  buffer  buffer for the record data
+ * \param[in]   size    size of \a buffer, at most this many bytes are read
+ *
+ * \return  number of bytes read (0 for an empty record) or -1 on error
+ * \throw   ZCC_ERR_FILE_NOT_FOUND  no such record
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ */
+long zcc_geos_vlir_read_record(const zcc_geos_vlir_t *vlir,
+                               int record,
+                               uint8_t *buffer,
+                               size_t size)
+{
+    int blocks[ZCC_D64_GEOMETRY_BLOCKS_MAX];
+    int head;
+    int count;
+    int last;
+    size_t pos = 0;
+
+    if (!vlir_head(vlir, record, &head)) {
+        return -1;
+    }
+    if (head < 0) {
+        return 0;
+    }
+    count = geos_chain(vlir->d64, head, blocks, &last);
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count && pos < size; i++) {
+        const uint8_t *block = vlir->d64->data + blocks[i] * ZCC_D64_BLOCK_SIZE_RAW;
+        size_t len = i < count - 1 ? ZCC_D64_BLOCK_SIZE_DATA : (size_t)last;
+
+        if (len > size - pos) {
+            len = size - pos;
+        }
+        memcpy(buffer + pos, block + ZCC_D64_BLOCK_DATA, len);
+        pos += len;
+    }
+    return (long)pos;
+}
+
+
+/** \brief  Dump record index of \a vlir on stdout
+ *
+ * \param[in]   vlir    VLIR handle
+ */
+void zcc_geos_vlir_dump(const zcc_geos_vlir_t *vlir)
+{
+    printf("%d records, info block %s\n",
+            vlir->record_count, vlir->info >= 0 ? "present" : "missing");
+    for (int i = 0; i < vlir->record_count; i++) {
+        long size = zcc_geos_vlir_record_size(vlir, i);
+
+        if (vlir->heads[i] < 0) {
+            printf("  record %3d: empty\n", i);
+        } else if (size < 0) {
+            printf("  record %3d: %s\n", i, zcc_strerror(zcc_errno));
+        } else {
+            printf("  record %3d: %ld bytes\n", i, size);
+        }
+    }
+}
+
+
+/** \brief  Write GEOS file at raw directory entry \a entry as CVT file
+ *
+ * The whole file is written with a single gathered write: the CVT header
+ * and converted record block are built on the stack, everything else comes
+ * straight from the image. Records are stored as whole blocks.
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   entry   raw directory entry in \a d64
+ * \param[in]   path    host path of the CVT file
+ *
+ * \return  number of bytes written or -1 on error
+ * \throw   ZCC_ERR_FILETYPE        not a GEOS file
+ * \throw   ZCC_ERR_INVALID_IMAGE   missing info block or oversized record
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ * \throw   ZCC_ERR_IO
+ */
+long zcc_geos_cvt_write(const zcc_d64_t *d64,
+                        const uint8_t *entry,
+                        const char *path)
+{
+    uint8_t header[ZCC_D64_BLOCK_SIZE_DATA];
+    uint8_t index[ZCC_D64_BLOCK_SIZE_DATA];
+    int blocks[ZCC_D64_GEOMETRY_BLOCKS_MAX];
+    int structure = zcc_geos_structure(entry);
+    zcc_geos_vlir_t vlir;
+    cvt_vec_t vec;
+    int info;
+    int count;
+    int last;
+    bool ok = true;
+
+    if (structure < 0) {
+        zcc_errno = ZCC_ERR_FILETYPE;
+        return -1;
+    }
+    info = zcc_d64_link_index(d64,
+                              entry[ZCC_GEOS_DIRENT_INFO_TRACK],
+                              entry[ZCC_GEOS_DIRENT_INFO_SECTOR]);
+    if (info < 0) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return -1;
+    }
+
+    memset(header, 0, sizeof header);
+    memcpy(header, entry + ZCC_D64_DIRENT_FILETYPE, CVT_DIRENT_SIZE);
+    memcpy(header + ZCC_GEOS_CVT_SIGNATURE,
+           structure == ZCC_GEOS_STRUCTURE_VLIR
+           ? CVT_SIGNATURE_VLIR : CVT_SIGNATURE_SEQ,
+           sizeof CVT_SIGNATURE_VLIR - 1);
+
+    vec.size = 64;
+    vec.count = 0;
+    vec.bytes = 0;
+    vec.iov = zcc_malloc(sizeof *(vec.iov) * (size_t)vec.size);
+    cvt_add(&vec, header, sizeof header);
+    cvt_add(&vec, d64->data + info * ZCC_D64_BLOCK_SIZE_RAW + ZCC_D64_BLOCK_DATA,
+            ZCC_D64_BLOCK_SIZE_DATA);
+
+    if (structure == ZCC_GEOS_STRUCTURE_VLIR) {
+        ok = zcc_geos_vlir_open(&vlir, d64, entry);
+        if (ok) {
+            memcpy(index,
+                   d64->data + vlir.index * ZCC_D64_BLOCK_SIZE_RAW + ZCC_D64_BLOCK_DATA,
+                   sizeof index);
+            cvt_add(&vec, index, sizeof index);
+        }
+        for (int i = 0; ok && i < vlir.record_count; i++) {
+            if (vlir.heads[i] < 0) {
+                continue;
+            }
+            count = geos_chain(d64, vlir.heads[i], blocks, &last);
+            if (count < 0) {
+                ok = false;
+            } else if (count > 0xff) {
+                zcc_errno = ZCC_ERR_INVALID_IMAGE;
+                ok = false;
+            } else {
+                index[i * 2] = (uint8_t)count;
+                index[i * 2 + 1] = (uint8_t)(last + 1);
+                cvt_add_blocks(&vec, d64, blocks, count, ZCC_D64_BLOCK_SIZE_DATA);
+            }
+        }
+    } else {
+        int start = zcc_d64_link_index(d64,
+                                       ZCC_D64_DIRENT_GET_TRACK(entry),
+                                       ZCC_D64_DIRENT_GET_SECTOR(entry));
+
+        count = start < 0 ? -1 : geos_chain(d64, start, blocks, &last);
+        if (count < 0) {
+            if (start < 0) {
+                zcc_errno = ZCC_ERR_SECTOR_RANGE;
+            }
+            ok = false;
+        } else {
+            cvt_add_blocks(&vec, d64, blocks, count, last);
+        }
+    }
+
+    if (ok) {
+        ok = zcc_d64_extract_writev(path, vec.iov, vec.count);
+    }
+    zcc_free(vec.iov);
+    return ok ? vec.bytes : -1;
+}
+
+
+/** \brief  Export the GEOS files of \a d64 as CVT files in the current directory
+ *
+ * Host filenames are generated from the CBM filename with a ".cvt"
+ * extension, duplicate names get a '~N' suffix.
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   name    host filename (without extension) of the file to
+ *                      export, or `NULL` to export all GEOS files
+ * \param[in]   verbose list files exported and VLIR records on stdout
+ *
+ * \return  number of files exported, or -1 when one or more files failed
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ */
+int zcc_geos_cvt_export(const zcc_d64_t *d64, const char *name, bool verbose)
+{
+    zcc_d64_dirview_t view;
+    zcc_pc64_names_t names;
+    int exported = 0;
+    int found = 0;
+    int error = 0;
+
+    if (!zcc_d64_dirview_read(&view, d64)) {
+        return -1;
+    }
+    zcc_pc64_names_init(&names);
+
+    for (int i = 0; i < view.entry_count; i++) {
+        const uint8_t *entry = view.entries[i];
+        char base[ZCC_CBMDOS_FILENAME_MAX + 5];
+        char path[CVT_NAME_MAX];
+        long size;
+
+        if (ZCC_D64_DIRENT_GET_TRACK(entry) == 0 || zcc_geos_structure(entry) < 0) {
+            continue;
+        }
+        zcc_pet_filename_to_host(base, ZCC_D64_DIRENT_GET_NAME(entry), NULL);
+        if (name != NULL && strcmp(base, name) != 0) {
+            continue;
+        }
+        found++;
+        if (base[0] == '\0') {
+            strcpy(base, "_");
+        }
+        snprintf(path, sizeof path, "%s.cvt", base);
+        for (int copy = 2; !zcc_pc64_names_add(&names, path); copy++) {
+            snprintf(path, sizeof path, "%s~%d.cvt", base, copy);
+        }
+
+        size = zcc_geos_cvt_write(d64, entry, path);
+        if (size < 0) {
+            if (error == 0) {
+                error = zcc_errno;
+            }
+            printf("%s: %s\n", path, zcc_strerror(zcc_errno));
+            continue;
+        }
+        exported++;
+        if (verbose) {
+            zcc_geos_vlir_t vlir;
+
+            printf("%s: %ld bytes\n", path, size);
+            if (zcc_geos_vlir_open(&vlir, d64, entry)) {
+                zcc_geos_vlir_dump(&vlir);
+            }
+        }
+    }
+    zcc_pc64_names_free(&names);
+
+    if (name != NULL && found == 0) {
+        zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+        return -1;
+    }
+    if (error != 0) {
+        zcc_errno = error;
+        return -1;
+    }
+    return exported;
+}
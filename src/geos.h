@@ -0,0 +1,104 @@
+/** \file   geos.h
+ * \brief   GEOS file handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_GEOS_H
+#define ZCC_GEOS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+
+
+/** \brief  Maximum number of records of a VLIR file
+ */
+#define ZCC_GEOS_RECORDS_MAX        127
+
+/** \brief  Offset in a raw directory entry of the info block track
+ */
+#define ZCC_GEOS_DIRENT_INFO_TRACK  0x15
+
+/** \brief  Offset in a raw directory entry of the info block sector
+ */
+#define ZCC_GEOS_DIRENT_INFO_SECTOR 0x16
+
+/** \brief  Offset in a raw directory entry of the GEOS file structure
+ */
+#define ZCC_GEOS_DIRENT_STRUCTURE   0x17
+
+/** \brief  Offset in a raw directory entry of the GEOS file type
+ */
+#define ZCC_GEOS_DIRENT_TYPE        0x18
+
+/** \brief  GEOS file structure: sequential
+ */
+#define ZCC_GEOS_STRUCTURE_SEQ      0x00
+
+/** \brief  GEOS file structure: VLIR
+ */
+#define ZCC_GEOS_STRUCTURE_VLIR     0x01
+
+/** \brief  Offset in a CVT file of the signature, after the directory entry
+ */
+#define ZCC_GEOS_CVT_SIGNATURE      0x1e
+
+
+/** \brief  GEOS VLIR file handle
+ *
+ * The record block is read once into an index of the first block of each
+ * record, so reading a record only follows its own block chain.
+ */
+typedef struct zcc_geos_vlir_s {
+    const zcc_d64_t *   d64;            /**< D64 image */
+    const uint8_t *     entry;          /**< raw directory entry */
+    int                 info;           /**< block index of the info block,
+                                             -1 if there's none */
+    int                 index;          /**< block index of the record block */
+    int                 record_count;   /**< number of records, up to the
+                                             00/00 terminator */
+    int                 heads[ZCC_GEOS_RECORDS_MAX];    /**< block index of the
+                                                             first block of
+                                                             each record, -1
+                                                             for an empty
+                                                             record */
+} zcc_geos_vlir_t;
+
+
+int  zcc_geos_structure(const uint8_t *entry);
+bool zcc_geos_vlir_open(zcc_geos_vlir_t *vlir,
+                        const zcc_d64_t *d64,
+                        const uint8_t *entry);
+long zcc_geos_vlir_record_size(const zcc_geos_vlir_t *vlir, int record);
+long zcc_geos_vlir_read_record(const zcc_geos_vlir_t *vlir,
+                               int record,
+                               uint8_t *buffer,
+                               size_t size);
+void zcc_geos_vlir_dump(const zcc_geos_vlir_t *vlir);
+long zcc_geos_cvt_write(const zcc_d64_t *d64,
+                        const uint8_t *entry,
+                        const char *path);
+int  zcc_geos_cvt_export(const zcc_d64_t *d64, const char *name, bool verbose);
+
+#endif
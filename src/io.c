@@ -128,6 +128,58 @@ long zcc_fread_alloc(uint8_t **dest, const char *path)
 }
 
 
+/** \brief  Read data from \a path into a reusable buffer
+ *
+ * Reads the file at \a path into \a *dest, which has room for \a *capacity
+ * bytes. The buffer is only reallocated when the file doesn't fit, in which
+ * case \a *dest and \a *capacity are updated. A `NULL` \a *dest with a zero
+ * \a *capacity is fine.
+ *
+ * \param[in,out]   dest        location of pointer to buffer
+ * \param[in,out]   capacity    size of the buffer at \a *dest
+ * \param[in]       path        path to file to read data from
+ *
+ * \return  number of bytes read, or -1 on error
+ * \throw   ZCC_ERR_IO
+ */
+long zcc_fread_into(uint8_t **dest, size_t *capacity, const char *path)
+{
+    FILE *fp;
+    long size;
+
+    errno = 0;
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        zcc_errno = ZCC_ERR_IO;
+        return -1;
+    }
+
+    /* determine file size */
+    if (fseek(fp, 0L, SEEK_END) != 0 || (size = ftell(fp)) < 0) {
+        zcc_errno = ZCC_ERR_IO;
+        fclose(fp);
+        return -1;
+    }
+    rewind(fp);
+
+    if (*dest == NULL || *capacity < (size_t)size) {
+        /* don't bother with realloc(): no need to preserve the contents */
+        zcc_free(*dest);
+        *dest = zcc_malloc(size > 0 ? (size_t)size : 1U);
+        *capacity = (size_t)size;
+    }
+
+    if (fread(*dest, 1U, (size_t)size, fp) != (size_t)size) {
+        zcc_errno = ZCC_ERR_IO;
+        fclose(fp);
+        return -1;
+    }
+
+    fclose(fp);
+    return size;
+}
+
+
 /** \brief  Write \a size bytes of \a data to \a path
  *
  * \param[in]   path    file to write \a data to
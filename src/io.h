@@ -32,6 +32,7 @@
 
 
 long zcc_fread_alloc(uint8_t **dest, const char *path);
+long zcc_fread_into(uint8_t **dest, size_t *capacity, const char *path);
 bool zcc_fwrite(const char *path, const uint8_t *data, size_t size);
 
 char *zcc_basename(char *path);
@@ -0,0 +1,491 @@
+/** \file   lnx.c
+ * \brief   Lynx container handling
+ *
+ * A Lynx container starts with a BASIC stub, followed by a directory in text
+ * form: fields terminated by a carriage return, numbers stored as digits.
+ * The stub and directory are padded to a whole number of 254-byte blocks,
+ * the files follow, each padded to whole blocks as well. Since a container
+ * block is a disk block without its link, the data of a file can be written
+ * into a block chain or to a host file as is.
+ *
+ * See doc/reference/formats/lnx.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "io.h"
+#include "petasc.h"
+#include "cbmdos.h"
+#include "d64.h"
+#include "d64write.h"
+
+#include "lnx.h"
+
+
+/** \brief  Carriage return, terminates the directory fields
+ */
+#define LNX_CR  0x0d
+
+
+/** \brief  Cursor in the directory of a Lynx container
+ */
+typedef struct lnx_cursor_s {
+    const uint8_t * data;   /**< container data */
+    size_t          pos;    /**< offset of the next field */
+    size_t          end;    /**< end of the directory */
+} lnx_cursor_t;
+
+
+/** \brief  Get next field at \a cursor
+ *
+ * \param[in,out]   cursor  directory cursor
+ * \param[out]      len     length of the field, without the carriage return
+ *
+ * \return  pointer to the field or `NULL` when the directory ends before its
+ *          carriage return
+ */
+static const uint8_t *lnx_field(lnx_cursor_t *cursor, size_t *len)
+{
+    const uint8_t *field = cursor->data + cursor->pos;
+    const uint8_t *cr = memchr(field, LNX_CR, cursor->end - cursor->pos);
+
+    if (cr == NULL) {
+        return NULL;
+    }
+    *len = (size_t)(cr - field);
+    cursor->pos += *len + 1;
+    return field;
+}
+
+
+/** \brief  Parse number at the start of \a field, skipping spaces
+ *
+ * \param[in]   field   directory field
+ * \param[in]   len     length of \a field
+ * \param[out]  used    number of bytes of \a field used (optional)
+ *
+ * \return  number or -1 when \a field doesn't start with one
+ */
+static int lnx_number(const uint8_t *field, size_t len, size_t *used)
+{
+    size_t i = 0;
+    int value = 0;
+
+    while (i < len && field[i] == ' ') {
+        i++;
+    }
+    if (i == len || field[i] < '0' || field[i] > '9') {
+        return -1;
+    }
+    while (i < len && field[i] >= '0' && field[i] <= '9' && value < 100000) {
+        value = value * 10 + field[i] - '0';
+        i++;
+    }
+    if (used != NULL) {
+        *used = i;
+    }
+    return value;
+}
+
+
+/** \brief  Parse number field at \a cursor
+ *
+ * \param[in,out]   cursor  directory cursor
+ *
+ * \return  number or -1 on error
+ */
+static int lnx_number_field(lnx_cursor_t *cursor)
+{
+    size_t len;
+    const uint8_t *field = lnx_field(cursor, &len);
+
+    return field != NULL ? lnx_number(field, len, NULL) : -1;
+}
+
+
+/** \brief  Find the end of the BASIC stub of \a lnx by following its links
+ *
+ * \param[in]   lnx Lynx handle
+ *
+ * \return  offset after the end of the program, or 0 on error
+ */
+static size_t lnx_stub_end(const zcc_lnx_t *lnx)
+{
+    size_t pos = 2;
+
+    if (lnx->size < 4 || lnx->data[0] + lnx->data[1] * 256 != ZCC_LNX_LOAD_ADDRESS) {
+        return 0;
+    }
+    while (pos + 2 <= lnx->size) {
+        size_t link = (size_t)(lnx->data[pos] + lnx->data[pos + 1] * 256);
+        size_t next;
+
+        if (link == 0) {
+            return pos + 2;
+        }
+        next = link - ZCC_LNX_LOAD_ADDRESS + 2;
+        if (link < ZCC_LNX_LOAD_ADDRESS || next <= pos) {
+            return 0;
+        }
+        pos = next;
+    }
+    return 0;
+}
+
+
+/** \brief  Parse directory entry at \a cursor into \a entry
+ *
+ * \param[in,out]   cursor  directory cursor
+ * \param[out]      entry   directory entry
+ *
+ * \return  bool
+ */
+static bool lnx_entry(lnx_cursor_t *cursor, zcc_lnx_entry_t *entry)
+{
+    const uint8_t *field;
+    size_t len;
+
+    field = lnx_field(cursor, &len);
+    if (field == NULL || len > ZCC_CBMDOS_FILENAME_MAX) {
+        return false;
+    }
+    memset(entry->name, 0xa0, sizeof entry->name);
+    memcpy(entry->name, field, len);
+
+    entry->blocks = lnx_number_field(cursor);
+    field = lnx_field(cursor, &len);
+    if (entry->blocks < 0 || field == NULL) {
+        return false;
+    }
+    while (len > 0 && *field == ' ') {
+        field++;
+        len--;
+    }
+    switch (len > 0 ? *field & 0x7f : 0) {
+        case 'P':
+            entry->type = ZCC_CBMDOS_FILETYPE_PRG;
+            break;
+        case 'S':
+            entry->type = ZCC_CBMDOS_FILETYPE_SEQ;
+            break;
+        case 'U':
+            entry->type = ZCC_CBMDOS_FILETYPE_USR;
+            break;
+        case 'D':
+            entry->type = ZCC_CBMDOS_FILETYPE_DEL;
+            break;
+        case 'R':
+            entry->type = ZCC_CBMDOS_FILETYPE_REL;
+            entry->record_size = lnx_number_field(cursor);
+            if (entry->record_size < 1 || entry->record_size > 254) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    entry->lsu = lnx_number_field(cursor);
+    return entry->blocks == 0 || (entry->lsu >= 1 && entry->lsu <= 255);
+}
+
+
+/** \brief  Locate the data of the files in \a lnx
+ *
+ * Files cut short by the end of the container keep the data that's there
+ * and are counted in \c lnx->truncated.
+ *
+ * \param[in,out]   lnx Lynx handle
+ */
+static void lnx_locate(zcc_lnx_t *lnx)
+{
+    size_t offset = (size_t)lnx->dir_blocks * ZCC_LNX_BLOCK_SIZE;
+
+    for (int i = 0; i < lnx->entry_count; i++) {
+        zcc_lnx_entry_t *entry = &lnx->entries[i];
+        size_t start = offset;
+        size_t size = 0;
+
+        if (entry->type == ZCC_CBMDOS_FILETYPE_REL) {
+            /* each side sector covers 120 data blocks */
+            entry->side_sectors = (entry->blocks + ZCC_LNX_REL_SIDE_BLOCKS)
+                / (ZCC_LNX_REL_SIDE_BLOCKS + 1);
+            start += (size_t)entry->side_sectors * ZCC_LNX_BLOCK_SIZE;
+        }
+        if (entry->blocks > entry->side_sectors) {
+            size = (size_t)(entry->blocks - entry->side_sectors - 1)
+                * ZCC_LNX_BLOCK_SIZE + (size_t)entry->lsu - 1;
+        }
+        offset += (size_t)entry->blocks * ZCC_LNX_BLOCK_SIZE;
+
+        if (start > lnx->size) {
+            start = lnx->size;
+        }
+        if (size > lnx->size - start) {
+            size = lnx->size - start;
+            lnx->truncated++;
+        }
+        entry->data = lnx->data + start;
+        entry->size = size;
+    }
+}
+
+
+/** \brief  Parse BASIC stub and directory of \a lnx
+ *
+ * \param[in,out]   lnx Lynx handle
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+static bool lnx_parse(zcc_lnx_t *lnx)
+{
+    lnx_cursor_t cursor;
+    const uint8_t *field;
+    size_t len;
+    int count;
+
+    cursor.data = lnx->data;
+    cursor.pos = lnx_stub_end(lnx);
+    cursor.end = lnx->size;
+    if (cursor.pos == 0) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+    while (cursor.pos < cursor.end && cursor.data[cursor.pos] == LNX_CR) {
+        cursor.pos++;
+    }
+
+    /* directory size in blocks and the signature share a field */
+    field = lnx_field(&cursor, &len);
+    if (field == NULL) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+    lnx->dir_blocks = lnx_number(field, len, NULL);
+    if (lnx->dir_blocks < 1
+            || (size_t)lnx->dir_blocks * ZCC_LNX_BLOCK_SIZE > lnx->size
+            || (size_t)lnx->dir_blocks * ZCC_LNX_BLOCK_SIZE < cursor.pos) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+    cursor.end = (size_t)lnx->dir_blocks * ZCC_LNX_BLOCK_SIZE;
+
+    count = lnx_number_field(&cursor);
+    if (count < 0) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+
+    lnx->entries = zcc_calloc((size_t)count + 1, sizeof *lnx->entries);
+    for (lnx->entry_count = 0; lnx->entry_count < count; lnx->entry_count++) {
+        if (!lnx_entry(&cursor, &lnx->entries[lnx->entry_count])) {
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+            return false;
+        }
+    }
+
+    lnx_locate(lnx);
+    return true;
+}
+
+
+/** \brief  Initialize Lynx handle \a lnx
+ *
+ * \param[out]  lnx Lynx handle
+ */
+void zcc_lnx_init(zcc_lnx_t *lnx)
+{
+    lnx->data = NULL;
+    lnx->size = 0;
+    lnx->dir_blocks = 0;
+    lnx->entries = NULL;
+    lnx->entry_count = 0;
+    lnx->truncated = 0;
+}
+
+
+/** \brief  Free memory used by the members of \a lnx
+ *
+ * \param[in,out]   lnx Lynx handle
+ */
+void zcc_lnx_free(zcc_lnx_t *lnx)
+{
+    if (lnx->data != NULL) {
+        zcc_free(lnx->data);
+    }
+    if (lnx->entries != NULL) {
+        zcc_free(lnx->entries);
+    }
+    zcc_lnx_init(lnx);
+}
+
+
+/** \brief  Read Lynx container \a path into \a lnx
+ *
+ * \param[in,out]   lnx     Lynx handle
+ * \param[in]       path    path to LNX file
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+bool zcc_lnx_read(zcc_lnx_t *lnx, const char *path)
+{
+    long size;
+
+    zcc_lnx_free(lnx);
+    size = zcc_fread_alloc(&lnx->data, path);
+    if (size < 0) {
+        return false;
+    }
+    lnx->size = (size_t)size;
+    if (!lnx_parse(lnx)) {
+        zcc_lnx_free(lnx);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Dump directory of \a lnx on stdout
+ *
+ * \param[in]   lnx Lynx handle
+ */
+void zcc_lnx_dump(const zcc_lnx_t *lnx)
+{
+    printf("%d directory blocks, %d files:\n",
+            lnx->dir_blocks, lnx->entry_count);
+    for (int i = 0; i < lnx->entry_count; i++) {
+        const zcc_lnx_entry_t *entry = &lnx->entries[i];
+        char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+        zcc_pet_filename_to_host(host, entry->name, NULL);
+        printf("%-5d \"%s\" %s  ($%06lx, %lu bytes)\n",
+               entry->blocks, host, zcc_cbmdos_filetype_str(entry->type),
+               (unsigned long)(entry->data - lnx->data),
+               (unsigned long)(entry->size));
+    }
+}
+
+
+/** \brief  Write files in \a lnx to host files
+ *
+ * Files are written to the current directory as 'name.ext', with 'ext' the
+ * file type. The data of REL files is written without side sectors.
+ *
+ * \param[in]   lnx     Lynx handle
+ * \param[in]   name    only extract file \a name (host filename, without
+ *                      extension), or NULL to extract all files
+ * \param[in]   verbose print the name and size of each file
+ *
+ * \return  number of files extracted or -1 on error
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ */
+int zcc_lnx_extract(const zcc_lnx_t *lnx, const char *name, bool verbose)
+{
+    int count = 0;
+
+    for (int i = 0; i < lnx->entry_count; i++) {
+        const zcc_lnx_entry_t *entry = &lnx->entries[i];
+        char host[ZCC_CBMDOS_FILENAME_MAX + 5];
+
+        if (name != NULL) {
+            zcc_pet_filename_to_host(host, entry->name, NULL);
+            if (strcmp(host, name) != 0) {
+                continue;
+            }
+        }
+        zcc_pet_filename_to_host(host, entry->name,
+                                 zcc_cbmdos_filetype_str(entry->type));
+        if (!zcc_fwrite(host, entry->data, entry->size)) {
+            return -1;
+        }
+        if (verbose) {
+            printf("%-20s %6lu bytes\n", host, (unsigned long)(entry->size));
+        }
+        count++;
+    }
+    if (name != NULL && count == 0) {
+        zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+        return -1;
+    }
+    return count;
+}
+
+
+/** \brief  Convert \a lnx to D64 image \a d64
+ *
+ * \a d64 must have been allocated with zcc_d64_alloc(), it gets formatted
+ * with disk name \a name. The blocks of each file are copied from the
+ * container into its block chain as is.
+ *
+ * \param[in]       lnx     Lynx handle
+ * \param[in,out]   d64     D64 image
+ * \param[in]       name    disk name (ASCII)
+ *
+ * \return  number of files written, less than \c lnx->entry_count on error
+ * \throw   ZCC_ERR_FILETYPE    REL files aren't supported
+ * \throw   ZCC_ERR_DISK_FULL
+ * \throw   ZCC_ERR_DIR_FULL
+ */
+int zcc_lnx_to_d64(const zcc_lnx_t *lnx, zcc_d64_t *d64, const char *name)
+{
+    zcc_d64_newfile_t *files;
+    char (*names)[ZCC_CBMDOS_FILENAME_MAX + 1];
+    int written;
+
+    zcc_d64_format(d64, name, "00");
+    if (lnx->entry_count == 0) {
+        return 0;
+    }
+
+    files = zcc_calloc((size_t)lnx->entry_count, sizeof *files);
+    names = zcc_calloc((size_t)lnx->entry_count, sizeof *names);
+    for (int i = 0; i < lnx->entry_count; i++) {
+        const zcc_lnx_entry_t *entry = &lnx->entries[i];
+        size_t len = ZCC_CBMDOS_FILENAME_MAX;
+
+        while (len > 0 && entry->name[len - 1] == 0xa0) {
+            len--;
+        }
+        zcc_pet_to_asc_str(names[i], entry->name, len);
+        files[i].name = names[i];
+        files[i].type = entry->type;
+        files[i].data = entry->data;
+        files[i].size = entry->size;
+    }
+    written = zcc_d64_write_files(d64, files, lnx->entry_count);
+    zcc_free(names);
+    zcc_free(files);
+    return written;
+}
@@ -0,0 +1,94 @@
+/** \file   lnx.h
+ * \brief   Lynx container handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_LNX_H
+#define ZCC_LNX_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbmdos.h"
+#include "d64.h"
+
+
+/** \brief  Load address of the BASIC stub in front of the directory
+ */
+#define ZCC_LNX_LOAD_ADDRESS    0x0801
+
+/** \brief  Size of a block in a Lynx container
+ *
+ * A disk block without its track/sector link.
+ */
+#define ZCC_LNX_BLOCK_SIZE      ZCC_D64_BLOCK_SIZE_DATA
+
+/** \brief  Number of data blocks covered by a side sector of a REL file
+ */
+#define ZCC_LNX_REL_SIDE_BLOCKS 120
+
+
+/** \brief  File in a Lynx container
+ */
+typedef struct zcc_lnx_entry_s {
+    uint8_t                 name[ZCC_CBMDOS_FILENAME_MAX];  /**< PETSCII name,
+                                                                 padded with
+                                                                 0xa0 */
+    zcc_cbmdos_filetype_t   type;   /**< file type */
+    int                     blocks; /**< size in blocks according to the
+                                         directory, including side sectors
+                                         of REL files */
+    int                     lsu;    /**< index of the last byte used in the
+                                         last block, plus one */
+    int                     record_size;    /**< record size of REL files */
+    int                     side_sectors;   /**< number of side sector blocks
+                                                 in front of the data of REL
+                                                 files */
+    const uint8_t *         data;   /**< file data, points into the
+                                         container */
+    size_t                  size;   /**< size of \c data in bytes */
+} zcc_lnx_entry_t;
+
+
+/** \brief  Lynx container handle
+ */
+typedef struct zcc_lnx_s {
+    uint8_t *           data;       /**< container data */
+    size_t              size;       /**< size of \c data */
+    int                 dir_blocks; /**< size of the BASIC stub and directory
+                                         in blocks */
+    zcc_lnx_entry_t *   entries;    /**< files, in directory order */
+    int                 entry_count;    /**< number of files */
+    int                 truncated;  /**< number of files cut short by the end
+                                         of the container */
+} zcc_lnx_t;
+
+
+void zcc_lnx_init(zcc_lnx_t *lnx);
+void zcc_lnx_free(zcc_lnx_t *lnx);
+bool zcc_lnx_read(zcc_lnx_t *lnx, const char *path);
+void zcc_lnx_dump(const zcc_lnx_t *lnx);
+int  zcc_lnx_extract(const zcc_lnx_t *lnx, const char *name, bool verbose);
+int  zcc_lnx_to_d64(const zcc_lnx_t *lnx, zcc_d64_t *d64, const char *name);
+
+#endif
@@ -25,12 +25,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
+#include "ark.h"
 #include "cmdline.h"
 #include "d64.h"
+#include "d64extract.h"
+#include "d64rel.h"
+#include "d64map.h"
+#include "d64write.h"
+#include "errors.h"
+#include "g64.h"
 #include "io.h"
+#include "geos.h"
+#include "lnx.h"
+#include "pc64.h"
 #include "mem.h"
+#include "petasc.h"
+#include "pool.h"
+#include "sixpack.h"
+#include "t64.h"
 #include "zipdisk.h"
+#include "zipfile.h"
 
 
 
@@ -113,10 +129,240 @@ static int opt_zipdisk_info = 0;
  */
 static int opt_zipdisk_unzip = 0;
 
+/** \brief  Convert multiple zipdisk and ARK/SRK archives to D64, reusing buffers
+ */
+static int opt_zipdisk_batch = 0;
+
+/** \brief  Extract a single file from a zipdisk archive
+ */
+static int opt_zipdisk_extract = 0;
+
+/** \brief  Recover what can be recovered from damaged zipdisk archives
+ *
+ * Applies to --zipdisk-unzip and --zipdisk-batch
+ */
+static int opt_zipdisk_recover = 0;
+
+/** \brief  Extract files from a filepacked zipcode archive
+ */
+static int opt_zipfile_extract = 0;
+
+/** \brief  Convert SixPack archive to D64
+ */
+static int opt_sixpack_unzip = 0;
+
+/** \brief  Convert SixPack archive to G64
+ */
+static int opt_sixpack_to_g64 = 0;
+
+/** \brief  Convert G64 image to D64
+ */
+static int opt_g64_to_d64 = 0;
+
+/** \brief  Convert D64 image to G64
+ */
+static int opt_d64_to_g64 = 0;
+
+/** \brief  Convert T64 container to D64
+ */
+static int opt_t64_to_d64 = 0;
+
+/** \brief  Extract files from a Lynx container
+ */
+static int opt_lnx_extract = 0;
+
+/** \brief  Convert Lynx container to D64
+ */
+static int opt_lnx_to_d64 = 0;
+
+/** \brief  Extract files from an ARK/SRK archive
+ */
+static int opt_ark_extract = 0;
+
+/** \brief  Convert ARK/SRK archive to D64
+ */
+static int opt_ark_to_d64 = 0;
+
 /** \brief  Dump directory listing of D64 file
  */
 static int opt_d64_dir = 0;
 
+/** \brief  Check D64 block chains and BAM for consistency
+ */
+static int opt_d64_validate = 0;
+
+/** \brief  Rebuild D64 BAM from the file chains
+ *
+ * Also applies to images created with --zipdisk-unzip and --zipdisk-batch
+ */
+static int opt_d64_rebuild_bam = 0;
+
+/** \brief  Extract files from a D64 image
+ */
+static int opt_d64_extract = 0;
+
+/** \brief  Create a D64 image from host files
+ */
+static int opt_d64_create = 0;
+
+/** \brief  Export files of D64 images to PC64 files
+ */
+static int opt_pc64_export = 0;
+
+/** \brief  Import PC64 files into D64 images
+ */
+static int opt_pc64_import = 0;
+
+/** \brief  Replace existing images
+ *
+ * Applies to --pc64-import
+ */
+static int opt_pc64_overwrite = 0;
+
+/** \brief  Export GEOS files of a D64 image to CVT files
+ */
+static int opt_geos_cvt = 0;
+
+/** \brief  Show REL file info and records
+ */
+static int opt_d64_rel = 0;
+
+
+/** \brief  Generate image filename from archive filename \a infile
+ *
+ * Strips the directory and the first \a prefix characters ('[1-5]!' for
+ * zipdisk, '[1-6]!!' for SixPack) and appends \a ext.
+ *
+ * \param[in]   infile  path to zipdisk slice or SixPack file
+ * \param[in]   prefix  length of the archive prefix
+ * \param[in]   ext     extension including the dot (".d64", ".g64")
+ *
+ * \return  heap-allocated filename, free with zcc_free()
+ */
+static char *archive_image_name(char *infile, size_t prefix, const char *ext)
+{
+    char *bname = zcc_basename(infile);
+    size_t blen = strlen(bname);
+    size_t elen = strlen(ext);
+    char *outfile;
+
+    if (blen < prefix) {
+        outfile = zcc_malloc(8 + elen + 1);
+        memcpy(outfile, "unzipped", 8);
+        memcpy(outfile + 8, ext, elen + 1);
+        return outfile;
+    }
+    /* -prefix, + extension, +1 for '\0' */
+    outfile = zcc_malloc(blen - prefix + elen + 1);
+    memcpy(outfile, bname + prefix, blen - prefix);
+    memcpy(outfile + blen - prefix, ext, elen + 1);
+    return outfile;
+}
+
+
+/** \brief  Generate image filename from image filename \a infile
+ *
+ * Strips the directory and replaces the extension, if any, with \a ext.
+ *
+ * \param[in]   infile  path to image
+ * \param[in]   ext     new extension including the dot
+ *
+ * \return  heap-allocated filename, free with zcc_free()
+ */
+static char *image_name(char *infile, const char *ext)
+{
+    char *bname = zcc_basename(infile);
+    char *dot = strrchr(bname, '.');
+    size_t blen = dot != NULL && dot != bname
+        ? (size_t)(dot - bname) : strlen(bname);
+    size_t elen = strlen(ext);
+    char *outfile;
+
+    outfile = zcc_malloc(blen + elen + 1);
+    memcpy(outfile, bname, blen);
+    memcpy(outfile + blen, ext, elen + 1);
+    return outfile;
+}
+
+
+/** \brief  Generate CBM DOS filename and type from host file \a path
+ *
+ * Strips the directory and, when present, a ".del", ".seq", ".prg" or ".usr"
+ * extension, which then determines the file type. Other files are PRG.
+ *
+ * \param[in]   path    path to host file
+ * \param[out]  type    CBM DOS file type
+ *
+ * \return  heap-allocated filename, free with zcc_free()
+ */
+static char *host_cbmdos_name(char *path, zcc_cbmdos_filetype_t *type)
+{
+    static const char *exts[] = { "del", "seq", "prg", "usr" };
+    char *name = zcc_strdup(zcc_basename(path));
+    size_t len = strlen(name);
+
+    *type = ZCC_CBMDOS_FILETYPE_PRG;
+    if (len < 5 || name[len - 4] != '.') {
+        return name;
+    }
+    for (int i = 0; i < (int)(sizeof exts / sizeof exts[0]); i++) {
+        int c = 0;
+
+        while (c < 3
+                && tolower((unsigned char)name[len - 3 + (size_t)c]) == exts[i][c]) {
+            c++;
+        }
+        if (c == 3) {
+            *type = (zcc_cbmdos_filetype_t)i;
+            name[len - 4] = '\0';
+            break;
+        }
+    }
+    return name;
+}
+
+
+/** \brief  Check if \a path has extension \a ext, ignoring case
+ *
+ * \param[in]   path    path
+ * \param[in]   ext     lower case extension including the dot
+ *
+ * \return  bool
+ */
+static bool has_extension(const char *path, const char *ext)
+{
+    size_t plen = strlen(path);
+    size_t elen = strlen(ext);
+
+    if (plen <= elen) {
+        return false;
+    }
+    for (size_t i = 0; i < elen; i++) {
+        if (tolower((unsigned char)path[plen - elen + i]) != ext[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Generate disk name from container filename \a infile
+ *
+ * \param[in]   infile  path to container
+ *
+ * \return  heap-allocated basename without extension, free with zcc_free()
+ */
+static char *container_disk_name(char *infile)
+{
+    char *diskname = zcc_strdup(zcc_basename(infile));
+    char *ext = strrchr(diskname, '.');
+
+    if (ext != NULL && ext != diskname) {
+        *ext = '\0';
+    }
+    return diskname;
+}
+
 
 
 /*
@@ -153,7 +399,6 @@ static bool cmd_zipdisk_unzip(strlist_t *args)
     char *infile = strlist_get(args, 0);
     char *outfile = strlist_get(args, 1);
     zcc_zipdisk_t zip;
-    char *bname;
     bool outfile_alloced = false;
 
     if (infile == NULL) {
@@ -163,27 +408,16 @@ static bool cmd_zipdisk_unzip(strlist_t *args)
 
     /* either use arg[1] or use arg[0] without the '1!' */
     if (outfile == NULL) {
-        size_t blen;
-
-        fprintf(stderr, "TODO: generate D64 filename from zipdisk filename\n");
-
-        bname = zcc_basename(infile);
-        blen = strlen(bname);
-        printf("basename = '%s'\n", bname);
-        /* -2 for '[1-5]!', + 4 for .d64, +1 for '\0' */
-        outfile = zcc_malloc(blen - 2 + 4 + 1);
-        memcpy(outfile, bname + 2, blen - 2);
-        memcpy(outfile + blen - 2, ".d64", 4);
-
+        outfile = archive_image_name(infile, 2, ".d64");
         outfile_alloced = true;
-
-
     }
 
     printf("infile  = '%s'\n", infile);
     printf("outfile = '%s'\n", outfile);
 
     zcc_zipdisk_init(&zip);
+    zip.rebuild_bam = opt_d64_rebuild_bam;
+    zip.recover = opt_zipdisk_recover;
     if (!zcc_zipdisk_read(&zip, infile)) {
         fprintf(stderr, "fuck\n");
         if (outfile_alloced) {
@@ -192,9 +426,18 @@ static bool cmd_zipdisk_unzip(strlist_t *args)
         return false;
     }
     if (zcc_zipdisk_unzip(&zip, outfile)) {
+        if (zip.bad_sectors > 0) {
+            fprintf(stderr, "%d bad sectors, see error info.\n",
+                    zip.bad_sectors);
+        }
+        if (zip.resyncs > 0 || zip.missing_slices > 0) {
+            fprintf(stderr, "%d missing slices, %d resyncs.\n",
+                    zip.missing_slices, zip.resyncs);
+        }
         fprintf(stderr, "OK.\n");
     } else {
-        fprintf(stderr, "fick");
+        fprintf(stderr, "failed to unzip '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
         if (outfile_alloced) {
             zcc_free(outfile);
         }
@@ -208,41 +451,1177 @@ static bool cmd_zipdisk_unzip(strlist_t *args)
 }
 
 
-/** \brief  List directory of a D64 image
+/** \brief  Convert zipdisk archive \a infile to D64 for a batch
  *
- * \param[in]   args    command argument list
+ * \param[in]       infile  path to a slice of the archive
+ * \param[in,out]   pool    buffer pool
  *
  * \return  bool
  */
-static bool cmd_d64_dir(strlist_t *args)
+static bool batch_zipdisk(char *infile, zcc_pool_t *pool)
 {
-    char *path = strlist_get(args, 0);
+    char *outfile = archive_image_name(infile, 2, ".d64");
+    zcc_zipdisk_t zip;
+    bool result = true;
+
+    zcc_zipdisk_init(&zip);
+    zip.pool = pool;
+    zip.rebuild_bam = opt_d64_rebuild_bam;
+    zip.recover = opt_zipdisk_recover;
+    if (!zcc_zipdisk_read(&zip, infile)
+            || !zcc_zipdisk_unzip(&zip, outfile)) {
+        fprintf(stderr, "%s: ", infile);
+        zcc_perror(NULL);
+        result = false;
+    } else if (zip.bad_sectors > 0) {
+        printf("%s -> %s (%d bad sectors)\n",
+                infile, outfile, zip.bad_sectors);
+    } else {
+        printf("%s -> %s\n", infile, outfile);
+    }
+    zcc_zipdisk_free(&zip);
+    zcc_free(outfile);
+    return result;
+}
+
+
+/** \brief  Convert ARK/SRK archive \a infile to D64 for a batch
+ *
+ * \param[in]       infile  path to archive
+ * \param[in,out]   pool    buffer pool
+ *
+ * \return  bool
+ */
+static bool batch_ark(char *infile, zcc_pool_t *pool)
+{
+    char *outfile = image_name(infile, ".d64");
+    char *diskname = container_disk_name(infile);
+    zcc_ark_t *ark = zcc_malloc(sizeof *ark);
     zcc_d64_t d64;
-    zcc_d64_dir_t dir;
+    bool result = false;
 
-    printf("Showing dir of '%s'\n", path);
+    zcc_ark_init(ark);
     zcc_d64_init(&d64);
-    printf("Loading file .. ");
-    if (zcc_d64_read(&d64, strlist_get(args, 0), 0)) {
-        printf("OK.\n");
-        printf("Initializing d64_dir object.. ");
-        zcc_d64_dir_init(&dir, &d64);
-        printf("Reading directory .. ");
-        if (zcc_d64_dir_read(&dir)) {
-            printf("OK.\n");
+    if (zcc_ark_read(ark, infile)) {
+        zcc_d64_alloc_pooled(&d64, ZCC_D64_TYPE_CBMDOS, pool);
+        result = zcc_ark_to_d64(ark, &d64, diskname) >= 0
+            && zcc_d64_write(&d64, outfile);
+    }
+    if (!result) {
+        fprintf(stderr, "%s: ", infile);
+        zcc_perror(NULL);
+    } else if (ark->unavailable > 0) {
+        printf("%s -> %s (%d files compressed or lost)\n",
+                infile, outfile, ark->unavailable);
+    } else {
+        printf("%s -> %s\n", infile, outfile);
+    }
+    zcc_d64_free(&d64);
+    zcc_ark_free(ark);
+    zcc_free(ark);
+    zcc_free(diskname);
+    zcc_free(outfile);
+    return result;
+}
+
+
+/** \brief  Convert a batch of zipdisk and ARK/SRK archives to D64 images
+ *
+ * Each argument is a path to a slice of a zipdisk archive or to an ARK/SRK
+ * archive (recognized by extension), the D64 is written to the current
+ * directory with a name generated from the archive name. All archives share
+ * a single buffer pool, so after the first archive image and slice buffers
+ * are reused instead of being allocated again.
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  true if all archives were converted
+ */
+static bool cmd_zipdisk_batch(strlist_t *args)
+{
+    zcc_pool_t pool;
+    size_t count = strlist_num_items(args);
+    size_t failed = 0;
+
+    if (count == 0) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    zcc_pool_init(&pool);
+
+    for (size_t i = 0; i < count; i++) {
+        char *infile = strlist_get(args, (int)i);
+        bool ok;
+
+        if (has_extension(infile, ".ark") || has_extension(infile, ".srk")) {
+            ok = batch_ark(infile, &pool);
         } else {
-            return false;
+            ok = batch_zipdisk(infile, &pool);
+        }
+        if (!ok) {
+            failed++;
         }
-        zcc_d64_dir_dump(&dir);
+    }
 
-        zcc_d64_free(&d64);
+    printf("%lu archives converted, %lu failed, %lu buffer allocations.\n",
+            (unsigned long)(count - failed), (unsigned long)failed,
+            pool.heap_allocs);
+    zcc_pool_free(&pool);
+    return failed == 0;
+}
+
+
+/** \brief  Extract a single file from a zipdisk archive
+ *
+ * Arguments are the path to a slice of the archive, the host filename of the
+ * file (without extension) and optionally the output path.
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  true on success
+ */
+static bool cmd_zipdisk_extract(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *name = strlist_get(args, 1);
+    char *outfile = strlist_get(args, 2);
+    zcc_zipdisk_t zip;
+    zcc_zipdisk_index_t index;
+    long size;
+
+    if (infile == NULL || name == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    zcc_zipdisk_init(&zip);
+    if (!zcc_zipdisk_read(&zip, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+        zcc_zipdisk_free(&zip);
+        return false;
+    }
 
+    size = zcc_zipdisk_extract(&zip, name, outfile, &index);
+    if (size < 0) {
+        fprintf(stderr, "failed to extract '%s': %s\n",
+                name, zcc_strerror(zcc_errno));
     } else {
-        printf("failed.,\n");
+        printf("%s: %ld bytes, %d of %d blocks decoded.\n",
+                name, size, index.decoded, index.block_count);
+    }
+    zcc_zipdisk_free(&zip);
+    return size >= 0;
+}
+
+
+/** \brief  Extract files from a filepacked zipcode archive
+ *
+ * Usage: --zipfile-extract &lt;part&gt; [&lt;name&gt;]
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  bool
+ */
+static bool cmd_zipfile_extract(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *name = strlist_get(args, 1);
+    zcc_zipfile_t zip;
+    int count;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
         return false;
     }
 
-    return true;
+    zcc_zipfile_init(&zip);
+    if (!zcc_zipfile_read(&zip, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+        zcc_zipfile_free(&zip);
+        return false;
+    }
+    if (opt_verbose) {
+        zcc_zipfile_dump(&zip);
+    }
+
+    count = zcc_zipfile_extract(&zip, name, opt_verbose);
+    if (count < 0) {
+        fprintf(stderr, "extraction failed: %s\n", zcc_strerror(zcc_errno));
+    } else {
+        printf("%d files extracted.\n", count);
+    }
+    zcc_zipfile_free(&zip);
+    return count >= 0;
+}
+
+
+/** \brief  Convert SixPack archive to D64
+ *
+ * Usage: --sixpack-unzip &lt;part&gt; [&lt;d64&gt;]
+ *
+ * Sectors with errors are listed, their contents are kept as far as they
+ * could be decoded.
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  bool
+ */
+static bool cmd_sixpack_unzip(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    zcc_sixpack_t six;
+    zcc_d64_t d64;
+    bool outfile_alloced = false;
+    bool result = false;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    if (outfile == NULL) {
+        outfile = archive_image_name(infile, 3, ".d64");
+        outfile_alloced = true;
+    }
+
+    zcc_sixpack_init(&six);
+    zcc_d64_init(&d64);
+    if (!zcc_sixpack_read(&six, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else if (zcc_sixpack_decode(&six, &d64)) {
+        if (six.bad_sectors > 0 || opt_verbose) {
+            zcc_sixpack_dump_errors(&six);
+        }
+        result = zcc_d64_write(&d64, outfile);
+        if (!result) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    outfile, zcc_strerror(zcc_errno));
+        }
+    }
+
+    zcc_d64_free(&d64);
+    zcc_sixpack_free(&six);
+    if (outfile_alloced) {
+        zcc_free(outfile);
+    }
+    return result;
+}
+
+
+/** \brief  Convert SixPack archive to G64
+ *
+ * Usage: --sixpack-to-g64 &lt;part&gt; [&lt;g64&gt;]
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  bool
+ */
+static bool cmd_sixpack_to_g64(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    zcc_sixpack_t six;
+    zcc_g64_t g64;
+    bool outfile_alloced = false;
+    bool result = false;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    if (outfile == NULL) {
+        outfile = archive_image_name(infile, 3, ".g64");
+        outfile_alloced = true;
+    }
+
+    zcc_sixpack_init(&six);
+    zcc_g64_init(&g64);
+    if (!zcc_sixpack_read(&six, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else if (zcc_sixpack_to_g64(&six, &g64)) {
+        result = zcc_g64_write(&g64, outfile);
+        if (!result) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    outfile, zcc_strerror(zcc_errno));
+        }
+    }
+
+    zcc_g64_free(&g64);
+    zcc_sixpack_free(&six);
+    if (outfile_alloced) {
+        zcc_free(outfile);
+    }
+    return result;
+}
+
+
+/** \brief  Convert G64 image to D64
+ *
+ * Usage: --g64-to-d64 &lt;g64&gt; [&lt;d64&gt;]
+ *
+ * Sectors with errors are listed, their contents are kept as far as they
+ * could be decoded.
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  bool
+ */
+static bool cmd_g64_to_d64(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    zcc_g64_t g64;
+    zcc_d64_t d64;
+    bool outfile_alloced = false;
+    bool result = false;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    if (outfile == NULL) {
+        outfile = image_name(infile, ".d64");
+        outfile_alloced = true;
+    }
+
+    zcc_g64_init(&g64);
+    zcc_d64_init(&d64);
+    if (!zcc_g64_read(&g64, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else if (zcc_g64_decode(&g64, &d64, 0)) {
+        if (g64.bad_sectors > 0 || opt_verbose) {
+            zcc_g64_dump_errors(&g64);
+        }
+        result = zcc_d64_write(&d64, outfile);
+        if (!result) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    outfile, zcc_strerror(zcc_errno));
+        }
+    }
+
+    zcc_d64_free(&d64);
+    zcc_g64_free(&g64);
+    if (outfile_alloced) {
+        zcc_free(outfile);
+    }
+    return result;
+}
+
+
+/** \brief  Convert D64 image to G64
+ *
+ * Usage: --d64-to-g64 &lt;d64&gt; [&lt;g64&gt;]
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  bool
+ */
+static bool cmd_d64_to_g64(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    zcc_g64_t g64;
+    zcc_d64_t d64;
+    bool outfile_alloced = false;
+    bool result = false;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    if (outfile == NULL) {
+        outfile = image_name(infile, ".g64");
+        outfile_alloced = true;
+    }
+
+    zcc_d64_init(&d64);
+    zcc_g64_init(&g64);
+    if (!zcc_d64_read(&d64, infile, 0)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else if (!zcc_g64_encode(&g64, &d64, 0)) {
+        fprintf(stderr, "failed to encode '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else {
+        result = zcc_g64_write(&g64, outfile);
+        if (!result) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    outfile, zcc_strerror(zcc_errno));
+        }
+    }
+
+    zcc_g64_free(&g64);
+    zcc_d64_free(&d64);
+    if (outfile_alloced) {
+        zcc_free(outfile);
+    }
+    return result;
+}
+
+
+/** \brief  List directory of a D64 image
+ *
+ * Uses the zero-copy directory view, unless --verbose is used: file sizes in
+ * bytes require walking the block chains, which is done via the dirent copies
+ * of zcc_d64_dir_t.
+ *
+ * \param[in]   args    command argument list
+ *
+ * \return  bool
+ */
+static bool cmd_d64_dir(strlist_t *args)
+{
+    char *path = strlist_get(args, 0);
+    zcc_d64_t d64;
+    bool result = true;
+
+    if (path == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    printf("Showing dir of '%s'\n", path);
+    zcc_d64_init(&d64);
+    printf("Loading file .. ");
+    if (!zcc_d64_read(&d64, path, 0)) {
+        printf("failed.,\n");
+        return false;
+    }
+    printf("OK.\n");
+
+    if (opt_verbose) {
+        zcc_d64_dir_t dir;
+
+        printf("Initializing d64_dir object.. ");
+        zcc_d64_dir_init(&dir, &d64);
+        printf("Reading directory .. ");
+        if (zcc_d64_dir_read(&dir)) {
+            printf("OK.\n");
+            /* file sizes in bytes require walking all block chains */
+            if (!zcc_d64_dir_calc_sizes(&dir)) {
+                printf("warning: some files have broken block chains\n");
+            }
+            zcc_d64_dir_dump(&dir);
+        } else {
+            result = false;
+        }
+    } else {
+        zcc_d64_dirview_t view;
+
+        if (zcc_d64_dirview_read(&view, &d64)) {
+            zcc_d64_dirview_dump(&view);
+        } else {
+            result = false;
+        }
+    }
+
+    zcc_d64_free(&d64);
+    return result;
+}
+
+
+/** \brief  Check consistency of a D64 image
+ *
+ * Builds a block ownership map and reports cycles, cross-linked files, invalid
+ * links and blocks whose BAM state doesn't match their use.
+ *
+ * \param[in]   args    non-option arguments
+ *
+ * \return  true if the image is consistent
+ */
+static bool cmd_d64_validate(strlist_t *args)
+{
+    char *path = strlist_get(args, 0);
+    zcc_d64_t d64;
+    zcc_d64_map_t *map;
+    bool result;
+
+    if (path == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    zcc_d64_init(&d64);
+    if (!zcc_d64_read(&d64, path, 0)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                path, zcc_strerror(zcc_errno));
+        return false;
+    }
+
+    map = zcc_malloc(sizeof *map);
+    result = zcc_d64_map_build(map, &d64);
+    if (result) {
+        zcc_d64_map_dump(map, opt_verbose);
+        result = zcc_d64_map_is_valid(map);
+    } else {
+        fprintf(stderr, "failed to read directory: %s\n",
+                zcc_strerror(zcc_errno));
+    }
+
+    zcc_free(map);
+    zcc_d64_free(&d64);
+    return result;
+}
+
+
+/** \brief  Rebuild the BAM of a D64 image from its file chains
+ *
+ * The image is rewritten in place, unless a second argument is given.
+ *
+ * \param[in]   args    non-option arguments
+ *
+ * \return  true on success
+ */
+static bool cmd_d64_rebuild_bam(strlist_t *args)
+{
+    char *path = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    zcc_d64_t d64;
+    int changed;
+    bool result = true;
+
+    if (path == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    zcc_d64_init(&d64);
+    if (!zcc_d64_read(&d64, path, 0)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                path, zcc_strerror(zcc_errno));
+        return false;
+    }
+
+    changed = zcc_d64_rebuild_bam(&d64);
+    if (changed < 0 && zcc_errno == ZCC_ERR_INVALID_IMAGE) {
+        fprintf(stderr, "broken directory or file chains, BAM not rebuilt "
+                "(use --d64-validate for details)\n");
+        result = false;
+    } else if (changed < 0) {
+        fprintf(stderr, "failed to read directory: %s\n",
+                zcc_strerror(zcc_errno));
+        result = false;
+    } else {
+        printf("%d blocks changed, %d blocks free.\n",
+                changed, zcc_d64_blocks_free(&d64));
+        if (!zcc_d64_write(&d64, outfile)) {
+            fprintf(stderr, "failed to write image: %s\n",
+                    zcc_strerror(zcc_errno));
+            result = false;
+        }
+    }
+
+    zcc_d64_free(&d64);
+    return result;
+}
+
+
+/** \brief  Extract files from a D64 image into the current directory
+ *
+ * Extracts all files, or only the file named by the second argument (the host
+ * filename without extension).
+ *
+ * \param[in]   args    non-option arguments
+ *
+ * \return  true on success
+ */
+static bool cmd_d64_extract(strlist_t *args)
+{
+    char *path = strlist_get(args, 0);
+    char *name = strlist_get(args, 1);
+    zcc_d64_t d64;
+    int count;
+
+    if (path == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    zcc_d64_init(&d64);
+    if (!zcc_d64_read(&d64, path, 0)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                path, zcc_strerror(zcc_errno));
+        return false;
+    }
+
+    count = zcc_d64_extract(&d64, NULL, name, 0, opt_verbose);
+    if (count < 0) {
+        fprintf(stderr, "extraction failed: %s\n", zcc_strerror(zcc_errno));
+    } else {
+        printf("%d files extracted.\n", count);
+    }
+
+    zcc_d64_free(&d64);
+    return count >= 0;
+}
+
+
+/** \brief  Create D64 image from host files
+ *
+ * Usage: --d64-create &lt;image&gt; &lt;file&gt; [&lt;file&gt; ...]
+ *
+ * The disk name is taken from the image filename. All files are written in a
+ * single pass with one BAM update.
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  bool
+ */
+static bool cmd_d64_create(strlist_t *args)
+{
+    char *path = strlist_get(args, 0);
+    int count = (int)strlist_num_items(args) - 1;
+    zcc_d64_newfile_t *files;
+    uint8_t **buffers;
+    char **names;
+    char *diskname;
+    char *ext;
+    zcc_d64_t d64;
+    int loaded = 0;
+    int written = -1;
+
+    if (path == NULL || count < 1) {
+        fprintf(stderr, "missing argument(s)\n");
+        return false;
+    }
+
+    files = zcc_calloc((size_t)count, sizeof *files);
+    buffers = zcc_calloc((size_t)count, sizeof *buffers);
+    names = zcc_calloc((size_t)count, sizeof *names);
+
+    for (loaded = 0; loaded < count; loaded++) {
+        char *infile = strlist_get(args, loaded + 1);
+        long size = zcc_fread_alloc(&buffers[loaded], infile);
+
+        if (size < 0) {
+            fprintf(stderr, "failed to read '%s': %s\n",
+                    infile, zcc_strerror(zcc_errno));
+            break;
+        }
+        names[loaded] = host_cbmdos_name(infile, &files[loaded].type);
+        files[loaded].name = names[loaded];
+        files[loaded].data = buffers[loaded];
+        files[loaded].size = (size_t)size;
+    }
+
+    if (loaded == count) {
+        diskname = zcc_strdup(zcc_basename(path));
+        ext = strrchr(diskname, '.');
+        if (ext != NULL && ext != diskname) {
+            *ext = '\0';
+        }
+        zcc_d64_init(&d64);
+        zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+        zcc_d64_format(&d64, diskname, "00");
+        zcc_free(diskname);
+
+        written = zcc_d64_write_files(&d64, files, count);
+        if (written < count) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    names[written], zcc_strerror(zcc_errno));
+        } else if (!zcc_d64_write(&d64, path)) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    path, zcc_strerror(zcc_errno));
+            written = -1;
+        } else {
+            printf("%d files written to '%s'.\n", written, path);
+        }
+        zcc_d64_free(&d64);
+    }
+
+    for (int i = 0; i < loaded; i++) {
+        zcc_free(buffers[i]);
+        zcc_free(names[i]);
+    }
+    zcc_free(buffers);
+    zcc_free(names);
+    zcc_free(files);
+    return written == count;
+}
+
+
+/** \brief  Export files of D64 images to PC64 files
+ *
+ * Usage: --pc64-export &lt;image|dir&gt; [&lt;image|dir&gt; ...]
+ *
+ * Directories are searched recursively for images, the files of each image
+ * are written to a directory named after the image.
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  true if all images were exported
+ */
+static bool cmd_pc64_export(strlist_t *args)
+{
+    size_t count = strlist_num_items(args);
+    int images = 0;
+    bool result = true;
+
+    if (count == 0) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        int exported = zcc_pc64_export_tree(strlist_get(args, (int)i),
+                                            0, opt_verbose);
+
+        if (exported < 0) {
+            result = false;
+        } else {
+            images += exported;
+        }
+    }
+    printf("%d images exported.\n", images);
+    return result;
+}
+
+
+/** \brief  Import PC64 files into D64 images
+ *
+ * Usage: --pc64-import &lt;dir&gt; [&lt;dir&gt; ...]
+ *
+ * Each directory holding PC64 files, searched recursively, becomes a D64
+ * image named after the directory. Directories next to an existing image of
+ * that name are skipped, unless --pc64-overwrite is used.
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  true if all images were written
+ */
+static bool cmd_pc64_import(strlist_t *args)
+{
+    size_t count = strlist_num_items(args);
+    int images = 0;
+    bool result = true;
+
+    if (count == 0) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        int written = zcc_pc64_import_tree(strlist_get(args, (int)i),
+                                           opt_pc64_overwrite, opt_verbose);
+
+        if (written < 0) {
+            result = false;
+        } else {
+            images += written;
+        }
+    }
+    printf("%d images written.\n", images);
+    return result;
+}
+
+
+/** \brief  Export GEOS files of a D64 image to CVT files
+ *
+ * Usage: --geos-cvt &lt;image&gt; [&lt;name&gt;]
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  bool
+ */
+static bool cmd_geos_cvt(strlist_t *args)
+{
+    char *path = strlist_get(args, 0);
+    char *name = strlist_get(args, 1);
+    zcc_d64_t d64;
+    int count;
+
+    if (path == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    zcc_d64_init(&d64);
+    if (!zcc_d64_read(&d64, path, 0)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                path, zcc_strerror(zcc_errno));
+        return false;
+    }
+
+    count = zcc_geos_cvt_export(&d64, name, opt_verbose);
+    if (count < 0) {
+        fprintf(stderr, "export failed: %s\n", zcc_strerror(zcc_errno));
+    } else {
+        printf("%d files exported.\n", count);
+    }
+
+    zcc_d64_free(&d64);
+    return count >= 0;
+}
+
+
+/** \brief  Show REL file info and optionally dump a record
+ *
+ * Usage: --d64-rel &lt;image&gt; &lt;name&gt; [&lt;record&gt;]
+ *
+ * Records are numbered from 1, like RECORD# in CBM BASIC.
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  bool
+ */
+static bool cmd_d64_rel(strlist_t *args)
+{
+    char *path = strlist_get(args, 0);
+    char *name = strlist_get(args, 1);
+    char *number = strlist_get(args, 2);
+    zcc_d64_t d64;
+    zcc_d64_dirview_t view;
+    zcc_d64_rel_t *rel;
+    bool result = false;
+
+    if (path == NULL || name == NULL) {
+        fprintf(stderr, "missing argument(s)\n");
+        return false;
+    }
+
+    zcc_d64_init(&d64);
+    if (!zcc_d64_read(&d64, path, 0)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                path, zcc_strerror(zcc_errno));
+        return false;
+    }
+
+    rel = zcc_malloc(sizeof *rel);
+    zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+    if (zcc_d64_dirview_read(&view, &d64)) {
+        for (int i = 0; i < view.entry_count && !result; i++) {
+            char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+            zcc_pet_filename_to_host(host, ZCC_D64_DIRENT_GET_NAME(view.entries[i]),
+                                     NULL);
+            if (strcmp(host, name) == 0) {
+                result = zcc_d64_rel_open(rel, &d64, view.entries[i]);
+            }
+        }
+    }
+
+    if (!result) {
+        fprintf(stderr, "failed to open '%s': %s\n",
+                name, zcc_strerror(zcc_errno));
+    } else if (number == NULL) {
+        printf("%ld records of %d bytes, %d data blocks, %d side sectors.\n",
+                rel->record_count, rel->record_size,
+                rel->block_count, rel->side_sectors);
+    } else {
+        uint8_t record[ZCC_D64_BLOCK_SIZE_RAW];
+        long index = strtol(number, NULL, 10);
+
+        if (zcc_d64_rel_read_record(rel, index - 1, record) < 0) {
+            fprintf(stderr, "failed to read record %ld: %s\n",
+                    index, zcc_strerror(zcc_errno));
+            result = false;
+        } else {
+            zcc_hexdump(record, (size_t)rel->record_size, 0);
+        }
+    }
+
+    zcc_free(rel);
+    zcc_d64_free(&d64);
+    return result;
+}
+
+
+/** \brief  Convert T64 container to D64
+ *
+ * Usage: --t64-to-d64 &lt;t64&gt; [&lt;d64&gt;]
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  bool
+ */
+static bool cmd_t64_to_d64(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    zcc_t64_t t64;
+    zcc_d64_t d64;
+    bool outfile_alloced = false;
+    bool result = false;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    if (outfile == NULL) {
+        outfile = image_name(infile, ".d64");
+        outfile_alloced = true;
+    }
+
+    zcc_t64_init(&t64);
+    zcc_d64_init(&d64);
+    if (!zcc_t64_read(&t64, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else {
+        int written;
+
+        if (opt_verbose) {
+            zcc_t64_dump(&t64);
+        }
+        zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+        written = zcc_t64_to_d64(&t64, &d64);
+        if (written < t64.entry_count) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    t64.entries[written].name, zcc_strerror(zcc_errno));
+        } else if (!zcc_d64_write(&d64, outfile)) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    outfile, zcc_strerror(zcc_errno));
+        } else {
+            printf("%d files written to '%s'", written, outfile);
+            if (t64.fixed_sizes > 0) {
+                printf(" (%d end addresses fixed)", t64.fixed_sizes);
+            }
+            printf(".\n");
+            result = true;
+        }
+    }
+
+    zcc_d64_free(&d64);
+    zcc_t64_free(&t64);
+    if (outfile_alloced) {
+        zcc_free(outfile);
+    }
+    return result;
+}
+
+
+/** \brief  Extract files from a Lynx container
+ *
+ * Usage: --lnx-extract &lt;lnx&gt; [&lt;name&gt;]
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  bool
+ */
+static bool cmd_lnx_extract(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *name = strlist_get(args, 1);
+    zcc_lnx_t lnx;
+    int count;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    zcc_lnx_init(&lnx);
+    if (!zcc_lnx_read(&lnx, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+        return false;
+    }
+    if (opt_verbose) {
+        zcc_lnx_dump(&lnx);
+    }
+
+    count = zcc_lnx_extract(&lnx, name, opt_verbose);
+    if (count < 0) {
+        fprintf(stderr, "extraction failed: %s\n", zcc_strerror(zcc_errno));
+    } else {
+        printf("%d files extracted.\n", count);
+    }
+    if (lnx.truncated > 0) {
+        fprintf(stderr, "%d files truncated.\n", lnx.truncated);
+    }
+    zcc_lnx_free(&lnx);
+    return count >= 0;
+}
+
+
+/** \brief  Convert Lynx container to D64
+ *
+ * Usage: --lnx-to-d64 &lt;lnx&gt; [&lt;d64&gt;]
+ *
+ * The disk name is the name of the container without extension.
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  bool
+ */
+static bool cmd_lnx_to_d64(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    char *diskname;
+    zcc_lnx_t lnx;
+    zcc_d64_t d64;
+    bool outfile_alloced = false;
+    bool result = false;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    if (outfile == NULL) {
+        outfile = image_name(infile, ".d64");
+        outfile_alloced = true;
+    }
+
+    zcc_lnx_init(&lnx);
+    zcc_d64_init(&d64);
+    if (!zcc_lnx_read(&lnx, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else {
+        int written;
+
+        if (opt_verbose) {
+            zcc_lnx_dump(&lnx);
+        }
+        diskname = container_disk_name(infile);
+        zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+        written = zcc_lnx_to_d64(&lnx, &d64, diskname);
+        zcc_free(diskname);
+        if (written < lnx.entry_count) {
+            char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+            zcc_pet_filename_to_host(host, lnx.entries[written].name, NULL);
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    host, zcc_strerror(zcc_errno));
+        } else if (!zcc_d64_write(&d64, outfile)) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    outfile, zcc_strerror(zcc_errno));
+        } else {
+            printf("%d files written to '%s'.\n", written, outfile);
+            result = true;
+        }
+        if (lnx.truncated > 0) {
+            fprintf(stderr, "%d files truncated.\n", lnx.truncated);
+        }
+    }
+
+    zcc_d64_free(&d64);
+    zcc_lnx_free(&lnx);
+    if (outfile_alloced) {
+        zcc_free(outfile);
+    }
+    return result;
+}
+
+
+/** \brief  Extract files from an ARK/SRK archive
+ *
+ * Usage: --ark-extract &lt;ark&gt; [&lt;name&gt;]
+ *
+ * \param[in]   args    argument list
+ *
+ * \return  bool
+ */
+static bool cmd_ark_extract(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *name = strlist_get(args, 1);
+    zcc_ark_t *ark;
+    int count = -1;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+
+    ark = zcc_malloc(sizeof *ark);
+    zcc_ark_init(ark);
+    if (!zcc_ark_read(ark, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else {
+        if (opt_verbose) {
+            zcc_ark_dump(ark);
+        }
+        count = zcc_ark_extract(ark, name, opt_verbose);
+        if (count < 0) {
+            fprintf(stderr, "extraction failed: %s\n",
+                    zcc_strerror(zcc_errno));
+        } else {
+            printf("%d files extracted.\n", count);
+        }
+        if (ark->unavailable > 0) {
+            fprintf(stderr, "%d files compressed or lost.\n",
+                    ark->unavailable);
+        }
+    }
+    zcc_ark_free(ark);
+    zcc_free(ark);
+    return count >= 0;
+}
+
+
+/** \brief  Convert ARK/SRK archive to D64
+ *
+ * Usage: --ark-to-d64 &lt;ark&gt; [&lt;d64&gt;]
+ *
+ * \param[in]   args    command arguments
+ *
+ * \return  bool
+ */
+static bool cmd_ark_to_d64(strlist_t *args)
+{
+    char *infile = strlist_get(args, 0);
+    char *outfile = strlist_get(args, 1);
+    char *diskname;
+    zcc_ark_t *ark;
+    zcc_d64_t d64;
+    bool outfile_alloced = false;
+    bool result = false;
+
+    if (infile == NULL) {
+        fprintf(stderr, "missing argument\n");
+        return false;
+    }
+    if (outfile == NULL) {
+        outfile = image_name(infile, ".d64");
+        outfile_alloced = true;
+    }
+
+    ark = zcc_malloc(sizeof *ark);
+    zcc_ark_init(ark);
+    zcc_d64_init(&d64);
+    if (!zcc_ark_read(ark, infile)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                infile, zcc_strerror(zcc_errno));
+    } else {
+        int written;
+
+        if (opt_verbose) {
+            zcc_ark_dump(ark);
+        }
+        diskname = container_disk_name(infile);
+        zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+        written = zcc_ark_to_d64(ark, &d64, diskname);
+        zcc_free(diskname);
+        if (written < 0) {
+            fprintf(stderr, "conversion failed: %s\n",
+                    zcc_strerror(zcc_errno));
+        } else if (!zcc_d64_write(&d64, outfile)) {
+            fprintf(stderr, "failed to write '%s': %s\n",
+                    outfile, zcc_strerror(zcc_errno));
+        } else {
+            printf("%d files written to '%s'.\n", written, outfile);
+            result = true;
+        }
+        if (ark->unavailable > 0) {
+            fprintf(stderr, "%d files compressed or lost.\n",
+                    ark->unavailable);
+        }
+    }
+
+    zcc_d64_free(&d64);
+    zcc_ark_free(ark);
+    zcc_free(ark);
+    if (outfile_alloced) {
+        zcc_free(outfile);
+    }
+    return result;
 }
 
 
@@ -255,8 +1634,61 @@ static const cmdline_option_t main_cmdline_options[] = {
         &opt_verbose, 0, "enable verbose output" },
     { 0, "zipdisk-unzip", NULL, CMDLINE_TYPE_BOOL,
         &opt_zipdisk_unzip, NULL, "unpack" },
+    { 0, "zipdisk-batch", NULL, CMDLINE_TYPE_BOOL,
+        &opt_zipdisk_batch, NULL,
+        "unpack multiple zipdisk and ARK/SRK archives, reusing buffers" },
+    { 0, "zipdisk-extract", NULL, CMDLINE_TYPE_BOOL,
+        &opt_zipdisk_extract, NULL,
+        "extract a single file from a zipdisk archive" },
+    { 0, "zipdisk-recover", NULL, CMDLINE_TYPE_BOOL,
+        &opt_zipdisk_recover, NULL,
+        "skip corrupt data and missing slices when unpacking zipdisks" },
+    { 0, "zipfile-extract", NULL, CMDLINE_TYPE_BOOL,
+        &opt_zipfile_extract, NULL,
+        "extract files from a filepacked zipcode archive" },
+    { 0, "sixpack-unzip", NULL, CMDLINE_TYPE_BOOL,
+        &opt_sixpack_unzip, NULL, "convert SixPack archive to D64" },
+    { 0, "sixpack-to-g64", NULL, CMDLINE_TYPE_BOOL,
+        &opt_sixpack_to_g64, NULL,
+        "convert SixPack archive to G64, keeping the GCR data" },
+    { 0, "g64-to-d64", NULL, CMDLINE_TYPE_BOOL,
+        &opt_g64_to_d64, NULL, "convert G64 image to D64" },
+    { 0, "d64-to-g64", NULL, CMDLINE_TYPE_BOOL,
+        &opt_d64_to_g64, NULL, "convert D64 image to G64" },
+    { 0, "t64-to-d64", NULL, CMDLINE_TYPE_BOOL,
+        &opt_t64_to_d64, NULL, "convert T64 container to D64" },
+    { 0, "lnx-extract", NULL, CMDLINE_TYPE_BOOL,
+        &opt_lnx_extract, NULL, "extract files from a Lynx container" },
+    { 0, "lnx-to-d64", NULL, CMDLINE_TYPE_BOOL,
+        &opt_lnx_to_d64, NULL, "convert Lynx container to D64" },
+    { 0, "ark-extract", NULL, CMDLINE_TYPE_BOOL,
+        &opt_ark_extract, NULL, "extract files from an ARK/SRK archive" },
+    { 0, "ark-to-d64", NULL, CMDLINE_TYPE_BOOL,
+        &opt_ark_to_d64, NULL, "convert ARK/SRK archive to D64" },
     { 0, "d64-dir", NULL, CMDLINE_TYPE_BOOL,
         &opt_d64_dir, NULL, "display D64 directory" },
+    { 0, "d64-validate", NULL, CMDLINE_TYPE_BOOL,
+        &opt_d64_validate, NULL, "check D64 block chains and BAM" },
+    { 0, "d64-rebuild-bam", NULL, CMDLINE_TYPE_BOOL,
+        &opt_d64_rebuild_bam, NULL,
+        "rebuild D64 BAM from the file chains (also when unzipping)" },
+    { 0, "d64-extract", NULL, CMDLINE_TYPE_BOOL,
+        &opt_d64_extract, NULL, "extract files from D64" },
+    { 0, "d64-create", NULL, CMDLINE_TYPE_BOOL,
+        &opt_d64_create, NULL, "create D64 from host files" },
+    { 0, "d64-rel", NULL, CMDLINE_TYPE_BOOL,
+        &opt_d64_rel, NULL, "show REL file info or dump a record" },
+    { 0, "pc64-export", NULL, CMDLINE_TYPE_BOOL,
+        &opt_pc64_export, NULL,
+        "export files of D64 images (or trees of them) to PC64 files" },
+    { 0, "pc64-import", NULL, CMDLINE_TYPE_BOOL,
+        &opt_pc64_import, NULL,
+        "import directories (or trees of them) of PC64 files into D64 images" },
+    { 0, "pc64-overwrite", NULL, CMDLINE_TYPE_BOOL,
+        &opt_pc64_overwrite, NULL,
+        "replace existing images with --pc64-import" },
+    { 0, "geos-cvt", NULL, CMDLINE_TYPE_BOOL,
+        &opt_geos_cvt, NULL, "export GEOS files of a D64 image to CVT files" },
 
     CMDLINE_OPTION_TERMINATOR
 };
@@ -275,8 +1707,48 @@ static bool handle_commands(strlist_t *args)
         return cmd_zipdisk_info(args);
     } else if (opt_zipdisk_unzip) {
         return cmd_zipdisk_unzip(args);
+    } else if (opt_zipdisk_batch) {
+        return cmd_zipdisk_batch(args);
+    } else if (opt_zipdisk_extract) {
+        return cmd_zipdisk_extract(args);
+    } else if (opt_zipfile_extract) {
+        return cmd_zipfile_extract(args);
+    } else if (opt_sixpack_unzip) {
+        return cmd_sixpack_unzip(args);
+    } else if (opt_sixpack_to_g64) {
+        return cmd_sixpack_to_g64(args);
+    } else if (opt_g64_to_d64) {
+        return cmd_g64_to_d64(args);
+    } else if (opt_d64_to_g64) {
+        return cmd_d64_to_g64(args);
+    } else if (opt_t64_to_d64) {
+        return cmd_t64_to_d64(args);
+    } else if (opt_lnx_extract) {
+        return cmd_lnx_extract(args);
+    } else if (opt_lnx_to_d64) {
+        return cmd_lnx_to_d64(args);
+    } else if (opt_ark_extract) {
+        return cmd_ark_extract(args);
+    } else if (opt_ark_to_d64) {
+        return cmd_ark_to_d64(args);
     } else if (opt_d64_dir) {
         return cmd_d64_dir(args);
+    } else if (opt_d64_validate) {
+        return cmd_d64_validate(args);
+    } else if (opt_d64_rebuild_bam) {
+        return cmd_d64_rebuild_bam(args);
+    } else if (opt_d64_extract) {
+        return cmd_d64_extract(args);
+    } else if (opt_d64_create) {
+        return cmd_d64_create(args);
+    } else if (opt_pc64_export) {
+        return cmd_pc64_export(args);
+    } else if (opt_pc64_import) {
+        return cmd_pc64_import(args);
+    } else if (opt_geos_cvt) {
+        return cmd_geos_cvt(args);
+    } else if (opt_d64_rel) {
+        return cmd_d64_rel(args);
     }
 
     return true;
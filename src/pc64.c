@@ -0,0 +1,742 @@
+/** \file   pc64.c
+ * \brief   PC64 (P00) container handling
+ *
+ * A PC64 file holds a single CBM file: a 26-byte header with the signature,
+ * the PETSCII filename and the record size of REL files, followed by the
+ * file data. The file type is stored in the first letter of the extension,
+ * the two digits that follow it tell apart files whose names reduce to the
+ * same host name.
+ *
+ * See doc/reference/formats/pc64.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* opendir(), mkdir(), stat() */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "io.h"
+#include "petasc.h"
+#include "cbmdos.h"
+#include "d64.h"
+#include "d64extract.h"
+#include "d64write.h"
+
+#include "pc64.h"
+
+
+/** \brief  Initial number of slots of a name set
+ */
+#define NAMES_SLOTS_INIT    64
+
+/** \brief  Extension letters of the PC64 file types, indexed by CBM DOS type
+ *
+ * DEL files can't be stored in a PC64 file.
+ */
+static const char type_letters[] = { '\0', 's', 'p', 'u', 'r' };
+
+
+/** \brief  Calculate hash of \a name, ignoring case
+ *
+ * FNV-1a over the lower case characters of \a name.
+ *
+ * \param[in]   name    filename
+ *
+ * \return  hash
+ */
+static uint32_t names_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (uint32_t)tolower((unsigned char)*name++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/** \brief  Compare \a s1 and \a s2, ignoring case
+ *
+ * \param[in]   s1  string
+ * \param[in]   s2  string
+ *
+ * \return  true if equal
+ */
+static bool names_equal(const char *s1, const char *s2)
+{
+    while (*s1 != '\0'
+            && tolower((unsigned char)*s1) == tolower((unsigned char)*s2)) {
+        s1++;
+        s2++;
+    }
+    return tolower((unsigned char)*s1) == tolower((unsigned char)*s2);
+}
+
+
+/** \brief  Find slot of \a name in \a names
+ *
+ * \param[in]   names   name set
+ * \param[in]   name    filename
+ *
+ * \return  slot holding \a name, or the unused slot where it would go
+ */
+static size_t names_slot(const zcc_pc64_names_t *names, const char *name)
+{
+    size_t mask = names->size - 1;
+    size_t slot = names_hash(name) & mask;
+
+    while (names->slots[slot] != NULL
+            && !names_equal(names->slots[slot], name)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+
+/** \brief  Double the number of slots of \a names
+ *
+ * \param[in,out]   names   name set
+ */
+static void names_grow(zcc_pc64_names_t *names)
+{
+    char **slots = names->slots;
+    size_t size = names->size;
+
+    names->size = size * 2;
+    names->slots = zcc_calloc(names->size, sizeof *(names->slots));
+    for (size_t i = 0; i < size; i++) {
+        if (slots[i] != NULL) {
+            names->slots[names_slot(names, slots[i])] = slots[i];
+        }
+    }
+    zcc_free(slots);
+}
+
+
+/** \brief  Compare two strings for qsort()
+ *
+ * \param[in]   p1  pointer to first string
+ * \param[in]   p2  pointer to second string
+ *
+ * \return  <0, 0 or >0
+ */
+static int list_cmp(const void *p1, const void *p2)
+{
+    return strcmp(*(char * const *)p1, *(char * const *)p2);
+}
+
+
+/** \brief  Read the names in host directory \a dir
+ *
+ * \param[in]   dir     host directory
+ * \param[out]  count   number of names
+ *
+ * \return  sorted list of names without "." and "..", free with list_free(),
+ *          or `NULL` on error
+ * \throw   ZCC_ERR_IO
+ */
+static char **list_read(const char *dir, int *count)
+{
+    DIR *handle;
+    struct dirent *entry;
+    char **list;
+    int size = 16;
+
+    *count = 0;
+    handle = opendir(dir);
+    if (handle == NULL) {
+        zcc_errno = ZCC_ERR_IO;
+        return NULL;
+    }
+    list = zcc_malloc(sizeof *list * (size_t)size);
+    while ((entry = readdir(handle)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (*count == size) {
+            size *= 2;
+            list = zcc_realloc(list, sizeof *list * (size_t)size);
+        }
+        list[(*count)++] = zcc_strdup(entry->d_name);
+    }
+    closedir(handle);
+    qsort(list, (size_t)*count, sizeof *list, list_cmp);
+    return list;
+}
+
+
+/** \brief  Free list of names \a list
+ *
+ * \param[in,out]   list    list of names
+ * \param[in]       count   number of names in \a list
+ */
+static void list_free(char **list, int count)
+{
+    for (int i = 0; i < count; i++) {
+        zcc_free(list[i]);
+    }
+    zcc_free(list);
+}
+
+
+/** \brief  Join host directory \a dir and \a name
+ *
+ * \param[in]   dir     directory
+ * \param[in]   name    name in \a dir
+ *
+ * \return  heap-allocated path, free with zcc_free()
+ */
+static char *path_join(const char *dir, const char *name)
+{
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = zcc_malloc(len);
+
+    snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+
+/** \brief  Check if \a path is a directory
+ *
+ * \param[in]   path    host path
+ *
+ * \return  bool
+ */
+static bool path_is_dir(const char *path)
+{
+    struct stat st;
+
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+/** \brief  Check if \a path is a disk image, going by its extension
+ *
+ * \param[in]   path    host path
+ *
+ * \return  bool
+ */
+static bool path_is_image(const char *path)
+{
+    static const char *exts[] = { "d64", "d71", "d81" };
+    const char *ext = strrchr(path, '.');
+
+    if (ext == NULL || strlen(ext) != 4) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof exts / sizeof exts[0]; i++) {
+        if (tolower((unsigned char)ext[1]) == exts[i][0]
+                && tolower((unsigned char)ext[2]) == exts[i][1]
+                && tolower((unsigned char)ext[3]) == exts[i][2]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief  Find an existing disk image named after directory \a dir
+ *
+ * \param[in]   dir     host directory, without trailing slash
+ *
+ * \return  heap-allocated path of the first image found, or `NULL`
+ */
+static char *path_image_of_dir(const char *dir)
+{
+    static const char *exts[] = { "d64", "d71", "d81" };
+    size_t len = strlen(dir) + 5;
+    char *image = zcc_malloc(len);
+
+    for (size_t i = 0; i < sizeof exts / sizeof exts[0]; i++) {
+        struct stat st;
+
+        snprintf(image, len, "%s.%s", dir, exts[i]);
+        if (stat(image, &st) == 0) {
+            return image;
+        }
+    }
+    zcc_free(image);
+    return NULL;
+}
+
+
+/** \brief  Write PC64 header for file \a name in \a head
+ *
+ * \param[out]  head        header, ZCC_PC64_HEADER_SIZE bytes
+ * \param[in]   name        PETSCII filename, padded with 0xa0
+ * \param[in]   record_size record size of a REL file, 0 for other files
+ */
+void zcc_pc64_header(uint8_t *head, const uint8_t *name, int record_size)
+{
+    memset(head, 0, ZCC_PC64_HEADER_SIZE);
+    memcpy(head, ZCC_PC64_MAGIC, ZCC_PC64_MAGIC_SIZE);
+    for (int i = 0; i < ZCC_CBMDOS_FILENAME_MAX && name[i] != 0xa0; i++) {
+        head[ZCC_PC64_FILENAME + i] = name[i];
+    }
+    head[ZCC_PC64_RECORD_SIZE] = (uint8_t)record_size;
+}
+
+
+/** \brief  Get file type of PC64 file \a path from its extension
+ *
+ * \param[in]   path    host path
+ *
+ * \return  CBM DOS file type, or -1 if \a path doesn't have a PC64 extension
+ */
+int zcc_pc64_type(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    const char *letter;
+
+    if (ext == NULL || strlen(ext) != 4
+            || !isdigit((unsigned char)ext[2])
+            || !isdigit((unsigned char)ext[3])) {
+        return -1;
+    }
+    letter = memchr(type_letters + 1, tolower((unsigned char)ext[1]),
+                    sizeof type_letters - 1);
+    if (letter == NULL) {
+        return -1;
+    }
+    return (int)(letter - type_letters);
+}
+
+
+/** \brief  Initialize empty name set \a names
+ *
+ * \param[out]  names   name set
+ */
+void zcc_pc64_names_init(zcc_pc64_names_t *names)
+{
+    names->size = NAMES_SLOTS_INIT;
+    names->count = 0;
+    names->slots = zcc_calloc(names->size, sizeof *(names->slots));
+}
+
+
+/** \brief  Free memory used by the members of \a names
+ *
+ * \param[in,out]   names   name set
+ */
+void zcc_pc64_names_free(zcc_pc64_names_t *names)
+{
+    for (size_t i = 0; i < names->size; i++) {
+        zcc_free(names->slots[i]);
+    }
+    zcc_free(names->slots);
+    names->slots = NULL;
+    names->size = 0;
+    names->count = 0;
+}
+
+
+/** \brief  Add \a name to \a names
+ *
+ * \param[in,out]   names   name set
+ * \param[in]       name    filename
+ *
+ * \return  false if \a name was already in the set
+ */
+bool zcc_pc64_names_add(zcc_pc64_names_t *names, const char *name)
+{
+    size_t slot;
+
+    if ((names->count + 1) * 2 > names->size) {
+        names_grow(names);
+    }
+    slot = names_slot(names, name);
+    if (names->slots[slot] != NULL) {
+        return false;
+    }
+    names->slots[slot] = zcc_strdup(name);
+    names->count++;
+    return true;
+}
+
+
+/** \brief  Add the names of the files in host directory \a dir to \a names
+ *
+ * A missing directory is treated as an empty one.
+ *
+ * \param[in,out]   names   name set
+ * \param[in]       dir     host directory
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_IO
+ */
+bool zcc_pc64_names_scan(zcc_pc64_names_t *names, const char *dir)
+{
+    char **list;
+    int count;
+
+    list = list_read(dir, &count);
+    if (list == NULL) {
+        return errno == ENOENT;
+    }
+    for (int i = 0; i < count; i++) {
+        zcc_pc64_names_add(names, list[i]);
+    }
+    list_free(list, count);
+    return true;
+}
+
+
+/** \brief  Generate unique PC64 filename for CBM file \a name in \a dest
+ *
+ * The host name of the CBM file gets an extension with the type letter and
+ * the lowest number not yet used by a file with the same name. The result is
+ * added to \a names.
+ *
+ * \param[in,out]   names   names already in use
+ * \param[out]      dest    filename, ZCC_PC64_NAME_MAX bytes
+ * \param[in]       name    PETSCII filename, padded with 0xa0
+ * \param[in]       type    CBM DOS file type (not DEL)
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_FILETYPE
+ * \throw   ZCC_ERR_INVALID_FILENAME    all 100 numbers are in use
+ */
+bool zcc_pc64_name(zcc_pc64_names_t *names,
+                   char *dest,
+                   const uint8_t *name,
+                   zcc_cbmdos_filetype_t type)
+{
+    char base[ZCC_CBMDOS_FILENAME_MAX + 5];
+
+    if (type == ZCC_CBMDOS_FILETYPE_DEL || type > ZCC_CBMDOS_FILETYPE_REL) {
+        zcc_errno = ZCC_ERR_FILETYPE;
+        return false;
+    }
+    zcc_pet_filename_to_host(base, name, NULL);
+    if (base[0] == '\0') {
+        strcpy(base, "_");
+    }
+    for (int copy = 0; copy < ZCC_PC64_COPIES_MAX; copy++) {
+        snprintf(dest, ZCC_PC64_NAME_MAX, "%s.%c%02d",
+                 base, type_letters[type], copy);
+        if (zcc_pc64_names_add(names, dest)) {
+            return true;
+        }
+    }
+    zcc_errno = ZCC_ERR_INVALID_FILENAME;
+    return false;
+}
+
+
+/** \brief  Import the PC64 files in host directory \a dir into \a d64
+ *
+ * \a d64 must have been allocated and formatted. Files are added in order of
+ * their host names. REL files are skipped, they can't be written to a D64
+ * image yet.
+ *
+ * \param[in,out]   d64     D64 image
+ * \param[in]       dir     host directory
+ * \param[in]       verbose list files imported on stdout
+ *
+ * \return  number of files imported or -1 on error
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ * \throw   ZCC_ERR_DISK_FULL
+ * \throw   ZCC_ERR_DIR_FULL
+ */
+int zcc_pc64_import(zcc_d64_t *d64, const char *dir, bool verbose)
+{
+    zcc_d64_newfile_t *files;
+    uint8_t **buffers;
+    char (*names)[ZCC_CBMDOS_FILENAME_MAX + 1];
+    char **list;
+    int count;
+    int loaded = 0;
+    int written = -1;
+    bool ok = true;
+
+    list = list_read(dir, &count);
+    if (list == NULL) {
+        return -1;
+    }
+    files = zcc_calloc((size_t)count + 1, sizeof *files);
+    buffers = zcc_calloc((size_t)count + 1, sizeof *buffers);
+    names = zcc_calloc((size_t)count + 1, sizeof *names);
+
+    for (int i = 0; i < count && ok; i++) {
+        int type = zcc_pc64_type(list[i]);
+        char *path;
+        long size;
+        size_t len = 0;
+
+        if (type < 0) {
+            continue;
+        }
+        path = path_join(dir, list[i]);
+        if (type == ZCC_CBMDOS_FILETYPE_REL) {
+            fprintf(stderr, "%s: skipped, REL files aren't supported.\n", path);
+            zcc_free(path);
+            continue;
+        }
+        size = zcc_fread_alloc(&buffers[loaded], path);
+        if (size < ZCC_PC64_HEADER_SIZE
+                || memcmp(buffers[loaded], ZCC_PC64_MAGIC, ZCC_PC64_MAGIC_SIZE) != 0) {
+            if (size >= 0) {
+                zcc_errno = ZCC_ERR_INVALID_IMAGE;
+                zcc_free(buffers[loaded]);
+            }
+            fprintf(stderr, "%s: %s\n", path, zcc_strerror(zcc_errno));
+            ok = false;
+        } else {
+            const uint8_t *name = buffers[loaded] + ZCC_PC64_FILENAME;
+
+            while (len < ZCC_CBMDOS_FILENAME_MAX && name[len] != 0) {
+                len++;
+            }
+            zcc_pet_to_asc_str(names[loaded], name, len);
+            files[loaded].name = names[loaded];
+            files[loaded].type = (zcc_cbmdos_filetype_t)type;
+            files[loaded].data = buffers[loaded] + ZCC_PC64_HEADER_SIZE;
+            files[loaded].size = (size_t)size - ZCC_PC64_HEADER_SIZE;
+            if (verbose) {
+                printf("%s: %ld bytes\n", path, (long)files[loaded].size);
+            }
+            loaded++;
+        }
+        zcc_free(path);
+    }
+
+    if (ok) {
+        written = zcc_d64_write_files(d64, files, loaded);
+        if (written < loaded) {
+            written = -1;
+        }
+    }
+
+    for (int i = 0; i < loaded; i++) {
+        zcc_free(buffers[i]);
+    }
+    zcc_free(buffers);
+    zcc_free(names);
+    zcc_free(files);
+    list_free(list, count);
+    return written;
+}
+
+
+/** \brief  Export the files of image \a path to PC64 files
+ *
+ * The files are written to a directory next to the image, named after the
+ * image without its extension.
+ *
+ * \param[in]   path    host path of the image
+ * \param[in]   threads number of worker threads (0 = number of CPUs)
+ * \param[in]   verbose list files exported on stdout
+ *
+ * \return  bool
+ */
+static bool export_image(const char *path, int threads, bool verbose)
+{
+    zcc_d64_t d64;
+    char *dir = zcc_strdup(path);
+    char *ext = strrchr(dir, '.');
+    int count = -1;
+
+    zcc_d64_init(&d64);
+    if (ext == NULL || ext == dir || strchr(ext, '/') != NULL) {
+        /* no extension to drop for the directory name */
+        zcc_errno = ZCC_ERR_INVALID_FILENAME;
+    } else {
+        *ext = '\0';
+        if (!zcc_d64_read(&d64, path, 0)) {
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        } else if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+            zcc_errno = ZCC_ERR_IO;
+        } else {
+            count = zcc_d64_extract_pc64(&d64, dir, threads, verbose);
+        }
+    }
+
+    if (count < 0) {
+        fprintf(stderr, "%s: %s\n", path, zcc_strerror(zcc_errno));
+    } else {
+        printf("%s -> %s/ (%d files)\n", path, dir, count);
+    }
+    zcc_d64_free(&d64);
+    zcc_free(dir);
+    return count >= 0;
+}
+
+
+/** \brief  Export disk images to PC64 files in bulk
+ *
+ * \a path is either a disk image or a directory, which is searched
+ * recursively for images (*.d64, *.d71, *.d81). The files of each image are
+ * exported to a directory next to the image, named after the image without
+ * its extension.
+ *
+ * \param[in]   path    host path of an image or a directory
+ * \param[in]   threads number of worker threads per image (0 = number of CPUs)
+ * \param[in]   verbose list files exported on stdout
+ *
+ * \return  number of images exported, or -1 when one or more images failed
+ * \throw   ZCC_ERR_IO
+ */
+int zcc_pc64_export_tree(const char *path, int threads, bool verbose)
+{
+    char **list;
+    int count;
+    int exported = 0;
+    bool failed = false;
+
+    if (!path_is_dir(path)) {
+        return export_image(path, threads, verbose) ? 1 : -1;
+    }
+    list = list_read(path, &count);
+    if (list == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        char *child = path_join(path, list[i]);
+        int result = 0;
+
+        if (path_is_dir(child)) {
+            result = zcc_pc64_export_tree(child, threads, verbose);
+        } else if (path_is_image(child)) {
+            result = export_image(child, threads, verbose) ? 1 : -1;
+        }
+        if (result < 0) {
+            failed = true;
+        } else {
+            exported += result;
+        }
+        zcc_free(child);
+    }
+    list_free(list, count);
+    return failed ? -1 : exported;
+}
+
+
+/** \brief  Import directories of PC64 files into D64 images in bulk
+ *
+ * \a path and its subdirectories are searched for PC64 files. The files in
+ * each directory that has them are written to a D64 image next to the
+ * directory, named after the directory with a ".d64" extension, which is
+ * also used as disk name.
+ *
+ * A directory created by zcc_pc64_export_tree() sits next to the image it was
+ * exported from, so unless \a overwrite is set a directory is skipped with an
+ * error when an image (*.d64, *.d71, *.d81) named after it exists already.
+ *
+ * \param[in]   path        host directory
+ * \param[in]   overwrite   replace existing images
+ * \param[in]   verbose     list files imported on stdout
+ *
+ * \return  number of images written, or -1 when one or more images failed
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_FILE_EXISTS
+ */
+int zcc_pc64_import_tree(const char *path, bool overwrite, bool verbose)
+{
+    char **list;
+    char *dir = zcc_strdup(path);
+    size_t len = strlen(dir);
+    int count;
+    int images = 0;
+    bool has_pc64 = false;
+    bool failed = false;
+
+    /* drop trailing slashes, the image name is derived from the path */
+    while (len > 1 && dir[len - 1] == '/') {
+        dir[--len] = '\0';
+    }
+    list = list_read(dir, &count);
+    if (list == NULL) {
+        fprintf(stderr, "%s: %s\n", dir, zcc_strerror(zcc_errno));
+        zcc_free(dir);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        char *child = path_join(dir, list[i]);
+
+        if (path_is_dir(child)) {
+            int result = zcc_pc64_import_tree(child, overwrite, verbose);
+
+            if (result < 0) {
+                failed = true;
+            } else {
+                images += result;
+            }
+        } else if (zcc_pc64_type(list[i]) >= 0) {
+            has_pc64 = true;
+        }
+        zcc_free(child);
+    }
+    list_free(list, count);
+
+    if (has_pc64 && !overwrite) {
+        char *existing = path_image_of_dir(dir);
+
+        if (existing != NULL) {
+            zcc_errno = ZCC_ERR_FILE_EXISTS;
+            fprintf(stderr, "%s: %s, not importing %s/\n",
+                    existing, zcc_strerror(zcc_errno), dir);
+            zcc_free(existing);
+            has_pc64 = false;
+            failed = true;
+        }
+    }
+    if (has_pc64) {
+        zcc_d64_t d64;
+        char *image = zcc_malloc(len + 5);
+        char *name = zcc_strdup(dir);
+        int written;
+
+        snprintf(image, len + 5, "%s.d64", dir);
+        zcc_d64_init(&d64);
+        zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+        zcc_d64_format(&d64, zcc_basename(name), "00");
+        written = zcc_pc64_import(&d64, dir, verbose);
+        if (written < 0 || !zcc_d64_write(&d64, image)) {
+            fprintf(stderr, "%s: %s\n", image, zcc_strerror(zcc_errno));
+            failed = true;
+        } else {
+            printf("%s/ -> %s (%d files)\n", dir, image, written);
+            images++;
+        }
+        zcc_d64_free(&d64);
+        zcc_free(name);
+        zcc_free(image);
+    }
+    zcc_free(dir);
+    return failed ? -1 : images;
+}
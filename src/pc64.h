@@ -0,0 +1,95 @@
+/** \file   pc64.h
+ * \brief   PC64 (P00) container handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_PC64_H
+#define ZCC_PC64_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbmdos.h"
+#include "d64.h"
+
+
+/** \brief  Signature at the start of a PC64 file, including its terminator
+ */
+#define ZCC_PC64_MAGIC          "C64File"
+
+/** \brief  Size of the signature, including its terminator
+ */
+#define ZCC_PC64_MAGIC_SIZE     8
+
+/** \brief  Offset of the PETSCII filename, padded with 0x00
+ */
+#define ZCC_PC64_FILENAME       0x08
+
+/** \brief  Offset of the record size of REL files
+ */
+#define ZCC_PC64_RECORD_SIZE    0x19
+
+/** \brief  Size of the PC64 header, the file data follows it
+ */
+#define ZCC_PC64_HEADER_SIZE    0x1a
+
+/** \brief  Number of PC64 files that can share a base name (x00-x99)
+ */
+#define ZCC_PC64_COPIES_MAX     100
+
+/** \brief  Size of a host filename buffer for a PC64 file
+ *
+ * Filename, '.', type letter, two digits and terminator
+ */
+#define ZCC_PC64_NAME_MAX       (ZCC_CBMDOS_FILENAME_MAX + 4 + 1)
+
+
+/** \brief  Set of host filenames used in a directory
+ *
+ * Open addressing hash set of filenames, compared ignoring case so the
+ * result is also valid on case-insensitive file systems.
+ */
+typedef struct zcc_pc64_names_s {
+    char ** slots;  /**< filenames, `NULL` for unused slots */
+    size_t  size;   /**< number of slots, a power of two */
+    size_t  count;  /**< number of filenames in the set */
+} zcc_pc64_names_t;
+
+
+void zcc_pc64_header(uint8_t *head, const uint8_t *name, int record_size);
+int  zcc_pc64_type(const char *path);
+
+void zcc_pc64_names_init(zcc_pc64_names_t *names);
+void zcc_pc64_names_free(zcc_pc64_names_t *names);
+bool zcc_pc64_names_add(zcc_pc64_names_t *names, const char *name);
+bool zcc_pc64_names_scan(zcc_pc64_names_t *names, const char *dir);
+bool zcc_pc64_name(zcc_pc64_names_t *names,
+                   char *dest,
+                   const uint8_t *name,
+                   zcc_cbmdos_filetype_t type);
+
+int  zcc_pc64_import(zcc_d64_t *d64, const char *dir, bool verbose);
+int  zcc_pc64_export_tree(const char *path, int threads, bool verbose);
+int  zcc_pc64_import_tree(const char *path, bool overwrite, bool verbose);
+
+#endif
@@ -0,0 +1,207 @@
+/** \file   pool.c
+ * \brief   Reusable image and slice buffers
+ *
+ * Converting a zipdisk archive needs a D64 image buffer and up to five slice
+ * buffers. Allocating (and zero-filling) those for every disk is wasteful for
+ * batch conversion, so a pool can be attached to the D64 and zipdisk handles:
+ * buffers released by their free() functions are then handed back to the pool
+ * and reused for the next disk.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mem.h"
+#include "d64.h"
+
+#include "pool.h"
+
+
+/** \brief  Size of a pooled D64 buffer
+ *
+ * Large enough to hold any D64 type, including error info
+ */
+#define POOL_D64_SIZE   ZCC_D64_SIZE_EXTENDED_ERRORS
+
+
+/** \brief  Initialize \a pool for use
+ *
+ * \param[out]  pool    buffer pool
+ */
+void zcc_pool_init(zcc_pool_t *pool)
+{
+    for (int i = 0; i < ZCC_POOL_D64_MAX; i++) {
+        pool->d64_buffers[i] = NULL;
+    }
+    pool->d64_count = 0;
+    for (int i = 0; i < ZCC_POOL_SLICE_MAX; i++) {
+        pool->slice_buffers[i] = NULL;
+        pool->slice_sizes[i] = 0;
+    }
+    pool->slice_count = 0;
+    pool->slice_size_max = 0;
+    pool->heap_allocs = 0;
+}
+
+
+/** \brief  Free all idle buffers in \a pool
+ *
+ * Buffers still in use by D64 or zipdisk handles are not touched, those will
+ * be freed normally if their handles are freed after the pool.
+ *
+ * \param[in,out]   pool    buffer pool
+ */
+void zcc_pool_free(zcc_pool_t *pool)
+{
+    for (int i = 0; i < pool->d64_count; i++) {
+        zcc_free(pool->d64_buffers[i]);
+        pool->d64_buffers[i] = NULL;
+    }
+    pool->d64_count = 0;
+    for (int i = 0; i < pool->slice_count; i++) {
+        zcc_free(pool->slice_buffers[i]);
+        pool->slice_buffers[i] = NULL;
+        pool->slice_sizes[i] = 0;
+    }
+    pool->slice_count = 0;
+}
+
+
+/** \brief  Get a D64 image buffer from \a pool
+ *
+ * If the pool has an idle buffer, that buffer is returned as-is and
+ * \a recycled is set to `true`: the caller is responsible for clearing any
+ * data it doesn't overwrite (see zcc_d64_clear_unwritten()). Otherwise a new
+ * zeroed-out buffer is allocated.
+ *
+ * \param[in,out]   pool        buffer pool
+ * \param[out]      recycled    buffer contains stale data
+ *
+ * \return  buffer of at least #ZCC_D64_SIZE_EXTENDED_ERRORS bytes
+ */
+uint8_t *zcc_pool_d64_get(zcc_pool_t *pool, bool *recycled)
+{
+    if (pool->d64_count > 0) {
+        *recycled = true;
+        return pool->d64_buffers[--pool->d64_count];
+    }
+    *recycled = false;
+    pool->heap_allocs++;
+    return zcc_calloc(POOL_D64_SIZE, 1LU);
+}
+
+
+/** \brief  Return D64 image buffer \a data to \a pool
+ *
+ * If the pool is full, the buffer is freed.
+ *
+ * \param[in,out]   pool    buffer pool
+ * \param[in]       data    buffer obtained with zcc_pool_d64_get()
+ */
+void zcc_pool_d64_put(zcc_pool_t *pool, uint8_t *data)
+{
+    if (data == NULL) {
+        return;
+    }
+    if (pool->d64_count < ZCC_POOL_D64_MAX) {
+        pool->d64_buffers[pool->d64_count++] = data;
+    } else {
+        zcc_free(data);
+    }
+}
+
+
+/** \brief  Register a slice of \a size bytes with \a pool
+ *
+ * Used to keep track of the largest slice seen, so fresh slice buffers can be
+ * allocated at a size that most likely won't require resizing later.
+ *
+ * \param[in,out]   pool    buffer pool
+ * \param[in]       size    slice size
+ */
+void zcc_pool_slice_seen(zcc_pool_t *pool, size_t size)
+{
+    if (size > pool->slice_size_max) {
+        pool->slice_size_max = size;
+    }
+}
+
+
+/** \brief  Get a slice buffer from \a pool
+ *
+ * The buffer is not cleared. Buffers are sized to the largest slice seen so
+ * far: an idle buffer smaller than that is replaced, and if no idle buffer is
+ * available a new one is allocated (unless no slice has been seen yet, in
+ * which case `NULL` is returned and the caller's reader will allocate).
+ *
+ * \param[in,out]   pool        buffer pool
+ * \param[out]      capacity    size of the buffer returned
+ *
+ * \return  slice buffer or `NULL`
+ */
+uint8_t *zcc_pool_slice_get(zcc_pool_t *pool, size_t *capacity)
+{
+    if (pool->slice_count > 0) {
+        pool->slice_count--;
+        if (pool->slice_sizes[pool->slice_count] >= pool->slice_size_max) {
+            *capacity = pool->slice_sizes[pool->slice_count];
+            return pool->slice_buffers[pool->slice_count];
+        }
+        /* too small, no need to preserve contents */
+        zcc_free(pool->slice_buffers[pool->slice_count]);
+    }
+    *capacity = pool->slice_size_max;
+    if (pool->slice_size_max == 0) {
+        return NULL;
+    }
+    pool->heap_allocs++;
+    return zcc_malloc(pool->slice_size_max);
+}
+
+
+/** \brief  Return slice buffer \a data of \a capacity bytes to \a pool
+ *
+ * If the pool is full, the buffer is freed.
+ *
+ * \param[in,out]   pool        buffer pool
+ * \param[in]       data        slice buffer
+ * \param[in]       capacity    size of \a data
+ */
+void zcc_pool_slice_put(zcc_pool_t *pool, uint8_t *data, size_t capacity)
+{
+    if (data == NULL) {
+        return;
+    }
+    zcc_pool_slice_seen(pool, capacity);
+    if (pool->slice_count < ZCC_POOL_SLICE_MAX) {
+        pool->slice_buffers[pool->slice_count] = data;
+        pool->slice_sizes[pool->slice_count] = capacity;
+        pool->slice_count++;
+    } else {
+        zcc_free(data);
+    }
+}
@@ -0,0 +1,80 @@
+/** \file   pool.h
+ * \brief   Reusable image and slice buffers - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_POOL_H
+#define ZCC_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/** \brief  Maximum number of idle D64 image buffers kept in a pool
+ */
+#define ZCC_POOL_D64_MAX    4
+
+/** \brief  Maximum number of idle slice buffers kept in a pool
+ *
+ * Enough for two complete zipdisk/sixpack archives
+ */
+#define ZCC_POOL_SLICE_MAX  12
+
+
+/** \brief  Buffer pool handle
+ *
+ * Keeps buffers released by zcc_d64_free() and zcc_zipdisk_free() around so
+ * a batch job can reuse them for the next disk instead of going back to the
+ * heap for every image.
+ *
+ * D64 buffers are always allocated large enough for a 40-track image with
+ * error info, so 35-track and 40-track images can share them. Slice buffers grow to the
+ * largest slice seen so far.
+ */
+typedef struct zcc_pool_s {
+    uint8_t *   d64_buffers[ZCC_POOL_D64_MAX];      /**< idle D64 buffers */
+    int         d64_count;                          /**< number of idle D64
+                                                         buffers */
+    uint8_t *   slice_buffers[ZCC_POOL_SLICE_MAX];  /**< idle slice buffers */
+    size_t      slice_sizes[ZCC_POOL_SLICE_MAX];    /**< capacity of each idle
+                                                         slice buffer */
+    int         slice_count;                        /**< number of idle slice
+                                                         buffers */
+    size_t      slice_size_max;                     /**< largest slice seen */
+    unsigned long heap_allocs;                      /**< number of buffers
+                                                         obtained from the
+                                                         heap (statistics) */
+} zcc_pool_t;
+
+
+void     zcc_pool_init(zcc_pool_t *pool);
+void     zcc_pool_free(zcc_pool_t *pool);
+
+uint8_t *zcc_pool_d64_get(zcc_pool_t *pool, bool *recycled);
+void     zcc_pool_d64_put(zcc_pool_t *pool, uint8_t *data);
+
+uint8_t *zcc_pool_slice_get(zcc_pool_t *pool, size_t *capacity);
+void     zcc_pool_slice_put(zcc_pool_t *pool, uint8_t *data, size_t capacity);
+void     zcc_pool_slice_seen(zcc_pool_t *pool, size_t size);
+
+#endif
@@ -36,48 +36,66 @@
 
 
 
-/** \brief  Decode run-length encoded data
+/** \brief  Generate RLE decoder for blocks of \a SIZE bytes
  *
- * \param[out]  dest    destination of RLE data (use `NULL` to not
- *                      copy data, useful for debugging)
+ * The generated function zcc_rle_decode_SIZE() decodes directly into its
+ * destination. A run is the 'run' byte followed by a count and the byte to
+ * repeat; a count of 0 yields a single byte. The block size being constant,
+ * each run is checked against it once and written with a single memset().
+ *
+ * \param[in]   SIZE    decoded block size in bytes
+ */
+#define RLE_DECODER(SIZE) \
+int zcc_rle_decode_##SIZE(uint8_t *dest, const uint8_t *src, int run, int len) \
+{ \
+    int s = 0;  /* source index */ \
+    int b = 0;  /* destination index */ \
+\
+    while (s < len) { \
+        if (src[s] == run) { \
+            int count = src[s + 1] > 0 ? src[s + 1] : 1; \
+\
+            if (s + 2 >= len || b + count > (SIZE)) { \
+                break; \
+            } \
+            memset(dest + b, src[s + 2], (size_t)count); \
+            b += count; \
+            s += 3; \
+        } else { \
+            if (b == (SIZE)) { \
+                break; \
+            } \
+            dest[b++] = src[s++]; \
+        } \
+    } \
+    if (b != (SIZE)) { \
+        zcc_errno = ZCC_ERR_RLE; \
+    } \
+    return b; \
+}
+
+
+/** \brief  Decode run-length encoded data into a 256-byte block
+ *
+ * \param[out]  dest    destination, 256 bytes
  * \param[in]   src     RLE data
  * \param[in]   run     RLE 'run' byte
  * \param[in]   len     number of bytes to decode of \a src
  *
- * \return  size of decode data (should be 256)
+ * \return  size of decoded data (should be 256)
  * \throw   ZCC_ERR_RLE
  */
-int zcc_rle_decode(uint8_t *dest, const uint8_t *src, int run, int len)
-{
-    uint8_t buffer[256];
-    int s = 0;  /* source index */
-    int b = 0;  /* buffer index */
-
-    memset(buffer, 0, sizeof(buffer));
-
-    while (s < len && b < 256) {
-        if (src[s] == run) {
-            /* run */
-            int r = src[s + 1];
-            while (--r > 0 && b < 256) {
-                buffer[b++] = src[s + 2];
-            }
-            s += 2;
-        } else {
-            buffer[b++] = src[s++];
-        }
-    }
-
-    if (b == 256) {
-        if (dest != NULL) {
-            memcpy(dest, buffer, 256);
-        }
-    } else {
-        zcc_errno = ZCC_ERR_RLE;
-    }
+RLE_DECODER(256)
 
-    /* debug */
-    zcc_hexdump(buffer, 256, 0);
 
-    return b;
-}
+/** \brief  Decode run-length encoded data into a 254-byte block
+ *
+ * \param[out]  dest    destination, 254 bytes
+ * \param[in]   src     RLE data
+ * \param[in]   run     RLE 'run' byte
+ * \param[in]   len     number of bytes to decode of \a src
+ *
+ * \return  size of decoded data (should be 254)
+ * \throw   ZCC_ERR_RLE
+ */
+RLE_DECODER(254)
@@ -30,7 +30,8 @@
 #include <stdbool.h>
 
 
-int zcc_rle_decode(uint8_t *dest, const uint8_t *src, int run, int len);
+int zcc_rle_decode_256(uint8_t *dest, const uint8_t *src, int run, int len);
+int zcc_rle_decode_254(uint8_t *dest, const uint8_t *src, int run, int len);
 
 
 #endif
@@ -0,0 +1,488 @@
+/** \file   sixpack.c
+ * \brief   SixPack zipcode handling
+ *
+ * SixPack archives contain a low-level copy of a disk: the GCR-encoded sector
+ * headers and data blocks of each track, spread over six files '1!!' through
+ * '6!!'. Decoding them verifies the header and data block checksums of each
+ * sector, the resulting error codes are kept per block. Conversion to G64
+ * copies the GCR data as is, adding only the sync marks and gaps.
+ *
+ * See doc/reference/formats/zip_six.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "io.h"
+#include "gcr.h"
+#include "d64.h"
+#include "g64.h"
+
+#include "sixpack.h"
+
+
+/** \brief  First track of each file of an archive
+ *
+ * The last file runs up to the last track of the archive.
+ */
+static const int part_tracks[ZCC_SIXPACK_PART_MAX] = {
+    1, 7, 13, 19, 26, 33
+};
+
+
+/** \brief  Build the order in which the data blocks of a track are stored
+ *
+ * Slot 0 holds the data block of header group 0, each following slot the
+ * group 8 positions further, or the next unused group when that one is taken.
+ *
+ * \param[out]  order   header group index for each slot
+ * \param[in]   count   number of sectors stored for the track
+ */
+static void track_order(int *order, int count)
+{
+    bool used[ZCC_D64_SECTOR_MAX + 1] = { false };
+    int pos = 0;
+
+    for (int slot = 0; slot < count; slot++) {
+        while (used[pos]) {
+            pos = (pos + 1) % count;
+        }
+        used[pos] = true;
+        order[slot] = pos;
+        pos = (pos + 8) % count;
+    }
+}
+
+
+/** \brief  Decode sector header group \a group of track descriptor \a desc
+ *
+ * Invalid GCR codes aren't reported by themselves: they decode as 0 and then
+ * show up in the checksum, unless they're in the filler bytes, which the
+ * drive ignores as well.
+ *
+ * \param[out]  header  decoded header (#ZCC_SIXPACK_HEADER_DATA bytes)
+ * \param[in]   desc    track descriptor block
+ * \param[in]   group   header group index
+ *
+ * \return  error info code of the header, ignoring the disk ID
+ */
+static zcc_d64_error_t header_decode(uint8_t *header,
+                                     const uint8_t *desc,
+                                     int group)
+{
+    zcc_gcr_decode(header, desc + group * ZCC_GCR_HEADER_SIZE,
+                   ZCC_GCR_HEADER_SIZE / ZCC_GCR_GROUP_SIZE);
+
+    if (header[0] != ZCC_GCR_HEADER_ID) {
+        return ZCC_D64_ERROR_HEADER;
+    }
+    if (header[1] != (header[2] ^ header[3] ^ header[4] ^ header[5])) {
+        return ZCC_D64_ERROR_HEADER_CHECKSUM;
+    }
+    return ZCC_D64_ERROR_OK;
+}
+
+
+/** \brief  Decode data block stored at \a src
+ *
+ * Like header_decode(), invalid GCR codes only count through the checksum.
+ *
+ * \param[out]  sector  decoded sector (#ZCC_SIXPACK_SECTOR_DATA bytes)
+ * \param[in]   src     GCR data as stored in the archive, with the overflow
+ *                      bytes in front
+ *
+ * \return  error info code of the data block
+ */
+static zcc_d64_error_t sector_decode(uint8_t *sector, const uint8_t *src)
+{
+    uint8_t gcr[ZCC_GCR_DATA_SIZE];
+    uint8_t checksum = 0;
+
+    memcpy(gcr, src + ZCC_SIXPACK_SECTOR_OVERFLOW,
+           ZCC_GCR_DATA_SIZE - ZCC_SIXPACK_SECTOR_OVERFLOW);
+    memcpy(gcr + ZCC_GCR_DATA_SIZE - ZCC_SIXPACK_SECTOR_OVERFLOW, src,
+           ZCC_SIXPACK_SECTOR_OVERFLOW);
+    zcc_gcr_decode(sector, gcr, ZCC_SIXPACK_SECTOR_DATA / ZCC_GCR_GROUP_DATA);
+
+    if (sector[0] != ZCC_GCR_DATA_ID) {
+        return ZCC_D64_ERROR_DATA;
+    }
+    for (int i = 1; i <= ZCC_D64_BLOCK_SIZE_RAW; i++) {
+        checksum ^= sector[i];
+    }
+    if (checksum != sector[ZCC_D64_BLOCK_SIZE_RAW + 1]) {
+        return ZCC_D64_ERROR_DATA_CHECKSUM;
+    }
+    return ZCC_D64_ERROR_OK;
+}
+
+
+/** \brief  Get master disk ID from the header of 18/0
+ *
+ * \param[in]   six     SixPack handle
+ * \param[out]  id      disk ID as stored in sector headers (ID2, ID1)
+ *
+ * \return  false if the header of 18/0 is missing or broken
+ */
+static bool master_id(const zcc_sixpack_t *six, uint8_t *id)
+{
+    const uint8_t *desc = six->tracks[ZCC_D64_BAM_TRACK];
+    int count = desc[ZCC_SIXPACK_DESC_COUNT];
+
+    for (int group = 0; group < count; group++) {
+        uint8_t header[ZCC_SIXPACK_HEADER_DATA];
+
+        if (header_decode(header, desc, group) == ZCC_D64_ERROR_OK
+                && header[2] == ZCC_D64_BAM_SECTOR
+                && header[3] == ZCC_D64_BAM_TRACK) {
+            id[0] = header[4];
+            id[1] = header[5];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief  Decode \a track of \a six into \a d64
+ *
+ * Sectors without a header are left zeroed and flagged as error 20, all
+ * sectors of an empty track as error 21.
+ *
+ * \param[in,out]   six     SixPack handle
+ * \param[in,out]   d64     D64 image
+ * \param[in]       track   track number
+ * \param[in]       id      master disk ID (`NULL` to skip the ID check)
+ */
+static void track_decode(zcc_sixpack_t *six,
+                         zcc_d64_t *d64,
+                         int track,
+                         const uint8_t *id)
+{
+    const uint8_t *desc = six->tracks[track];
+    const uint8_t *data = desc + ZCC_SIXPACK_DESC_SIZE;
+    uint8_t *errors = six->errors + zcc_d64_block_index(track, 0);
+    int sectors = zcc_d64_track_max_sector(track);
+    int count = desc[ZCC_SIXPACK_DESC_COUNT];
+    int group_sector[ZCC_D64_SECTOR_MAX + 1];
+    int order[ZCC_D64_SECTOR_MAX + 1];
+    uint32_t seen = 0;
+
+    for (int sector = 0; sector < sectors; sector++) {
+        errors[sector] = count == 0 ? ZCC_D64_ERROR_SYNC : ZCC_D64_ERROR_HEADER;
+    }
+
+    /* headers: map each group to its sector */
+    for (int group = 0; group < count; group++) {
+        uint8_t header[ZCC_SIXPACK_HEADER_DATA];
+        zcc_d64_error_t error = header_decode(header, desc, group);
+        int sector = header[2];
+
+        group_sector[group] = -1;
+        if (header[3] != track || sector >= sectors
+                || (seen & (1U << sector)) != 0) {
+            continue;
+        }
+        seen |= 1U << sector;
+        if (error == ZCC_D64_ERROR_OK && id != NULL
+                && (header[4] != id[0] || header[5] != id[1])) {
+            error = ZCC_D64_ERROR_ID_MISMATCH;
+        }
+        errors[sector] = (uint8_t)error;
+        group_sector[group] = sector;
+    }
+
+    /* data blocks, in interleaved order */
+    track_order(order, count);
+    for (int slot = 0; slot < count; slot++) {
+        uint8_t block[ZCC_SIXPACK_SECTOR_DATA];
+        int sector = group_sector[order[slot]];
+        zcc_d64_error_t error;
+
+        if (sector < 0) {
+            continue;
+        }
+        error = sector_decode(block, data + slot * ZCC_GCR_DATA_SIZE);
+        if (errors[sector] == ZCC_D64_ERROR_OK) {
+            errors[sector] = (uint8_t)error;
+        }
+        zcc_d64_block_write(d64, block + 1, track, sector);
+    }
+
+    for (int sector = 0; sector < sectors; sector++) {
+        if (errors[sector] != ZCC_D64_ERROR_OK) {
+            six->bad_sectors++;
+        }
+    }
+}
+
+
+/** \brief  Initialize SixPack handle \a six
+ *
+ * \param[out]  six SixPack handle
+ */
+void zcc_sixpack_init(zcc_sixpack_t *six)
+{
+    for (int i = 0; i < ZCC_SIXPACK_PART_MAX; i++) {
+        six->parts[i].data = NULL;
+        six->parts[i].size = 0;
+    }
+    for (int t = 0; t <= ZCC_D64_TRACK_MAX_EXT; t++) {
+        six->tracks[t] = NULL;
+    }
+    six->track_max = 0;
+    memset(six->errors, ZCC_D64_ERROR_NONE, sizeof six->errors);
+    six->bad_sectors = 0;
+}
+
+
+/** \brief  Free memory used by the members of \a six
+ *
+ * \param[in,out]   six SixPack handle
+ */
+void zcc_sixpack_free(zcc_sixpack_t *six)
+{
+    for (int i = 0; i < ZCC_SIXPACK_PART_MAX; i++) {
+        if (six->parts[i].data != NULL) {
+            zcc_free(six->parts[i].data);
+        }
+    }
+    zcc_sixpack_init(six);
+}
+
+
+/** \brief  Locate the track descriptor blocks of \a six
+ *
+ * \param[in,out]   six SixPack handle
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ */
+static bool sixpack_index(zcc_sixpack_t *six)
+{
+    for (int i = 0; i < ZCC_SIXPACK_PART_MAX; i++) {
+        const zcc_sixpack_part_t *part = &six->parts[i];
+        int last = i < ZCC_SIXPACK_PART_MAX - 1
+            ? part_tracks[i + 1] - 1 : six->track_max;
+        size_t offset = ZCC_SIXPACK_HEADER_SIZE;
+
+        if (part->size < ZCC_SIXPACK_HEADER_SIZE
+                || part->data[0] != 0xff || part->data[1] != 0x03
+                || part->data[ZCC_SIXPACK_HEADER_TRACKS] != six->track_max + 1) {
+            zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+            return false;
+        }
+
+        for (int track = part_tracks[i]; track <= last; track++) {
+            int count;
+
+            if (offset + ZCC_SIXPACK_DESC_SIZE > part->size) {
+                zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+                return false;
+            }
+            count = part->data[offset + ZCC_SIXPACK_DESC_COUNT];
+            if (count > zcc_d64_track_max_sector(track)) {
+                zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+                return false;
+            }
+            six->tracks[track] = part->data + offset;
+            offset += ZCC_SIXPACK_DESC_SIZE + (size_t)count * ZCC_GCR_DATA_SIZE;
+            if (offset > part->size) {
+                zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Read SixPack archive containing file \a path
+ *
+ * \a path can be any of the six files, the others are found by replacing the
+ * digit in front of the '!!'.
+ *
+ * \param[in,out]   six     SixPack handle
+ * \param[in]       path    path to one of the files of the archive
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_INVALID_FILENAME
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ */
+bool zcc_sixpack_read(zcc_sixpack_t *six, const char *path)
+{
+    char *part_path;
+    char *base;
+    bool result = true;
+
+    zcc_sixpack_free(six);
+
+    part_path = zcc_strdup(path);
+    base = zcc_basename(part_path);
+    if (strlen(base) < 3 || base[0] < '1' || base[0] > '6'
+            || base[1] != '!' || base[2] != '!') {
+        zcc_errno = ZCC_ERR_INVALID_FILENAME;
+        zcc_free(part_path);
+        return false;
+    }
+
+    for (int i = 0; result && i < ZCC_SIXPACK_PART_MAX; i++) {
+        long size;
+
+        base[0] = (char)('1' + i);
+        size = zcc_fread_alloc(&six->parts[i].data, part_path);
+        if (size < 0) {
+            result = false;
+        } else {
+            six->parts[i].size = (size_t)size;
+        }
+    }
+    zcc_free(part_path);
+    if (!result) {
+        return false;
+    }
+
+    if (six->parts[0].size > ZCC_SIXPACK_HEADER_TRACKS) {
+        six->track_max = six->parts[0].data[ZCC_SIXPACK_HEADER_TRACKS] - 1;
+    }
+    if (six->track_max != ZCC_D64_TRACK_MAX
+            && six->track_max != ZCC_D64_TRACK_MAX_EXT) {
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+        return false;
+    }
+    return sixpack_index(six);
+}
+
+
+/** \brief  Decode SixPack archive \a six into \a d64
+ *
+ * Allocates a 35-track CBM DOS image or, for 40-track archives, a SpeedDOS
+ * image. The error code of each block is stored in \a six.
+ *
+ * \param[in,out]   six SixPack handle
+ * \param[out]      d64 D64 image
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_NULL
+ */
+bool zcc_sixpack_decode(zcc_sixpack_t *six, zcc_d64_t *d64)
+{
+    uint8_t id[2];
+    bool have_id;
+
+    if (six->track_max == 0) {
+        zcc_errno = ZCC_ERR_NULL;
+        return false;
+    }
+
+    zcc_d64_alloc(d64, six->track_max == ZCC_D64_TRACK_MAX
+                  ? ZCC_D64_TYPE_CBMDOS : ZCC_D64_TYPE_SPEEDDOS);
+    memset(six->errors, ZCC_D64_ERROR_NONE, sizeof six->errors);
+    six->bad_sectors = 0;
+
+    have_id = master_id(six, id);
+    for (int track = ZCC_D64_TRACK_MIN; track <= six->track_max; track++) {
+        track_decode(six, d64, track, have_id ? id : NULL);
+    }
+    zcc_debug("%d bad sectors", six->bad_sectors);
+    return true;
+}
+
+
+/** \brief  Copy the GCR data of \a six into G64 image \a g64
+ *
+ * The sectors of each track are laid out in the order of the headers in the
+ * track descriptor block, which is the order they were read from disk in,
+ * with the remaining space spread over the tail gaps. Nothing is decoded, so
+ * damaged headers and data blocks are kept as they are. Tracks without
+ * sectors are left without sync marks.
+ *
+ * \param[in]   six SixPack handle
+ * \param[out]  g64 G64 image
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_NULL
+ */
+bool zcc_sixpack_to_g64(const zcc_sixpack_t *six, zcc_g64_t *g64)
+{
+    if (six->track_max == 0) {
+        zcc_errno = ZCC_ERR_NULL;
+        return false;
+    }
+
+    zcc_g64_alloc(g64, six->track_max);
+    for (int track = ZCC_D64_TRACK_MIN; track <= six->track_max; track++) {
+        const uint8_t *desc = six->tracks[track];
+        const uint8_t *data = desc + ZCC_SIXPACK_DESC_SIZE;
+        int count = desc[ZCC_SIXPACK_DESC_COUNT];
+        int order[ZCC_D64_SECTOR_MAX + 1];
+        int slots[ZCC_D64_SECTOR_MAX + 1];
+        size_t size;
+        size_t gap;
+        uint8_t *dest;
+
+        if (count == 0) {
+            continue;
+        }
+        dest = zcc_g64_track(g64, track, &size);
+        gap = (size - (size_t)count * ZCC_G64_SECTOR_SIZE) / (size_t)count;
+
+        track_order(order, count);
+        for (int slot = 0; slot < count; slot++) {
+            slots[order[slot]] = slot;
+        }
+
+        for (int group = 0; group < count; group++) {
+            const uint8_t *src = data + slots[group] * ZCC_GCR_DATA_SIZE;
+
+            dest = zcc_g64_sector_frame(dest,
+                                        desc + group * ZCC_GCR_HEADER_SIZE);
+            /* the extra byte after the data block ends up in the tail gap */
+            memcpy(dest, src + ZCC_SIXPACK_SECTOR_OVERFLOW,
+                   ZCC_GCR_DATA_SIZE - ZCC_SIXPACK_SECTOR_OVERFLOW);
+            memcpy(dest + ZCC_GCR_DATA_SIZE - ZCC_SIXPACK_SECTOR_OVERFLOW, src,
+                   ZCC_SIXPACK_SECTOR_OVERFLOW);
+            dest += ZCC_GCR_DATA_SIZE - 1 + gap;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Show the blocks of \a six with errors
+ *
+ * Only valid after zcc_sixpack_decode().
+ *
+ * \param[in]   six SixPack handle
+ */
+void zcc_sixpack_dump_errors(const zcc_sixpack_t *six)
+{
+    zcc_d64_dump_errors(six->errors, six->track_max);
+}
@@ -0,0 +1,106 @@
+/** \file   sixpack.h
+ * \brief   SixPack zipcode handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_SIXPACK_H
+#define ZCC_SIXPACK_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "d64.h"
+#include "g64.h"
+
+
+/** \brief  Number of files of a SixPack archive ('1!!' through '6!!')
+ */
+#define ZCC_SIXPACK_PART_MAX    6
+
+/** \brief  Size of the header of each file
+ *
+ * $ff, $03, followed by the number of tracks plus one ($24 or $29)
+ */
+#define ZCC_SIXPACK_HEADER_SIZE 3
+
+/** \brief  Offset in a file of the number of tracks plus one
+ */
+#define ZCC_SIXPACK_HEADER_TRACKS   0x02
+
+/** \brief  Size of a track descriptor block
+ */
+#define ZCC_SIXPACK_DESC_SIZE   0x100
+
+/** \brief  Offset in a track descriptor block of the number of sectors stored
+ */
+#define ZCC_SIXPACK_DESC_COUNT  0xff
+
+/** \brief  Number of bytes of a decoded sector header
+ */
+#define ZCC_SIXPACK_HEADER_DATA 8
+
+/** \brief  Number of bytes of a decoded sector
+ *
+ * Data block descriptor, 256 bytes of data, checksum and two filler bytes
+ */
+#define ZCC_SIXPACK_SECTOR_DATA 260
+
+/** \brief  Number of GCR bytes of a sector stored in front of the rest
+ */
+#define ZCC_SIXPACK_SECTOR_OVERFLOW 70
+
+
+/** \brief  File of a SixPack archive
+ */
+typedef struct zcc_sixpack_part_s {
+    uint8_t *   data;   /**< file data */
+    size_t      size;   /**< file size */
+} zcc_sixpack_part_t;
+
+
+/** \brief  SixPack archive handle
+ */
+typedef struct zcc_sixpack_s {
+    zcc_sixpack_part_t  parts[ZCC_SIXPACK_PART_MAX];    /**< files */
+    int                 track_max;  /**< number of tracks (35 or 40) */
+    const uint8_t *     tracks[ZCC_D64_TRACK_MAX_EXT + 1];  /**< track
+                                                                 descriptor
+                                                                 blocks,
+                                                                 indexed by
+                                                                 track number
+                                                                 */
+    uint8_t             errors[ZCC_D64_BLOCKS_MAX]; /**< error info code per
+                                                         block, see
+                                                         zcc_d64_error_t */
+    int                 bad_sectors;    /**< number of blocks with errors */
+} zcc_sixpack_t;
+
+
+void zcc_sixpack_init(zcc_sixpack_t *six);
+void zcc_sixpack_free(zcc_sixpack_t *six);
+bool zcc_sixpack_read(zcc_sixpack_t *six, const char *path);
+bool zcc_sixpack_decode(zcc_sixpack_t *six, zcc_d64_t *d64);
+bool zcc_sixpack_to_g64(const zcc_sixpack_t *six, zcc_g64_t *g64);
+void zcc_sixpack_dump_errors(const zcc_sixpack_t *six);
+
+#endif
@@ -0,0 +1,337 @@
+/** \file   t64.c
+ * \brief   T64 tape container handling
+ *
+ * A T64 container has a 64-byte header followed by a directory of 32-byte
+ * entries and the data of the files, without their load addresses. Many
+ * containers have bogus end addresses (usually $c3c6), so the size of each
+ * file is derived from the offset of the file stored after it, only trusting
+ * the end address when it fits.
+ *
+ * See doc/reference/formats/t64.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "io.h"
+#include "petasc.h"
+#include "cbmdos.h"
+#include "d64.h"
+#include "d64write.h"
+
+#include "t64.h"
+
+
+/** \brief  Get 16-bit little endian value at \a p
+ *
+ * \param[in]   p   data
+ *
+ * \return  value
+ */
+static unsigned int get_le16(const uint8_t *p)
+{
+    return (unsigned int)(p[0] + p[1] * 256);
+}
+
+
+/** \brief  Translate PETSCII name \a pet to ASCII, dropping the padding
+ *
+ * \param[out]  asc     ASCII name, at least \a n + 1 bytes
+ * \param[in]   pet     PETSCII name, padded with spaces or 0xa0
+ * \param[in]   n       size of \a pet
+ */
+static void name_to_asc(char *asc, const uint8_t *pet, size_t n)
+{
+    while (n > 0 && (pet[n - 1] == 0x20 || pet[n - 1] == 0xa0)) {
+        n--;
+    }
+    zcc_pet_to_asc_str(asc, pet, n);
+}
+
+
+/** \brief  Compare the container offsets of two entries for qsort()
+ *
+ * \param[in]   p1  pointer to pointer to first entry
+ * \param[in]   p2  pointer to pointer to second entry
+ *
+ * \return  <0, 0 or >0
+ */
+static int entry_offset_cmp(const void *p1, const void *p2)
+{
+    const zcc_t64_entry_t *e1 = *(const zcc_t64_entry_t * const *)p1;
+    const zcc_t64_entry_t *e2 = *(const zcc_t64_entry_t * const *)p2;
+
+    if (e1->offset != e2->offset) {
+        return e1->offset < e2->offset ? -1 : 1;
+    }
+    return e1 < e2 ? -1 : e1 > e2;
+}
+
+
+/** \brief  Determine the size of the files in \a t64
+ *
+ * The entries are sorted by offset, each file runs up to the next offset or
+ * the end of the container. The end address is only used when it gives a
+ * size that fits, otherwise the file is counted in \c t64->fixed_sizes.
+ *
+ * \param[in,out]   t64 T64 handle
+ */
+static void t64_sizes(zcc_t64_t *t64)
+{
+    zcc_t64_entry_t **sorted;
+    int count = t64->entry_count;
+    int next = 0;
+
+    if (count == 0) {
+        return;
+    }
+    sorted = zcc_malloc((size_t)count * sizeof *sorted);
+    for (int i = 0; i < count; i++) {
+        sorted[i] = &t64->entries[i];
+    }
+    qsort(sorted, (size_t)count, sizeof *sorted, entry_offset_cmp);
+
+    for (int i = 0; i < count; i++) {
+        zcc_t64_entry_t *entry = sorted[i];
+        unsigned int start = get_le16(entry->load);
+        size_t limit;
+
+        /* files sharing an offset share the data up to the next offset */
+        if (next <= i) {
+            next = i + 1;
+            while (next < count && sorted[next]->offset == entry->offset) {
+                next++;
+            }
+        }
+        limit = (next < count ? sorted[next]->offset : t64->size)
+            - entry->offset;
+
+        if (entry->end > start && entry->end - start <= limit) {
+            entry->size = entry->end - start;
+        } else {
+            entry->size = limit;
+            t64->fixed_sizes++;
+        }
+        entry->data = t64->data + entry->offset;
+    }
+    zcc_free(sorted);
+}
+
+
+/** \brief  Parse header and directory of \a t64
+ *
+ * Free entries and memory snapshots are skipped.
+ *
+ * \param[in,out]   t64 T64 handle
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+static bool t64_parse(zcc_t64_t *t64)
+{
+    const uint8_t *data = t64->data;
+    size_t dir_end;
+    int used;
+
+    if (t64->size < ZCC_T64_HEADER_SIZE || memcmp(data, "C64", 3) != 0) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+
+    /* some tools only set the number of used entries */
+    t64->entry_max = (int)get_le16(data + ZCC_T64_ENTRY_MAX);
+    used = (int)get_le16(data + ZCC_T64_ENTRY_USED);
+    if (t64->entry_max < used) {
+        t64->entry_max = used;
+    }
+    dir_end = ZCC_T64_HEADER_SIZE + (size_t)t64->entry_max * ZCC_T64_DIRENT_SIZE;
+    if (dir_end > t64->size) {
+        zcc_errno = ZCC_ERR_INVALID_IMAGE;
+        return false;
+    }
+    name_to_asc(t64->name, data + ZCC_T64_TAPENAME, ZCC_T64_TAPENAME_LEN);
+
+    t64->entries = zcc_calloc((size_t)t64->entry_max + 1, sizeof *t64->entries);
+    for (int i = 0; i < t64->entry_max; i++) {
+        const uint8_t *dirent = data + ZCC_T64_HEADER_SIZE + i * ZCC_T64_DIRENT_SIZE;
+        zcc_t64_entry_t *entry = &t64->entries[t64->entry_count];
+        int filetype = dirent[ZCC_T64_DIRENT_FILETYPE];
+        size_t offset = get_le16(dirent + ZCC_T64_DIRENT_OFFSET)
+            + ((size_t)get_le16(dirent + ZCC_T64_DIRENT_OFFSET + 2) << 16);
+
+        if (dirent[ZCC_T64_DIRENT_C64S_TYPE] != ZCC_T64_C64S_NORMAL) {
+            continue;
+        }
+        if (offset < dir_end || offset > t64->size) {
+            zcc_errno = ZCC_ERR_INVALID_IMAGE;
+            return false;
+        }
+
+        name_to_asc(entry->name, dirent + ZCC_T64_DIRENT_FILENAME,
+                    ZCC_CBMDOS_FILENAME_MAX);
+        /* anything but a proper SEQ, PRG or USR type is loaded as PRG */
+        entry->type = ZCC_CBMDOS_FILETYPE_PRG;
+        if ((filetype & ZCC_CBMDOS_CLOSED_MASK)
+                && (filetype & ZCC_CBMDOS_FILETYPE_MASK) >= ZCC_CBMDOS_FILETYPE_SEQ
+                && (filetype & ZCC_CBMDOS_FILETYPE_MASK) <= ZCC_CBMDOS_FILETYPE_USR) {
+            entry->type = (zcc_cbmdos_filetype_t)(filetype & ZCC_CBMDOS_FILETYPE_MASK);
+        }
+        entry->load[0] = dirent[ZCC_T64_DIRENT_START];
+        entry->load[1] = dirent[ZCC_T64_DIRENT_START + 1];
+        entry->end = (uint16_t)get_le16(dirent + ZCC_T64_DIRENT_END);
+        entry->offset = offset;
+        t64->entry_count++;
+    }
+
+    t64_sizes(t64);
+    return true;
+}
+
+
+/** \brief  Initialize T64 handle \a t64
+ *
+ * \param[out]  t64 T64 handle
+ */
+void zcc_t64_init(zcc_t64_t *t64)
+{
+    t64->data = NULL;
+    t64->size = 0;
+    t64->name[0] = '\0';
+    t64->entry_max = 0;
+    t64->entries = NULL;
+    t64->entry_count = 0;
+    t64->fixed_sizes = 0;
+}
+
+
+/** \brief  Free memory used by the members of \a t64
+ *
+ * \param[in,out]   t64 T64 handle
+ */
+void zcc_t64_free(zcc_t64_t *t64)
+{
+    if (t64->data != NULL) {
+        zcc_free(t64->data);
+    }
+    if (t64->entries != NULL) {
+        zcc_free(t64->entries);
+    }
+    zcc_t64_init(t64);
+}
+
+
+/** \brief  Read T64 container \a path into \a t64
+ *
+ * The container is read in one go, the entries point into its data.
+ *
+ * \param[in,out]   t64     T64 handle
+ * \param[in]       path    path to T64 file
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_INVALID_IMAGE
+ */
+bool zcc_t64_read(zcc_t64_t *t64, const char *path)
+{
+    long size;
+
+    zcc_t64_free(t64);
+    size = zcc_fread_alloc(&t64->data, path);
+    if (size < 0) {
+        return false;
+    }
+    t64->size = (size_t)size;
+    if (!t64_parse(t64)) {
+        zcc_t64_free(t64);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Dump directory of \a t64 on stdout
+ *
+ * \param[in]   t64 T64 handle
+ */
+void zcc_t64_dump(const zcc_t64_t *t64)
+{
+    printf("tape name: \"%s\", %d/%d entries\n",
+            t64->name, t64->entry_count, t64->entry_max);
+    for (int i = 0; i < t64->entry_count; i++) {
+        const zcc_t64_entry_t *entry = &t64->entries[i];
+        unsigned int start = get_le16(entry->load);
+
+        printf("%-16s  %s  $%04x-$%04lx  offset $%06lx%s\n",
+                entry->name, zcc_cbmdos_filetype_str(entry->type),
+                start, (unsigned long)(start + entry->size),
+                (unsigned long)(entry->offset),
+                start + entry->size != entry->end ? "  (end address fixed)" : "");
+    }
+}
+
+
+/** \brief  Convert \a t64 to D64 image \a d64
+ *
+ * \a d64 must have been allocated with zcc_d64_alloc(), it gets formatted
+ * with the tape name. The data of each file is written into its block chain
+ * straight from the container.
+ *
+ * \param[in]       t64 T64 handle
+ * \param[in,out]   d64 D64 image
+ *
+ * \return  number of files written, less than \c t64->entry_count on error
+ * \throw   ZCC_ERR_DISK_FULL
+ * \throw   ZCC_ERR_DIR_FULL
+ */
+int zcc_t64_to_d64(const zcc_t64_t *t64, zcc_d64_t *d64)
+{
+    zcc_d64_newfile_t *files;
+    int written;
+
+    zcc_d64_format(d64, t64->name, "00");
+    if (t64->entry_count == 0) {
+        return 0;
+    }
+
+    files = zcc_calloc((size_t)t64->entry_count, sizeof *files);
+    for (int i = 0; i < t64->entry_count; i++) {
+        const zcc_t64_entry_t *entry = &t64->entries[i];
+
+        files[i].name = entry->name;
+        files[i].type = entry->type;
+        files[i].head = entry->load;
+        files[i].head_size = sizeof entry->load;
+        files[i].data = entry->data;
+        files[i].size = entry->size;
+    }
+    written = zcc_d64_write_files(d64, files, t64->entry_count);
+    zcc_free(files);
+    return written;
+}
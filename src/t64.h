@@ -0,0 +1,130 @@
+/** \file   t64.h
+ * \brief   T64 tape container handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_T64_H
+#define ZCC_T64_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbmdos.h"
+#include "d64.h"
+
+
+/** \brief  Size of the T64 header, the directory follows it
+ */
+#define ZCC_T64_HEADER_SIZE     0x40
+
+/** \brief  Offset in the header of the maximum number of directory entries
+ */
+#define ZCC_T64_ENTRY_MAX       0x22
+
+/** \brief  Offset in the header of the number of used directory entries
+ */
+#define ZCC_T64_ENTRY_USED      0x24
+
+/** \brief  Offset in the header of the tape name
+ */
+#define ZCC_T64_TAPENAME        0x28
+
+/** \brief  Length of the tape name, padded with spaces
+ */
+#define ZCC_T64_TAPENAME_LEN    24
+
+/** \brief  Size of a directory entry
+ */
+#define ZCC_T64_DIRENT_SIZE     0x20
+
+/** \brief  Offset in a directory entry of the C64s file type
+ */
+#define ZCC_T64_DIRENT_C64S_TYPE    0x00
+
+/** \brief  Offset in a directory entry of the 1541 file type
+ */
+#define ZCC_T64_DIRENT_FILETYPE 0x01
+
+/** \brief  Offset in a directory entry of the start (load) address
+ */
+#define ZCC_T64_DIRENT_START    0x02
+
+/** \brief  Offset in a directory entry of the end address
+ */
+#define ZCC_T64_DIRENT_END      0x04
+
+/** \brief  Offset in a directory entry of the offset of the file data
+ */
+#define ZCC_T64_DIRENT_OFFSET   0x08
+
+/** \brief  Offset in a directory entry of the filename
+ */
+#define ZCC_T64_DIRENT_FILENAME 0x10
+
+/** \brief  C64s file type of a normal tape file
+ *
+ * Type 0 is a free entry, the others are memory snapshots.
+ */
+#define ZCC_T64_C64S_NORMAL     0x01
+
+
+/** \brief  File in a T64 container
+ */
+typedef struct zcc_t64_entry_s {
+    char                    name[ZCC_CBMDOS_FILENAME_MAX + 1];  /**< ASCII
+                                                                     filename
+                                                                     */
+    zcc_cbmdos_filetype_t   type;       /**< CBM DOS file type */
+    uint8_t                 load[2];    /**< load address, the first two
+                                             bytes of the file */
+    uint16_t                end;        /**< end address from the
+                                             directory */
+    const uint8_t *         data;       /**< file data after the load address,
+                                             points into the container */
+    size_t                  size;       /**< size of \c data in bytes */
+    size_t                  offset;     /**< offset of \c data in the
+                                             container */
+} zcc_t64_entry_t;
+
+
+/** \brief  T64 container handle
+ */
+typedef struct zcc_t64_s {
+    uint8_t *           data;       /**< container data */
+    size_t              size;       /**< size of \c data */
+    char                name[ZCC_T64_TAPENAME_LEN + 1]; /**< tape name */
+    int                 entry_max;  /**< directory size in entries */
+    zcc_t64_entry_t *   entries;    /**< files, in directory order */
+    int                 entry_count;    /**< number of files */
+    int                 fixed_sizes;    /**< number of files with a wrong end
+                                             address */
+} zcc_t64_t;
+
+
+void zcc_t64_init(zcc_t64_t *t64);
+void zcc_t64_free(zcc_t64_t *t64);
+bool zcc_t64_read(zcc_t64_t *t64, const char *path);
+void zcc_t64_dump(const zcc_t64_t *t64);
+int  zcc_t64_to_d64(const zcc_t64_t *t64, zcc_d64_t *d64);
+
+#endif
@@ -0,0 +1,113 @@
+/** \file   zipcode.c
+ * \brief   Zipcode block codec
+ *
+ * Decoding of single zipcoded blocks, shared by the diskpacked (256-byte
+ * sectors) and filepacked (254-byte sectors) formats. The functions for each
+ * sector size are generated from one macro, so the size is a constant in each
+ * of them and the copy, fill and RLE paths don't check it at runtime.
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "errors.h"
+#include "rle.h"
+#include "zipdisk.h"
+
+#include "zipcode.h"
+
+
+/** \brief  Generate codec functions for sectors of \a SIZE bytes
+ *
+ * Generates:
+ *
+ * - zcc_zipcode_block_size_SIZE(): get the size in bytes of a zipcoded
+ *   block, including its two-byte header, checked against the number of
+ *   bytes available
+ * - zcc_zipcode_decode_SIZE(): decode a zipcoded block, which must have been
+ *   checked with zcc_zipcode_block_size_SIZE(), into \a SIZE bytes
+ *
+ * \param[in]   SIZE    decoded sector size in bytes
+ */
+#define ZIPCODE_CODEC(SIZE) \
+long zcc_zipcode_block_size_##SIZE(const uint8_t *block, size_t avail) \
+{ \
+    size_t size; \
+\
+    if (avail < ZCC_ZIPDISK_DATA) { \
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA; \
+        return -1; \
+    } \
+    switch (block[ZCC_ZIPDISK_TRACK] >> 6U) { \
+        case ZCC_PACK_NONE: \
+            size = ZCC_ZIPDISK_DATA + (SIZE); \
+            break; \
+        case ZCC_PACK_FILL: \
+            size = ZCC_ZIPDISK_DATA + 1; \
+            break; \
+        case ZCC_PACK_RLE: \
+            if (avail < ZCC_ZIPDISK_RLE_DATA) { \
+                zcc_errno = ZCC_ERR_ZC_INVALID_DATA; \
+                return -1; \
+            } \
+            size = ZCC_ZIPDISK_RLE_DATA + block[ZCC_ZIPDISK_RLE_LENGTH]; \
+            break; \
+        default: \
+            zcc_errno = ZCC_ERR_ZC_INVALID_PACK_METHOD; \
+            return -1; \
+    } \
+    if (size > avail) { \
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA; \
+        return -1; \
+    } \
+    return (long)size; \
+} \
+\
+bool zcc_zipcode_decode_##SIZE(uint8_t *dest, const uint8_t *block) \
+{ \
+    switch (block[ZCC_ZIPDISK_TRACK] >> 6U) { \
+        case ZCC_PACK_NONE: \
+            memcpy(dest, block + ZCC_ZIPDISK_DATA, (SIZE)); \
+            return true; \
+        case ZCC_PACK_FILL: \
+            memset(dest, block[ZCC_ZIPDISK_DATA], (SIZE)); \
+            return true; \
+        case ZCC_PACK_RLE: \
+            return zcc_rle_decode_##SIZE(dest, \
+                                         block + ZCC_ZIPDISK_RLE_DATA, \
+                                         block[ZCC_ZIPDISK_RLE_PACKBYTE], \
+                                         block[ZCC_ZIPDISK_RLE_LENGTH]) \
+                == (SIZE); \
+        default: \
+            zcc_errno = ZCC_ERR_ZC_INVALID_PACK_METHOD; \
+            return false; \
+    } \
+}
+
+
+ZIPCODE_CODEC(256)
+ZIPCODE_CODEC(254)
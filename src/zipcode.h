@@ -0,0 +1,45 @@
+/** \file   zipcode.h
+ * \brief   Zipcode block codec - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_ZIPCODE_H
+#define ZCC_ZIPCODE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*
+ * Diskpacked archives: full 256-byte sectors
+ */
+long zcc_zipcode_block_size_256(const uint8_t *block, size_t avail);
+bool zcc_zipcode_decode_256(uint8_t *dest, const uint8_t *block);
+
+/*
+ * Filepacked archives: 254 bytes, the sector minus its track/sector link
+ */
+long zcc_zipcode_block_size_254(const uint8_t *block, size_t avail);
+bool zcc_zipcode_decode_254(uint8_t *dest, const uint8_t *block);
+
+#endif
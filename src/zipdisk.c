@@ -34,6 +34,10 @@
 #include "mem.h"
 #include "io.h"
 #include "rle.h"
+#include "cbmdos.h"
+#include "petasc.h"
+#include "d64map.h"
+#include "zipcode.h"
 
 #include "zipdisk.h"
 
@@ -60,12 +64,22 @@ void zcc_zipdisk_init(zcc_zipdisk_t *zip)
     for (int i = 0; i < ZCC_ZIPCODE_SLICE_MAX; i++) {
         zip->slices[i].data = NULL;
         zip->slices[i].size = 0;
+        zip->slices[i].capacity = 0;
     }
     zip->slice_count = 0;
+    zip->pool = NULL;
+    zip->rebuild_bam = false;
+    zip->bad_sectors = 0;
+    zip->recover = false;
+    zip->missing_slices = 0;
+    zip->resyncs = 0;
 }
 
 
 /** \brief  Clean up all memory used by the member of \a zip
+ *
+ * When \a zip has a buffer pool, the slice buffers are returned to the pool.
+ * Afterwards \a zip can be reused with zcc_zipdisk_read().
  *
  * \param[in,out]   zip     zipdisk handle
  */
@@ -73,16 +87,63 @@ void zcc_zipdisk_free(zcc_zipdisk_t *zip)
 {
     if (zip->path != NULL) {
         zcc_free(zip->path);
+        zip->path = NULL;
     }
     for (int i = 0; i < ZCC_ZIPCODE_SLICE_MAX; i++) {
         if (zip->slices[i].data != NULL) {
-            zcc_free(zip->slices[i].data);
+            if (zip->pool != NULL) {
+                zcc_pool_slice_put(zip->pool,
+                                   zip->slices[i].data,
+                                   zip->slices[i].capacity);
+            } else {
+                zcc_free(zip->slices[i].data);
+            }
         }
+        zip->slices[i].data = NULL;
+        zip->slices[i].size = 0;
+        zip->slices[i].capacity = 0;
+    }
+    zip->slice_count = 0;
+}
+
+
+/** \brief  Read slice file at the current path of \a zip into \a slice
+ *
+ * Uses a buffer from the pool of \a zip if it has one.
+ *
+ * \param[in,out]   zip     zipdisk handle
+ * \param[out]      slice   slice
+ *
+ * \return  number of bytes read or -1 on error
+ * \throw   ZCC_ERR_IO
+ */
+static long zipdisk_read_slice(zcc_zipdisk_t *zip, zcc_zipdisk_slice_t *slice)
+{
+    uint8_t *buffer;
+    long result;
+
+    if (zip->pool == NULL) {
+        return zcc_fread_alloc(&(slice->data), zip->path);
+    }
+
+    buffer = zcc_pool_slice_get(zip->pool, &(slice->capacity));
+    slice->data = buffer;
+    result = zcc_fread_into(&(slice->data), &(slice->capacity), zip->path);
+    if (slice->data != buffer) {
+        /* buffer was too small (or missing) and got replaced */
+        zip->pool->heap_allocs++;
+    }
+    if (result > 0) {
+        zcc_pool_slice_seen(zip->pool, (size_t)result);
     }
+    return result;
 }
 
 
 /** \brief  Read data from \a path into \a zip
+ *
+ * In recovery mode a missing slice is left empty and counted in
+ * \c zip->missing_slices, reading only fails when no slice was found at all.
  *
  * \param[in,out]   zip     zipdisk handle
  * \param[in]       path    path to a file of the zipcoded disk image
@@ -97,12 +158,14 @@ bool zcc_zipdisk_read(zcc_zipdisk_t *zip, const char *path)
     int i;
 
     zip->path = zcc_strdup(path);
+    zip->missing_slices = 0;
     basename = zcc_basename(zip->path);
 
     /* check basename for "[1-5]!*" */
     if (basename[1] != '!' || (basename[0] < '1' || basename[0] > '5')) {
         zcc_errno = ZCC_ERR_INVALID_FILENAME;
         zcc_free(zip->path);
+        zip->path = NULL;
         return false;
     }
 
@@ -113,24 +176,34 @@ bool zcc_zipdisk_read(zcc_zipdisk_t *zip, const char *path)
 
         *(zip->slice_index) = (char)(i + 1 + '0');
         printf("reading '%s' ... ", zip->path);
-        result = zcc_fread_alloc(&(zip->slices[i].data), zip->path);
+        result = zipdisk_read_slice(zip, &(zip->slices[i]));
         printf("%ld\n", result);
 
         if (result < 0) {
-            if (i < ZCC_ZIPCODE_SLICE_MAX - 2) {
-                zcc_errno = ZCC_ERR_IO;
-                return false;
-            } else {
+            if (i == ZCC_ZIPCODE_SLICE_MAX - 2) {
                 printf("No fifth slice found, continuing\n");
                 zip->slice_count = 4;
-                return true;
+                break;
+            } else if (zip->recover) {
+                printf("Slice %d missing, continuing\n", i + 1);
+                zip->slices[i].size = 0;
+                zip->missing_slices++;
+            } else {
+                zcc_errno = ZCC_ERR_IO;
+                return false;
             }
         } else {
             zip->slices[i].size = (size_t)result;
         }
 
     }
-    zip->slice_count = 5;
+    if (i == ZCC_ZIPCODE_SLICE_MAX - 1) {
+        zip->slice_count = 5;
+    }
+    if (zip->missing_slices == zip->slice_count) {
+        zcc_errno = ZCC_ERR_IO;
+        return false;
+    }
 
     return true;
 }
@@ -148,6 +221,7 @@ void zcc_zipdisk_dump_slice(zcc_zipdisk_t *zip, int slice)
     uint8_t *data = zip->slices[slice].data;
     size_t   size = zip->slices[slice].size;
     uint16_t load = (uint16_t)(data[0] + data[1] * 256);
+    uint8_t buffer[ZCC_D64_BLOCK_SIZE_RAW];
     uint8_t *p;
 
     if (load == 0x3fe) {
@@ -183,7 +257,7 @@ void zcc_zipdisk_dump_slice(zcc_zipdisk_t *zip, int slice)
                 printf("packbyte: $%02x, data: $%04x bytes\n",
                         p[3], p[2]);
 
-                rle_result = zcc_rle_decode(NULL, p + 4, p[3], p[2]);
+                rle_result = zcc_rle_decode_256(buffer, p + 4, p[3], p[2]);
                 printf("rle result = %d", rle_result);
 
                 p += p[2] + 2;
@@ -197,46 +271,6 @@ void zcc_zipdisk_dump_slice(zcc_zipdisk_t *zip, int slice)
 }
 
 
-/** \brief  Unpack a zipdisk block
- *
- * Unpacks a zipdisk block into a buffer. The \a dest should point to a buffer
- * of at least 256 bytes, the \a src should contain the track/sector bytes.
- *
- * \param   [out]   dest    destination of the unpacked block
- * \param   [in]    src     zipcoded block to depack
- *
- * \return  boolean
- */
-static bool zcc_unpack_block(uint8_t *dest, uint8_t *src)
-{
-    int track = src[ZCC_ZIPDISK_TRACK] & 0x3f;
-    int sector = src[ZCC_ZIPDISK_SECTOR];
-    int method = src[ZCC_ZIPDISK_TRACK] >> 6U;
-
-    printf("track %d, sector %d, pack method %d (%s)\n",
-            track, sector, method, zipdisk_pack_methods[method]);
-
-    switch (method) {
-        case ZCC_PACK_NONE:
-            memcpy(dest, src + ZCC_ZIPDISK_DATA, 256);
-            break;
-        case ZCC_PACK_FILL:
-            memset(dest, src[ZCC_ZIPDISK_DATA], 256);
-            break;
-        case ZCC_PACK_RLE:
-            if (zcc_rle_decode(dest,
-                               src + ZCC_ZIPDISK_RLE_DATA,
-                               src[ZCC_ZIPDISK_RLE_PACKBYTE],
-                               src[ZCC_ZIPDISK_RLE_LENGTH]) != 256) {
-                return false;
-            }
-            break;
-        default:
-            return false;
-    }
-    return true;
-}
-
 #if 0
 bool zcc_zipdisk_write(zcc_zipdisk_t *zip, zcc_d64_t *d64)
 {
@@ -275,6 +309,113 @@ static bool iter_current_block_info(zcc_zipdisk_iter_t *iter)
 }
 
 
+/** \brief  Get size of the block at \a data if its header is plausible
+ *
+ * A plausible block has a valid pack method, a track and sector that exist
+ * on the D64 the archive unpacks to, and fits in \a avail bytes.
+ *
+ * \param[in]   zip     zipdisk handle
+ * \param[in]   data    block data
+ * \param[in]   avail   number of bytes available at \a data
+ *
+ * \return  size of the block in bytes, or -1 when not plausible
+ */
+static long iter_block_plausible(const zcc_zipdisk_t *zip,
+                                 const uint8_t *data,
+                                 size_t avail)
+{
+    const zcc_d64_geometry_t *geometry;
+    int track_max = zip->slice_count == 5 ? 40 : 35;
+    int track;
+
+    if (avail < ZCC_ZIPDISK_DATA) {
+        return -1;
+    }
+    geometry = zcc_d64_geometry(ZCC_D64_FORMAT_D64);
+    track = data[ZCC_ZIPDISK_TRACK] & 0x3f;
+    if (track < ZCC_D64_TRACK_MIN || track > track_max
+            || data[ZCC_ZIPDISK_SECTOR] >= geometry->sectors[track]) {
+        return -1;
+    }
+    return zcc_zipcode_block_size_256(data, avail);
+}
+
+
+/** \brief  Resynchronize \a iter in recovery mode
+ *
+ * When the block at the current offset of \a iter isn't plausible, the slice
+ * is scanned for the next offset holding a plausible block that is followed
+ * by another plausible block or the end of the slice. When none is found the
+ * iterator is moved to the end of the slice.
+ *
+ * Does nothing when the zipdisk isn't in recovery mode.
+ *
+ * \param[in,out]   iter    zipdisk iterator
+ */
+static void iter_resync(zcc_zipdisk_iter_t *iter)
+{
+    zcc_zipdisk_t *zip = iter->zip;
+    const zcc_zipdisk_slice_t *slice = &zip->slices[iter->slice_index];
+    size_t offset;
+
+    if (!zip->recover || iter->slice_offset >= slice->size
+            || iter_block_plausible(zip,
+                                    slice->data + iter->slice_offset,
+                                    slice->size - iter->slice_offset) > 0) {
+        return;
+    }
+
+    for (offset = iter->slice_offset + 1; offset < slice->size; offset++) {
+        long length = iter_block_plausible(zip,
+                                           slice->data + offset,
+                                           slice->size - offset);
+        size_t next;
+
+        if (length < 0) {
+            continue;
+        }
+        next = offset + (size_t)length;
+        if (next == slice->size
+                || iter_block_plausible(zip,
+                                        slice->data + next,
+                                        slice->size - next) > 0) {
+            break;
+        }
+    }
+
+    fprintf(stderr, "slice #%d: corrupt data at $%04lx, skipped %lu bytes\n",
+            iter->slice_index + 1, (unsigned long)(iter->slice_offset),
+            (unsigned long)(offset - iter->slice_offset));
+    zip->resyncs++;
+    iter->slice_offset = offset;
+}
+
+
+/** \brief  Move \a iter to the first block of the next non-empty slice
+ *
+ * Empty slices only occur in recovery mode, for missing slices.
+ *
+ * \param[in,out]   iter    zipdisk iterator
+ *
+ * \return  false on end of archive
+ */
+static bool iter_next_slice(zcc_zipdisk_iter_t *iter)
+{
+    do {
+        printf("Getting next slice\n");
+        if (iter->slice_index + 1 >= iter->zip->slice_count) {
+            printf("End of archive\n");
+            return false;
+        }
+        iter->slice_index++;
+        iter->slice_offset = 2;     /* skip load address */
+        iter_resync(iter);
+    } while (!iter_current_block_info(iter));
+
+    return true;
+}
+
+
 /** \brief  Dump information of the state of \a iter on stdout
  *
  * \param[in]   iter    zipdisk iterator
@@ -302,60 +443,52 @@ bool zcc_zipdisk_iter_init(zcc_zipdisk_iter_t *iter, zcc_zipdisk_t *zip)
     iter->slice_offset = 4;
     iter->block_nr = 0;
     iter->block_data = NULL;
+    iter->error = 0;
 
-    return iter_current_block_info(iter);
+    iter_resync(iter);
+    if (iter_current_block_info(iter)) {
+        return true;
+    }
+    return zip->recover && iter_next_slice(iter);
 }
 
 
 /** \brief  Move zipdisk iterator \a iter to the next block
+ *
+ * In recovery mode corrupt data is skipped by resynchronizing to the next
+ * plausible block, see iter_resync().
  *
  * \param[in,out]   iter    zipdisk iterator
  *
  * \return  true when a next block was found, false on end of archive, or error
+ *          (`iter->error` is set then)
  *
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
  * \throw   ZCC_ERR_ZC_INVALID_PACK_METHOD
  */
 bool zcc_zipdisk_iter_next(zcc_zipdisk_iter_t *iter)
 {
-    int offset;         /* offset to next block in the current slice */
-    uint8_t *data;      /* current block's data, includes the zipcode
-                           track+packmethod,sector data */
+    long offset;        /* offset to next block in the current slice */
 
     if (iter_current_block_info(iter)) {
         /* got current block, get the next one */
-        switch (iter->method) {
-            case ZCC_PACK_NONE:
-                /* full raw block of 256 bytes */
-                offset = 256 + 2;
-                break;
-            case ZCC_PACK_FILL:
-                offset = 3;
-                break;
-            case ZCC_PACK_RLE:
-                data = iter->block_data;
-                offset = data[ZCC_ZIPDISK_RLE_LENGTH] + 4;
-                break;
-            default:
-                offset = -1;
-                zcc_errno = ZCC_ERR_ZC_INVALID_PACK_METHOD;
+        zcc_zipdisk_slice_t *slice = &iter->zip->slices[iter->slice_index];
+
+        offset = zcc_zipcode_block_size_256(iter->block_data,
+                                            slice->size - iter->slice_offset);
+        if (offset < 0) {
+            if (!iter->zip->recover) {
+                iter->error = zcc_errno;
                 return false;
+            }
+            /* truncated block at the end of the slice */
+            offset = (long)(slice->size - iter->slice_offset);
         }
         iter->slice_offset += (size_t)offset;
-        iter_current_block_info(iter);
-    } else {
-        /* end of slice, check if we have another one */
-        printf("Getting next slice\n");
-        if (iter->slice_index >= iter->zip->slice_count + 1) {
-            /* end of archive */
-            printf("End of archive\n");
-            return false;
-        }
-        iter->slice_index++;
-        iter->slice_offset = 2;     /* skip load address */
-        if (!iter_current_block_info(iter)) {
-            /* error code already set */
-            return false;
-        }
+        iter_resync(iter);
+    }
+    if (!iter_current_block_info(iter) && !iter_next_slice(iter)) {
+        return false;
     }
 
     iter->block_nr++;
@@ -405,12 +538,47 @@ bool zcc_zipdisk_test_iter(const char *path)
 }
 
 
+/** \brief  Flag blocks of \a d64 missing from the archive in its error info
+ *
+ * Error info is attached to \a d64 when a block is missing and it doesn't
+ * have any yet.
+ *
+ * \param[in,out]   d64     D64 image
+ *
+ * \return  number of missing blocks
+ */
+static int unzip_flag_missing(zcc_d64_t *d64)
+{
+    size_t blocks = d64->size / ZCC_D64_BLOCK_SIZE_RAW;
+    int missing = 0;
+
+    for (size_t i = 0; i < blocks; i++) {
+        if (!(d64->written[i / 8] & (1U << (i % 8)))) {
+            zcc_d64_errors_attach(d64);
+            d64->errors[i] = ZCC_D64_ERROR_HEADER;
+            missing++;
+        }
+    }
+    return missing;
+}
+
+
 /** \brief  Unzip zipdisk \a zip into a new D64 at \a path
+ *
+ * Blocks that fail to decode don't abort the conversion: they're zero-filled
+ * and flagged with #ZCC_D64_ERROR_DATA_CHECKSUM in the error info of the D64,
+ * blocks missing from the archive then get #ZCC_D64_ERROR_HEADER. In
+ * recovery mode (\c zip->recover) corrupt data and missing slices are skipped
+ * as well, so the blocks lost that way end up flagged as missing. Outside
+ * recovery mode corrupt data fails the conversion. The number of bad blocks is
+ * stored in \c zip->bad_sectors.
  *
  * \param[in]   zip     zipdisk handle
  * \param[in]   path    path to write D64 file to
  *
  * \return  boolean
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ * \throw   ZCC_ERR_ZC_INVALID_PACK_METHOD
  */
 bool zcc_zipdisk_unzip(zcc_zipdisk_t *zip, const char *path)
 {
@@ -429,8 +597,10 @@ bool zcc_zipdisk_unzip(zcc_zipdisk_t *zip, const char *path)
 
     /* create target D64 and allocate space and copy path */
     zcc_d64_init(&d64);
-    zcc_d64_alloc(&d64, type);
+    zcc_d64_alloc_pooled(&d64, type, zip->pool);
     d64.path = zcc_strdup(path);
+    zip->bad_sectors = 0;
+    zip->resyncs = 0;
 
     /* init zipdisk iter */
     if (!zcc_zipdisk_iter_init(&iter, zip)) {
@@ -440,26 +610,294 @@ bool zcc_zipdisk_unzip(zcc_zipdisk_t *zip, const char *path)
 
 
     do {
-        if (!zcc_unpack_block(buffer, iter.block_data)) {
+        if (!zcc_zipcode_decode_256(buffer, iter.block_data)) {
+            int index = zcc_d64_link_index(&d64, iter.track, iter.sector);
+
+            fprintf(stderr, "(%2d,%2d): ", iter.track, iter.sector);
             zcc_perror(NULL);
+            memset(buffer, 0, sizeof buffer);
+            if (index >= 0) {
+                zcc_d64_errors_attach(&d64);
+                d64.errors[index] = ZCC_D64_ERROR_DATA_CHECKSUM;
+                zip->bad_sectors++;
+            }
+        }
+        zcc_d64_block_write(&d64, buffer, iter.track, iter.sector);
+    } while (zcc_zipdisk_iter_next(&iter));
+
+    if (iter.error != 0) {
+        /* corrupt data outside recovery mode: the rest of the archive is lost */
+        fprintf(stderr, "slice #%d: corrupt data at $%04lx, use recovery mode "
+                "to skip it\n",
+                iter.slice_index + 1, (unsigned long)(iter.slice_offset));
+        zcc_errno = iter.error;
+        zcc_d64_free(&d64);
+        return false;
+    }
+    if (d64.errors != NULL || zip->recover) {
+        zip->bad_sectors += unzip_flag_missing(&d64);
+    }
+    /* clear any blocks not in the archive if the D64 buffer was recycled */
+    zcc_d64_clear_unwritten(&d64);
+    if (zip->rebuild_bam && zcc_d64_rebuild_bam(&d64) < 0) {
+        if (zcc_errno != ZCC_ERR_INVALID_IMAGE) {
             zcc_d64_free(&d64);
             return false;
         }
-        printf("(%2d,%2d):\n", iter.track, iter.sector);
-        zcc_hexdump(buffer, 256, 0);
+        /* damaged chains: keep the BAM of the archive */
+        fprintf(stderr, "broken directory or file chains, BAM not rebuilt\n");
+    }
+    if (!zcc_d64_write(&d64, path)) {
+        zcc_d64_free(&d64);
+        return false;
+    }
+    zcc_d64_free(&d64);
 
-        zcc_d64_block_write(&d64, buffer, iter.track, iter.sector);
+    return true;
+}
 
 
-    } while (zcc_zipdisk_iter_next(&iter));
+/** \brief  Build block index of \a zip
+ *
+ * Only the two-byte block headers are looked at, no block is decoded. When a
+ * block occurs more than once the last copy wins, just like when unzipping.
+ *
+ * \param[out]  index   block index
+ * \param[in]   zip     zipdisk handle
+ *
+ * \return  true on success
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ * \throw   ZCC_ERR_ZC_INVALID_PACK_METHOD
+ */
+bool zcc_zipdisk_index_build(zcc_zipdisk_index_t *index,
+                             const zcc_zipdisk_t *zip)
+{
+    for (int i = 0; i < ZCC_D64_BLOCKS_MAX; i++) {
+        index->blocks[i] = NULL;
+    }
+    index->block_count = 0;
+    index->decoded = 0;
+
+    for (int slice = 0; slice < zip->slice_count; slice++) {
+        uint8_t *data = zip->slices[slice].data;
+        size_t size = zip->slices[slice].size;
+        /* first slice: load address and disk ID, others: load address */
+        size_t offset = slice == 0 ? 4 : 2;
+
+        while (offset + 2 < size) {
+            uint8_t *block = data + offset;
+            int track = block[ZCC_ZIPDISK_TRACK] & 0x3f;
+            int sector = block[ZCC_ZIPDISK_SECTOR];
+            int bindex;
+            long length;
+
+            length = zcc_zipcode_block_size_256(block, size - offset);
+            if (length < 0) {
+                return false;
+            }
 
-    zcc_d64_write(&d64, path);
-    zcc_d64_free(&d64);
+            bindex = zcc_d64_block_index(track, sector);
+            if (bindex < 0) {
+                zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+                return false;
+            }
+            if (index->blocks[bindex] == NULL) {
+                index->block_count++;
+            }
+            index->blocks[bindex] = block;
+            offset += (size_t)length;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Decode block (\a track, \a sector) via \a index into \a dest
+ *
+ * Blocks not present in the archive are returned as zeroes, like they would
+ * be in an unzipped image.
+ *
+ * \param[in,out]   index   block index
+ * \param[out]      dest    buffer of at least 256 bytes
+ * \param[in]       track   track number
+ * \param[in]       sector  sector number
+ *
+ * \return  true on success
+ * \throw   ZCC_ERR_TRACK_RANGE
+ * \throw   ZCC_ERR_SECTOR_RANGE
+ * \throw   ZCC_ERR_RLE
+ */
+bool zcc_zipdisk_index_read_block(zcc_zipdisk_index_t *index,
+                                  uint8_t *dest,
+                                  int track, int sector)
+{
+    int bindex = zcc_d64_block_index(track, sector);
 
+    if (bindex < 0) {
+        return false;
+    }
+    if (index->blocks[bindex] == NULL) {
+        memset(dest, 0, ZCC_D64_BLOCK_SIZE_RAW);
+        return true;
+    }
+    index->decoded++;
+    if (!zcc_zipcode_decode_256(dest, index->blocks[bindex])) {
+        zcc_errno = ZCC_ERR_RLE;
+        return false;
+    }
     return true;
 }
 
 
+/** \brief  Find directory entry of file \a name via \a index
+ *
+ * \param[in,out]   index   block index
+ * \param[in]       name    host filename without extension
+ * \param[out]      entry   directory entry (32 bytes)
+ *
+ * \return  true if found
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ * \throw   ZCC_ERR_CHAIN_CYCLE
+ */
+static bool zipdisk_find_entry(zcc_zipdisk_index_t *index,
+                               const char *name,
+                               uint8_t *entry)
+{
+    uint8_t block[ZCC_D64_BLOCK_SIZE_RAW];
+    uint64_t visited[ZCC_D64_BITMAP_WORDS];
+    int track = ZCC_D64_DIR_TRACK;
+    int sector = ZCC_D64_DIR_SECTOR;
+
+    memset(visited, 0, sizeof visited);
+    while (track != 0) {
+        int bindex = zcc_d64_block_index(track, sector);
+
+        if (bindex < 0) {
+            return false;
+        }
+        if (ZCC_D64_BITMAP_GET(visited, bindex)) {
+            zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+            return false;
+        }
+        ZCC_D64_BITMAP_SET(visited, bindex);
+        if (!zcc_zipdisk_index_read_block(index, block, track, sector)) {
+            return false;
+        }
+
+        for (int i = 0; i < ZCC_D64_BLOCK_SIZE_RAW; i += ZCC_D64_DIRENT_SIZE) {
+            const uint8_t *dirent = block + i;
+            char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+            if ((ZCC_D64_DIRENT_GET_FILETYPE(dirent) & ZCC_CBMDOS_FILETYPE_MASK)
+                        == ZCC_CBMDOS_FILETYPE_DEL
+                    || ZCC_D64_DIRENT_GET_TRACK(dirent) == 0) {
+                continue;
+            }
+            zcc_pet_filename_to_host(host, ZCC_D64_DIRENT_GET_NAME(dirent),
+                                     NULL);
+            if (strcmp(host, name) == 0) {
+                memcpy(entry, dirent, ZCC_D64_DIRENT_SIZE);
+                return true;
+            }
+        }
+        track = block[ZCC_D64_BLOCK_TRACK];
+        sector = block[ZCC_D64_BLOCK_SECTOR];
+    }
+    zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+    return false;
+}
+
+
+/** \brief  Extract file \a name from \a zip to host file \a path
+ *
+ * Only the directory blocks and the blocks of the file itself are decoded.
+ *
+ * \param[in]   zip     zipdisk handle
+ * \param[in]   name    host filename (without extension) of the file
+ * \param[in]   path    host path to write the file to (`NULL` to use
+ *                      \a name with the file type as extension)
+ * \param[out]  index   block index (optional, `NULL` to use a temporary
+ *                      one), useful for the \c decoded statistic
+ *
+ * \return  size of the file in bytes or -1 on failure
+ */
+long zcc_zipdisk_extract(zcc_zipdisk_t *zip,
+                         const char *name,
+                         const char *path,
+                         zcc_zipdisk_index_t *index)
+{
+    zcc_zipdisk_index_t local;
+    uint8_t entry[ZCC_D64_DIRENT_SIZE];
+    uint8_t block[ZCC_D64_BLOCK_SIZE_RAW];
+    uint64_t visited[ZCC_D64_BITMAP_WORDS];
+    uint8_t *data;
+    long size = 0;
+    int track;
+    int sector;
+
+    if (index == NULL) {
+        index = &local;
+    }
+    if (!zcc_zipdisk_index_build(index, zip)) {
+        return -1;
+    }
+    if (!zipdisk_find_entry(index, name, entry)) {
+        return -1;
+    }
+
+    data = zcc_malloc((size_t)ZCC_D64_BLOCKS_MAX * ZCC_D64_BLOCK_SIZE_DATA);
+    memset(visited, 0, sizeof visited);
+    track = ZCC_D64_DIRENT_GET_TRACK(entry);
+    sector = ZCC_D64_DIRENT_GET_SECTOR(entry);
+    while (true) {
+        int bindex = zcc_d64_block_index(track, sector);
+
+        if (bindex < 0
+                || !zcc_zipdisk_index_read_block(index, block, track, sector)) {
+            zcc_free(data);
+            return -1;
+        }
+        if (ZCC_D64_BITMAP_GET(visited, bindex)) {
+            zcc_errno = ZCC_ERR_CHAIN_CYCLE;
+            zcc_free(data);
+            return -1;
+        }
+        ZCC_D64_BITMAP_SET(visited, bindex);
+
+        if (block[ZCC_D64_BLOCK_TRACK] == 0) {
+            /* last block */
+            int last = block[ZCC_D64_BLOCK_SECTOR];
+
+            if (last >= ZCC_D64_BLOCK_DATA) {
+                memcpy(data + size, block + ZCC_D64_BLOCK_DATA,
+                       (size_t)(last - 1));
+                size += last - 1;
+            }
+            break;
+        }
+        memcpy(data + size, block + ZCC_D64_BLOCK_DATA,
+               ZCC_D64_BLOCK_SIZE_DATA);
+        size += ZCC_D64_BLOCK_SIZE_DATA;
+        track = block[ZCC_D64_BLOCK_TRACK];
+        sector = block[ZCC_D64_BLOCK_SECTOR];
+    }
+
+    if (path == NULL) {
+        char host[ZCC_CBMDOS_FILENAME_MAX + 5];
+
+        snprintf(host, sizeof host, "%s.%s", name,
+                 zcc_cbmdos_filetype_str(ZCC_D64_DIRENT_GET_FILETYPE(entry)));
+        if (!zcc_fwrite(host, data, (size_t)size)) {
+            size = -1;
+        }
+    } else if (!zcc_fwrite(path, data, (size_t)size)) {
+        size = -1;
+    }
+    zcc_free(data);
+    return size;
+}
+
+
 /** \brief  Dump information on zipdisk archive \a path
  *
  * \param[in]   path    path to zipdisk archive file
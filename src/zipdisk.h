@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "d64.h"
+#include "pool.h"
 
 
 /** \brief  Maximum number of slices in a zipdisk archive
@@ -90,8 +91,9 @@ typedef enum zcc_pack_e {
  * The filename of the slice can be reconstructed via its parent #zcc_zipdisk_t
  */
 typedef struct zcc_zipdisk_slice_s {
-    uint8_t *   data;   /**< file data */
-    size_t      size;   /**< file size */
+    uint8_t *   data;       /**< file data */
+    size_t      size;       /**< file size */
+    size_t      capacity;   /**< size of the buffer at \c data */
 } zcc_zipdisk_slice_t;
 
 
@@ -116,6 +118,46 @@ typedef struct zcc_zipdisk_s {
     /** \brief  Number of slices
      */
     int slice_count;
+
+    /** \brief  Buffer pool (optional)
+     *
+     * When set, slice buffers are taken from and returned to this pool, and
+     * the D64 created by zcc_zipdisk_unzip() uses it as well. Set this after
+     * calling zcc_zipdisk_init().
+     */
+    zcc_pool_t *pool;
+
+    /** \brief  Rebuild the BAM from the file chains after unzipping
+     *
+     * Archives often contain a stale BAM, setting this makes
+     * zcc_zipdisk_unzip() derive the BAM from the directory instead.
+     */
+    bool rebuild_bam;
+
+    /** \brief  Number of sectors that failed to decode or are missing
+     *
+     * Set by zcc_zipdisk_unzip(), the D64 gets error info when this is
+     * non-zero.
+     */
+    int bad_sectors;
+
+    /** \brief  Recovery mode
+     *
+     * When set, zcc_zipdisk_read() skips missing slices and the iterator
+     * resynchronizes to the next plausible block header after corrupt data
+     * instead of ending, blocks lost this way are flagged in the error info
+     * of the D64 created by zcc_zipdisk_unzip().
+     */
+    bool recover;
+
+    /** \brief  Number of slices missing (recovery mode)
+     */
+    int missing_slices;
+
+    /** \brief  Number of times the iterator had to resynchronize (recovery
+     *          mode)
+     */
+    int resyncs;
 } zcc_zipdisk_t;
 
 
@@ -148,9 +190,29 @@ typedef struct zcc_zipdisk_iter_s {
     int             sector;             /**< current sector number */
     int             method;             /**< pack method of the block, shifted
                                              so it's in the range %00-%11 */
+    int             error;              /**< error code when iteration stopped
+                                             at corrupt data, 0 when it ended
+                                             normally */
 } zcc_zipdisk_iter_t;
 
 
+/** \brief  Index of the blocks in a zipdisk archive
+ *
+ * Maps each (track, sector) to its packed block in the slices, so single
+ * blocks can be decoded without unpacking the whole archive.
+ */
+typedef struct zcc_zipdisk_index_s {
+    uint8_t *   blocks[ZCC_D64_BLOCKS_MAX]; /**< packed block (including the
+                                                 track/method and sector
+                                                 bytes) per block index,
+                                                 `NULL` if not in the
+                                                 archive */
+    int         block_count;                /**< number of blocks indexed */
+    int         decoded;                    /**< number of blocks decoded
+                                                 via this index (statistics) */
+} zcc_zipdisk_index_t;
+
+
 void zcc_zipdisk_init(zcc_zipdisk_t *zip);
 void zcc_zipdisk_free(zcc_zipdisk_t *zip);
 
@@ -167,6 +229,16 @@ void zcc_zipdisk_iter_dump(const zcc_zipdisk_iter_t *iter);
 
 bool zcc_zipdisk_unzip(zcc_zipdisk_t *zip, const char *path);
 
+bool zcc_zipdisk_index_build(zcc_zipdisk_index_t *index,
+                             const zcc_zipdisk_t *zip);
+bool zcc_zipdisk_index_read_block(zcc_zipdisk_index_t *index,
+                                  uint8_t *dest,
+                                  int track, int sector);
+long zcc_zipdisk_extract(zcc_zipdisk_t *zip,
+                         const char *name,
+                         const char *path,
+                         zcc_zipdisk_index_t *index);
+
 bool zcc_zipdisk_show_info(const char *path, bool verbose);
 
 
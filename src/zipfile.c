@@ -0,0 +1,572 @@
+/** \file   zipfile.c
+ * \brief   Filepacked zipcode handling
+ *
+ * A filepacked archive consists of a directory file 'X!*' and data parts
+ * 'A!*', 'B!*', etc. The parts contain the zipcoded blocks of all files in
+ * directory order, without any offsets, so on reading the block headers are
+ * scanned once to find where each file starts. Blocks are 254 bytes: the
+ * track/sector link is the block header, with the pack method in the top two
+ * bits of the track.
+ *
+ * See doc/reference/formats/zip_file.txt
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "debug.h"
+#include "errors.h"
+#include "mem.h"
+#include "io.h"
+#include "cbmdos.h"
+#include "petasc.h"
+#include "d64.h"
+#include "d64file.h"
+#include "zipdisk.h"
+#include "zipcode.h"
+
+#include "zipfile.h"
+
+
+/** \brief  Position in the blocks of a filepacked archive
+ */
+typedef struct zipfile_cursor_s {
+    const zcc_zipfile_t *zip;   /**< archive */
+    int part;                   /**< index of current part */
+    size_t offset;              /**< offset in current part */
+    int remaining;              /**< blocks left in current part */
+} zipfile_cursor_t;
+
+
+/** \brief  Free data of \a part
+ *
+ * \param[in,out]   part    archive part
+ */
+static void part_free(zcc_zipfile_part_t *part)
+{
+    if (part->data != NULL) {
+        zcc_free(part->data);
+    }
+    part->data = NULL;
+    part->size = 0;
+}
+
+
+/** \brief  Get pointer to the current block of \a cursor
+ *
+ * Moves to the next part when the current part is exhausted.
+ *
+ * \param[in,out]   cursor  cursor
+ * \param[out]      avail   number of bytes left in the part
+ *
+ * \return  block or NULL when there are no more blocks
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ */
+static const uint8_t *cursor_block(zipfile_cursor_t *cursor, size_t *avail)
+{
+    const zcc_zipfile_part_t *part;
+
+    while (cursor->remaining == 0) {
+        if (++cursor->part >= cursor->zip->part_count) {
+            zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+            return NULL;
+        }
+        part = &cursor->zip->parts[cursor->part];
+        cursor->offset = ZCC_ZIPFILE_PART_DATA;
+        cursor->remaining = part->data[ZCC_ZIPFILE_PART_BLOCKS];
+    }
+
+    part = &cursor->zip->parts[cursor->part];
+    if (cursor->offset + ZCC_ZIPDISK_DATA > part->size) {
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+        return NULL;
+    }
+    *avail = part->size - cursor->offset;
+    return part->data + cursor->offset;
+}
+
+
+/** \brief  Parse the directory of \a zip
+ *
+ * \param[in,out]   zip archive with the X! file loaded
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ */
+static bool zipfile_parse_dir(zcc_zipfile_t *zip)
+{
+    const uint8_t *dir = zip->dir.data;
+    int count;
+
+    if (zip->dir.size < ZCC_ZIPFILE_DIR_ENTRIES) {
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+        return false;
+    }
+    zip->part_count = dir[ZCC_ZIPFILE_DIR_PARTS];
+    count = dir[ZCC_ZIPFILE_DIR_FILES];
+    if (zip->part_count < 1 || zip->part_count > ZCC_ZIPFILE_PART_MAX
+            || count > ZCC_ZIPFILE_FILES_MAX
+            || zip->dir.size < ZCC_ZIPFILE_DIR_ENTRIES
+                + (size_t)count * ZCC_ZIPFILE_DIRENT_SIZE) {
+        zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+        return false;
+    }
+
+    zip->file_count = 0;
+    for (int i = 0; i < count; i++) {
+        const uint8_t *entry = dir + ZCC_ZIPFILE_DIR_ENTRIES
+            + i * ZCC_ZIPFILE_DIRENT_SIZE;
+        zcc_zipfile_entry_t *file = &zip->files[i];
+
+        memcpy(file->name, entry + ZCC_ZIPFILE_DIRENT_NAME,
+               ZCC_CBMDOS_FILENAME_MAX);
+        switch (entry[ZCC_ZIPFILE_DIRENT_TYPE] & 0x7f) {
+            case 'P':
+                file->type = ZCC_CBMDOS_FILETYPE_PRG;
+                break;
+            case 'S':
+                file->type = ZCC_CBMDOS_FILETYPE_SEQ;
+                break;
+            case 'U':
+                file->type = ZCC_CBMDOS_FILETYPE_USR;
+                break;
+            default:
+                zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+                return false;
+        }
+        file->blocks = entry[ZCC_ZIPFILE_DIRENT_BLOCKS]
+            | (entry[ZCC_ZIPFILE_DIRENT_BLOCKS + 1] << 8);
+        file->track = entry[ZCC_ZIPFILE_DIRENT_TRACK];
+        file->sector = entry[ZCC_ZIPFILE_DIRENT_SECTOR];
+        zip->file_count++;
+    }
+    return true;
+}
+
+
+/** \brief  Find the first block of each file in \a zip
+ *
+ * Only the block headers are looked at, no data is decoded.
+ *
+ * \param[in,out]   zip archive with directory and parts loaded
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ * \throw   ZCC_ERR_ZC_INVALID_PACK_METHOD
+ */
+static bool zipfile_index(zcc_zipfile_t *zip)
+{
+    zipfile_cursor_t cursor;
+
+    for (int i = 0; i < zip->part_count; i++) {
+        if (zip->parts[i].size < ZCC_ZIPFILE_PART_DATA) {
+            zcc_errno = ZCC_ERR_ZC_INVALID_DATA;
+            return false;
+        }
+    }
+
+    cursor.zip = zip;
+    cursor.part = -1;
+    cursor.offset = 0;
+    cursor.remaining = 0;
+
+    for (int i = 0; i < zip->file_count; i++) {
+        zcc_zipfile_entry_t *file = &zip->files[i];
+        bool last = false;
+
+        file->block_count = 0;
+        while (!last) {
+            size_t avail;
+            const uint8_t *block = cursor_block(&cursor, &avail);
+            long size;
+
+            if (block == NULL) {
+                return false;
+            }
+            size = zcc_zipcode_block_size_254(block, avail);
+            if (size < 0) {
+                return false;
+            }
+            if (file->block_count == 0) {
+                file->part = cursor.part;
+                file->offset = cursor.offset;
+                file->remaining = cursor.remaining;
+            }
+            file->block_count++;
+            last = (block[ZCC_ZIPDISK_TRACK] & 0x3f) == 0;
+            cursor.offset += (size_t)size;
+            cursor.remaining--;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Find file named \a name in the directory of \a d64 and read it
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   view    directory of \a d64
+ * \param[in]   name    ASCII filename
+ * \param[out]  part    part to store the file contents in
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ */
+static bool d64_read_part(const zcc_d64_t *d64,
+                          const zcc_d64_dirview_t *view,
+                          const char *name,
+                          zcc_zipfile_part_t *part)
+{
+    for (int i = 0; i < view->entry_count; i++) {
+        const uint8_t *entry = view->entries[i];
+        char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+        zcc_d64_file_t file;
+        long size;
+
+        if ((ZCC_D64_DIRENT_GET_FILETYPE(entry) & ZCC_CBMDOS_FILETYPE_MASK)
+                == ZCC_CBMDOS_FILETYPE_DEL) {
+            continue;
+        }
+        zcc_pet_filename_to_host(host, ZCC_D64_DIRENT_GET_NAME(entry), NULL);
+        if (strcmp(host, name) != 0) {
+            continue;
+        }
+
+        if (!zcc_d64_file_open_entry(&file, d64, entry)) {
+            return false;
+        }
+        size = zcc_d64_file_length(&file);
+        if (size < 0) {
+            return false;
+        }
+        part->data = zcc_malloc(size > 0 ? (size_t)size : 1);
+        part->size = (size_t)zcc_d64_file_read(&file, part->data, (size_t)size);
+        zcc_d64_file_close(&file);
+        return part->size == (size_t)size;
+    }
+    zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+    return false;
+}
+
+
+/** \brief  Initialize \a zip
+ *
+ * \param[out]  zip filepacked archive handle
+ */
+void zcc_zipfile_init(zcc_zipfile_t *zip)
+{
+    zip->dir.data = NULL;
+    zip->dir.size = 0;
+    for (int i = 0; i < ZCC_ZIPFILE_PART_MAX; i++) {
+        zip->parts[i].data = NULL;
+        zip->parts[i].size = 0;
+    }
+    zip->part_count = 0;
+    zip->file_count = 0;
+}
+
+
+/** \brief  Free memory used by the members of \a zip
+ *
+ * \param[in,out]   zip filepacked archive handle
+ */
+void zcc_zipfile_free(zcc_zipfile_t *zip)
+{
+    part_free(&zip->dir);
+    for (int i = 0; i < ZCC_ZIPFILE_PART_MAX; i++) {
+        part_free(&zip->parts[i]);
+    }
+    zip->part_count = 0;
+    zip->file_count = 0;
+}
+
+
+/** \brief  Read filepacked archive from host files
+ *
+ * \a path can be any of the files of the archive ('X!*', 'A!*', ...), the
+ * other filenames are derived from it, keeping the case of the letter.
+ *
+ * \param[in,out]   zip     filepacked archive handle
+ * \param[in]       path    path to a file of the archive
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_INVALID_FILENAME
+ * \throw   ZCC_ERR_IO
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ */
+bool zcc_zipfile_read(zcc_zipfile_t *zip, const char *path)
+{
+    char *part_path;
+    char *base;
+    char first;
+    long size;
+    bool result = false;
+
+    zcc_zipfile_free(zip);
+
+    part_path = zcc_strdup(path);
+    base = zcc_basename(part_path);
+    if (strlen(base) < 3 || base[1] != '!' || !isalpha((unsigned char)base[0])) {
+        zcc_errno = ZCC_ERR_INVALID_FILENAME;
+        zcc_free(part_path);
+        return false;
+    }
+    first = isupper((unsigned char)base[0]) ? 'A' : 'a';
+
+    base[0] = (char)(first + 'x' - 'a');
+    size = zcc_fread_alloc(&zip->dir.data, part_path);
+    if (size >= 0) {
+        zip->dir.size = (size_t)size;
+        result = zipfile_parse_dir(zip);
+    }
+
+    for (int i = 0; result && i < zip->part_count; i++) {
+        base[0] = (char)(first + i);
+        size = zcc_fread_alloc(&zip->parts[i].data, part_path);
+        if (size < 0) {
+            result = false;
+        } else {
+            zip->parts[i].size = (size_t)size;
+        }
+    }
+    zcc_free(part_path);
+
+    return result && zipfile_index(zip);
+}
+
+
+/** \brief  Read filepacked archive from files in D64 image
+ *
+ * \param[in,out]   zip     filepacked archive handle
+ * \param[in]       d64     D64 image
+ * \param[in]       name    name of the archive, without the 'X!' prefix, as
+ *                          shown in the directory
+ *
+ * \return  bool
+ * \throw   ZCC_ERR_INVALID_FILENAME
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ */
+bool zcc_zipfile_read_d64(zcc_zipfile_t *zip,
+                          const zcc_d64_t *d64,
+                          const char *name)
+{
+    zcc_d64_dirview_t view;
+    char part_name[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+    zcc_zipfile_free(zip);
+    if (strlen(name) > ZCC_CBMDOS_FILENAME_MAX - 2) {
+        zcc_errno = ZCC_ERR_INVALID_FILENAME;
+        return false;
+    }
+    zcc_d64_dirview_read(&view, d64);
+
+    snprintf(part_name, sizeof part_name, "x!%s", name);
+    if (!d64_read_part(d64, &view, part_name, &zip->dir)
+            || !zipfile_parse_dir(zip)) {
+        return false;
+    }
+    for (int i = 0; i < zip->part_count; i++) {
+        part_name[0] = (char)('a' + i);
+        if (!d64_read_part(d64, &view, part_name, &zip->parts[i])) {
+            return false;
+        }
+    }
+    return zipfile_index(zip);
+}
+
+
+/** \brief  Find file \a name in \a zip
+ *
+ * \param[in]   zip     filepacked archive handle
+ * \param[in]   name    host filename, without extension
+ *
+ * \return  index in \a zip or -1 when not found
+ * \throw   ZCC_ERR_FILE_NOT_FOUND
+ */
+int zcc_zipfile_find(const zcc_zipfile_t *zip, const char *name)
+{
+    for (int i = 0; i < zip->file_count; i++) {
+        char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+        zcc_pet_filename_to_host(host, zip->files[i].name, NULL);
+        if (strcmp(host, name) == 0) {
+            return i;
+        }
+    }
+    zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+    return -1;
+}
+
+
+/** \brief  Decode file \a index of \a zip into memory
+ *
+ * \param[in]   zip     filepacked archive handle
+ * \param[in]   index   index of file in \a zip
+ * \param[out]  dest    heap-allocated file contents, free with zcc_free()
+ *
+ * \return  size of the file in bytes or -1 on error
+ * \throw   ZCC_ERR_ZC_INVALID_DATA
+ * \throw   ZCC_ERR_RLE
+ */
+long zcc_zipfile_file_read(const zcc_zipfile_t *zip, int index,
+                           uint8_t **dest)
+{
+    const zcc_zipfile_entry_t *file;
+    zipfile_cursor_t cursor;
+    uint8_t *data;
+    long size = 0;
+
+    if (index < 0 || index >= zip->file_count) {
+        zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+        return -1;
+    }
+    file = &zip->files[index];
+
+    cursor.zip = zip;
+    cursor.part = file->part;
+    cursor.offset = file->offset;
+    cursor.remaining = file->remaining;
+
+    data = zcc_malloc((size_t)file->block_count * ZCC_D64_BLOCK_SIZE_DATA);
+    for (int i = 0; i < file->block_count; i++) {
+        size_t avail;
+        const uint8_t *block = cursor_block(&cursor, &avail);
+        long bsize = block != NULL
+            ? zcc_zipcode_block_size_254(block, avail) : -1;
+
+        if (bsize < 0 || !zcc_zipcode_decode_254(data + size, block)) {
+            zcc_free(data);
+            return -1;
+        }
+        if ((block[ZCC_ZIPDISK_TRACK] & 0x3f) == 0) {
+            /* last block: sector byte is the index of the last data byte */
+            int last = block[ZCC_ZIPDISK_SECTOR];
+
+            size += last >= ZCC_D64_BLOCK_DATA ? last - 1 : 0;
+        } else {
+            size += ZCC_D64_BLOCK_SIZE_DATA;
+        }
+        cursor.offset += (size_t)bsize;
+        cursor.remaining--;
+    }
+    *dest = data;
+    return size;
+}
+
+
+/** \brief  Decode file \a index of \a zip into host file \a path
+ *
+ * \param[in]   zip     filepacked archive handle
+ * \param[in]   index   index of file in \a zip
+ * \param[in]   path    host file
+ *
+ * \return  number of bytes written or -1 on error
+ */
+long zcc_zipfile_extract_file(const zcc_zipfile_t *zip, int index,
+                              const char *path)
+{
+    uint8_t *data;
+    long size = zcc_zipfile_file_read(zip, index, &data);
+
+    if (size < 0) {
+        return -1;
+    }
+    if (!zcc_fwrite(path, data, (size_t)size)) {
+        size = -1;
+    }
+    zcc_free(data);
+    return size;
+}
+
+
+/** \brief  Decode files in \a zip into host files
+ *
+ * Files are written to the current directory as 'name.ext', with 'ext' the
+ * file type.
+ *
+ * \param[in]   zip     filepacked archive handle
+ * \param[in]   name    only extract file \a name (host filename, without
+ *                      extension), or NULL to extract all files
+ * \param[in]   verbose print the name and size of each file
+ *
+ * \return  number of files extracted or -1 on error
+ */
+int zcc_zipfile_extract(const zcc_zipfile_t *zip, const char *name,
+                        bool verbose)
+{
+    int count = 0;
+
+    for (int i = 0; i < zip->file_count; i++) {
+        const zcc_zipfile_entry_t *file = &zip->files[i];
+        char host[ZCC_CBMDOS_FILENAME_MAX + 5];
+        long size;
+
+        if (name != NULL) {
+            zcc_pet_filename_to_host(host, file->name, NULL);
+            if (strcmp(host, name) != 0) {
+                continue;
+            }
+        }
+        zcc_pet_filename_to_host(host, file->name,
+                                 zcc_cbmdos_filetype_str(file->type));
+        size = zcc_zipfile_extract_file(zip, i, host);
+        if (size < 0) {
+            return -1;
+        }
+        if (verbose) {
+            printf("%-20s %6ld bytes\n", host, size);
+        }
+        count++;
+    }
+    if (name != NULL && count == 0) {
+        zcc_errno = ZCC_ERR_FILE_NOT_FOUND;
+        return -1;
+    }
+    return count;
+}
+
+
+/** \brief  Dump directory of \a zip on stdout
+ *
+ * \param[in]   zip filepacked archive handle
+ */
+void zcc_zipfile_dump(const zcc_zipfile_t *zip)
+{
+    printf("%d parts, %d files:\n", zip->part_count, zip->file_count);
+    for (int i = 0; i < zip->file_count; i++) {
+        const zcc_zipfile_entry_t *file = &zip->files[i];
+        char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+
+        zcc_pet_filename_to_host(host, file->name, NULL);
+        printf("%-5d \"%s\" %s  (%c!, $%04lx, %d blocks)\n",
+               file->blocks, host, zcc_cbmdos_filetype_str(file->type),
+               'a' + file->part, (unsigned long)file->offset,
+               file->block_count);
+    }
+}
@@ -0,0 +1,154 @@
+/** \file   zipfile.h
+ * \brief   Filepacked zipcode handling - header
+ */
+
+/*
+ * This file is part of zipcode-conv
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef ZCC_ZIPFILE_H
+#define ZCC_ZIPFILE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbmdos.h"
+#include "d64.h"
+
+
+/** \brief  Maximum number of data parts (A! through W!, X! is the directory)
+ */
+#define ZCC_ZIPFILE_PART_MAX    23
+
+/** \brief  Maximum number of files in a filepacked archive
+ */
+#define ZCC_ZIPFILE_FILES_MAX   ZCC_D64_DIRENT_MAX
+
+/** \brief  Offset in a part of the number of blocks in the part
+ *
+ * Preceeded by a load address, usually $03ff.
+ */
+#define ZCC_ZIPFILE_PART_BLOCKS 0x02
+
+/** \brief  Offset in a part of the first zipcoded block
+ */
+#define ZCC_ZIPFILE_PART_DATA   0x03
+
+/** \brief  Offset in the X! file of the number of data parts
+ *
+ * Preceeded by a load address and a BASIC/ML program to list the archive.
+ */
+#define ZCC_ZIPFILE_DIR_PARTS   0x1ff
+
+/** \brief  Offset in the X! file of the number of files
+ */
+#define ZCC_ZIPFILE_DIR_FILES   0x200
+
+/** \brief  Offset in the X! file of the first directory entry
+ */
+#define ZCC_ZIPFILE_DIR_ENTRIES 0x201
+
+/** \brief  Size of a directory entry in the X! file
+ */
+#define ZCC_ZIPFILE_DIRENT_SIZE 0x15
+
+/** \brief  Offset in a directory entry of the PETSCII filename
+ */
+#define ZCC_ZIPFILE_DIRENT_NAME     0x00
+
+/** \brief  Offset in a directory entry of the filetype ("P", "S" or "U"
+ *          ORed with $80)
+ */
+#define ZCC_ZIPFILE_DIRENT_TYPE     0x10
+
+/** \brief  Offset in a directory entry of the size in blocks (16-bit LE)
+ */
+#define ZCC_ZIPFILE_DIRENT_BLOCKS   0x11
+
+/** \brief  Offset in a directory entry of the original track number
+ */
+#define ZCC_ZIPFILE_DIRENT_TRACK    0x13
+
+/** \brief  Offset in a directory entry of the original sector number
+ */
+#define ZCC_ZIPFILE_DIRENT_SECTOR   0x14
+
+
+/** \brief  Part of a filepacked archive
+ *
+ * Contents of an 'X!*' or '[A-W]!*' file
+ */
+typedef struct zcc_zipfile_part_s {
+    uint8_t *   data;   /**< file data */
+    size_t      size;   /**< file size */
+} zcc_zipfile_part_t;
+
+
+/** \brief  File in a filepacked archive
+ */
+typedef struct zcc_zipfile_entry_s {
+    uint8_t                 name[ZCC_CBMDOS_FILENAME_MAX];  /**< PETSCII name,
+                                                                 padded with
+                                                                 0xa0 */
+    zcc_cbmdos_filetype_t   type;   /**< file type */
+    int                     blocks; /**< size in blocks according to the
+                                         directory */
+    int                     track;  /**< original track of the first block */
+    int                     sector; /**< original sector of the first block */
+
+    int                     part;   /**< index of the part containing the
+                                         first block */
+    size_t                  offset; /**< offset in \c part of the first block */
+    int                     remaining;  /**< blocks left in \c part, including
+                                             the first block */
+    int                     block_count;    /**< number of blocks found in the
+                                                 archive */
+} zcc_zipfile_entry_t;
+
+
+/** \brief  Filepacked zipcode archive handle
+ */
+typedef struct zcc_zipfile_s {
+    zcc_zipfile_part_t  dir;    /**< directory (X!) */
+    zcc_zipfile_part_t  parts[ZCC_ZIPFILE_PART_MAX];    /**< data parts */
+    int                 part_count;     /**< number of data parts */
+    zcc_zipfile_entry_t files[ZCC_ZIPFILE_FILES_MAX];   /**< files */
+    int                 file_count;     /**< number of files */
+} zcc_zipfile_t;
+
+
+void zcc_zipfile_init(zcc_zipfile_t *zip);
+void zcc_zipfile_free(zcc_zipfile_t *zip);
+
+bool zcc_zipfile_read(zcc_zipfile_t *zip, const char *path);
+bool zcc_zipfile_read_d64(zcc_zipfile_t *zip,
+                          const zcc_d64_t *d64,
+                          const char *name);
+
+int  zcc_zipfile_find(const zcc_zipfile_t *zip, const char *name);
+long zcc_zipfile_file_read(const zcc_zipfile_t *zip, int index,
+                           uint8_t **dest);
+long zcc_zipfile_extract_file(const zcc_zipfile_t *zip, int index,
+                              const char *path);
+int  zcc_zipfile_extract(const zcc_zipfile_t *zip, const char *name,
+                         bool verbose);
+void zcc_zipfile_dump(const zcc_zipfile_t *zip);
+
+#endif
@@ -0,0 +1,187 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   bench_gcr.c
+ * \brief   Benchmark GCR decoding
+ *
+ * Decodes all sectors of a SixPack file repeatedly, with zcc_gcr_decode() and
+ * with a straightforward decoder that extracts and looks up each 5-bit code
+ * separately, and reports the throughput of both.
+ *
+ * Usage: gcr_bench [&lt;sixpack-file&gt; [&lt;iterations&gt;]]
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../src/errors.h"
+#include "../src/gcr.h"
+#include "../src/io.h"
+#include "../src/mem.h"
+#include "../src/sixpack.h"
+
+#define SIXPACK     "data/zipsix/1!!S1.PRG"
+#define ITERATIONS  200
+
+
+/** \brief  Decoder function type
+ */
+typedef bool (*decoder_t)(uint8_t *, const uint8_t *, size_t);
+
+
+/** \brief  Nybble for each 5-bit GCR code, -1 for invalid codes
+ */
+static const int nybbles[32] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1,  8,  0,  1, -1, 12,  4,  5,
+    -1, -1,  2,  3, -1, 15,  6,  7, -1,  9, 10, 11, -1, 13, 14, -1
+};
+
+
+/** \brief  Reference decoder: one 5-bit code at a time
+ *
+ * \param[out]  dest    decoded data
+ * \param[in]   src     GCR data
+ * \param[in]   groups  number of 5-byte groups to decode
+ *
+ * \return  false if \a src contained invalid GCR codes
+ */
+static bool decode_nybbles(uint8_t *dest, const uint8_t *src, size_t groups)
+{
+    size_t codes = groups * 8;
+    bool valid = true;
+
+    for (size_t i = 0; i < codes; i++) {
+        size_t bit = i * 5;
+        unsigned int word = (unsigned int)(src[bit / 8] << 8)
+            | (bit / 8 + 1 < groups * ZCC_GCR_GROUP_SIZE ? src[bit / 8 + 1] : 0);
+        int nybble = nybbles[(word >> (11 - bit % 8)) & 0x1f];
+
+        if (nybble < 0) {
+            valid = false;
+            nybble = 0;
+        }
+        if (i & 1) {
+            dest[i / 2] = (uint8_t)(dest[i / 2] | nybble);
+        } else {
+            dest[i / 2] = (uint8_t)(nybble << 4);
+        }
+    }
+    return valid;
+}
+
+
+/** \brief  Check that both decoders agree on all sector data of \a six
+ *
+ * \param[in]   six SixPack handle
+ *
+ * \return  bool
+ */
+static bool verify(const zcc_sixpack_t *six)
+{
+    for (int track = ZCC_D64_TRACK_MIN; track <= six->track_max; track++) {
+        const uint8_t *desc = six->tracks[track];
+        const uint8_t *data = desc + ZCC_SIXPACK_DESC_SIZE;
+        int count = desc[ZCC_SIXPACK_DESC_COUNT];
+
+        for (int slot = 0; slot < count; slot++) {
+            uint8_t lut[ZCC_SIXPACK_SECTOR_DATA];
+            uint8_t ref[ZCC_SIXPACK_SECTOR_DATA];
+            const uint8_t *src = data + slot * ZCC_GCR_DATA_SIZE;
+            size_t groups = ZCC_SIXPACK_SECTOR_DATA / ZCC_GCR_GROUP_DATA;
+
+            if (zcc_gcr_decode(lut, src, groups)
+                        != decode_nybbles(ref, src, groups)
+                    || memcmp(lut, ref, sizeof lut) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Decode all sector data of \a six \a iterations times
+ *
+ * \param[in]   six         SixPack handle
+ * \param[in]   decoder     decoder function
+ * \param[in]   iterations  number of passes
+ * \param[out]  bytes       number of GCR bytes decoded
+ *
+ * \return  CPU time used in seconds
+ */
+static double run(const zcc_sixpack_t *six, decoder_t decoder,
+                  int iterations, size_t *bytes)
+{
+    uint8_t sector[ZCC_SIXPACK_SECTOR_DATA];
+    clock_t start = clock();
+    unsigned int sink = 0;
+
+    *bytes = 0;
+    for (int i = 0; i < iterations; i++) {
+        for (int track = ZCC_D64_TRACK_MIN; track <= six->track_max; track++) {
+            const uint8_t *desc = six->tracks[track];
+            const uint8_t *data = desc + ZCC_SIXPACK_DESC_SIZE;
+            int count = desc[ZCC_SIXPACK_DESC_COUNT];
+
+            for (int slot = 0; slot < count; slot++) {
+                decoder(sector, data + slot * ZCC_GCR_DATA_SIZE,
+                        ZCC_SIXPACK_SECTOR_DATA / ZCC_GCR_GROUP_DATA);
+                sink += sector[0];
+                *bytes += ZCC_GCR_DATA_SIZE - 1;
+            }
+        }
+    }
+    if (sink == 1) {
+        /* keep the compiler from dropping the decoding */
+        putchar('\n');
+    }
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/** \brief  Entry point
+ *
+ * \param[in]   argc    argument count
+ * \param[in]   argv    argument vector
+ *
+ * \return  EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : SIXPACK;
+    int iterations = argc > 2 ? atoi(argv[2]) : ITERATIONS;
+    zcc_sixpack_t six;
+    size_t bytes;
+    double lut;
+    double ref;
+
+    zcc_sixpack_init(&six);
+    if (!zcc_sixpack_read(&six, path)) {
+        fprintf(stderr, "failed to read '%s': %s\n",
+                path, zcc_strerror(zcc_errno));
+        return EXIT_FAILURE;
+    }
+
+    /* also builds the lookup table outside of the timing */
+    if (!verify(&six)) {
+        fprintf(stderr, "decoders disagree\n");
+        zcc_sixpack_free(&six);
+        return EXIT_FAILURE;
+    }
+
+    lut = run(&six, zcc_gcr_decode, iterations, &bytes);
+    ref = run(&six, decode_nybbles, iterations, &bytes);
+
+    printf("%zu GCR bytes per pass, %d passes\n", bytes / (size_t)iterations,
+           iterations);
+    printf("table:   %8.3f s  %8.1f MB/s\n", lut, (double)bytes / lut / 1e6);
+    printf("nybbles: %8.3f s  %8.1f MB/s\n", ref, (double)bytes / ref / 1e6);
+    printf("speedup: %8.2fx\n", ref / lut);
+
+    zcc_sixpack_free(&six);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_ark.c
+ * \brief   Test ARK handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/d64file.h"
+#include "../src/errors.h"
+#include "../src/io.h"
+#include "../src/mem.h"
+#include "../src/ark.h"
+
+/** \brief  Temporary file for the ARK test
+ */
+#define ARK_TMP     "test_ark.tmp"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_ark_read(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "read", "Test reading an ARKive and converting it to D64",
+        test_ark_read, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t ark_module = {
+    "ark",
+    "Tests for the ARK code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Store a directory entry in ARKive \a data
+ *
+ * \param[out]  data    ARKive data
+ * \param[in]   index   index of the entry
+ * \param[in]   name    PETSCII name
+ * \param[in]   attr    attribute byte (file type and compression flag)
+ * \param[in]   blocks  size in blocks
+ * \param[in]   lsu     last sector usage
+ */
+static void set_dirent(uint8_t *data, int index, const char *name,
+                       int attr, int blocks, int lsu)
+{
+    uint8_t *dirent = data + 1 + index * ZCC_ARK_DIRENT_SIZE;
+
+    dirent[ZCC_ARK_DIRENT_TYPE] = (uint8_t)attr;
+    dirent[ZCC_ARK_DIRENT_LSU] = (uint8_t)lsu;
+    memset(dirent + ZCC_ARK_DIRENT_FILENAME, 0xa0, ZCC_CBMDOS_FILENAME_MAX);
+    memcpy(dirent + ZCC_ARK_DIRENT_FILENAME, name, strlen(name));
+    dirent[ZCC_ARK_DIRENT_BLOCKS] = (uint8_t)(blocks & 0xff);
+    dirent[ZCC_ARK_DIRENT_BLOCKS + 1] = (uint8_t)(blocks >> 8);
+}
+
+
+/** \brief  Read an ARKive with a compressed member and convert it to D64
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_ark_read(int *total, int *passed)
+{
+    static uint8_t data[5 * ZCC_ARK_BLOCK_SIZE];
+    static uint8_t buffer[2 * ZCC_ARK_BLOCK_SIZE];
+    long first_size = ZCC_ARK_BLOCK_SIZE + 50;
+    zcc_ark_t *ark;
+    zcc_d64_t d64;
+    zcc_d64_file_t file;
+    const uint8_t *dirblock;
+    int start = *passed;
+
+    memset(data, 0, sizeof data);
+    data[ZCC_ARK_FILE_COUNT] = 3;
+    set_dirent(data, 0, "FIRST", ZCC_CBMDOS_FILETYPE_PRG, 2, 51);
+    set_dirent(data, 1, "PACKED",
+               ZCC_CBMDOS_FILETYPE_SEQ | ZCC_ARK_COMPRESSED_MASK, 1, 20);
+    set_dirent(data, 2, "LOST", ZCC_CBMDOS_FILETYPE_USR, 1, 10);
+    for (size_t i = ZCC_ARK_BLOCK_SIZE; i < sizeof data; i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+
+    ark = zcc_malloc(sizeof *ark);
+    zcc_ark_init(ark);
+    zcc_d64_init(&d64);
+
+    (*total)++;
+    if (zcc_fwrite(ARK_TMP, data, sizeof data)
+            && zcc_ark_read(ark, ARK_TMP)
+            && ark->dir_blocks == 1
+            && ark->entry_count == 3
+            && ark->entries[0].type == ZCC_CBMDOS_FILETYPE_PRG
+            && ark->entries[0].data == ark->data + ZCC_ARK_BLOCK_SIZE
+            && ark->entries[0].size == (size_t)first_size
+            && ark->entries[1].compressed
+            && ark->entries[1].data == NULL
+            && ark->entries[2].data == NULL
+            && ark->unavailable == 2
+            && ark->truncated == 0) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+    remove(ARK_TMP);
+
+    (*total)++;
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+    dirblock = d64.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                               ZCC_D64_DIR_SECTOR);
+    if (ark->entry_count == 3
+            && zcc_ark_to_d64(ark, &d64, "ark") == 1
+            && zcc_d64_file_open_entry(&file, &d64, dirblock)
+            && zcc_d64_file_read(&file, buffer, sizeof buffer) == first_size
+            && memcmp(buffer, data + ZCC_ARK_BLOCK_SIZE, (size_t)first_size) == 0
+            && memcmp(dirblock + ZCC_D64_DIRENT_FILENAME, "FIRST", 5) == 0
+            && dirblock[ZCC_D64_DIRENT_SIZE + ZCC_D64_DIRENT_FILETYPE] == 0) {
+        (*passed)++;
+    }
+
+    zcc_d64_free(&d64);
+    zcc_ark_free(ark);
+    zcc_free(ark);
+    return *passed - start == 2;
+}
@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_ark.h
+ * \brief   Test ARK handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_ARK_H
+#define HAVE_TESTS_TEST_ARK_H
+
+extern unit_module_t ark_module;
+
+#endif
@@ -0,0 +1,234 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_bam.c
+ * \brief   Test BAM handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/bam.h"
+#include "../src/d64map.h"
+#include "../src/d64write.h"
+#include "../src/errors.h"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_bam_free(int *, int *);
+static bool test_bam_alloc(int *, int *);
+static bool test_bam_store(int *, int *);
+static bool test_bam_rebuild(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "free", "Test counting free blocks",
+        test_bam_free, true },
+    { "alloc", "Test allocating blocks with interleave",
+        test_bam_alloc, true },
+    { "store", "Test writing and reading back an extended BAM",
+        test_bam_store, true },
+    { "rebuild", "Test rebuilding the BAM from the file chains",
+        test_bam_rebuild, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t bam_module = {
+    "bam",
+    "Tests for the BAM code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Test counting free blocks of empty 35 and 40 track BAMs
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_bam_free(int *total, int *passed)
+{
+    zcc_bam_t bam;
+    int blocks;
+
+    (*total)++;
+    zcc_bam_init(&bam, ZCC_D64_TYPE_CBMDOS, ZCC_D64_TRACK_MAX);
+    blocks = zcc_bam_blocks_free(&bam);
+    printf(".. 35 tracks: %d blocks free (expected 664)\n", blocks);
+    if (blocks == 664) {
+        (*passed)++;
+    }
+
+    (*total)++;
+    zcc_bam_init(&bam, ZCC_D64_TYPE_SPEEDDOS, ZCC_D64_TRACK_MAX_EXT);
+    blocks = zcc_bam_blocks_free(&bam);
+    printf(".. 40 tracks: %d blocks free (expected 749)\n", blocks);
+    if (blocks == 749) {
+        (*passed)++;
+    }
+    return *total == *passed;
+}
+
+
+/** \brief  Test 1541-style block allocation
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_bam_alloc(int *total, int *passed)
+{
+    /* expected blocks for a file, starting on an empty disk */
+    static const int expected[][2] = {
+        { 17, 0 }, { 17, 10 }, { 17, 20 }, { 17, 8 }, { 17, 18 }
+    };
+    zcc_bam_t bam;
+    int track;
+    int sector;
+    int used;
+    int start = *passed;
+
+    zcc_bam_init(&bam, ZCC_D64_TYPE_CBMDOS, ZCC_D64_TRACK_MAX);
+    zcc_bam_alloc_first(&bam, &track, &sector);
+    for (size_t i = 0; i < sizeof expected / sizeof expected[0]; i++) {
+        (*total)++;
+        printf(".. block %d: (%d,%d)\n", (int)i, track, sector);
+        if (track == expected[i][0] && sector == expected[i][1]) {
+            (*passed)++;
+        }
+        zcc_bam_alloc_next(&bam, &track, &sector, ZCC_BAM_INTERLEAVE_FILE);
+    }
+
+    /* fill up the disk: all blocks except the directory track are used */
+    used = 6;
+    while (zcc_bam_alloc_next(&bam, &track, &sector, ZCC_BAM_INTERLEAVE_FILE)) {
+        used++;
+    }
+    (*total)++;
+    printf(".. allocated %d blocks, %d free\n",
+           used, zcc_bam_blocks_free(&bam));
+    if (used == 664 && zcc_bam_blocks_free(&bam) == 0
+            && zcc_errno == ZCC_ERR_DISK_FULL) {
+        (*passed)++;
+    }
+    return *passed - start == 6;
+}
+
+
+/** \brief  Test storing a DolphinDOS BAM and loading it back
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_bam_store(int *total, int *passed)
+{
+    zcc_d64_t d64;
+    zcc_bam_t bam;
+    zcc_bam_t copy;
+    uint64_t blocks[ZCC_D64_BITMAP_WORDS] = { 0 };
+    const uint8_t *entry;
+    bool result;
+
+    zcc_d64_init(&d64);
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_DOLPHINDOS);
+
+    /* mark track 36 and (40,16) as used in bulk */
+    for (int s = 0; s < 17; s++) {
+        ZCC_D64_BITMAP_SET(blocks, zcc_d64_block_index(36, s));
+    }
+    ZCC_D64_BITMAP_SET(blocks, zcc_d64_block_index(40, 16));
+
+    zcc_bam_init(&bam, ZCC_D64_TYPE_DOLPHINDOS, ZCC_D64_TRACK_MAX_EXT);
+    zcc_bam_mark_used_bitmap(&bam, blocks);
+    zcc_bam_store(&bam, &d64);
+    zcc_bam_load(&copy, &d64);
+
+    (*total)++;
+    entry = d64.data + ZCC_D64_BAM_OFFSET + ZCC_D64_BAM_TRACKS_DOLPHINDOS;
+    printf(".. track 36 entry: %02x %02x %02x %02x, blocks free: %d\n",
+           entry[0], entry[1], entry[2], entry[3],
+           zcc_bam_blocks_free(&copy));
+    result = copy.track_max == ZCC_D64_TRACK_MAX_EXT
+        && entry[0] == 0 && entry[1] == 0 && entry[2] == 0
+        && zcc_bam_track_free(&copy, 40) == 16
+        && zcc_bam_blocks_free(&copy) == 749 - 18;
+    if (result) {
+        (*passed)++;
+    }
+    zcc_d64_free(&d64);
+    return result;
+}
+
+
+/** \brief  Test rebuilding the BAM, and refusing to with a broken chain
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_bam_rebuild(int *total, int *passed)
+{
+    static uint8_t data[ZCC_D64_BLOCK_SIZE_DATA * 3];
+    zcc_d64_t d64;
+    zcc_d64_newfile_t file;
+    const uint8_t *entry;
+    uint8_t *block;
+    int start = *passed;
+
+    zcc_d64_init(&d64);
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&d64, "rebuild", "rb");
+    memset(&file, 0, sizeof file);
+    file.name = "chain";
+    file.type = ZCC_CBMDOS_FILETYPE_PRG;
+    file.data = data;
+    file.size = sizeof data;
+
+    /* a consistent image needs no changes */
+    (*total)++;
+    if (zcc_d64_write_file(&d64, &file)
+            && zcc_d64_rebuild_bam(&d64) == 0
+            && zcc_d64_blocks_free(&d64) == 661) {
+        (*passed)++;
+    }
+
+    /* point the first block past the last track: the rest of the chain is
+     * unknown, so the BAM must be left alone */
+    entry = d64.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                            ZCC_D64_DIR_SECTOR);
+    block = d64.data + zcc_d64_block_offset(ZCC_D64_DIRENT_GET_TRACK(entry),
+                                            ZCC_D64_DIRENT_GET_SECTOR(entry));
+    block[ZCC_D64_BLOCK_TRACK] = 50;
+    (*total)++;
+    if (zcc_d64_rebuild_bam(&d64) < 0
+            && zcc_errno == ZCC_ERR_INVALID_IMAGE
+            && zcc_d64_blocks_free(&d64) == 661) {
+        (*passed)++;
+    } else {
+        printf(".. BAM rebuilt from a broken chain\n");
+    }
+
+    zcc_d64_free(&d64);
+    return *passed - start == 2;
+}
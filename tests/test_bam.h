@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_bam.h
+ * \brief   Test BAM handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_BAM_H
+#define HAVE_TESTS_TEST_BAM_H
+
+extern unit_module_t bam_module;
+
+#endif
@@ -7,15 +7,23 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #include "unit.h"
 
+#include "../src/bam.h"
 #include "../src/d64.h"
+#include "../src/d64write.h"
 #include "../src/errors.h"
+#include "../src/petasc.h"
 
 #define ARMALYTE    "data/d64/armalyte-rem.d64"
+#define GUMBO       "data/d64/gumbo_dec2019.d64"
+
+/** \brief  Temporary file for the error info test */
+#define ERRORS_TMP  "test_d64_errors.tmp"
 
 
 /*
@@ -26,11 +34,20 @@ static bool setup(void);
 static bool teardown(void);
 
 static bool test_d64_read(int *, int *);
+static bool test_d64_geometry(int *, int *);
+static bool test_d64_errors(int *, int *);
+static bool test_d64_dirview(int *, int *);
 
 
 /** \brief  Test cases
  */
 static unit_test_t tests[] = {
+    { "geometry", "Test D71 and D81 geometries",
+        test_d64_geometry, true },
+    { "errors", "Test D64 images with error info",
+        test_d64_errors, true },
+    { "dirview", "Test iterating the directory without copying",
+        test_d64_dirview, true },
     { "read", "Test reading a D64 image",
         test_d64_read, false },
     { NULL, NULL, NULL, NULL }
@@ -105,3 +122,235 @@ static bool test_d64_read(int *total, int *passed)
     zcc_d64_free(&d64);
     return result;
 }
+
+
+/** \brief  Format \a d64 with an empty BAM and a single directory entry
+ *
+ * \param[in,out]   d64     image of any geometry
+ */
+static void format_image(zcc_d64_t *d64)
+{
+    const zcc_d64_geometry_t *geometry = d64->geometry;
+    zcc_bam_t bam;
+    uint8_t *dir;
+
+    zcc_bam_load(&bam, d64);
+    for (int track = 1; track <= geometry->track_max; track++) {
+        for (int sector = 0; sector < geometry->sectors[track]; sector++) {
+            zcc_bam_mark_free(&bam, track, sector);
+        }
+    }
+    zcc_bam_mark_used(&bam, geometry->dir_track, geometry->dir_sector);
+    zcc_bam_store(&bam, d64);
+
+    dir = d64->data + zcc_d64_geometry_block_offset(geometry,
+                                                    geometry->dir_track,
+                                                    geometry->dir_sector);
+    dir[ZCC_D64_BLOCK_SECTOR] = 0xff;
+    dir[ZCC_D64_DIRENT_FILETYPE] = 0x82;
+    memcpy(dir + ZCC_D64_DIRENT_FILENAME, "FILE", 4);
+}
+
+
+/** \brief  Test block offsets, BAM and directory of D71 and D81 images
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64_geometry(int *total, int *passed)
+{
+    const zcc_d64_geometry_t *d71 = zcc_d64_geometry(ZCC_D64_FORMAT_D71);
+    const zcc_d64_geometry_t *d81 = zcc_d64_geometry(ZCC_D64_FORMAT_D81);
+    zcc_d64_dirview_t view;
+    zcc_d64_t d64;
+    int start = *passed;
+
+    /* offsets from the format descriptions */
+    (*total)++;
+    if (zcc_d64_block_offset(18, 0) == ZCC_D64_BAM_OFFSET
+            && zcc_d64_geometry_block_offset(d71, 36, 0) == 0x2ab00
+            && zcc_d64_geometry_block_offset(d71, 53, 0) == 0x41000
+            && zcc_d64_geometry_block_index(d71, 70, 16) == ZCC_D71_BLOCKS - 1
+            && zcc_d64_geometry_block_index(d71, 71, 0) < 0
+            && zcc_d64_geometry_block_index(d71, 53, 19) < 0
+            && zcc_d64_geometry_block_offset(d81, 40, 0) == 0x61800
+            && zcc_d64_geometry_block_index(d81, 80, 39) == ZCC_D81_BLOCKS - 1
+            && zcc_d64_geometry_block_index(d81, 1, 40) < 0) {
+        (*passed)++;
+    }
+
+    /* D71: tracks 18 and 53 don't count as free */
+    (*total)++;
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_format(&d64, ZCC_D64_FORMAT_D71);
+    format_image(&d64);
+    if (d64.size == ZCC_D71_SIZE
+            && zcc_d64_blocks_free(&d64) == 1328
+            && d64.data[ZCC_D64_BAM_OFFSET + ZCC_D71_BAM_COUNTS] == 21
+            && zcc_d64_dirview_read(&view, &d64)
+            && view.entry_count == 1) {
+        (*passed)++;
+    }
+    zcc_d64_free(&d64);
+
+    /* D81: header, BAM and directory on track 40 */
+    (*total)++;
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_format(&d64, ZCC_D64_FORMAT_D81);
+    format_image(&d64);
+    if (d64.size == ZCC_D81_SIZE
+            && zcc_d64_blocks_free(&d64) == 3160
+            && zcc_d64_dirview_read(&view, &d64)
+            && view.entry_count == 1
+            && view.diskname == d64.data + 0x61800 + ZCC_D81_DISKNAME) {
+        (*passed)++;
+    }
+    zcc_d64_free(&d64);
+
+    return *passed - start == 3;
+}
+
+
+/** \brief  Test writing and reading back a D64 with error info
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64_errors(int *total, int *passed)
+{
+    zcc_d64_t d64;
+    zcc_d64_t copy;
+    int start = *passed;
+
+    zcc_d64_init(&d64);
+    zcc_d64_init(&copy);
+
+    (*total)++;
+    if (zcc_d64_read(&d64, GUMBO, 0) && d64.errors == NULL
+            && zcc_d64_block_error(&d64, 1, 0) == ZCC_D64_ERROR_NONE) {
+        (*passed)++;
+    }
+
+    /* the error info is a view into the image data */
+    (*total)++;
+    zcc_d64_errors_attach(&d64);
+    d64.errors[zcc_d64_block_index(35, 16)] = ZCC_D64_ERROR_ID_MISMATCH;
+    if (zcc_d64_write(&d64, ERRORS_TMP)
+            && zcc_d64_read(&copy, ERRORS_TMP, 0)
+            && copy.size == ZCC_D64_SIZE_CBMDOS
+            && copy.errors == copy.data + ZCC_D64_SIZE_CBMDOS
+            && memcmp(copy.data, d64.data, ZCC_D64_SIZE_CBMDOS) == 0
+            && zcc_d64_block_error(&copy, 35, 15) == ZCC_D64_ERROR_OK
+            && zcc_d64_block_error(&copy, 35, 16) == ZCC_D64_ERROR_ID_MISMATCH
+            && zcc_d64_block_error(&copy, 36, 0) == ZCC_D64_ERROR_NONE) {
+        (*passed)++;
+    }
+    remove(ERRORS_TMP);
+
+    zcc_d64_free(&copy);
+    zcc_d64_free(&d64);
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test the directory view iterator
+ *
+ * The view must match the copying directory reader, point into the image
+ * data, follow the directory chain to the next block and stop on a chain
+ * linking back to itself.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64_dirview(int *total, int *passed)
+{
+    static zcc_d64_dir_t dir;
+    zcc_d64_dirview_iter_t iter;
+    zcc_d64_dirview_t view;
+    zcc_d64_newfile_t files[10];
+    char names[10][8];
+    char host[ZCC_CBMDOS_FILENAME_MAX + 1];
+    zcc_d64_t d64;
+    uint8_t *block;
+    bool ok = true;
+    int count = 0;
+    int start = *passed;
+
+    /* same entries as the copying reader, pointing into the image data */
+    zcc_d64_init(&d64);
+    (*total)++;
+    if (zcc_d64_read(&d64, GUMBO, 0)) {
+        zcc_d64_dir_init(&dir, &d64);
+        ok = zcc_d64_dir_read(&dir)
+            && zcc_d64_dirview_iter_init(&iter, &d64);
+        while (ok) {
+            const zcc_d64_dirent_t *dirent = &(dir.entries[count]);
+
+            ok = count < dir.entry_count
+                && iter.index == count
+                && iter.entry >= d64.data
+                && iter.entry < d64.data + d64.size
+                && ZCC_D64_DIRENT_GET_FILETYPE(iter.entry) == dirent->filetype
+                && ZCC_D64_DIRENT_GET_TRACK(iter.entry) == dirent->track
+                && ZCC_D64_DIRENT_GET_SECTOR(iter.entry) == dirent->sector
+                && ZCC_D64_DIRENT_GET_BLOCKS(iter.entry) == dirent->blocks
+                && memcmp(ZCC_D64_DIRENT_GET_NAME(iter.entry), dirent->name,
+                          ZCC_CBMDOS_FILENAME_MAX) == 0;
+            count++;
+            if (!zcc_d64_dirview_iter_next(&iter)) {
+                break;
+            }
+        }
+        printf(".. %d entries, %d in view\n", dir.entry_count, count);
+        if (ok && count == dir.entry_count) {
+            (*passed)++;
+        }
+    }
+    zcc_d64_free(&d64);
+
+    /* ten files take two directory blocks */
+    zcc_d64_init(&d64);
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&d64, "dirview", "dv");
+    memset(files, 0, sizeof files);
+    for (int i = 0; i < 10; i++) {
+        snprintf(names[i], sizeof names[i], "file%d", i);
+        files[i].name = names[i];
+        files[i].type = ZCC_CBMDOS_FILETYPE_PRG;
+        files[i].data = (const uint8_t *)names[i];
+        files[i].size = strlen(names[i]);
+    }
+    (*total)++;
+    ok = zcc_d64_write_files(&d64, files, 10) == 10
+        && zcc_d64_dirview_read(&view, &d64)
+        && view.entry_count == 10;
+    for (int i = 0; i < 10 && ok; i++) {
+        zcc_pet_filename_to_host(host,
+                                 ZCC_D64_DIRENT_GET_NAME(view.entries[i]),
+                                 NULL);
+        ok = strcmp(host, names[i]) == 0;
+    }
+    if (ok && view.entries[8] - view.entries[0] != 8 * ZCC_D64_DIRENT_SIZE) {
+        (*passed)++;
+    }
+
+    /* directory block linking to itself */
+    (*total)++;
+    block = d64.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                            ZCC_D64_DIR_SECTOR);
+    block[ZCC_D64_BLOCK_TRACK] = ZCC_D64_DIR_TRACK;
+    block[ZCC_D64_BLOCK_SECTOR] = ZCC_D64_DIR_SECTOR;
+    if (zcc_d64_dirview_read(&view, &d64)
+            && view.entry_count == d64.geometry->dirent_max) {
+        (*passed)++;
+    }
+    zcc_d64_free(&d64);
+
+    return *passed - start == 3;
+}
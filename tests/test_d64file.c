@@ -0,0 +1,666 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_d64file.c
+ * \brief   Test D64 file streaming
+ */
+
+/* mkdir(), rmdir(), IOV_MAX */
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/d64extract.h"
+#include "../src/d64file.h"
+#include "../src/d64rel.h"
+#include "../src/d64write.h"
+#include "../src/errors.h"
+#include "../src/io.h"
+#include "../src/mem.h"
+
+#define GUMBO   "data/d64/gumbo_dec2019.d64"
+
+/** \brief  Temporary file for the extraction test
+ */
+#define EXTRACT_TMP     "test_d64file.tmp"
+
+/** \brief  Temporary directory for the extraction test
+ */
+#define EXTRACT_TMP_DIR "test_d64file_tmp"
+
+/** \brief  Number of files extracted by the worker threads
+ */
+#define EXTRACT_FILES   8
+
+#ifndef IOV_MAX
+/** \brief  Fallback for the maximum number of vectors passed to writev()
+ */
+# define IOV_MAX    16
+#endif
+
+
+/*
+ * Forward declarations
+ */
+
+static bool setup(void);
+static bool teardown(void);
+
+static bool test_d64file_read(int *, int *);
+static bool test_d64file_seek(int *, int *);
+static bool test_d64file_write(int *, int *);
+static bool test_d64file_rel(int *, int *);
+static bool test_d64file_rel_sides(int *, int *);
+static bool test_d64file_extract(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "read", "Test reading a file in chunks and spans",
+        test_d64file_read, true },
+    { "seek", "Test seeking in a file",
+        test_d64file_seek, true },
+    { "write", "Test writing files to a new image and reading them back",
+        test_d64file_write, true },
+    { "rel", "Test reading records of a REL file through its side sectors",
+        test_d64file_rel, true },
+    { "rel_sides", "Test a REL file indexed by two side sectors",
+        test_d64file_rel_sides, true },
+    { "extract", "Test extracting files to the host with writev()",
+        test_d64file_extract, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t d64file_module = {
+    "d64file",
+    "Tests for the D64 file streaming code",
+    setup, teardown,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Test image
+ */
+static zcc_d64_t d64;
+
+/** \brief  First file in the directory of the test image
+ */
+static const uint8_t *entry;
+
+/** \brief  Contents of the first file, read in one go
+ */
+static uint8_t contents[ZCC_D64_BLOCKS_MAX * ZCC_D64_BLOCK_SIZE_DATA];
+
+/** \brief  Size of the first file
+ */
+static long contents_size;
+
+
+/** \brief  Setup function
+ *
+ * Loads the test image and reads its first file.
+ *
+ * \return  true on success
+ */
+static bool setup(void)
+{
+    zcc_d64_dirview_t view;
+    zcc_d64_file_t file;
+
+    zcc_d64_init(&d64);
+    if (!zcc_d64_read(&d64, GUMBO, 0) || !zcc_d64_dirview_read(&view, &d64)) {
+        zcc_perror(__func__);
+        return false;
+    }
+    entry = view.entries[0];
+    if (!zcc_d64_file_open_entry(&file, &d64, entry)) {
+        zcc_perror(__func__);
+        return false;
+    }
+    contents_size = zcc_d64_file_read(&file, contents, sizeof contents);
+    zcc_d64_file_close(&file);
+    printf(".. first file: %ld bytes\n", contents_size);
+    return contents_size > 0;
+}
+
+
+/** \brief  Teardown function
+ *
+ * \return  true
+ */
+static bool teardown(void)
+{
+    zcc_d64_free(&d64);
+    return true;
+}
+
+
+/** \brief  Test reading in odd-sized chunks and via spans
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64file_read(int *total, int *passed)
+{
+    static uint8_t buffer[sizeof contents];
+    zcc_d64_file_t file;
+    const uint8_t *data;
+    long size = 0;
+    long result;
+    int start = *passed;
+
+    /* chunks of 100 bytes */
+    (*total)++;
+    zcc_d64_file_open_entry(&file, &d64, entry);
+    while ((result = zcc_d64_file_read(&file, buffer + size, 100)) > 0) {
+        size += result;
+    }
+    printf(".. chunked read: %ld bytes\n", size);
+    if (size == contents_size && memcmp(buffer, contents, (size_t)size) == 0
+            && zcc_d64_file_length(&file) == contents_size) {
+        (*passed)++;
+    }
+    zcc_d64_file_close(&file);
+
+    /* spans */
+    (*total)++;
+    size = 0;
+    zcc_d64_file_open_entry(&file, &d64, entry);
+    while ((result = zcc_d64_file_span(&file, &data)) > 0) {
+        if (size + result > contents_size
+                || memcmp(data, contents + size, (size_t)result) != 0) {
+            break;
+        }
+        size += result;
+    }
+    printf(".. spans: %ld bytes\n", size);
+    if (result == 0 && size == contents_size) {
+        (*passed)++;
+    }
+    zcc_d64_file_close(&file);
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test seeking
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64file_seek(int *total, int *passed)
+{
+    zcc_d64_file_t file;
+    uint8_t buffer[10];
+    int start = *passed;
+
+    zcc_d64_file_open_entry(&file, &d64, entry);
+
+    /* across a block boundary */
+    (*total)++;
+    if (zcc_d64_file_seek(&file, 500, SEEK_SET)
+            && zcc_d64_file_read(&file, buffer, 10) == 10
+            && memcmp(buffer, contents + 500, 10) == 0
+            && zcc_d64_file_tell(&file) == 510) {
+        (*passed)++;
+    }
+
+    /* relative to the end */
+    (*total)++;
+    if (zcc_d64_file_seek(&file, -3, SEEK_END)
+            && zcc_d64_file_read(&file, buffer, 10) == 3
+            && memcmp(buffer, contents + contents_size - 3, 3) == 0) {
+        (*passed)++;
+    }
+
+    /* past the end */
+    (*total)++;
+    if (!zcc_d64_file_seek(&file, contents_size + 1, SEEK_SET)
+            && zcc_errno == ZCC_ERR_SEEK_RANGE) {
+        (*passed)++;
+    }
+
+    zcc_d64_file_close(&file);
+    return *passed - start == 3;
+}
+
+
+/** \brief  Test writing files to a fresh image
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64file_write(int *total, int *passed)
+{
+    static uint8_t buffer[sizeof contents];
+    zcc_d64_t image;
+    zcc_d64_file_t file;
+    zcc_d64_newfile_t files[3];
+    const uint8_t *dir;
+    long blocks;
+    int start = *passed;
+
+    zcc_d64_init(&image);
+    zcc_d64_alloc(&image, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&image, "test", "zc");
+    memset(files, 0, sizeof files);
+
+    /* the first file of the test image, an empty file and exactly a block */
+    files[0].name = "first";
+    files[0].type = ZCC_CBMDOS_FILETYPE_PRG;
+    files[0].data = contents;
+    files[0].size = (size_t)contents_size;
+    files[1].name = "empty";
+    files[1].type = ZCC_CBMDOS_FILETYPE_SEQ;
+    files[1].data = contents;
+    files[1].size = 0;
+    files[2].name = "block";
+    files[2].type = ZCC_CBMDOS_FILETYPE_USR;
+    files[2].data = contents;
+    files[2].size = ZCC_D64_BLOCK_SIZE_DATA;
+    blocks = (contents_size + ZCC_D64_BLOCK_SIZE_DATA - 1)
+        / ZCC_D64_BLOCK_SIZE_DATA + 2;
+
+    (*total)++;
+    if (zcc_d64_write_files(&image, files, 3) == 3
+            && zcc_d64_blocks_free(&image) == 664 - blocks) {
+        (*passed)++;
+    }
+
+    /* read back through the directory */
+    (*total)++;
+    dir = image.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                            ZCC_D64_DIR_SECTOR);
+    if (zcc_d64_file_open_entry(&file, &image, dir)
+            && zcc_d64_file_read(&file, buffer, sizeof buffer) == contents_size
+            && memcmp(buffer, contents, (size_t)contents_size) == 0
+            && zcc_d64_file_open_entry(&file, &image, dir + ZCC_D64_DIRENT_SIZE)
+            && zcc_d64_file_length(&file) == 0
+            && zcc_d64_file_open_entry(&file, &image, dir + 2 * ZCC_D64_DIRENT_SIZE)
+            && zcc_d64_file_length(&file) == ZCC_D64_BLOCK_SIZE_DATA) {
+        (*passed)++;
+    }
+
+    /* a file that doesn't fit leaves the BAM untouched */
+    (*total)++;
+    files[0].size = sizeof contents;
+    if (!zcc_d64_write_file(&image, &files[0])
+            && zcc_errno == ZCC_ERR_DISK_FULL
+            && zcc_d64_blocks_free(&image) == 664 - blocks) {
+        (*passed)++;
+    }
+
+    /* the allocator only knows the 1541 layout */
+    zcc_d64_free(&image);
+    zcc_d64_init(&image);
+    zcc_d64_alloc_format(&image, ZCC_D64_FORMAT_D71);
+    (*total)++;
+    if (zcc_d64_write_files(&image, files, 3) == 0
+            && zcc_errno == ZCC_ERR_UNSUPPORTED) {
+        (*passed)++;
+    }
+
+    zcc_d64_free(&image);
+    return *passed - start == 4;
+}
+
+
+/** \brief  Test reading records of a REL file
+ *
+ * Builds a REL file of 100-byte records in three data blocks (600 bytes)
+ * with a single side sector, so record 2 spans the first two blocks.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64file_rel(int *total, int *passed)
+{
+    zcc_d64_t image;
+    zcc_d64_rel_t *rel;
+    uint8_t *dir;
+    uint8_t *side;
+    uint8_t record[100];
+    int start = *passed;
+    bool ok = true;
+
+    zcc_d64_init(&image);
+    zcc_d64_alloc(&image, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&image, "rel", "00");
+
+    dir = image.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                            ZCC_D64_DIR_SECTOR);
+    dir[ZCC_D64_DIRENT_FILETYPE] = 0x84;
+    dir[ZCC_D64_DIRENT_TRACK] = 1;
+    dir[ZCC_D64_DIRENT_SECTOR] = 0;
+    dir[ZCC_D64_DIRENT_SSB_TRACK] = 1;
+    dir[ZCC_D64_DIRENT_SSB_SECTOR] = 10;
+    dir[ZCC_D64_DIRENT_REL_LENGTH] = sizeof record;
+
+    /* data blocks 1/0, 1/1 and 1/2, the byte at offset N is N * 7 */
+    for (int b = 0; b < 3; b++) {
+        uint8_t *block = image.data + zcc_d64_block_offset(1, b);
+
+        block[ZCC_D64_BLOCK_TRACK] = b < 2 ? 1 : 0;
+        block[ZCC_D64_BLOCK_SECTOR] = (uint8_t)(b < 2 ? b + 1 : 92 + 1);
+        for (int i = 0; i < ZCC_D64_BLOCK_SIZE_DATA; i++) {
+            block[ZCC_D64_BLOCK_DATA + i] =
+                (uint8_t)((b * ZCC_D64_BLOCK_SIZE_DATA + i) * 7);
+        }
+    }
+    side = image.data + zcc_d64_block_offset(1, 10);
+    side[ZCC_D64_BLOCK_TRACK] = 0;
+    side[ZCC_D64_BLOCK_SECTOR] = ZCC_D64_REL_SIDE_DATA + 3 * 2 - 1;
+    side[ZCC_D64_REL_SIDE_NUMBER] = 0;
+    side[ZCC_D64_REL_SIDE_RECORD_SIZE] = sizeof record;
+    side[0x04] = 1;
+    side[0x05] = 10;
+    for (int b = 0; b < 3; b++) {
+        side[ZCC_D64_REL_SIDE_DATA + b * 2] = 1;
+        side[ZCC_D64_REL_SIDE_DATA + b * 2 + 1] = (uint8_t)b;
+    }
+
+    rel = zcc_malloc(sizeof *rel);
+
+    (*total)++;
+    if (zcc_d64_rel_open(rel, &image, dir)
+            && rel->block_count == 3
+            && rel->side_sectors == 1
+            && rel->size == 600
+            && rel->record_count == 6) {
+        (*passed)++;
+    }
+
+    (*total)++;
+    for (long r = 0; r < 6 && ok; r++) {
+        ok = zcc_d64_rel_read_record(rel, r, record) == (long)sizeof record;
+        for (int i = 0; i < (int)sizeof record && ok; i++) {
+            ok = record[i] == (uint8_t)((r * (long)sizeof record + i) * 7);
+        }
+    }
+    if (ok
+            && zcc_d64_rel_read_record(rel, 6, record) < 0
+            && zcc_errno == ZCC_ERR_SEEK_RANGE) {
+        (*passed)++;
+    }
+
+    zcc_free(rel);
+    zcc_d64_free(&image);
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test reading records of a REL file with two side sectors
+ *
+ * Builds a REL file of 200-byte records in 125 data blocks, stored on tracks
+ * 6 down to 1 so the data blocks are in reverse order of their block index.
+ * The first side sector lists 120 blocks, the second the remaining 5, so
+ * record 152 spans the last block of the first side sector and the first
+ * block of the second.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64file_rel_sides(int *total, int *passed)
+{
+    zcc_d64_t image;
+    zcc_d64_rel_t *rel;
+    uint8_t *dir;
+    uint8_t *sides[2];
+    uint8_t track[125];
+    uint8_t sector[125];
+    uint8_t record[200];
+    int start = *passed;
+    bool ok = true;
+
+    zcc_d64_init(&image);
+    zcc_d64_alloc(&image, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&image, "rel", "00");
+
+    dir = image.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                            ZCC_D64_DIR_SECTOR);
+    dir[ZCC_D64_DIRENT_FILETYPE] = 0x84;
+    dir[ZCC_D64_DIRENT_SSB_TRACK] = 19;
+    dir[ZCC_D64_DIRENT_SSB_SECTOR] = 0;
+    dir[ZCC_D64_DIRENT_REL_LENGTH] = sizeof record;
+
+    /* data blocks, the byte at offset N is N * 7 + N / 256 */
+    for (int b = 0; b < 125; b++) {
+        track[b] = (uint8_t)(6 - b / 21);
+        sector[b] = (uint8_t)(20 - b % 21);
+    }
+    dir[ZCC_D64_DIRENT_TRACK] = track[0];
+    dir[ZCC_D64_DIRENT_SECTOR] = sector[0];
+    for (int b = 0; b < 125; b++) {
+        uint8_t *block = image.data + zcc_d64_block_offset(track[b], sector[b]);
+
+        block[ZCC_D64_BLOCK_TRACK] = b < 124 ? track[b + 1] : 0;
+        block[ZCC_D64_BLOCK_SECTOR] = b < 124 ? sector[b + 1] : 0xff;
+        for (int i = 0; i < ZCC_D64_BLOCK_SIZE_DATA; i++) {
+            long n = (long)b * ZCC_D64_BLOCK_SIZE_DATA + i;
+
+            block[ZCC_D64_BLOCK_DATA + i] = (uint8_t)(n * 7 + n / 256);
+        }
+    }
+
+    /* side sectors 19/0 and 19/1 */
+    for (int s = 0; s < 2; s++) {
+        int first = s * ZCC_D64_REL_SIDE_BLOCKS;
+        int count = s == 0 ? ZCC_D64_REL_SIDE_BLOCKS
+                           : 125 - ZCC_D64_REL_SIDE_BLOCKS;
+
+        sides[s] = image.data + zcc_d64_block_offset(19, s);
+        sides[s][ZCC_D64_BLOCK_TRACK] = s == 0 ? 19 : 0;
+        sides[s][ZCC_D64_BLOCK_SECTOR] = (uint8_t)(s == 0
+                ? 1 : ZCC_D64_REL_SIDE_DATA + count * 2 - 1);
+        sides[s][ZCC_D64_REL_SIDE_NUMBER] = (uint8_t)s;
+        sides[s][ZCC_D64_REL_SIDE_RECORD_SIZE] = sizeof record;
+        sides[s][0x04] = 19;
+        sides[s][0x05] = 0;
+        sides[s][0x06] = 19;
+        sides[s][0x07] = 1;
+        for (int b = 0; b < count; b++) {
+            sides[s][ZCC_D64_REL_SIDE_DATA + b * 2] = track[first + b];
+            sides[s][ZCC_D64_REL_SIDE_DATA + b * 2 + 1] = sector[first + b];
+        }
+    }
+
+    rel = zcc_malloc(sizeof *rel);
+
+    (*total)++;
+    if (zcc_d64_rel_open(rel, &image, dir)
+            && rel->block_count == 125
+            && rel->side_sectors == 2
+            && rel->size == 125 * ZCC_D64_BLOCK_SIZE_DATA
+            && rel->record_count == 125 * ZCC_D64_BLOCK_SIZE_DATA / 200
+            && rel->blocks[ZCC_D64_REL_SIDE_BLOCKS]
+                == zcc_d64_block_index(track[ZCC_D64_REL_SIDE_BLOCKS],
+                                       sector[ZCC_D64_REL_SIDE_BLOCKS])) {
+        (*passed)++;
+    }
+
+    /* every record, including 152 which spans both side sectors' blocks */
+    (*total)++;
+    for (long r = 0; r < rel->record_count && ok; r++) {
+        ok = zcc_d64_rel_read_record(rel, r, record) == (long)sizeof record;
+        for (int i = 0; i < (int)sizeof record && ok; i++) {
+            long n = r * (long)sizeof record + i;
+
+            ok = record[i] == (uint8_t)(n * 7 + n / 256);
+        }
+    }
+    if (ok) {
+        (*passed)++;
+    }
+
+    /* side sectors out of sequence */
+    (*total)++;
+    sides[1][ZCC_D64_REL_SIDE_NUMBER] = 2;
+    if (!zcc_d64_rel_open(rel, &image, dir)
+            && zcc_errno == ZCC_ERR_INVALID_IMAGE) {
+        (*passed)++;
+    }
+
+    /* side sector chain linking back to the first */
+    (*total)++;
+    sides[1][ZCC_D64_REL_SIDE_NUMBER] = 1;
+    sides[1][ZCC_D64_BLOCK_TRACK] = 19;
+    sides[1][ZCC_D64_BLOCK_SECTOR] = 0;
+    if (!zcc_d64_rel_open(rel, &image, dir)
+            && zcc_errno == ZCC_ERR_CHAIN_CYCLE) {
+        (*passed)++;
+    }
+
+    zcc_free(rel);
+    zcc_d64_free(&image);
+    return *passed - start == 4;
+}
+
+
+/** \brief  Check if host file \a path holds the file at \a dirent of \a image
+ *
+ * \param[in]   image   D64 image
+ * \param[in]   dirent  raw directory entry in \a image
+ * \param[in]   path    host path
+ *
+ * \return  true if the contents match those read with zcc_d64_file_read()
+ */
+static bool extracted_equal(const zcc_d64_t *image,
+                            const uint8_t *dirent,
+                            const char *path)
+{
+    static uint8_t buffer[sizeof contents];
+    zcc_d64_file_t file;
+    uint8_t *data = NULL;
+    long size;
+    long expected = -1;
+    bool result;
+
+    if (zcc_d64_file_open_entry(&file, image, dirent)) {
+        expected = zcc_d64_file_read(&file, buffer, sizeof buffer);
+        zcc_d64_file_close(&file);
+    }
+    size = zcc_fread_alloc(&data, path);
+    result = expected >= 0 && size == expected
+        && memcmp(data, buffer, (size_t)size) == 0;
+    if (data != NULL) {
+        zcc_free(data);
+    }
+    return result;
+}
+
+
+/** \brief  Test extracting files to the host
+ *
+ * Extracts the first file of the test image, extracts a set of files with
+ * the worker threads and writes a vector longer than IOV_MAX, which has to
+ * be written in chunks. Zero-length elements are skipped.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64file_extract(int *total, int *passed)
+{
+    zcc_d64_t image;
+    zcc_d64_newfile_t files[EXTRACT_FILES];
+    char names[EXTRACT_FILES][8];
+    char path[128];
+    const uint8_t *dir;
+    struct iovec *iov;
+    int iov_count = IOV_MAX * 2 + 5;
+    long size = 0;
+    uint8_t *data = NULL;
+    int start = *passed;
+    bool ok = true;
+
+    /* single file */
+    (*total)++;
+    if (zcc_d64_extract_file(&d64, entry, EXTRACT_TMP) == contents_size
+            && extracted_equal(&d64, entry, EXTRACT_TMP)) {
+        (*passed)++;
+    }
+    remove(EXTRACT_TMP);
+
+    /* files of different sizes, extracted by four threads */
+    zcc_d64_init(&image);
+    zcc_d64_alloc(&image, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&image, "extract", "ex");
+    memset(files, 0, sizeof files);
+    for (int i = 0; i < EXTRACT_FILES; i++) {
+        snprintf(names[i], sizeof names[i], "file%d", i);
+        files[i].name = names[i];
+        files[i].type = ZCC_CBMDOS_FILETYPE_PRG;
+        files[i].data = contents;
+        files[i].size = (size_t)(contents_size * i / (EXTRACT_FILES - 1));
+    }
+    mkdir(EXTRACT_TMP_DIR, 0755);
+
+    (*total)++;
+    if (zcc_d64_write_files(&image, files, EXTRACT_FILES) == EXTRACT_FILES
+            && zcc_d64_extract(&image, EXTRACT_TMP_DIR, NULL, 4, false)
+                == EXTRACT_FILES) {
+        dir = image.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                                ZCC_D64_DIR_SECTOR);
+        for (int i = 0; i < EXTRACT_FILES && ok; i++) {
+            snprintf(path, sizeof path, "%s/%s.prg", EXTRACT_TMP_DIR, names[i]);
+            ok = extracted_equal(&image, dir + i * ZCC_D64_DIRENT_SIZE, path);
+        }
+        if (ok) {
+            (*passed)++;
+        }
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+    for (int i = 0; i < EXTRACT_FILES; i++) {
+        snprintf(path, sizeof path, "%s/%s.prg", EXTRACT_TMP_DIR, names[i]);
+        remove(path);
+    }
+    rmdir(EXTRACT_TMP_DIR);
+    zcc_d64_free(&image);
+
+    /* more elements than writev() accepts in one call */
+    iov = zcc_malloc(sizeof *iov * (size_t)iov_count);
+    for (int i = 0; i < iov_count; i++) {
+        iov[i].iov_base = contents + size;
+        iov[i].iov_len = (size_t)(i % 4);
+        size += i % 4;
+    }
+    (*total)++;
+    if (zcc_d64_extract_writev(EXTRACT_TMP, iov, iov_count)
+            && zcc_fread_alloc(&data, EXTRACT_TMP) == size
+            && memcmp(data, contents, (size_t)size) == 0) {
+        (*passed)++;
+    }
+    if (data != NULL) {
+        zcc_free(data);
+    }
+    remove(EXTRACT_TMP);
+    zcc_free(iov);
+
+    return *passed - start == 3;
+}
@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_d64file.h
+ * \brief   Test D64 file streaming - header
+ */
+
+#ifndef HAVE_TESTS_TEST_D64FILE_H
+#define HAVE_TESTS_TEST_D64FILE_H
+
+extern unit_module_t d64file_module;
+
+#endif
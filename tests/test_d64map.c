@@ -0,0 +1,388 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_d64map.c
+ * \brief   Test the block ownership map
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/bam.h"
+#include "../src/d64map.h"
+#include "../src/errors.h"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_d64map_rebuild(int *, int *);
+static bool test_d64map_dir_sizes(int *, int *);
+static bool test_d64map_file_size(int *, int *);
+static bool test_d64map_analyze(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "rebuild", "Test rebuilding the BAM of consistent D71 and D81 images",
+        test_d64map_rebuild, true },
+    { "dirsizes", "Test directory file sizes agreeing with the map",
+        test_d64map_dir_sizes, true },
+    { "filesize", "Test sizes of directory entries and arbitrary chains",
+        test_d64map_file_size, true },
+    { "analyze", "Test detecting cycles, cross-links and orphans",
+        test_d64map_analyze, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t d64map_module = {
+    "d64map",
+    "Tests for the block ownership map",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Get pointer to block (\a track, \a sector) of \a d64
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  pointer into the image data
+ */
+static uint8_t *block_ptr(zcc_d64_t *d64, int track, int sector)
+{
+    return d64->data + zcc_d64_geometry_block_offset(d64->geometry,
+                                                     track, sector);
+}
+
+
+/** \brief  Get highest track of \a d64
+ *
+ * The D64 geometry covers 40 tracks, but a plain D64 has 35.
+ *
+ * \param[in]   d64     image
+ *
+ * \return  track number
+ */
+static int image_track_max(const zcc_d64_t *d64)
+{
+    if (d64->geometry->format == ZCC_D64_FORMAT_D64) {
+        return ZCC_D64_TRACK_MAX;
+    }
+    return d64->geometry->track_max;
+}
+
+
+/** \brief  Create a consistent, empty image of \a format
+ *
+ * The header, BAM and first directory block are allocated, like a drive
+ * formats a disk. On a D71 all of track 53 is allocated, like the 1571 does.
+ *
+ * \param[out]  d64     image
+ * \param[in]   format  image format
+ */
+static void image_create(zcc_d64_t *d64, zcc_d64_format_t format)
+{
+    const zcc_d64_geometry_t *geometry;
+    zcc_bam_t bam;
+    uint8_t *dir;
+
+    zcc_d64_init(d64);
+    zcc_d64_alloc_format(d64, format);
+    geometry = d64->geometry;
+
+    zcc_bam_init_geometry(&bam, geometry, d64->type, image_track_max(d64));
+    zcc_bam_mark_used(&bam, geometry->header_track, geometry->header_sector);
+    zcc_bam_mark_used(&bam, geometry->bam_track, geometry->bam_sector);
+    zcc_bam_mark_used(&bam, geometry->dir_track, geometry->dir_sector);
+    if (format == ZCC_D64_FORMAT_D71) {
+        for (int s = 0; s < geometry->sectors[geometry->bam2_track]; s++) {
+            zcc_bam_mark_used(&bam, geometry->bam2_track, s);
+        }
+    } else if (geometry->bam2_track != 0) {
+        zcc_bam_mark_used(&bam, geometry->bam2_track, geometry->bam2_sector);
+    }
+    zcc_bam_store(&bam, d64);
+
+    dir = block_ptr(d64, geometry->dir_track, geometry->dir_sector);
+    dir[ZCC_D64_BLOCK_SECTOR] = 0xff;
+}
+
+
+/** \brief  Add a file of \a count blocks on the last track of \a d64
+ *
+ * The blocks are sectors \a first to \a first + \a count - 1, linked in
+ * order and allocated in the BAM. The last block holds 127 bytes. The
+ * directory entry goes into slot \a slot of the first directory block.
+ *
+ * \param[in,out]   d64     image created with image_create()
+ * \param[in]       slot    directory slot
+ * \param[in]       first   sector of the first block
+ * \param[in]       count   number of blocks
+ */
+static void image_add_file(zcc_d64_t *d64, int slot, int first, int count)
+{
+    const zcc_d64_geometry_t *geometry = d64->geometry;
+    int track = image_track_max(d64);
+    zcc_bam_t bam;
+    uint8_t *entry;
+
+    zcc_bam_load(&bam, d64);
+    for (int s = first; s < first + count; s++) {
+        uint8_t *block = block_ptr(d64, track, s);
+
+        if (s < first + count - 1) {
+            block[ZCC_D64_BLOCK_TRACK] = (uint8_t)track;
+            block[ZCC_D64_BLOCK_SECTOR] = (uint8_t)(s + 1);
+        } else {
+            block[ZCC_D64_BLOCK_TRACK] = 0;
+            block[ZCC_D64_BLOCK_SECTOR] = 0x80;
+        }
+        zcc_bam_mark_used(&bam, track, s);
+    }
+    zcc_bam_store(&bam, d64);
+
+    entry = block_ptr(d64, geometry->dir_track, geometry->dir_sector)
+        + slot * ZCC_D64_DIRENT_SIZE;
+    entry[ZCC_D64_DIRENT_FILETYPE] = 0x82;  /* closed PRG */
+    entry[ZCC_D64_DIRENT_TRACK] = (uint8_t)track;
+    entry[ZCC_D64_DIRENT_SECTOR] = (uint8_t)first;
+    memset(entry + ZCC_D64_DIRENT_FILENAME, 0xa0, ZCC_CBMDOS_FILENAME_MAX);
+    entry[ZCC_D64_DIRENT_FILENAME] = (uint8_t)(0x41 + slot);
+    entry[ZCC_D64_DIRENT_BLOCKS_LSB] = (uint8_t)count;
+}
+
+
+/** \brief  Test rebuilding the BAM of consistent D71 and D81 images
+ *
+ * Both have a file on their last track, so the part of the BAM in the second
+ * BAM sector is covered as well.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64map_rebuild(int *total, int *passed)
+{
+    static const zcc_d64_format_t formats[] = {
+        ZCC_D64_FORMAT_D71, ZCC_D64_FORMAT_D81
+    };
+    int start = *passed;
+
+    for (size_t i = 0; i < sizeof formats / sizeof formats[0]; i++) {
+        zcc_d64_t d64;
+        uint8_t *copy;
+        int changed;
+        int blocks;
+
+        image_create(&d64, formats[i]);
+        image_add_file(&d64, 0, 0, 3);
+        blocks = zcc_d64_blocks_free(&d64);
+        copy = malloc(d64.size);
+        memcpy(copy, d64.data, d64.size);
+
+        (*total)++;
+        changed = zcc_d64_rebuild_bam(&d64);
+        printf(".. %s: %d blocks changed, %d blocks free (expected %d)\n",
+               d64.geometry->name, changed, zcc_d64_blocks_free(&d64), blocks);
+        if (changed == 0 && memcmp(copy, d64.data, d64.size) == 0) {
+            (*passed)++;
+        }
+        free(copy);
+        zcc_d64_free(&d64);
+    }
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test directory file sizes of cross-linked files
+ *
+ * The second file runs into the chain of the first, so just like in the map
+ * only the first file gets a size.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64map_dir_sizes(int *total, int *passed)
+{
+    zcc_d64_t d64;
+    zcc_d64_dir_t *dir;
+    zcc_d64_map_t *map;
+    long size = 2 * ZCC_D64_BLOCK_SIZE_DATA + 0x80 - 1;
+    int start = *passed;
+
+    image_create(&d64, ZCC_D64_FORMAT_D64);
+    image_add_file(&d64, 0, 0, 3);
+    image_add_file(&d64, 1, 5, 2);
+    /* link the last block of the second file to the first file's chain */
+    block_ptr(&d64, ZCC_D64_TRACK_MAX, 6)[ZCC_D64_BLOCK_TRACK] =
+        ZCC_D64_TRACK_MAX;
+    block_ptr(&d64, ZCC_D64_TRACK_MAX, 6)[ZCC_D64_BLOCK_SECTOR] = 1;
+
+    dir = malloc(sizeof *dir);
+    map = malloc(sizeof *map);
+    zcc_d64_dir_init(dir, &d64);
+
+    (*total)++;
+    if (zcc_d64_dir_read(dir)
+            && dir->entry_count == 2
+            && !zcc_d64_dir_calc_sizes(dir)
+            && dir->entries[0].size_valid
+            && dir->entries[0].size == (size_t)size
+            && !dir->entries[1].size_valid
+            && zcc_d64_map_build(map, &d64)
+            && zcc_d64_map_file_size(map, 0) == size
+            && zcc_d64_map_file_size(map, 1) < 0) {
+        (*passed)++;
+    }
+
+    free(map);
+    free(dir);
+    zcc_d64_free(&d64);
+    return *passed - start == 1;
+}
+
+
+/** \brief  Test sizes of directory entries and arbitrary chains
+ *
+ * Entries of a directory get their size from the map on first use, just like
+ * with zcc_d64_dir_calc_sizes(). A chain not starting at a directory entry
+ * can still be sized with zcc_d64_file_size().
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64map_file_size(int *total, int *passed)
+{
+    zcc_d64_t d64;
+    zcc_d64_dir_t *dir;
+    long size = 2 * ZCC_D64_BLOCK_SIZE_DATA + 0x80 - 1;
+    int start = *passed;
+
+    image_create(&d64, ZCC_D64_FORMAT_D64);
+    image_add_file(&d64, 0, 0, 3);
+    image_add_file(&d64, 1, 5, 2);
+    block_ptr(&d64, ZCC_D64_TRACK_MAX, 6)[ZCC_D64_BLOCK_TRACK] =
+        ZCC_D64_TRACK_MAX;
+    block_ptr(&d64, ZCC_D64_TRACK_MAX, 6)[ZCC_D64_BLOCK_SECTOR] = 1;
+
+    dir = malloc(sizeof *dir);
+    zcc_d64_dir_init(dir, &d64);
+
+    (*total)++;
+    if (zcc_d64_dir_read(dir)
+            && zcc_d64_dirent_size(&(dir->entries[1])) < 0
+            && zcc_d64_dirent_size(&(dir->entries[0])) == size) {
+        (*passed)++;
+    }
+
+    /* the tail of the first file, which no directory entry points at */
+    (*total)++;
+    if (zcc_d64_file_size(&d64, ZCC_D64_TRACK_MAX, 1)
+            == size - ZCC_D64_BLOCK_SIZE_DATA) {
+        (*passed)++;
+    }
+
+    free(dir);
+    zcc_d64_free(&d64);
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test detecting cycles, cross-links and orphaned blocks
+ *
+ * The image has an intact file A, a file B running into the chain of A, a
+ * file C whose last block links back to its first and an allocated block
+ * that no file uses.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_d64map_analyze(int *total, int *passed)
+{
+    zcc_d64_t d64;
+    zcc_d64_map_t *map;
+    zcc_bam_t bam;
+    int track = ZCC_D64_TRACK_MAX;
+    int start = *passed;
+
+    image_create(&d64, ZCC_D64_FORMAT_D64);
+    image_add_file(&d64, 0, 0, 3);
+    image_add_file(&d64, 1, 5, 2);
+    image_add_file(&d64, 2, 8, 2);
+    block_ptr(&d64, track, 6)[ZCC_D64_BLOCK_TRACK] = (uint8_t)track;
+    block_ptr(&d64, track, 6)[ZCC_D64_BLOCK_SECTOR] = 1;
+    block_ptr(&d64, track, 9)[ZCC_D64_BLOCK_TRACK] = (uint8_t)track;
+    block_ptr(&d64, track, 9)[ZCC_D64_BLOCK_SECTOR] = 8;
+    zcc_bam_load(&bam, &d64);
+    zcc_bam_mark_used(&bam, track, 12);
+    zcc_bam_store(&bam, &d64);
+
+    map = malloc(sizeof *map);
+
+    (*total)++;
+    if (zcc_d64_map_build(map, &d64)
+            && map->file_count == 3
+            && map->cycles == 1
+            && map->crosslinks == 1
+            && map->bad_links == 0
+            && map->orphans == 1
+            && map->unallocated == 0
+            && !map->dir_broken
+            && !zcc_d64_map_is_valid(map)) {
+        (*passed)++;
+    } else {
+        printf(".. %d cycles, %d cross-links, %d invalid links, %d orphans\n",
+               map->cycles, map->crosslinks, map->bad_links, map->orphans);
+    }
+
+    /* flags and owners per file and block */
+    (*total)++;
+    if (map->files[0].status == 0
+            && map->files[1].status == ZCC_D64_FILE_CROSSLINK
+            && map->files[1].owner == 0
+            && map->files[2].status == ZCC_D64_FILE_CYCLE
+            && map->owner[zcc_d64_block_index(track, 1)] == 0
+            && map->owner[zcc_d64_block_index(track, 6)] == 1
+            && map->owner[zcc_d64_block_index(track, 9)] == 2
+            && map->owner[zcc_d64_block_index(track, 12)] == ZCC_D64_OWNER_NONE
+            && map->owner[zcc_d64_block_index(ZCC_D64_DIR_TRACK,
+                                              ZCC_D64_DIR_SECTOR)]
+                == ZCC_D64_OWNER_SYSTEM) {
+        (*passed)++;
+    }
+
+    /* walking the cyclic chain must end */
+    (*total)++;
+    if (zcc_d64_file_size(&d64, track, 8) < 0
+            && zcc_errno == ZCC_ERR_CHAIN_CYCLE
+            && zcc_d64_map_file_size(map, 2) < 0
+            && zcc_errno == ZCC_ERR_CHAIN_CYCLE) {
+        (*passed)++;
+    }
+
+    free(map);
+    zcc_d64_free(&d64);
+    return *passed - start == 3;
+}
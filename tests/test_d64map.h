@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_d64map.h
+ * \brief   Test the block ownership map - header
+ */
+
+#ifndef HAVE_TESTS_TEST_D64MAP_H
+#define HAVE_TESTS_TEST_D64MAP_H
+
+extern unit_module_t d64map_module;
+
+#endif
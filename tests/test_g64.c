@@ -0,0 +1,181 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_g64.c
+ * \brief   Test G64 handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/errors.h"
+#include "../src/g64.h"
+#include "../src/sixpack.h"
+
+#define SIXPACK     "data/zipsix/1!!S2.PRG"
+#define GUMBO       "data/d64/gumbo_dec2019.d64"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_g64_decode(int *, int *);
+static bool test_g64_encode(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "decode", "Test decoding a G64 image to D64",
+        test_g64_decode, true },
+    { "encode", "Test encoding a D64 image to G64",
+        test_g64_encode, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t g64_module = {
+    "g64",
+    "Tests for the G64 code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Rotate the bit stream of \a track of \a g64 left by \a shift bits
+ *
+ * Moves all data off byte boundaries.
+ *
+ * \param[in,out]   g64     G64 image
+ * \param[in]       track   track number
+ * \param[in]       shift   number of bits (1-7)
+ */
+static void track_rotate(zcc_g64_t *g64, int track, int shift)
+{
+    size_t size;
+    uint8_t *data = zcc_g64_track(g64, track, &size);
+    uint8_t first = data[0];
+
+    for (size_t i = 0; i < size; i++) {
+        uint8_t next = i + 1 < size ? data[i + 1] : first;
+
+        data[i] = (uint8_t)((data[i] << shift) | (next >> (8 - shift)));
+    }
+}
+
+
+/** \brief  Decode a G64 created from a SixPack archive
+ *
+ * The result has to match decoding the archive directly, also after moving
+ * the tracks off byte boundaries.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_g64_decode(int *total, int *passed)
+{
+    zcc_sixpack_t six;
+    zcc_g64_t g64;
+    zcc_d64_t expected;
+    zcc_d64_t d64;
+    int start = *passed;
+    bool result;
+
+    zcc_sixpack_init(&six);
+    zcc_g64_init(&g64);
+    zcc_d64_init(&expected);
+    zcc_d64_init(&d64);
+
+    result = zcc_sixpack_read(&six, SIXPACK)
+        && zcc_sixpack_decode(&six, &expected)
+        && zcc_sixpack_to_g64(&six, &g64);
+
+    (*total)++;
+    if (result && zcc_g64_decode(&g64, &d64, 0)
+            && d64.size == expected.size
+            && memcmp(d64.data, expected.data, d64.size) == 0
+            && memcmp(g64.errors, six.errors, sizeof six.errors) == 0
+            && g64.bad_sectors == six.bad_sectors) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+    zcc_d64_free(&d64);
+
+    (*total)++;
+    for (int track = 1; result && track <= g64.track_max; track++) {
+        track_rotate(&g64, track, track % 7 + 1);
+    }
+    if (result && zcc_g64_decode(&g64, &d64, 1)
+            && d64.size == expected.size
+            && memcmp(d64.data, expected.data, d64.size) == 0
+            && memcmp(g64.errors, six.errors, sizeof six.errors) == 0) {
+        (*passed)++;
+    }
+
+    zcc_d64_free(&d64);
+    zcc_d64_free(&expected);
+    zcc_g64_free(&g64);
+    zcc_sixpack_free(&six);
+    return *passed - start == 2;
+}
+
+
+/** \brief  Encode a D64 to G64 and decode it again
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_g64_encode(int *total, int *passed)
+{
+    zcc_g64_t g64;
+    zcc_d64_t expected;
+    zcc_d64_t d64;
+    int start = *passed;
+
+    zcc_g64_init(&g64);
+    zcc_d64_init(&expected);
+    zcc_d64_init(&d64);
+
+    (*total)++;
+    if (zcc_d64_read(&expected, GUMBO, 0)
+            && zcc_g64_encode(&g64, &expected, 0)
+            && zcc_g64_decode(&g64, &d64, 0)
+            && g64.bad_sectors == 0
+            && d64.size == expected.size
+            && memcmp(d64.data, expected.data, d64.size) == 0) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+
+    /* D71 and D81 images can't be encoded as 1541 tracks */
+    zcc_d64_free(&d64);
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_format(&d64, ZCC_D64_FORMAT_D81);
+    (*total)++;
+    if (!zcc_g64_encode(&g64, &d64, 0) && zcc_errno == ZCC_ERR_UNSUPPORTED) {
+        (*passed)++;
+    } else {
+        printf(".. D81 image not rejected\n");
+    }
+
+    zcc_d64_free(&d64);
+    zcc_d64_free(&expected);
+    zcc_g64_free(&g64);
+    return *passed - start == 2;
+}
@@ -0,0 +1,156 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_geos.c
+ * \brief   Test GEOS handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/cbmdos.h"
+#include "../src/d64.h"
+#include "../src/d64write.h"
+#include "../src/errors.h"
+#include "../src/io.h"
+#include "../src/mem.h"
+#include "../src/geos.h"
+
+/** \brief  Temporary file for the CVT test
+ */
+#define CVT_TMP     "test_geos.tmp"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_geos_vlir(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "vlir", "Test reading VLIR records and writing a CVT file",
+        test_geos_vlir, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t geos_module = {
+    "geos",
+    "Tests for the GEOS code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Get pointer to block (\a track, \a sector) of \a d64
+ *
+ * \param[in]   d64     D64 image
+ * \param[in]   track   track number
+ * \param[in]   sector  sector number
+ *
+ * \return  pointer to the raw block
+ */
+static uint8_t *block_ptr(zcc_d64_t *d64, int track, int sector)
+{
+    return d64->data + zcc_d64_block_offset(track, sector);
+}
+
+
+/** \brief  Read VLIR records and export a VLIR file to CVT
+ *
+ * The file has three records: two blocks (264 bytes), an empty record and
+ * a single block (5 bytes).
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_geos_vlir(int *total, int *passed)
+{
+    static const uint8_t links[] = { 1, 2, 0x00, 0xff, 2, 0, 0, 0 };
+    static const uint8_t cvt_links[] = { 2, 11, 0x00, 0xff, 1, 6, 0, 0 };
+    uint8_t buffer[2 * ZCC_D64_BLOCK_SIZE_DATA];
+    uint8_t *entry;
+    uint8_t *cvt = NULL;
+    zcc_geos_vlir_t vlir;
+    zcc_d64_t d64;
+    long size;
+    int start = *passed;
+
+    zcc_d64_init(&d64);
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&d64, "geos", "00");
+
+    /* directory entry: USR, record block at 1/0, info block at 1/1 */
+    entry = block_ptr(&d64, ZCC_D64_DIR_TRACK, ZCC_D64_DIR_SECTOR);
+    entry[ZCC_D64_DIRENT_FILETYPE] = ZCC_CBMDOS_CLOSED_MASK | ZCC_CBMDOS_FILETYPE_USR;
+    entry[ZCC_D64_DIRENT_TRACK] = 1;
+    entry[ZCC_D64_DIRENT_SECTOR] = 0;
+    memcpy(entry + ZCC_D64_DIRENT_FILENAME, "DESK TOP\xa0\xa0\xa0\xa0\xa0\xa0\xa0\xa0", 16);
+    entry[ZCC_GEOS_DIRENT_INFO_TRACK] = 1;
+    entry[ZCC_GEOS_DIRENT_INFO_SECTOR] = 1;
+    entry[ZCC_GEOS_DIRENT_STRUCTURE] = ZCC_GEOS_STRUCTURE_VLIR;
+    entry[ZCC_GEOS_DIRENT_TYPE] = 0x06;
+
+    block_ptr(&d64, 1, 0)[ZCC_D64_BLOCK_SECTOR] = 0xff;
+    memcpy(block_ptr(&d64, 1, 0) + ZCC_D64_BLOCK_DATA, links, sizeof links);
+    block_ptr(&d64, 1, 1)[ZCC_D64_BLOCK_SECTOR] = 0xff;
+    memset(block_ptr(&d64, 1, 2), 0x11, ZCC_D64_BLOCK_SIZE_RAW);
+    block_ptr(&d64, 1, 2)[ZCC_D64_BLOCK_TRACK] = 1;
+    block_ptr(&d64, 1, 2)[ZCC_D64_BLOCK_SECTOR] = 3;
+    memset(block_ptr(&d64, 1, 3), 0x22, ZCC_D64_BLOCK_SIZE_RAW);
+    block_ptr(&d64, 1, 3)[ZCC_D64_BLOCK_TRACK] = 0;
+    block_ptr(&d64, 1, 3)[ZCC_D64_BLOCK_SECTOR] = 11;
+    memset(block_ptr(&d64, 2, 0), 0x33, ZCC_D64_BLOCK_SIZE_RAW);
+    block_ptr(&d64, 2, 0)[ZCC_D64_BLOCK_TRACK] = 0;
+    block_ptr(&d64, 2, 0)[ZCC_D64_BLOCK_SECTOR] = 6;
+
+    (*total)++;
+    if (zcc_geos_vlir_open(&vlir, &d64, entry)
+            && vlir.record_count == 3
+            && vlir.heads[1] == -1
+            && zcc_geos_vlir_record_size(&vlir, 0) == ZCC_D64_BLOCK_SIZE_DATA + 10
+            && zcc_geos_vlir_record_size(&vlir, 1) == 0
+            && zcc_geos_vlir_read_record(&vlir, 0, buffer, sizeof buffer)
+                == ZCC_D64_BLOCK_SIZE_DATA + 10
+            && buffer[ZCC_D64_BLOCK_SIZE_DATA - 1] == 0x11
+            && buffer[ZCC_D64_BLOCK_SIZE_DATA] == 0x22
+            && zcc_geos_vlir_read_record(&vlir, 2, buffer, sizeof buffer) == 5
+            && buffer[0] == 0x33
+            && zcc_geos_vlir_read_record(&vlir, 3, buffer, sizeof buffer) < 0) {
+        (*passed)++;
+    }
+
+    /* header, info block, record block and three blocks of records */
+    (*total)++;
+    size = zcc_geos_cvt_write(&d64, entry, CVT_TMP);
+    if (size == 6 * ZCC_D64_BLOCK_SIZE_DATA
+            && zcc_fread_alloc(&cvt, CVT_TMP) == size
+            && cvt[0] == entry[ZCC_D64_DIRENT_FILETYPE]
+            && memcmp(cvt + ZCC_GEOS_CVT_SIGNATURE, "PRG formatted GEOS file", 23) == 0
+            && memcmp(cvt + 2 * ZCC_D64_BLOCK_SIZE_DATA, cvt_links, sizeof cvt_links) == 0
+            && cvt[3 * ZCC_D64_BLOCK_SIZE_DATA] == 0x11
+            && cvt[4 * ZCC_D64_BLOCK_SIZE_DATA] == 0x22
+            && cvt[5 * ZCC_D64_BLOCK_SIZE_DATA] == 0x33) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+    remove(CVT_TMP);
+    zcc_free(cvt);
+
+    zcc_d64_free(&d64);
+    return *passed - start == 2;
+}
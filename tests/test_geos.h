@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_geos.h
+ * \brief   Test GEOS handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_GEOS_H
+#define HAVE_TESTS_TEST_GEOS_H
+
+extern unit_module_t geos_module;
+
+#endif
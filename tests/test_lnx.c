@@ -0,0 +1,133 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_lnx.c
+ * \brief   Test Lynx handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/d64file.h"
+#include "../src/errors.h"
+#include "../src/io.h"
+#include "../src/lnx.h"
+
+/** \brief  Temporary file for the Lynx test
+ */
+#define LNX_TMP     "test_lnx.tmp"
+
+/** \brief  BASIC stub: 10 SYS64738
+ */
+static const uint8_t stub[] = {
+    0x01, 0x08, 0x0c, 0x08, 0x0a, 0x00, 0x9e, 0x36, 0x34, 0x37, 0x33, 0x38,
+    0x00, 0x00, 0x00
+};
+
+/** \brief  Directory: two files of 3 and 1 blocks, ending in the middle of
+ *          the last block
+ */
+static const char dir[] =
+    "\r 1  *LYNX XV  BY WILL CORLEY\r 2 \r"
+    "FIRST\r 3 \rP\r 100 \r"
+    "SECOND\r 1 \rS\r 11 \r";
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_lnx_read(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "read", "Test reading a Lynx container and converting it to D64",
+        test_lnx_read, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t lnx_module = {
+    "lnx",
+    "Tests for the Lynx code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Read a Lynx container and convert it to D64
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_lnx_read(int *total, int *passed)
+{
+    static uint8_t data[5 * ZCC_LNX_BLOCK_SIZE];
+    static uint8_t buffer[3 * ZCC_LNX_BLOCK_SIZE];
+    long first_size = 2 * ZCC_LNX_BLOCK_SIZE + 99;
+    zcc_lnx_t lnx;
+    zcc_d64_t d64;
+    zcc_d64_file_t file;
+    const uint8_t *dirblock;
+    int start = *passed;
+
+    memset(data, 0, sizeof data);
+    memcpy(data, stub, sizeof stub);
+    memcpy(data + sizeof stub, dir, sizeof dir - 1);
+    for (size_t i = ZCC_LNX_BLOCK_SIZE; i < sizeof data; i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+
+    zcc_lnx_init(&lnx);
+    zcc_d64_init(&d64);
+
+    (*total)++;
+    if (zcc_fwrite(LNX_TMP, data, sizeof data)
+            && zcc_lnx_read(&lnx, LNX_TMP)
+            && lnx.dir_blocks == 1
+            && lnx.entry_count == 2
+            && lnx.entries[0].type == ZCC_CBMDOS_FILETYPE_PRG
+            && lnx.entries[0].data == lnx.data + ZCC_LNX_BLOCK_SIZE
+            && lnx.entries[0].size == (size_t)first_size
+            && lnx.entries[1].type == ZCC_CBMDOS_FILETYPE_SEQ
+            && lnx.entries[1].data == lnx.data + 4 * ZCC_LNX_BLOCK_SIZE
+            && lnx.entries[1].size == 10
+            && lnx.truncated == 0) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+    remove(LNX_TMP);
+
+    (*total)++;
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+    dirblock = d64.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK,
+                                               ZCC_D64_DIR_SECTOR);
+    if (lnx.entry_count == 2
+            && zcc_lnx_to_d64(&lnx, &d64, "lynx") == 2
+            && zcc_d64_file_open_entry(&file, &d64, dirblock)
+            && zcc_d64_file_read(&file, buffer, sizeof buffer) == first_size
+            && memcmp(buffer, data + ZCC_LNX_BLOCK_SIZE, (size_t)first_size) == 0
+            && memcmp(dirblock + ZCC_D64_DIRENT_FILENAME, "FIRST", 5) == 0
+            && zcc_d64_file_open_entry(&file, &d64, dirblock + ZCC_D64_DIRENT_SIZE)
+            && zcc_d64_file_length(&file) == 10) {
+        (*passed)++;
+    }
+
+    zcc_d64_free(&d64);
+    zcc_lnx_free(&lnx);
+    return *passed - start == 2;
+}
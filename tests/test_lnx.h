@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_lnx.h
+ * \brief   Test Lynx handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_LNX_H
+#define HAVE_TESTS_TEST_LNX_H
+
+extern unit_module_t lnx_module;
+
+#endif
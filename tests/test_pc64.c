@@ -0,0 +1,189 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_pc64.c
+ * \brief   Test PC64 handling
+ */
+
+/* rmdir() */
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "unit.h"
+
+#include "../src/cbmdos.h"
+#include "../src/d64.h"
+#include "../src/d64write.h"
+#include "../src/errors.h"
+#include "../src/io.h"
+#include "../src/mem.h"
+#include "../src/pc64.h"
+
+/** \brief  Directory for the import test, exported from PC64_TMP_D64
+ */
+#define PC64_TMP        "test_pc64_tmp"
+
+/** \brief  Image for the import test
+ */
+#define PC64_TMP_D64    PC64_TMP ".d64"
+
+/** \brief  PC64 file exported from PC64_TMP_D64
+ */
+#define PC64_TMP_P00    PC64_TMP "/game.p00"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_pc64_names(int *, int *);
+static bool test_pc64_import(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "names", "Test PC64 headers, file types and name collisions",
+        test_pc64_names, true },
+    { "import", "Test importing an exported directory next to its image",
+        test_pc64_import, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t pc64_module = {
+    "pc64",
+    "Tests for the PC64 code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Test headers, file types from extensions and unique names
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_pc64_names(int *total, int *passed)
+{
+    static const uint8_t name[ZCC_CBMDOS_FILENAME_MAX] = {
+        0x47, 0x41, 0x4d, 0x45, 0xa0, 0xa0, 0xa0, 0xa0,
+        0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0
+    };
+    uint8_t head[ZCC_PC64_HEADER_SIZE];
+    char dest[ZCC_PC64_NAME_MAX];
+    zcc_pc64_names_t names;
+    int start = *passed;
+    bool ok = true;
+
+    (*total)++;
+    zcc_pc64_header(head, name, 0);
+    if (memcmp(head, "C64File", 8) == 0
+            && memcmp(head + ZCC_PC64_FILENAME, "GAME", 4) == 0
+            && head[ZCC_PC64_FILENAME + 4] == 0x00
+            && head[ZCC_PC64_RECORD_SIZE] == 0x00) {
+        (*passed)++;
+    }
+
+    (*total)++;
+    if (zcc_pc64_type("dir/game.p00") == ZCC_CBMDOS_FILETYPE_PRG
+            && zcc_pc64_type("GAME.S12") == ZCC_CBMDOS_FILETYPE_SEQ
+            && zcc_pc64_type("game.r99") == ZCC_CBMDOS_FILETYPE_REL
+            && zcc_pc64_type("game.prg") < 0
+            && zcc_pc64_type("game.d00") < 0) {
+        (*passed)++;
+    }
+
+    /* names already present are skipped, ignoring case */
+    (*total)++;
+    zcc_pc64_names_init(&names);
+    zcc_pc64_names_add(&names, "GAME.P00");
+    for (int i = 1; i < ZCC_PC64_COPIES_MAX && ok; i++) {
+        char expected[ZCC_PC64_NAME_MAX];
+
+        snprintf(expected, sizeof expected, "game.p%02d", i);
+        ok = zcc_pc64_name(&names, dest, name, ZCC_CBMDOS_FILETYPE_PRG)
+            && strcmp(dest, expected) == 0;
+    }
+    if (ok
+            && !zcc_pc64_name(&names, dest, name, ZCC_CBMDOS_FILETYPE_PRG)
+            && zcc_pc64_name(&names, dest, name, ZCC_CBMDOS_FILETYPE_SEQ)
+            && strcmp(dest, "game.s00") == 0
+            && names.count == ZCC_PC64_COPIES_MAX + 1) {
+        (*passed)++;
+    }
+    zcc_pc64_names_free(&names);
+
+    return *passed - start == 3;
+}
+
+
+/** \brief  Test importing a directory next to the image it was exported from
+ *
+ * The image must be left alone, unless overwriting is requested.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_pc64_import(int *total, int *passed)
+{
+    static const uint8_t data[] = { 0x01, 0x08, 0x60 };
+    zcc_d64_t d64;
+    zcc_d64_newfile_t file;
+    uint8_t *before = NULL;
+    uint8_t *after = NULL;
+    long size;
+    int start = *passed;
+
+    zcc_d64_init(&d64);
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+    zcc_d64_format(&d64, "original", "or");
+    memset(&file, 0, sizeof file);
+    file.name = "game";
+    file.type = ZCC_CBMDOS_FILETYPE_PRG;
+    file.data = data;
+    file.size = sizeof data;
+
+    (*total)++;
+    if (zcc_d64_write_file(&d64, &file)
+            && zcc_d64_write(&d64, PC64_TMP_D64)
+            && zcc_pc64_export_tree(PC64_TMP_D64, 1, false) == 1
+            && (size = zcc_fread_alloc(&before, PC64_TMP_D64)) > 0
+            && zcc_pc64_import_tree(PC64_TMP, false, false) < 0
+            && zcc_errno == ZCC_ERR_FILE_EXISTS
+            && zcc_fread_alloc(&after, PC64_TMP_D64) == size
+            && memcmp(before, after, (size_t)size) == 0) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+
+    (*total)++;
+    if (zcc_pc64_import_tree(PC64_TMP, true, false) == 1) {
+        (*passed)++;
+    }
+
+    if (before != NULL) {
+        zcc_free(before);
+    }
+    if (after != NULL) {
+        zcc_free(after);
+    }
+    remove(PC64_TMP_P00);
+    rmdir(PC64_TMP);
+    remove(PC64_TMP_D64);
+    zcc_d64_free(&d64);
+    return *passed - start == 2;
+}
@@ -0,0 +1,241 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_pool.c
+ * \brief   Test the buffer pool
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/mem.h"
+#include "../src/pool.h"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_pool_d64(int *, int *);
+static bool test_pool_clear(int *, int *);
+static bool test_pool_slice(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "d64", "Test reusing D64 buffers",
+        test_pool_d64, true },
+    { "clear", "Test clearing unwritten blocks of a recycled D64 buffer",
+        test_pool_clear, true },
+    { "slice", "Test reusing and growing slice buffers",
+        test_pool_slice, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t pool_module = {
+    "pool",
+    "Tests for the buffer pool",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Test reusing D64 buffers
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_pool_d64(int *total, int *passed)
+{
+    zcc_pool_t pool;
+    zcc_d64_t d64;
+    uint8_t *buffers[ZCC_POOL_D64_MAX + 1];
+    uint8_t *data;
+    bool recycled;
+    int start = *passed;
+
+    zcc_pool_init(&pool);
+
+    /* a fresh buffer comes from the heap, zeroed-out */
+    (*total)++;
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_pooled(&d64, ZCC_D64_TYPE_CBMDOS, &pool);
+    data = d64.data;
+    if (!d64.recycled && pool.heap_allocs == 1
+            && d64.size == ZCC_D64_SIZE_CBMDOS
+            && data[0] == 0 && data[d64.size - 1] == 0) {
+        (*passed)++;
+    }
+
+    /* freeing hands it back, the next image gets the same buffer */
+    (*total)++;
+    zcc_d64_free(&d64);
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_pooled(&d64, ZCC_D64_TYPE_SPEEDDOS, &pool);
+    if (pool.d64_count == 0 && d64.data == data && d64.recycled
+            && pool.heap_allocs == 1
+            && d64.size == ZCC_D64_SIZE_EXTENDED) {
+        (*passed)++;
+    }
+    zcc_d64_free(&d64);
+
+    /* a full pool frees the buffers it can't keep */
+    (*total)++;
+    for (int i = 0; i < ZCC_POOL_D64_MAX + 1; i++) {
+        buffers[i] = zcc_pool_d64_get(&pool, &recycled);
+    }
+    for (int i = 0; i < ZCC_POOL_D64_MAX + 1; i++) {
+        zcc_pool_d64_put(&pool, buffers[i]);
+    }
+    if (pool.d64_count == ZCC_POOL_D64_MAX
+            && pool.heap_allocs == ZCC_POOL_D64_MAX + 1) {
+        (*passed)++;
+    }
+
+    zcc_pool_free(&pool);
+    return *passed - start == 3;
+}
+
+
+/** \brief  Test clearing the unwritten blocks of a recycled D64 buffer
+ *
+ * The blocks written are chosen so the runs of unwritten blocks start and
+ * end both on and off the boundaries of the bytes of the written bitmap.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_pool_clear(int *total, int *passed)
+{
+    static const int sectors[] = { 0, 7, 8, 9, 16, 17, 18, 19, 20, 21, 22, 23 };
+    zcc_pool_t pool;
+    zcc_d64_t d64;
+    uint8_t block[ZCC_D64_BLOCK_SIZE_RAW];
+    bool written[ZCC_D64_BLOCKS_MAX];
+    bool ok = true;
+    int start = *passed;
+
+    zcc_pool_init(&pool);
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_pooled(&d64, ZCC_D64_TYPE_CBMDOS, &pool);
+    memset(d64.data, 0xaa, d64.size);
+    zcc_d64_free(&d64);
+
+    /* recycled buffer with stale data everywhere */
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_pooled(&d64, ZCC_D64_TYPE_CBMDOS, &pool);
+    memset(block, 0x55, sizeof block);
+    memset(written, 0, sizeof written);
+    for (size_t i = 0; i < sizeof sectors / sizeof sectors[0]; i++) {
+        /* sectors past 20 continue on track 2 */
+        int track = sectors[i] < 21 ? 1 : 2;
+        int sector = sectors[i] < 21 ? sectors[i] : sectors[i] - 21;
+
+        zcc_d64_block_write(&d64, block, track, sector);
+        written[zcc_d64_block_index(track, sector)] = true;
+    }
+    zcc_d64_block_write(&d64, block, ZCC_D64_TRACK_MAX, 16);
+    written[zcc_d64_block_index(ZCC_D64_TRACK_MAX, 16)] = true;
+
+    (*total)++;
+    if (d64.recycled) {
+        zcc_d64_clear_unwritten(&d64);
+        for (int i = 0; i < ZCC_D64_BLOCKS_MAX && ok; i++) {
+            const uint8_t *data = d64.data + i * ZCC_D64_BLOCK_SIZE_RAW;
+            uint8_t expected = written[i] ? 0x55 : 0x00;
+
+            for (int b = 0; b < ZCC_D64_BLOCK_SIZE_RAW && ok; b++) {
+                ok = data[b] == expected;
+            }
+            if (!ok) {
+                printf(".. block %d not %s\n", i,
+                       written[i] ? "preserved" : "cleared");
+            }
+        }
+        if (ok && !d64.recycled) {
+            (*passed)++;
+        }
+    }
+
+    /* a fresh buffer is left alone */
+    (*total)++;
+    zcc_d64_free(&d64);
+    zcc_pool_free(&pool);
+    zcc_d64_init(&d64);
+    zcc_d64_alloc_pooled(&d64, ZCC_D64_TYPE_CBMDOS, &pool);
+    d64.data[0] = 0xaa;
+    zcc_d64_clear_unwritten(&d64);
+    if (!d64.recycled && d64.data[0] == 0xaa) {
+        (*passed)++;
+    }
+
+    zcc_d64_free(&d64);
+    zcc_pool_free(&pool);
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test reusing and growing slice buffers
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_pool_slice(int *total, int *passed)
+{
+    zcc_pool_t pool;
+    uint8_t *data;
+    uint8_t *other;
+    size_t capacity;
+    int start = *passed;
+
+    zcc_pool_init(&pool);
+
+    /* nothing seen yet: the reader allocates */
+    (*total)++;
+    if (zcc_pool_slice_get(&pool, &capacity) == NULL && capacity == 0) {
+        (*passed)++;
+    }
+
+    /* sized to the largest slice seen, and reused */
+    (*total)++;
+    zcc_pool_slice_seen(&pool, 1000);
+    zcc_pool_slice_seen(&pool, 500);
+    data = zcc_pool_slice_get(&pool, &capacity);
+    zcc_pool_slice_put(&pool, data, capacity);
+    if (data != NULL && capacity == 1000 && pool.slice_count == 1
+            && zcc_pool_slice_get(&pool, &capacity) == data
+            && capacity == 1000 && pool.heap_allocs == 1) {
+        (*passed)++;
+    }
+
+    /* a buffer smaller than the largest slice seen is replaced */
+    (*total)++;
+    zcc_pool_slice_put(&pool, data, capacity);
+    zcc_pool_slice_seen(&pool, 2000);
+    other = zcc_pool_slice_get(&pool, &capacity);
+    if (other != NULL && capacity == 2000 && pool.slice_count == 0
+            && pool.heap_allocs == 2) {
+        (*passed)++;
+    }
+    zcc_free(other);
+
+    zcc_pool_free(&pool);
+    return *passed - start == 3;
+}
@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_pool.h
+ * \brief   Test the buffer pool - header
+ */
+
+#ifndef HAVE_TESTS_TEST_POOL_H
+#define HAVE_TESTS_TEST_POOL_H
+
+extern unit_module_t pool_module;
+
+#endif
@@ -0,0 +1,211 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_sixpack.c
+ * \brief   Test SixPack zipcode handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/errors.h"
+#include "../src/g64.h"
+#include "../src/gcr.h"
+#include "../src/sixpack.h"
+
+#define SIXPACK     "data/zipsix/1!!S1.PRG"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_sixpack_gcr(int *, int *);
+static bool test_sixpack_decode(int *, int *);
+static bool test_sixpack_g64(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "gcr", "Test GCR decoding",
+        test_sixpack_gcr, true },
+    { "decode", "Test decoding a 40-track archive",
+        test_sixpack_decode, true },
+    { "g64", "Test copying the GCR data to a G64 image",
+        test_sixpack_g64, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t sixpack_module = {
+    "sixpack",
+    "Tests for the SixPack zipcode code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Test GCR decoding with the example from zip_six.txt
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_sixpack_gcr(int *total, int *passed)
+{
+    static const uint8_t gcr[ZCC_GCR_GROUP_SIZE] = {
+        0x57, 0x6a, 0xff, 0x3a, 0x77
+    };
+    static const uint8_t data[ZCC_GCR_GROUP_DATA] = {
+        0x0d, 0xf5, 0xe4, 0x37
+    };
+    static const uint8_t sync[ZCC_GCR_GROUP_SIZE] = {
+        0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    uint8_t result[ZCC_GCR_GROUP_DATA];
+    int start = *passed;
+
+    (*total)++;
+    if (zcc_gcr_decode(result, gcr, 1)
+            && memcmp(result, data, sizeof data) == 0) {
+        (*passed)++;
+    }
+    (*total)++;
+    if (!zcc_gcr_decode(result, sync, 1)) {
+        (*passed)++;
+    }
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test decoding the sample archive
+ *
+ * Tracks 1-35 decode without errors, the extra tracks were formatted with
+ * another disk ID.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_sixpack_decode(int *total, int *passed)
+{
+    zcc_sixpack_t six;
+    zcc_d64_t d64;
+    uint8_t bam[ZCC_D64_BLOCK_SIZE_RAW];
+    int start = *passed;
+    bool result;
+
+    zcc_sixpack_init(&six);
+    zcc_d64_init(&d64);
+
+    (*total)++;
+    result = zcc_sixpack_read(&six, SIXPACK) && zcc_sixpack_decode(&six, &d64);
+    if (result && six.track_max == ZCC_D64_TRACK_MAX_EXT
+            && d64.size == ZCC_D64_SIZE_EXTENDED) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+
+    (*total)++;
+    if (result
+            && six.bad_sectors == 5 * 17
+            && six.errors[zcc_d64_block_index(35, 16)] == ZCC_D64_ERROR_OK
+            && six.errors[zcc_d64_block_index(36, 0)]
+                == ZCC_D64_ERROR_ID_MISMATCH) {
+        (*passed)++;
+    }
+
+    (*total)++;
+    if (result
+            && zcc_d64_block_read(&d64, bam, ZCC_D64_BAM_TRACK,
+                                  ZCC_D64_BAM_SECTOR)
+            && bam[0] == ZCC_D64_DIR_TRACK && bam[1] == ZCC_D64_DIR_SECTOR
+            && bam[2] == 0x41) {
+        (*passed)++;
+    }
+
+    zcc_d64_free(&d64);
+    zcc_sixpack_free(&six);
+    return *passed - start == 3;
+}
+
+
+/** \brief  Test converting the sample archive to G64
+ *
+ * Checks the framing of the first sector of each track and that its data
+ * block decodes to the same data as the D64 conversion.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_sixpack_g64(int *total, int *passed)
+{
+    zcc_sixpack_t six;
+    zcc_d64_t d64;
+    zcc_g64_t g64;
+    int start = *passed;
+    bool result;
+
+    zcc_sixpack_init(&six);
+    zcc_d64_init(&d64);
+    zcc_g64_init(&g64);
+
+    (*total)++;
+    result = zcc_sixpack_read(&six, SIXPACK)
+        && zcc_sixpack_decode(&six, &d64)
+        && zcc_sixpack_to_g64(&six, &g64);
+    if (result && g64.track_max == six.track_max
+            && memcmp(g64.data, ZCC_G64_SIGNATURE, ZCC_G64_SIGNATURE_LEN) == 0) {
+        (*passed)++;
+    }
+
+    (*total)++;
+    for (int track = 1; result && track <= g64.track_max; track++) {
+        static const uint8_t sync[ZCC_G64_SYNC_SIZE] = {
+            0xff, 0xff, 0xff, 0xff, 0xff
+        };
+        uint8_t header[ZCC_SIXPACK_HEADER_DATA];
+        uint8_t sector[ZCC_SIXPACK_SECTOR_DATA];
+        uint8_t block[ZCC_D64_BLOCK_SIZE_RAW];
+        size_t size;
+        const uint8_t *gcr = zcc_g64_track(&g64, track, &size);
+
+        result = gcr != NULL
+            && size == zcc_g64_track_capacity(track)
+            && memcmp(gcr, sync, sizeof sync) == 0
+            && memcmp(gcr + ZCC_G64_SYNC_SIZE, six.tracks[track],
+                      ZCC_GCR_HEADER_SIZE) == 0;
+        if (result) {
+            zcc_gcr_decode(header, gcr + ZCC_G64_SYNC_SIZE,
+                           ZCC_GCR_HEADER_SIZE / ZCC_GCR_GROUP_SIZE);
+            zcc_gcr_decode(sector,
+                           gcr + ZCC_G64_SECTOR_SIZE - (ZCC_GCR_DATA_SIZE - 1),
+                           ZCC_SIXPACK_SECTOR_DATA / ZCC_GCR_GROUP_DATA);
+            result = zcc_d64_block_read(&d64, block, track, header[2])
+                && memcmp(block, sector + 1, sizeof block) == 0;
+        }
+    }
+    if (result) {
+        (*passed)++;
+    }
+
+    zcc_g64_free(&g64);
+    zcc_d64_free(&d64);
+    zcc_sixpack_free(&six);
+    return *passed - start == 2;
+}
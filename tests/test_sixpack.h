@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_sixpack.h
+ * \brief   Test SixPack zipcode handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_SIXPACK_H
+#define HAVE_TESTS_TEST_SIXPACK_H
+
+extern unit_module_t sixpack_module;
+
+#endif
@@ -0,0 +1,164 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_t64.c
+ * \brief   Test T64 handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/d64file.h"
+#include "../src/errors.h"
+#include "../src/io.h"
+#include "../src/t64.h"
+
+/** \brief  Temporary file for the T64 test
+ */
+#define T64_TMP     "test_t64.tmp"
+
+/** \brief  Number of directory entries of the test container
+ */
+#define T64_ENTRIES 3
+
+/** \brief  Size of the first file (without load address)
+ */
+#define FIRST_SIZE  700
+
+/** \brief  Size of the second file (without load address)
+ */
+#define SECOND_SIZE 20
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_t64_read(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "read", "Test reading a T64 container and converting it to D64",
+        test_t64_read, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t t64_module = {
+    "t64",
+    "Tests for the T64 code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Set directory entry \a index of \a t64
+ *
+ * \param[out]  t64     container data
+ * \param[in]   index   entry index
+ * \param[in]   name    PETSCII filename
+ * \param[in]   start   start address
+ * \param[in]   end     end address
+ * \param[in]   offset  offset of the file data
+ */
+static void dirent_set(uint8_t *t64, int index, const char *name,
+                       unsigned int start, unsigned int end, size_t offset)
+{
+    uint8_t *dirent = t64 + ZCC_T64_HEADER_SIZE + index * ZCC_T64_DIRENT_SIZE;
+
+    dirent[ZCC_T64_DIRENT_C64S_TYPE] = ZCC_T64_C64S_NORMAL;
+    dirent[ZCC_T64_DIRENT_FILETYPE] = 0x82;
+    dirent[ZCC_T64_DIRENT_START] = (uint8_t)(start & 0xff);
+    dirent[ZCC_T64_DIRENT_START + 1] = (uint8_t)(start >> 8);
+    dirent[ZCC_T64_DIRENT_END] = (uint8_t)(end & 0xff);
+    dirent[ZCC_T64_DIRENT_END + 1] = (uint8_t)(end >> 8);
+    dirent[ZCC_T64_DIRENT_OFFSET] = (uint8_t)(offset & 0xff);
+    dirent[ZCC_T64_DIRENT_OFFSET + 1] = (uint8_t)(offset >> 8);
+    memset(dirent + ZCC_T64_DIRENT_FILENAME, 0x20, 16);
+    memcpy(dirent + ZCC_T64_DIRENT_FILENAME, name, strlen(name));
+}
+
+
+/** \brief  Read a T64 container with a bogus end address and convert it
+ *
+ * The files are stored in reverse directory order, the first file has the
+ * infamous $c3c6 end address, the second one is followed by padding.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_t64_read(int *total, int *passed)
+{
+    static uint8_t data[ZCC_T64_HEADER_SIZE + T64_ENTRIES * ZCC_T64_DIRENT_SIZE
+                        + SECOND_SIZE + 4 + FIRST_SIZE];
+    static uint8_t buffer[FIRST_SIZE + 2];
+    size_t second = ZCC_T64_HEADER_SIZE + T64_ENTRIES * ZCC_T64_DIRENT_SIZE;
+    size_t first = second + SECOND_SIZE + 4;
+    zcc_t64_t t64;
+    zcc_d64_t d64;
+    zcc_d64_file_t file;
+    const uint8_t *dir;
+    int start = *passed;
+
+    memset(data, 0, sizeof data);
+    memcpy(data, "C64S tape image file", 20);
+    data[ZCC_T64_ENTRY_MAX] = T64_ENTRIES;
+    data[ZCC_T64_ENTRY_USED] = 2;
+    memset(data + ZCC_T64_TAPENAME, 0x20, ZCC_T64_TAPENAME_LEN);
+    memcpy(data + ZCC_T64_TAPENAME, "TEST TAPE", 9);
+    dirent_set(data, 0, "FIRST", 0x0801, 0xc3c6, first);
+    dirent_set(data, 2, "SECOND", 0xc000, 0xc000 + SECOND_SIZE, second);
+    for (size_t i = second; i < sizeof data; i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+
+    zcc_t64_init(&t64);
+    zcc_d64_init(&d64);
+
+    (*total)++;
+    if (zcc_fwrite(T64_TMP, data, sizeof data)
+            && zcc_t64_read(&t64, T64_TMP)
+            && strcmp(t64.name, "test tape") == 0
+            && t64.entry_count == 2
+            && strcmp(t64.entries[1].name, "second") == 0
+            && t64.entries[0].size == FIRST_SIZE
+            && t64.entries[1].size == SECOND_SIZE
+            && t64.fixed_sizes == 1) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+    remove(T64_TMP);
+
+    /* the first file has to come out with its load address */
+    (*total)++;
+    zcc_d64_alloc(&d64, ZCC_D64_TYPE_CBMDOS);
+    dir = d64.data + zcc_d64_block_offset(ZCC_D64_DIR_TRACK, ZCC_D64_DIR_SECTOR);
+    if (t64.entry_count == 2
+            && zcc_t64_to_d64(&t64, &d64) == 2
+            && zcc_d64_file_open_entry(&file, &d64, dir)
+            && zcc_d64_file_read(&file, buffer, sizeof buffer) == FIRST_SIZE + 2
+            && buffer[0] == 0x01 && buffer[1] == 0x08
+            && memcmp(buffer + 2, data + first, FIRST_SIZE) == 0
+            && zcc_d64_file_open_entry(&file, &d64, dir + ZCC_D64_DIRENT_SIZE)
+            && zcc_d64_file_length(&file) == SECOND_SIZE + 2) {
+        (*passed)++;
+    }
+
+    zcc_d64_free(&d64);
+    zcc_t64_free(&t64);
+    return *passed - start == 2;
+}
@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_t64.h
+ * \brief   Test T64 handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_T64_H
+#define HAVE_TESTS_TEST_T64_H
+
+extern unit_module_t t64_module;
+
+#endif
@@ -0,0 +1,362 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_zipdisk.c
+ * \brief   Test zipdisk handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/cbmdos.h"
+#include "../src/d64.h"
+#include "../src/d64file.h"
+#include "../src/errors.h"
+#include "../src/io.h"
+#include "../src/mem.h"
+#include "../src/petasc.h"
+#include "../src/zipcode.h"
+#include "../src/zipdisk.h"
+
+/** \brief  First slice of the test archive
+ */
+#define SPHERE      "data/zipdisk/1!SPHERE.Z64"
+
+/** \brief  D64 the test archive unpacks to
+ */
+#define SPHERE_D64  "data/zipdisk/sphere.d64"
+
+/** \brief  Temporary file for the unzipped D64
+ */
+#define ZIPDISK_TMP "test_zipdisk.tmp"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_zipdisk_unzip(int *, int *);
+static bool test_zipdisk_corrupt(int *, int *);
+static bool test_zipdisk_recover(int *, int *);
+static bool test_zipdisk_extract(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "unzip", "Test unzipping an archive to D64",
+        test_zipdisk_unzip, true },
+    { "corrupt", "Test unzipping an archive with a corrupt block header",
+        test_zipdisk_corrupt, true },
+    { "recover", "Test recovering from corrupt data and a missing slice",
+        test_zipdisk_recover, true },
+    { "extract", "Test extracting a single file from an archive",
+        test_zipdisk_extract, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t zipdisk_module = {
+    "zipdisk",
+    "Tests for the zipdisk code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Test unzipping the test archive
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_zipdisk_unzip(int *total, int *passed)
+{
+    zcc_zipdisk_t zip;
+    zcc_d64_t expected;
+    zcc_d64_t d64;
+    int start = *passed;
+
+    zcc_zipdisk_init(&zip);
+    zcc_d64_init(&expected);
+    zcc_d64_init(&d64);
+
+    (*total)++;
+    if (zcc_zipdisk_read(&zip, SPHERE)
+            && zcc_zipdisk_unzip(&zip, ZIPDISK_TMP)
+            && zip.bad_sectors == 0
+            && zcc_d64_read(&expected, SPHERE_D64, 0)
+            && zcc_d64_read(&d64, ZIPDISK_TMP, 0)
+            && d64.size == expected.size
+            && memcmp(d64.data, expected.data, d64.size) == 0) {
+        (*passed)++;
+    } else {
+        printf(".. %s\n", zcc_strerror(zcc_errno));
+    }
+    remove(ZIPDISK_TMP);
+
+    zcc_d64_free(&d64);
+    zcc_d64_free(&expected);
+    zcc_zipdisk_free(&zip);
+    return *passed - start == 1;
+}
+
+
+/** \brief  Test unzipping an archive with a corrupt block header
+ *
+ * Without recovery mode the iterator can't find the next block, which must
+ * fail the conversion instead of ending it like a normal end of archive.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_zipdisk_corrupt(int *total, int *passed)
+{
+    zcc_zipdisk_t zip;
+    int start = *passed;
+
+    zcc_zipdisk_init(&zip);
+
+    (*total)++;
+    if (zcc_zipdisk_read(&zip, SPHERE)) {
+        /* pack method %11 on the first block of the second slice */
+        zip.slices[1].data[2 + ZCC_ZIPDISK_TRACK] |= 0xc0;
+        if (!zcc_zipdisk_unzip(&zip, ZIPDISK_TMP)
+                && zcc_errno == ZCC_ERR_ZC_INVALID_PACK_METHOD) {
+            (*passed)++;
+        }
+    }
+    remove(ZIPDISK_TMP);
+
+    zcc_zipdisk_free(&zip);
+    return *passed - start == 1;
+}
+
+
+/** \brief  Count blocks of \a d64 flagged in its error info
+ *
+ * \param[in]   d64     D64 image
+ *
+ * \return  number of blocks with an error code other than 'OK'
+ */
+static int count_errors(const zcc_d64_t *d64)
+{
+    int count = 0;
+
+    if (d64->errors == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < d64->geometry->blocks; i++) {
+        if ((size_t)i * ZCC_D64_BLOCK_SIZE_RAW < d64->size
+                && d64->errors[i] != 0
+                && d64->errors[i] != ZCC_D64_ERROR_OK) {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+/** \brief  Unzip \a zip in recovery mode and read the result into \a d64
+ *
+ * \param[in,out]   zip     zipdisk handle
+ * \param[out]      d64     unzipped image
+ *
+ * \return  bool
+ */
+static bool unzip_recover(zcc_zipdisk_t *zip, zcc_d64_t *d64)
+{
+    bool result = zcc_zipdisk_unzip(zip, ZIPDISK_TMP)
+        && zcc_d64_read(d64, ZIPDISK_TMP, 0);
+
+    remove(ZIPDISK_TMP);
+    return result;
+}
+
+
+/** \brief  Test recovering from corrupt data and a missing slice
+ *
+ * A corrupt block header makes the iterator resynchronize, losing that block.
+ * A missing slice loses all its blocks. Lost blocks must be zero-filled and
+ * flagged as missing in the error info, and counted in \c zip.bad_sectors.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_zipdisk_recover(int *total, int *passed)
+{
+    static const uint8_t zero[ZCC_D64_BLOCK_SIZE_RAW];
+    zcc_zipdisk_t zip;
+    zcc_d64_t d64;
+    zcc_zipdisk_slice_t *slice;
+    uint8_t *header;
+    int index;
+    int lost;
+    int start = *passed;
+
+    /* corrupt header of the first block of the second slice */
+    zcc_zipdisk_init(&zip);
+    zcc_d64_init(&d64);
+    zip.recover = true;
+    (*total)++;
+    if (zcc_zipdisk_read(&zip, SPHERE)) {
+        header = zip.slices[1].data + 2;
+        index = zcc_d64_block_index(header[ZCC_ZIPDISK_TRACK] & 0x3f,
+                                    header[ZCC_ZIPDISK_SECTOR]);
+        header[ZCC_ZIPDISK_TRACK] |= 0xc0;
+        if (unzip_recover(&zip, &d64)
+                && zip.resyncs >= 1
+                && zip.bad_sectors >= 1
+                && zip.bad_sectors == count_errors(&d64)
+                && d64.errors[index] == ZCC_D64_ERROR_HEADER
+                && memcmp(d64.data + index * ZCC_D64_BLOCK_SIZE_RAW, zero,
+                          sizeof zero) == 0) {
+            (*passed)++;
+        } else {
+            printf(".. resync: %d resyncs, %d bad sectors, %d flagged\n",
+                   zip.resyncs, zip.bad_sectors, count_errors(&d64));
+        }
+    }
+    zcc_d64_free(&d64);
+    zcc_zipdisk_free(&zip);
+
+    /* third slice missing: exactly its blocks are lost */
+    zcc_zipdisk_init(&zip);
+    zcc_d64_init(&d64);
+    zip.recover = true;
+    (*total)++;
+    if (zcc_zipdisk_read(&zip, SPHERE)) {
+        bool ok = true;
+        size_t offset = 2;
+
+        slice = &(zip.slices[2]);
+        lost = 0;
+        while (offset < slice->size) {
+            long size = zcc_zipcode_block_size_256(slice->data + offset,
+                                                   slice->size - offset);
+            if (size < 0) {
+                ok = false;
+                break;
+            }
+            offset += (size_t)size;
+            lost++;
+        }
+        slice->size = 0;
+        zip.missing_slices = 1;
+        ok = ok && unzip_recover(&zip, &d64)
+            && zip.bad_sectors == lost
+            && count_errors(&d64) == lost;
+        /* the lost blocks are the ones flagged, and they're empty */
+        for (int i = 0; ok && i < d64.geometry->blocks; i++) {
+            if ((size_t)i * ZCC_D64_BLOCK_SIZE_RAW < d64.size
+                    && d64.errors[i] == ZCC_D64_ERROR_HEADER) {
+                ok = memcmp(d64.data + i * ZCC_D64_BLOCK_SIZE_RAW, zero,
+                            sizeof zero) == 0;
+            }
+        }
+        if (ok) {
+            (*passed)++;
+        } else {
+            printf(".. missing slice: %d blocks lost, %d bad sectors\n",
+                   lost, zip.bad_sectors);
+        }
+    }
+    zcc_d64_free(&d64);
+    zcc_zipdisk_free(&zip);
+
+    return *passed - start == 2;
+}
+
+
+/** \brief  Test extracting a single file from the test archive
+ *
+ * Extracts the largest PRG file and compares it with the same file read
+ * from the unpacked image, only the blocks of the directory and the file
+ * should be decoded.
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_zipdisk_extract(int *total, int *passed)
+{
+    static uint8_t buffer[ZCC_D64_BLOCKS_MAX * ZCC_D64_BLOCK_SIZE_DATA];
+    zcc_zipdisk_t zip;
+    zcc_zipdisk_index_t index;
+    zcc_d64_t d64;
+    zcc_d64_dirview_t view;
+    zcc_d64_file_t file;
+    const uint8_t *entry = NULL;
+    char name[ZCC_CBMDOS_FILENAME_MAX + 1];
+    uint8_t *data = NULL;
+    long expected = -1;
+    long size;
+    int start = *passed;
+
+    zcc_zipdisk_init(&zip);
+    zcc_d64_init(&d64);
+
+    /* largest PRG file in the unpacked image */
+    if (zcc_d64_read(&d64, SPHERE_D64, 0)
+            && zcc_d64_dirview_read(&view, &d64)) {
+        for (int i = 0; i < view.entry_count; i++) {
+            const uint8_t *e = view.entries[i];
+
+            if ((ZCC_D64_DIRENT_GET_FILETYPE(e) & ZCC_CBMDOS_FILETYPE_MASK)
+                        == ZCC_CBMDOS_FILETYPE_PRG
+                    && (entry == NULL
+                        || ZCC_D64_DIRENT_GET_BLOCKS(e)
+                            > ZCC_D64_DIRENT_GET_BLOCKS(entry))) {
+                entry = e;
+            }
+        }
+    }
+    if (entry != NULL && zcc_d64_file_open_entry(&file, &d64, entry)) {
+        expected = zcc_d64_file_read(&file, buffer, sizeof buffer);
+        zcc_d64_file_close(&file);
+    }
+
+    (*total)++;
+    if (expected > 0 && zcc_zipdisk_read(&zip, SPHERE)) {
+        zcc_pet_filename_to_host(name, ZCC_D64_DIRENT_GET_NAME(entry), NULL);
+        size = zcc_zipdisk_extract(&zip, name, ZIPDISK_TMP, &index);
+        printf(".. '%s': %ld bytes, %d of %d blocks decoded\n",
+               name, size, index.decoded, index.block_count);
+        if (size == expected
+                && zcc_fread_alloc(&data, ZIPDISK_TMP) == expected
+                && memcmp(data, buffer, (size_t)expected) == 0
+                && index.decoded < index.block_count) {
+            (*passed)++;
+        }
+    }
+    if (data != NULL) {
+        zcc_free(data);
+    }
+    remove(ZIPDISK_TMP);
+
+    /* unknown file */
+    (*total)++;
+    if (zcc_zipdisk_extract(&zip, "no such file", ZIPDISK_TMP, NULL) < 0
+            && zcc_errno == ZCC_ERR_FILE_NOT_FOUND) {
+        (*passed)++;
+    }
+    remove(ZIPDISK_TMP);
+
+    zcc_d64_free(&d64);
+    zcc_zipdisk_free(&zip);
+    return *passed - start == 2;
+}
@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_zipdisk.h
+ * \brief   Test zipdisk handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_ZIPDISK_H
+#define HAVE_TESTS_TEST_ZIPDISK_H
+
+extern unit_module_t zipdisk_module;
+
+#endif
@@ -0,0 +1,139 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_zipfile.c
+ * \brief   Test filepacked zipcode handling
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unit.h"
+
+#include "../src/d64.h"
+#include "../src/mem.h"
+#include "../src/errors.h"
+#include "../src/zipfile.h"
+
+#define HOOGO       "data/zipfile/x!hoogo"
+#define HOOGO_D64   "data/zipfile/zipfile-test-hoogo.d64"
+#define KOALA       "data/zipfile/a!koalapaintii"
+#define KOALA_D64   "data/zipfile/koala-painter-ii-zipfiled.d64"
+
+
+/*
+ * Forward declarations
+ */
+
+static bool test_zipfile_read(int *, int *);
+
+
+/** \brief  Test cases
+ */
+static unit_test_t tests[] = {
+    { "read", "Test decoding host files and files in a D64 image",
+        test_zipfile_read, true },
+    { NULL, NULL, NULL, NULL }
+};
+
+
+/** \brief  Module containing tests
+ */
+unit_module_t zipfile_module = {
+    "zipfile",
+    "Tests for the filepacked zipcode code",
+    NULL, NULL,
+    0, 0,
+    tests
+};
+
+
+/** \brief  Archive handle for the host files
+ */
+static zcc_zipfile_t zip_host;
+
+/** \brief  Archive handle for the copy in the D64 image
+ */
+static zcc_zipfile_t zip_d64;
+
+
+/** \brief  Read an archive from host files and from a D64 and compare
+ *
+ * Checks that each file decodes to the same data from both sources and
+ * that the number of blocks matches the directory.
+ *
+ * \param[in]   path    path to a part of the archive on the host
+ * \param[in]   image   path to D64 image containing the archive
+ * \param[in]   name    name of the archive in \a image
+ * \param[in]   files   expected number of files
+ *
+ * \return  bool
+ */
+static bool compare_archive(const char *path, const char *image,
+                            const char *name, int files)
+{
+    zcc_d64_t d64;
+    bool result;
+
+    zcc_zipfile_init(&zip_host);
+    zcc_zipfile_init(&zip_d64);
+    zcc_d64_init(&d64);
+
+    result = zcc_zipfile_read(&zip_host, path)
+        && zcc_d64_read(&d64, image, 0)
+        && zcc_zipfile_read_d64(&zip_d64, &d64, name)
+        && zip_host.file_count == files
+        && zip_d64.file_count == files;
+
+    for (int i = 0; result && i < files; i++) {
+        uint8_t *data_host;
+        uint8_t *data_d64;
+        long size_host = zcc_zipfile_file_read(&zip_host, i, &data_host);
+        long size_d64 = zcc_zipfile_file_read(&zip_d64, i, &data_d64);
+
+        if (size_host < 0 || size_d64 < 0) {
+            result = false;
+            break;
+        }
+        result = size_host == size_d64
+            && memcmp(data_host, data_d64, (size_t)size_host) == 0
+            && zip_host.files[i].block_count == zip_host.files[i].blocks
+            && (size_host + ZCC_D64_BLOCK_SIZE_DATA - 1)
+                / ZCC_D64_BLOCK_SIZE_DATA == zip_host.files[i].blocks;
+        zcc_free(data_host);
+        zcc_free(data_d64);
+    }
+    printf(".. %s: %d files, %s\n", name, zip_host.file_count,
+           result ? "OK" : zcc_strerror(zcc_errno));
+
+    zcc_d64_free(&d64);
+    zcc_zipfile_free(&zip_host);
+    zcc_zipfile_free(&zip_d64);
+    return result;
+}
+
+
+/** \brief  Test decoding the sample archives
+ *
+ * \param[out]  total   total number of subtests
+ * \param[out]  passed  number of passed subtests
+ *
+ * \return  bool
+ */
+static bool test_zipfile_read(int *total, int *passed)
+{
+    int start = *passed;
+
+    (*total)++;
+    if (compare_archive(HOOGO, HOOGO_D64, "hoogo", 5)) {
+        (*passed)++;
+    }
+    (*total)++;
+    if (compare_archive(KOALA, KOALA_D64, "koalapaintii", 22)) {
+        (*passed)++;
+    }
+    return *passed - start == 2;
+}
@@ -0,0 +1,12 @@
+/* vim: set et ts=4 sw=4 sts=4 fdm=marker syntax=c.doxygen: */
+
+/** \file   test_zipfile.h
+ * \brief   Test filepacked zipcode handling - header
+ */
+
+#ifndef HAVE_TESTS_TEST_ZIPFILE_H
+#define HAVE_TESTS_TEST_ZIPFILE_H
+
+extern unit_module_t zipfile_module;
+
+#endif
@@ -18,6 +18,19 @@
  */
 #include "test_unittest.h"
 #include "test_d64.h"
+#include "test_bam.h"
+#include "test_d64file.h"
+#include "test_zipfile.h"
+#include "test_sixpack.h"
+#include "test_g64.h"
+#include "test_t64.h"
+#include "test_lnx.h"
+#include "test_ark.h"
+#include "test_pc64.h"
+#include "test_geos.h"
+#include "test_d64map.h"
+#include "test_zipdisk.h"
+#include "test_pool.h"
 #if 0
 #include "test_mem.h"
 #include "test_io.h"
@@ -68,6 +81,19 @@ static void register_modules(void)
 
     unit_module_add(&unittest_module);
     unit_module_add(&d64_module);
+    unit_module_add(&bam_module);
+    unit_module_add(&d64file_module);
+    unit_module_add(&zipfile_module);
+    unit_module_add(&sixpack_module);
+    unit_module_add(&g64_module);
+    unit_module_add(&t64_module);
+    unit_module_add(&lnx_module);
+    unit_module_add(&ark_module);
+    unit_module_add(&pc64_module);
+    unit_module_add(&geos_module);
+    unit_module_add(&d64map_module);
+    unit_module_add(&zipdisk_module);
+    unit_module_add(&pool_module);
 #if 0
     unit_module_add(&mem_module);
     unit_module_add(&io_module);